@@ -0,0 +1,435 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Connection Manager - WiFi/MQTT recovery state machine
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_wifi.h"
+#include "esp_event.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_mac.h"
+#include "nvs.h"
+#include "conn_manager.h"
+#include "halo_metrics.h"
+
+static const char *TAG = "conn_mgr";
+
+/* ============================================================================
+   STATE
+   ============================================================================
+   All state transitions run in the default event loop task. The backoff
+   timer and the MQTT notifications post CONN_EVENTs instead of touching
+   state directly, so no locking is needed.
+   ============================================================================ */
+
+#define NVS_NAMESPACE       "conn"
+#define NVS_KEY_AP          "ap"
+
+ESP_EVENT_DEFINE_BASE(CONN_EVENT);
+
+enum {
+    CONN_EVENT_RETRY = 0,           /* Backoff expired / first attempt */
+    CONN_EVENT_MQTT_ATTACH,         /* Data: esp_mqtt_client_handle_t */
+    CONN_EVENT_MQTT_UP,
+    CONN_EVENT_MQTT_DOWN,
+};
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+} cached_ap_t;
+
+static volatile conn_state_t s_state = CONN_STATE_IDLE;
+static volatile bool s_has_ip = false;
+static volatile bool s_degraded = false;
+
+static cached_ap_t s_ap;
+static bool s_ap_valid = false;
+static bool s_fast_pending = false;     /* Next attempt should use the cached AP */
+static bool s_attempt_fast = false;     /* Attempt in flight uses the cached AP */
+
+static uint32_t s_failures = 0;         /* Consecutive failed attempts */
+static uint32_t s_backoff_ms = CONN_BACKOFF_MIN_MS;
+static int64_t s_ip_up_us = 0;          /* When the current address arrived */
+static esp_timer_handle_t s_retry_timer = NULL;
+
+#if CONFIG_HALO_MQTT
+static esp_mqtt_client_handle_t s_mqtt = NULL;
+static bool s_mqtt_started = false;
+#endif
+static bool s_mqtt_connected = false;
+
+/* Recovery measurement: link loss -> commands flowing */
+static int64_t s_loss_us = 0;
+static uint32_t s_link_losses = 0;
+static metrics_histogram_t s_recovery_hist = METRICS_HISTOGRAM_INIT("net_recovery", "ms");
+
+/* ============================================================================
+   CACHED ACCESS POINT (NVS)
+   ============================================================================ */
+
+static void cached_ap_load(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    size_t size = sizeof(s_ap);
+    s_ap_valid = (nvs_get_blob(handle, NVS_KEY_AP, &s_ap, &size) == ESP_OK && size == sizeof(s_ap));
+    nvs_close(handle);
+
+    if (s_ap_valid) {
+        ESP_LOGI(TAG, "Cached AP " MACSTR " on channel %d", MAC2STR(s_ap.bssid), s_ap.channel);
+    }
+}
+
+static void cached_ap_store(const uint8_t *bssid, uint8_t channel)
+{
+    if (s_ap_valid && memcmp(s_ap.bssid, bssid, 6) == 0 && s_ap.channel == channel) {
+        return;  /* Unchanged - don't wear flash */
+    }
+    memcpy(s_ap.bssid, bssid, 6);
+    s_ap.channel = channel;
+    s_ap_valid = true;
+
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
+        nvs_set_blob(handle, NVS_KEY_AP, &s_ap, sizeof(s_ap));
+        nvs_commit(handle);
+        nvs_close(handle);
+    }
+}
+
+/* ============================================================================
+   STATE MACHINE HELPERS
+   ============================================================================ */
+
+static void set_state(conn_state_t state)
+{
+    if (s_state != state) {
+        ESP_LOGD(TAG, "%s -> %s", conn_manager_state_to_string(s_state),
+                 conn_manager_state_to_string(state));
+        s_state = state;
+    }
+}
+
+static void link_lost(const char *what)
+{
+    if (s_loss_us == 0) {
+        s_loss_us = esp_timer_get_time();
+        s_link_losses++;
+        ESP_LOGW(TAG, "Link lost (%s) - recovering", what);
+    }
+}
+
+/* Commands are flowing again: close out the recovery measurement */
+static void went_online(void)
+{
+    set_state(CONN_STATE_ONLINE);
+    if (s_loss_us != 0) {
+        uint32_t ms = (uint32_t)((esp_timer_get_time() - s_loss_us) / 1000);
+        metrics_hist_record(&s_recovery_hist, ms);
+        ESP_LOGI(TAG, "Recovered in %lu ms", (unsigned long)ms);
+        s_loss_us = 0;
+    }
+}
+
+static void attempt_connect(void)
+{
+    wifi_config_t cfg;
+    if (esp_wifi_get_config(WIFI_IF_STA, &cfg) != ESP_OK) {
+        return;
+    }
+
+    /* Fast path: skip the scan and go straight to the AP we last used */
+    bool fast = s_fast_pending && s_ap_valid;
+    s_fast_pending = false;
+    s_attempt_fast = fast;
+    cfg.sta.bssid_set = fast;
+    if (fast) {
+        memcpy(cfg.sta.bssid, s_ap.bssid, sizeof(s_ap.bssid));
+        cfg.sta.channel = s_ap.channel;
+    } else {
+        cfg.sta.channel = 0;
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &cfg);
+
+    set_state(CONN_STATE_ASSOCIATING);
+    esp_err_t err = esp_wifi_connect();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "esp_wifi_connect failed: %s", esp_err_to_name(err));
+    }
+}
+
+static void schedule_retry(void)
+{
+    if (s_failures >= CONN_DEGRADED_AFTER && !s_degraded) {
+        s_degraded = true;
+        ESP_LOGW(TAG, "");
+        ESP_LOGW(TAG, "╔══════════════════════════════════════════════════════════╗");
+        ESP_LOGW(TAG, "║  ⚠️  DEGRADED MODE - %2lu failed attempts                  ║",
+                 (unsigned long)s_failures);
+        ESP_LOGW(TAG, "║  Local control keeps working, retrying in background    ║");
+        ESP_LOGW(TAG, "╚══════════════════════════════════════════════════════════╝");
+    }
+
+    /* Equal jitter: half the backoff fixed, half random, so a house full of
+       devices doesn't hammer the AP in lockstep after it reboots */
+    uint32_t half = s_backoff_ms / 2;
+    uint32_t delay_ms = half + (esp_random() % (half + 1));
+    if (s_backoff_ms < CONN_BACKOFF_MAX_MS) {
+        s_backoff_ms = (s_backoff_ms * 2 > CONN_BACKOFF_MAX_MS) ? CONN_BACKOFF_MAX_MS : s_backoff_ms * 2;
+    }
+
+    set_state(s_degraded ? CONN_STATE_DEGRADED : CONN_STATE_BACKOFF);
+    ESP_LOGI(TAG, "Retry %lu in %lu ms", (unsigned long)s_failures, (unsigned long)delay_ms);
+    esp_timer_stop(s_retry_timer);
+    esp_timer_start_once(s_retry_timer, (uint64_t)delay_ms * 1000);
+}
+
+static void kick_mqtt(void)
+{
+#if !CONFIG_HALO_MQTT
+    went_online();      /* Built without MQTT: an IP address is as online as it gets */
+#else
+    if (s_mqtt == NULL) {
+        return;
+    }
+    if (s_mqtt_connected) {
+        /* The TCP session survived the blip (same DHCP lease) */
+        went_online();
+        return;
+    }
+    set_state(CONN_STATE_WAIT_MQTT);
+    if (!s_mqtt_started) {
+        esp_mqtt_client_start(s_mqtt);
+        s_mqtt_started = true;
+    } else {
+        /* Skip esp-mqtt's reconnect timer - the network is back now */
+        esp_mqtt_client_reconnect(s_mqtt);
+    }
+#endif
+}
+
+/* ============================================================================
+   EVENT HANDLERS
+   ============================================================================ */
+
+static void on_disconnected(void)
+{
+    s_has_ip = false;
+
+    switch (s_state) {
+        case CONN_STATE_ASSOCIATING:
+            s_failures++;
+            if (s_attempt_fast) {
+                /* AP moved channel or was replaced - try a full scan right away */
+                ESP_LOGI(TAG, "Cached AP unreachable, falling back to full scan");
+                attempt_connect();
+            } else {
+                schedule_retry();
+            }
+            break;
+
+        case CONN_STATE_WAIT_IP:
+            /* Associated but never got an address (no DHCP answer, or the AP
+               kicked us right away): a failed attempt, so it backs off and
+               eventually degrades instead of looping. The AP itself answered,
+               so the next attempt goes straight to it. */
+            link_lost("wifi");
+            s_failures++;
+            s_fast_pending = true;
+            schedule_retry();
+            break;
+
+        case CONN_STATE_BACKOFF:
+        case CONN_STATE_DEGRADED:
+            break;  /* Already waiting for the next attempt */
+
+        default:
+            link_lost("wifi");
+            s_fast_pending = true;
+            if (esp_timer_get_time() - s_ip_up_us >= (int64_t)CONN_STABLE_MS * 1000) {
+                /* Link had been up a while: reconnect immediately to the AP
+                   we were just on */
+                s_failures = 0;
+                s_backoff_ms = CONN_BACKOFF_MIN_MS;
+                attempt_connect();
+            } else {
+                /* Dropped soon after coming up (an AP that lets us in, then
+                   kicks us): a failed attempt, so it backs off and degrades */
+                s_failures++;
+                schedule_retry();
+            }
+            break;
+    }
+}
+
+static void conn_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    if (base == WIFI_EVENT && id == WIFI_EVENT_STA_CONNECTED) {
+        wifi_event_sta_connected_t *ev = (wifi_event_sta_connected_t *)data;
+        cached_ap_store(ev->bssid, ev->channel);
+        set_state(CONN_STATE_WAIT_IP);
+    } else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED) {
+        on_disconnected();
+    } else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
+        s_has_ip = true;
+        s_ip_up_us = esp_timer_get_time();  /* Backoff resets once this proves stable */
+        if (s_degraded) {
+            ESP_LOGI(TAG, "Network back - leaving degraded mode");
+            s_degraded = false;
+        }
+        set_state(CONN_STATE_WAIT_MQTT);
+        kick_mqtt();
+    } else if (base == IP_EVENT && id == IP_EVENT_STA_LOST_IP) {
+        s_has_ip = false;
+        link_lost("ip");
+        if (s_state == CONN_STATE_ONLINE || s_state == CONN_STATE_WAIT_MQTT) {
+            set_state(CONN_STATE_WAIT_IP);
+        }
+    } else if (base == CONN_EVENT) {
+        switch (id) {
+            case CONN_EVENT_RETRY:
+                if (s_state == CONN_STATE_IDLE || s_state == CONN_STATE_BACKOFF ||
+                    s_state == CONN_STATE_DEGRADED) {
+                    attempt_connect();
+                }
+                break;
+#if CONFIG_HALO_MQTT
+            case CONN_EVENT_MQTT_ATTACH:
+                s_mqtt = *(esp_mqtt_client_handle_t *)data;
+                if (s_has_ip) {
+                    kick_mqtt();
+                }
+                break;
+#endif
+            case CONN_EVENT_MQTT_UP:
+                s_mqtt_connected = true;
+                if (s_has_ip) {
+                    went_online();
+                }
+                break;
+            case CONN_EVENT_MQTT_DOWN:
+                s_mqtt_connected = false;
+                if (s_state == CONN_STATE_ONLINE) {
+                    link_lost("mqtt");
+                    set_state(CONN_STATE_WAIT_MQTT);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void retry_timer_callback(void *arg)
+{
+    esp_event_post(CONN_EVENT, CONN_EVENT_RETRY, NULL, 0, 0);
+}
+
+/* ============================================================================
+   PUBLIC API
+   ============================================================================ */
+
+esp_err_t conn_manager_init(void)
+{
+    cached_ap_load();
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = retry_timer_callback,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "conn_retry",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &s_retry_timer);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ret = esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, conn_event_handler, NULL);
+    if (ret == ESP_OK) {
+        ret = esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, conn_event_handler, NULL);
+    }
+    if (ret == ESP_OK) {
+        ret = esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, conn_event_handler, NULL);
+    }
+    if (ret == ESP_OK) {
+        ret = esp_event_handler_register(IP_EVENT, IP_EVENT_STA_LOST_IP, conn_event_handler, NULL);
+    }
+    if (ret == ESP_OK) {
+        ret = esp_event_handler_register(CONN_EVENT, ESP_EVENT_ANY_ID, conn_event_handler, NULL);
+    }
+    return ret;
+}
+
+void conn_manager_start(void)
+{
+    s_fast_pending = true;
+    esp_event_post(CONN_EVENT, CONN_EVENT_RETRY, NULL, 0, portMAX_DELAY);
+}
+
+#if CONFIG_HALO_MQTT
+void conn_manager_attach_mqtt(esp_mqtt_client_handle_t client)
+{
+    esp_event_post(CONN_EVENT, CONN_EVENT_MQTT_ATTACH, &client, sizeof(client), portMAX_DELAY);
+}
+#endif
+
+void conn_manager_notify_mqtt_connected(void)
+{
+    esp_event_post(CONN_EVENT, CONN_EVENT_MQTT_UP, NULL, 0, portMAX_DELAY);
+}
+
+void conn_manager_notify_mqtt_disconnected(void)
+{
+    esp_event_post(CONN_EVENT, CONN_EVENT_MQTT_DOWN, NULL, 0, portMAX_DELAY);
+}
+
+conn_state_t conn_manager_get_state(void)
+{
+    return s_state;
+}
+
+const char* conn_manager_state_to_string(conn_state_t state)
+{
+    switch (state) {
+        case CONN_STATE_IDLE:        return "IDLE";
+        case CONN_STATE_ASSOCIATING: return "ASSOCIATING";
+        case CONN_STATE_WAIT_IP:     return "WAIT_IP";
+        case CONN_STATE_WAIT_MQTT:   return "WAIT_MQTT";
+        case CONN_STATE_ONLINE:      return "ONLINE";
+        case CONN_STATE_BACKOFF:     return "BACKOFF";
+        case CONN_STATE_DEGRADED:    return "DEGRADED";
+        default:                     return "UNKNOWN";
+    }
+}
+
+bool conn_manager_has_ip(void)
+{
+    return s_has_ip;
+}
+
+bool conn_manager_is_degraded(void)
+{
+    return s_degraded;
+}
+
+void conn_manager_print_status(void)
+{
+    ESP_LOGI(TAG, "State: %s%s, IP: %s, MQTT: %s",
+             conn_manager_state_to_string(s_state), s_degraded ? " (degraded)" : "",
+             s_has_ip ? "yes" : "no", s_mqtt_connected ? "connected" : "down");
+    if (s_ap_valid) {
+        ESP_LOGI(TAG, "Cached AP: " MACSTR " channel %d", MAC2STR(s_ap.bssid), s_ap.channel);
+    } else {
+        ESP_LOGI(TAG, "Cached AP: none");
+    }
+    ESP_LOGI(TAG, "Link losses: %lu, consecutive failures: %lu, next backoff: %lu ms",
+             (unsigned long)s_link_losses, (unsigned long)s_failures,
+             (unsigned long)s_backoff_ms);
+    metrics_hist_print(&s_recovery_hist);
+}
@@ -0,0 +1,127 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Connection Manager - WiFi/MQTT recovery state machine
+ *
+ * Owns the reconnect policy for the station interface and the MQTT client:
+ *   - first retry after a link loss goes straight to the cached BSSID/channel
+ *   - further retries use jittered exponential backoff
+ *   - MQTT is kicked as soon as an IP address is back
+ *   - after repeated failures it drops into DEGRADED mode, which keeps
+ *     retrying slowly while local control (encoder, Zigbee, Matter on LAN)
+ *     carries on untouched
+ * The time from link loss to commands flowing again is recorded as a histogram.
+ */
+
+#ifndef CONN_MANAGER_H
+#define CONN_MANAGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#if CONFIG_HALO_MQTT
+#include "mqtt_client.h"
+#endif
+
+/* ============================================================================
+   CONNECTION MANAGER CONFIGURATION
+   ============================================================================ */
+
+#define CONN_BACKOFF_MIN_MS         500     /* First backoff after a failed attempt */
+#define CONN_BACKOFF_MAX_MS         60000   /* Backoff ceiling */
+#define CONN_DEGRADED_AFTER         6       /* Consecutive failures before DEGRADED */
+#define CONN_STABLE_MS              60000   /* Link up this long before a drop resets the backoff */
+#define CONN_MQTT_RETRY_MS          2000    /* esp-mqtt's own retry while IP is up */
+
+/* ============================================================================
+   CONNECTION STATES
+   ============================================================================ */
+
+typedef enum {
+    CONN_STATE_IDLE = 0,        /* Not started */
+    CONN_STATE_ASSOCIATING,     /* esp_wifi_connect() in flight */
+    CONN_STATE_WAIT_IP,         /* Associated, waiting for DHCP */
+    CONN_STATE_WAIT_MQTT,       /* IP up, MQTT (re)connecting */
+    CONN_STATE_ONLINE,          /* MQTT connected - commands flowing (IP up without MQTT) */
+    CONN_STATE_BACKOFF,         /* Waiting before the next attempt */
+    CONN_STATE_DEGRADED,        /* Repeated failures - local control only, slow retries */
+} conn_state_t;
+
+/* ============================================================================
+   LIFECYCLE
+   ============================================================================ */
+
+/**
+ * @brief Register WiFi/IP event handlers and load the cached AP
+ *
+ * Call after esp_wifi_init() and before esp_wifi_start().
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t conn_manager_init(void);
+
+/**
+ * @brief Make the first connection attempt
+ *
+ * Uses the cached BSSID/channel when one is stored.
+ */
+void conn_manager_start(void);
+
+#if CONFIG_HALO_MQTT
+/**
+ * @brief Hand the MQTT client to the connection manager
+ *
+ * The client is started on the first IP address and reconnected
+ * immediately whenever the IP comes back after a loss.
+ *
+ * @param client Initialized (not yet started) MQTT client
+ */
+void conn_manager_attach_mqtt(esp_mqtt_client_handle_t client);
+#endif
+
+/* ============================================================================
+   MQTT NOTIFICATIONS (call from the MQTT event handler)
+   ============================================================================ */
+
+/**
+ * @brief MQTT is connected and subscribed - commands are flowing
+ */
+void conn_manager_notify_mqtt_connected(void);
+
+/**
+ * @brief MQTT connection dropped
+ */
+void conn_manager_notify_mqtt_disconnected(void);
+
+/* ============================================================================
+   STATUS
+   ============================================================================ */
+
+/**
+ * @brief Get the current connection state
+ */
+conn_state_t conn_manager_get_state(void);
+
+/**
+ * @brief Get the state as a human-readable string
+ */
+const char* conn_manager_state_to_string(conn_state_t state);
+
+/**
+ * @brief Check if the station has an IP address
+ */
+bool conn_manager_has_ip(void);
+
+/**
+ * @brief Check if the manager has given up on fast recovery
+ */
+bool conn_manager_is_degraded(void);
+
+/**
+ * @brief Log state, cached AP and the recovery-time histogram
+ */
+void conn_manager_print_status(void);
+
+#endif /* CONN_MANAGER_H */
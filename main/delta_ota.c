@@ -0,0 +1,429 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Delta OTA - Firmware updates from compressed binary patches
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_app_desc.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "esp_delta_ota.h"
+#include "nvs.h"
+#include "delta_ota.h"
+#include "radio_policy.h"
+#include "halo_tasks.h"
+
+static const char *TAG = "delta_ota";
+
+/* ============================================================================
+   STATE
+   ============================================================================
+   Everything the update path needs is allocated statically so RAM use is
+   fixed regardless of image or patch size. The patch decoder keeps its own
+   bounded heatshrink window inside esp_delta_ota.
+   ============================================================================ */
+
+#define NVS_NAMESPACE           "ota"
+#define NVS_KEY_LAST_DELTA      "last_delta"
+#define NVS_KEY_LAST_FULL       "last_full"
+
+#define OTA_HTTP_TIMEOUT_MS     15000
+#define OTA_REBOOT_DELAY_MS     2000
+
+static uint8_t s_stream_buf[DELTA_OTA_STREAM_BUF_SIZE];
+static char s_url[DELTA_OTA_URL_MAX_LEN];
+static bool s_is_delta = false;
+static volatile bool s_in_progress = false;
+
+static const esp_partition_t *s_running = NULL;
+static const esp_partition_t *s_target = NULL;
+static esp_ota_handle_t s_ota_handle = 0;
+static uint32_t s_image_bytes = 0;
+
+static delta_ota_stats_t s_last_stats = { 0 };
+
+/* ============================================================================
+   STATS PERSISTENCE
+   ============================================================================ */
+
+static void stats_save(const delta_ota_stats_t *stats)
+{
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    nvs_set_blob(handle, stats->is_delta ? NVS_KEY_LAST_DELTA : NVS_KEY_LAST_FULL,
+                 stats, sizeof(*stats));
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+static bool stats_load(const char *key, delta_ota_stats_t *out)
+{
+    nvs_handle_t handle;
+    memset(out, 0, sizeof(*out));
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    size_t size = sizeof(*out);
+    esp_err_t ret = nvs_get_blob(handle, key, out, &size);
+    nvs_close(handle);
+    return ret == ESP_OK && size == sizeof(*out);
+}
+
+/* ============================================================================
+   PATCH CALLBACKS (called from inside esp_delta_ota_feed_patch)
+   ============================================================================ */
+
+/* Read a chunk of the old image straight from the running partition */
+static esp_err_t patch_read_cb(uint8_t *buf_p, size_t size, int src_offset)
+{
+    if (size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return esp_partition_read(s_running, src_offset, buf_p, size);
+}
+
+/* Write reconstructed image bytes into the update partition */
+static esp_err_t patch_write_cb(const uint8_t *buf_p, size_t size, void *user_data)
+{
+    (void)user_data;
+    if (size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = esp_ota_write(s_ota_handle, buf_p, size);
+    if (ret == ESP_OK) {
+        s_image_bytes += size;
+    }
+    return ret;
+}
+
+/* ============================================================================
+   DOWNLOAD HELPERS
+   ============================================================================ */
+
+/* Read exactly len bytes (or fail) - used for the fixed patch header */
+static int http_read_exact(esp_http_client_handle_t client, uint8_t *buf, int len)
+{
+    int total = 0;
+    while (total < len) {
+        int n = esp_http_client_read(client, (char *)buf + total, len - total);
+        if (n <= 0) {
+            return -1;
+        }
+        total += n;
+    }
+    return total;
+}
+
+static esp_err_t check_patch_header(const delta_ota_header_t *hdr)
+{
+    if (memcmp(hdr->magic, DELTA_OTA_MAGIC, 4) != 0) {
+        ESP_LOGE(TAG, "Not a delta patch (bad magic)");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (hdr->version != DELTA_OTA_HEADER_VERSION ||
+        hdr->compression != DELTA_OTA_COMPRESSION_HEATSHRINK) {
+        ESP_LOGE(TAG, "Unsupported patch (version %d, compression %d)",
+                 hdr->version, hdr->compression);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (hdr->new_image_size > s_target->size) {
+        ESP_LOGE(TAG, "New image (%lu bytes) does not fit partition '%s' (%lu bytes)",
+                 (unsigned long)hdr->new_image_size, s_target->label,
+                 (unsigned long)s_target->size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    /* The patch only makes sense against the exact build that is running */
+    const esp_app_desc_t *app = esp_app_get_description();
+    if (memcmp(hdr->base_elf_sha256, app->app_elf_sha256, sizeof(hdr->base_elf_sha256)) != 0) {
+        ESP_LOGE(TAG, "Patch was generated for a different base image");
+        return ESP_ERR_INVALID_VERSION;
+    }
+    return ESP_OK;
+}
+
+/* ============================================================================
+   UPDATE TASK
+   ============================================================================ */
+
+static esp_err_t run_update(uint32_t *download_bytes)
+{
+    esp_err_t ret;
+    esp_delta_ota_handle_t patch = NULL;
+
+    s_running = esp_ota_get_running_partition();
+    s_target = esp_ota_get_next_update_partition(NULL);
+    if (s_running == NULL || s_target == NULL) {
+        ESP_LOGE(TAG, "No OTA partition available (check partitions.csv)");
+        return ESP_ERR_NOT_FOUND;
+    }
+    ESP_LOGI(TAG, "Running from '%s', writing to '%s'", s_running->label, s_target->label);
+
+    esp_http_client_config_t http_cfg = {
+        .url = s_url,
+        .timeout_ms = OTA_HTTP_TIMEOUT_MS,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .keep_alive_enable = true,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&http_cfg);
+    if (client == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ret = esp_http_client_open(client, 0);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "HTTP open failed: %s", esp_err_to_name(ret));
+        esp_http_client_cleanup(client);
+        return ret;
+    }
+    int64_t content_length = esp_http_client_fetch_headers(client);
+    int status = esp_http_client_get_status_code(client);
+    if (status != 200) {
+        ESP_LOGE(TAG, "HTTP status %d", status);
+        ret = ESP_FAIL;
+        goto cleanup_http;
+    }
+    ESP_LOGI(TAG, "Downloading %s (%lld bytes)", s_is_delta ? "patch" : "image", content_length);
+
+    /* Patches are validated before anything is erased */
+    if (s_is_delta) {
+        delta_ota_header_t hdr;
+        if (http_read_exact(client, (uint8_t *)&hdr, sizeof(hdr)) != sizeof(hdr)) {
+            ret = ESP_ERR_INVALID_SIZE;
+            goto cleanup_http;
+        }
+        *download_bytes += sizeof(hdr);
+        ret = check_patch_header(&hdr);
+        if (ret != ESP_OK) {
+            goto cleanup_http;
+        }
+        ESP_LOGI(TAG, "Patch: %lu bytes -> image: %lu bytes",
+                 (unsigned long)hdr.patch_size, (unsigned long)hdr.new_image_size);
+    }
+
+    ret = esp_ota_begin(s_target, OTA_SIZE_UNKNOWN, &s_ota_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_begin failed: %s", esp_err_to_name(ret));
+        goto cleanup_http;
+    }
+
+    if (s_is_delta) {
+        esp_delta_ota_cfg_t patch_cfg = {
+            .read_cb = patch_read_cb,
+            .write_cb_with_user_data = patch_write_cb,
+            .user_data = NULL,
+        };
+        patch = esp_delta_ota_init(&patch_cfg);
+        if (patch == NULL) {
+            ret = ESP_ERR_NO_MEM;
+            goto cleanup_ota;
+        }
+    }
+
+    /* Stream: network -> (patch decoder) -> update partition */
+    while (1) {
+        int n = esp_http_client_read(client, (char *)s_stream_buf, sizeof(s_stream_buf));
+        if (n < 0) {
+            ESP_LOGE(TAG, "Download error after %lu bytes", (unsigned long)*download_bytes);
+            ret = ESP_FAIL;
+            goto cleanup_ota;
+        }
+        if (n == 0) {
+            if (esp_http_client_is_complete_data_received(client)) {
+                break;
+            }
+            ESP_LOGE(TAG, "Connection closed before download completed");
+            ret = ESP_FAIL;
+            goto cleanup_ota;
+        }
+        *download_bytes += n;
+
+        if (s_is_delta) {
+            ret = esp_delta_ota_feed_patch(patch, s_stream_buf, n);
+        } else {
+            ret = patch_write_cb(s_stream_buf, n, NULL);
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Apply failed at %lu bytes: %s",
+                     (unsigned long)*download_bytes, esp_err_to_name(ret));
+            goto cleanup_ota;
+        }
+    }
+
+    if (s_is_delta) {
+        ret = esp_delta_ota_finalize(patch);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Patch finalize failed: %s", esp_err_to_name(ret));
+            goto cleanup_ota;
+        }
+        esp_delta_ota_deinit(patch);
+        patch = NULL;
+    }
+
+    /* esp_ota_end validates the image (header, segments, hash) */
+    ret = esp_ota_end(s_ota_handle);
+    s_ota_handle = 0;
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Image validation failed: %s", esp_err_to_name(ret));
+        goto cleanup_http;
+    }
+    ret = esp_ota_set_boot_partition(s_target);
+    goto cleanup_http;
+
+cleanup_ota:
+    if (patch != NULL) {
+        esp_delta_ota_deinit(patch);
+    }
+    if (s_ota_handle != 0) {
+        esp_ota_abort(s_ota_handle);
+        s_ota_handle = 0;
+    }
+cleanup_http:
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    return ret;
+}
+
+static void ota_job(void *arg)
+{
+    delta_ota_stats_t stats = {
+        .valid = true,
+        .is_delta = s_is_delta,
+    };
+
+    s_image_bytes = 0;
+    int64_t start_us = esp_timer_get_time();
+    radio_policy_streaming_begin();
+    stats.result = run_update(&stats.download_bytes);
+    radio_policy_streaming_end();
+    stats.elapsed_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    stats.image_bytes = s_image_bytes;
+
+    s_last_stats = stats;
+    stats_save(&stats);
+
+    if (stats.result == ESP_OK) {
+        ESP_LOGI(TAG, "");
+        ESP_LOGI(TAG, "╔══════════════════════════════════════════════════════════╗");
+        ESP_LOGI(TAG, "║  ✅ %s UPDATE COMPLETE                                ║",
+                 stats.is_delta ? "DELTA" : "FULL ");
+        ESP_LOGI(TAG, "╚══════════════════════════════════════════════════════════╝");
+        delta_ota_print_stats();
+        ESP_LOGI(TAG, "Rebooting into new firmware...");
+        vTaskDelay(pdMS_TO_TICKS(OTA_REBOOT_DELAY_MS));
+        esp_restart();
+    }
+
+    ESP_LOGE(TAG, "Update failed: %s (%lu bytes downloaded, %lu ms)",
+             esp_err_to_name(stats.result), (unsigned long)stats.download_bytes,
+             (unsigned long)stats.elapsed_ms);
+    s_in_progress = false;
+}
+
+static esp_err_t start_update(const char *url, bool is_delta)
+{
+    if (url == NULL || url[0] == '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (strlen(url) >= sizeof(s_url)) {
+        ESP_LOGE(TAG, "URL too long (max %d chars)", DELTA_OTA_URL_MAX_LEN - 1);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (s_in_progress) {
+        ESP_LOGW(TAG, "Update already in progress");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_in_progress = true;
+    strlcpy(s_url, url, sizeof(s_url));
+    s_is_delta = is_delta;
+
+    /* Runs on the job task (static stack, see halo_tasks.h) */
+    esp_err_t err = halo_job_submit(ota_job, NULL);
+    if (err != ESP_OK) {
+        s_in_progress = false;
+        return err;
+    }
+    ESP_LOGI(TAG, "Starting %s update from %s", is_delta ? "delta" : "full-image", url);
+    return ESP_OK;
+}
+
+/* ============================================================================
+   PUBLIC API
+   ============================================================================ */
+
+esp_err_t delta_ota_start_delta(const char *url)
+{
+    return start_update(url, true);
+}
+
+esp_err_t delta_ota_start_full(const char *url)
+{
+    return start_update(url, false);
+}
+
+bool delta_ota_in_progress(void)
+{
+    return s_in_progress;
+}
+
+void delta_ota_mark_valid(void)
+{
+    esp_ota_img_states_t state;
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    if (esp_ota_get_state_partition(running, &state) == ESP_OK &&
+        state == ESP_OTA_IMG_PENDING_VERIFY) {
+        ESP_LOGI(TAG, "New firmware is online - cancelling rollback");
+        esp_ota_mark_app_valid_cancel_rollback();
+    }
+}
+
+void delta_ota_get_last_stats(delta_ota_stats_t *out)
+{
+    *out = s_last_stats;
+}
+
+void delta_ota_print_stats(void)
+{
+    delta_ota_stats_t delta, full;
+    bool have_delta = stats_load(NVS_KEY_LAST_DELTA, &delta);
+    bool have_full = stats_load(NVS_KEY_LAST_FULL, &full);
+
+    ESP_LOGI(TAG, "Firmware: %s (running from '%s')",
+             esp_app_get_description()->version, esp_ota_get_running_partition()->label);
+    ESP_LOGI(TAG, "            %10s  %10s  %8s  %8s", "download", "image", "time", "result");
+    if (have_full) {
+        ESP_LOGI(TAG, "  full:     %10lu  %10lu  %6lums  %s",
+                 (unsigned long)full.download_bytes, (unsigned long)full.image_bytes,
+                 (unsigned long)full.elapsed_ms, esp_err_to_name(full.result));
+    }
+    if (have_delta) {
+        ESP_LOGI(TAG, "  delta:    %10lu  %10lu  %6lums  %s",
+                 (unsigned long)delta.download_bytes, (unsigned long)delta.image_bytes,
+                 (unsigned long)delta.elapsed_ms, esp_err_to_name(delta.result));
+        /* Compare against the reconstructed image size - what a full OTA would fetch */
+        if (delta.result == ESP_OK && delta.image_bytes > 0) {
+            ESP_LOGI(TAG, "  delta download is %lu%% of the full image",
+                     (unsigned long)((uint64_t)delta.download_bytes * 100 / delta.image_bytes));
+        }
+    }
+    if (have_full && have_delta && full.result == ESP_OK && delta.result == ESP_OK &&
+        full.elapsed_ms > 0) {
+        ESP_LOGI(TAG, "  delta time is %lu%% of the last full-image update",
+                 (unsigned long)((uint64_t)delta.elapsed_ms * 100 / full.elapsed_ms));
+    }
+    if (!have_full && !have_delta) {
+        ESP_LOGI(TAG, "  (no updates recorded yet)");
+    }
+}
@@ -0,0 +1,113 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Delta OTA - Firmware updates from compressed binary patches
+ *
+ * A host tool (tools/delta_ota_gen.py) diffs the running build against the
+ * new build and compresses the result. The device streams the patch over
+ * HTTP(S), reads the old image from the running partition and writes the
+ * reconstructed image into the next OTA slot. Full-image updates go through
+ * the same download loop so the two can be compared directly.
+ */
+
+#ifndef DELTA_OTA_H
+#define DELTA_OTA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/* ============================================================================
+   DELTA OTA CONFIGURATION
+   ============================================================================ */
+
+#define DELTA_OTA_MAGIC             "HDLT"  /* Patch header magic */
+#define DELTA_OTA_HEADER_VERSION    1       /* Patch header layout version */
+#define DELTA_OTA_HEADER_SIZE       64      /* Fixed header size in bytes */
+#define DELTA_OTA_STREAM_BUF_SIZE   2048    /* Download chunk buffer (static) */
+#define DELTA_OTA_URL_MAX_LEN       160     /* Longest accepted update URL */
+#define DELTA_OTA_COMPRESSION_HEATSHRINK 1  /* Only supported patch compression */
+
+/* ============================================================================
+   PATCH HEADER (little-endian, written by tools/delta_ota_gen.py)
+   ============================================================================ */
+
+typedef struct __attribute__((packed)) {
+    char magic[4];                  /* "HDLT" */
+    uint8_t version;                /* DELTA_OTA_HEADER_VERSION */
+    uint8_t compression;            /* DELTA_OTA_COMPRESSION_* */
+    uint16_t reserved0;
+    uint32_t new_image_size;        /* Size of the reconstructed app image */
+    uint32_t patch_size;            /* Patch payload size (after this header) */
+    uint8_t base_elf_sha256[32];    /* app_elf_sha256 of the image the patch applies to */
+    uint8_t reserved1[16];
+} delta_ota_header_t;
+
+/* ============================================================================
+   UPDATE STATISTICS
+   ============================================================================ */
+
+typedef struct {
+    bool valid;                     /* At least one update has been attempted */
+    bool is_delta;                  /* Patch (true) or full image (false) */
+    esp_err_t result;               /* ESP_OK on success */
+    uint32_t download_bytes;        /* Bytes received over the network */
+    uint32_t image_bytes;           /* Bytes written to the update partition */
+    uint32_t elapsed_ms;            /* Download + apply + verify time */
+} delta_ota_stats_t;
+
+/* ============================================================================
+   UPDATE CONTROL
+   ============================================================================ */
+
+/**
+ * @brief Start a delta update from a patch URL
+ *
+ * Queues a job on the background job task that downloads the patch, applies it against the
+ * running image and switches the boot partition on success (then reboots).
+ *
+ * @param url HTTP(S) URL of a patch produced by tools/delta_ota_gen.py
+ * @return ESP_OK if the update was queued,
+ *         ESP_ERR_INVALID_STATE if an update is already running
+ */
+esp_err_t delta_ota_start_delta(const char *url);
+
+/**
+ * @brief Start a full-image update from an app binary URL
+ *
+ * Uses the same download loop as the delta path so size and time can be
+ * compared against a delta update.
+ *
+ * @param url HTTP(S) URL of the app .bin
+ * @return ESP_OK if the update was queued
+ */
+esp_err_t delta_ota_start_full(const char *url);
+
+/**
+ * @brief Check whether an update is queued or running
+ */
+bool delta_ota_in_progress(void);
+
+/**
+ * @brief Mark the running image as good (cancels bootloader rollback)
+ *
+ * Call once the new firmware has proven it can reach the network.
+ */
+void delta_ota_mark_valid(void);
+
+/**
+ * @brief Get statistics of the last update attempt
+ *
+ * @param out Filled with the last attempt (out->valid is false if none)
+ */
+void delta_ota_get_last_stats(delta_ota_stats_t *out);
+
+/**
+ * @brief Log the last delta and full-image update side by side
+ *
+ * Results survive the post-update reboot (stored in NVS).
+ */
+void delta_ota_print_stats(void);
+
+#endif /* DELTA_OTA_H */
@@ -30,6 +30,7 @@
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
@@ -41,17 +42,63 @@
 #include "sdkconfig.h"
 #include "nvs_flash.h"
 #include "nvs.h"
+#if CONFIG_HALO_MQTT
 #include "mqtt_client.h"
+#endif
 #include "rotary_encoder.h"  /* Rotary encoder for brightness control */
 #include "driver/ledc.h"  /* PWM for passive buzzer */
 #include "esp_random.h"   /* For esp_random() in song selection */
 #include "esp_system.h"   /* For esp_get_free_heap_size(), chip info */
 #include "esp_heap_caps.h" /* For heap_caps_get_free_size() */
 #include "esp_timer.h"    /* For esp_timer_get_time() */
+#include "esp_attr.h"     /* IRAM_ATTR for the render path */
 #include "credentials.h"  /* WiFi and Adafruit IO credentials (gitignored) */
+#if CONFIG_HALO_ZIGBEE
 #include "zigbee_hub.h"   /* Zigbee coordinator for blind control */
 #include "zigbee_devices.h" /* Zigbee device storage */
+#endif
+#if CONFIG_HALO_MATTER
 #include "matter_devices.h" /* Matter smart home (Google Home, Apple HomeKit, Alexa) */
+#endif
+#include "delta_ota.h"      /* Full-image and delta firmware updates */
+#if CONFIG_HALO_MQTT
+#include "mqtt_tls.h"       /* TLS transport with session resumption */
+#include "mqtt_response.h"  /* Replies to commands that carry an ID */
+#include "mqtt_assembler.h" /* Fragmented messages, asset uploads to flash */
+#endif
+#include "conn_manager.h"   /* WiFi/MQTT reconnect state machine */
+#include "halo_metrics.h"   /* Latency histograms */
+#include "radio_policy.h"   /* WiFi power save / coexistence policy */
+#include "halo_tasks.h"     /* Task table and starvation supervisor */
+#if CONFIG_HALO_ZIGBEE
+#include "zigbee_ota.h"     /* Zigbee OTA Upgrade server */
+#include "zigbee_backup.h"  /* Coordinator network backup/restore */
+#include "zigbee_remote.h"  /* Zigbee remotes/switches as input devices */
+#include "zigbee_lights.h"  /* Zigbee bulbs and rooms */
+#include "zigbee_routing.h" /* Concentrator routing + route metrics */
+#include "zigbee_tuya.h"    /* Tuya DP parser + device state */
+#endif
+#if CONFIG_HALO_ZIGBEE_CAPTURE
+#include "zigbee_capture.h" /* 802.15.4 frame capture as pcap */
+#endif
+#include "halo_console.h"   /* Serial REPL sharing the command handler */
+#if CONFIG_HALO_PROFILER
+#include "halo_profiler.h"  /* Sampling CPU profiler */
+#endif
+#if CONFIG_HALO_HEAP_TRACKER
+#include "halo_heap.h"      /* Heap use per subsystem */
+#define HEAP_SCOPE_BEGIN(tag)   halo_heap_tag_push(tag)
+#define HEAP_SCOPE_END()        halo_heap_tag_pop()
+#else
+#define HEAP_SCOPE_BEGIN(tag)
+#define HEAP_SCOPE_END()
+#endif
+#include "halo_journal.h"   /* Command journal in .noinit RAM */
+#include "halo_mod.h"       /* Effect parameter modulation */
+#if CONFIG_HALO_SYNC
+#include "halo_sync.h"      /* Shared animation clock over UDP multicast */
+#endif
+#include "esp_mac.h"        /* For the persistent MQTT client ID */
 
 /* Logging tags for different components */
 static const char *TAG = "main";
@@ -66,33 +113,49 @@ static const char *TAG_METRICS = "metrics";
    ============================================================================
    Credentials are loaded from credentials.h (gitignored).
    Copy credentials.h.template to credentials.h and fill in your values.
+   Reconnect policy (cached BSSID, backoff, degraded mode) lives in
+   conn_manager.c - the handler here only logs.
    ============================================================================ */
 
 /* WIFI_SSID and WIFI_PASSWORD come from credentials.h */
-#define WIFI_MAX_RETRY 10
-
-/* Event group for WiFi status */
-static EventGroupHandle_t wifi_event_group;
-#define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT      BIT1
-
-static int wifi_retry_count = 0;
-static bool wifi_connected = false;
 
 /* ============================================================================
    MQTT / ADAFRUIT IO CONFIGURATION
    ============================================================================
    Connects to Adafruit IO to receive voice commands from IFTTT/Google Home.
    Credentials are loaded from credentials.h (gitignored).
+
+   Runs over TLS (port 8883). Reconnects reuse the cached TLS session (see
+   mqtt_tls.c) and a persistent MQTT session with a fixed client ID, so QoS1
+   commands sent while the link was down are delivered after it comes back.
+   Messages bigger than the receive buffer arrive in parts: mqtt_assembler.c
+   joins them, and stores uploads on the halo-asset feed in flash.
+   Not built with CONFIG_HALO_MQTT off: the console, Matter and Zigbee
+   remotes still reach the same command handler.
    ============================================================================ */
 
 /* ADAFRUIT_IO_USERNAME, ADAFRUIT_IO_KEY, and ADAFRUIT_IO_FEED come from credentials.h */
 
 /* Full topic path for Adafruit IO */
 #define MQTT_TOPIC              ADAFRUIT_IO_USERNAME "/feeds/" ADAFRUIT_IO_FEED
+#define MQTT_BACKUP_TOPIC       ADAFRUIT_IO_USERNAME "/feeds/halo-backup"
+#define MQTT_RESPONSE_TOPIC     ADAFRUIT_IO_USERNAME "/feeds/halo-response"
+#define MQTT_ASSET_TOPIC        ADAFRUIT_IO_USERNAME "/feeds/halo-asset"
+#define MQTT_COMMAND_MAX_LEN    768     /* Longest command + NUL (zigbee:restore:<base64> needs
+                                           the room) */
+#if CONFIG_HALO_MQTT
+_Static_assert(MQTT_ASSEMBLY_MAX_LEN == MQTT_COMMAND_MAX_LEN - 1,
+               "the assembler must not accept commands the handler would truncate");
+#endif
+#define MQTT_BROKER_HOST        "io.adafruit.com"
+#define MQTT_BROKER_PORT_TLS    8883
+#define MQTT_COMMAND_QOS        1       /* At-least-once delivery for the commands feed */
+#define MQTT_KEEPALIVE_SEC      60
 
 static const char *TAG_MQTT = "mqtt";
+#if CONFIG_HALO_MQTT
 static esp_mqtt_client_handle_t mqtt_client = NULL;
+#endif
 
 /* ============================================================================
    ROTARY ENCODER BRIGHTNESS CONTROL
@@ -268,6 +331,96 @@ static volatile uint8_t strip_color_g = 0;
 static volatile uint8_t strip_color_b = 255;
 static volatile uint8_t strip_color_w = 0;
 
+/* bench:render asks the render loop to time every animation on its next frame */
+static volatile bool render_bench_requested = false;
+
+/* bench:nvs runs in the caller's task, next to the render benchmark */
+static void run_nvs_bench(void);
+
+/* ============================================================================
+   COMMAND JOURNAL
+   ============================================================================
+   Every change to the ring or the blinds is appended to halo_journal with
+   the ring state it led to. Names match the mode commands, and the
+   "state:" command takes them back when a journal is replayed.
+   ============================================================================ */
+
+static const char *const animation_names[ANIM_OFF + 1] = {
+    [ANIM_CYCLE] = "cycle",         [ANIM_FUSION] = "fusion",
+    [ANIM_WAVE] = "wave",           [ANIM_TETRIS] = "tetris",
+    [ANIM_STARS] = "stars",         [ANIM_METEOR] = "meteor",
+    [ANIM_METEOR_SHOWER] = "shower", [ANIM_RAINBOW] = "rainbow",
+    [ANIM_BREATHING] = "breathing", [ANIM_SOLID] = "solid",
+    [ANIM_OFF] = "off",
+};
+
+static void journal_snapshot(halo_journal_state_t *state)
+{
+    memset(state, 0, sizeof(*state));   /* Padding too, snapshots are compared with memcmp */
+    state->anim = (uint8_t)current_animation;
+    state->r = strip_color_r;
+    state->g = strip_color_g;
+    state->b = strip_color_b;
+    state->w = strip_color_w;
+    state->brightness_pm = (uint16_t)(get_effective_brightness() * 1000.0f + 0.5f);
+    state->speed_pm = (uint16_t)(animation_speed * 1000.0f + 0.5f);
+}
+
+/* ============================================================================
+   EFFECT RANDOMNESS
+   ============================================================================
+   Stars, tetris and the meteor shower each run a small generator of their
+   own. They reseed from effect_seed, and restart, whenever effect_seed_gen
+   moves on. A fresh seed is drawn each time the journal sees one of them
+   (or cycle) selected, and is journaled as "seed:<hex>" right after. The
+   "seed:" command sets it back, so tools/journal_replay.py reproduces the
+   same random pattern, not just the same mode.
+   ============================================================================ */
+
+static volatile uint32_t effect_seed = 0;
+static volatile uint32_t effect_seed_gen = 0;  /* 0 = never set, keep the built-in seeds */
+static uint8_t journal_last_anim = 0xFF;
+static portMUX_TYPE journal_anim_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void set_effect_seed(uint32_t seed)
+{
+    effect_seed = seed;
+    effect_seed_gen++;  /* Published after the seed; single core, render task reads both */
+}
+
+static bool effect_uses_rng(uint8_t anim)
+{
+    return anim == ANIM_CYCLE || anim == ANIM_TETRIS || anim == ANIM_STARS ||
+           anim == ANIM_METEOR_SHOWER;
+}
+
+/* After journaling `state`: if it selected a random effect, reseed and record the seed */
+static void journal_effect_seed(halo_journal_source_t source, const halo_journal_state_t *state)
+{
+    taskENTER_CRITICAL(&journal_anim_lock);
+    bool changed = state->anim != journal_last_anim;
+    journal_last_anim = state->anim;
+    taskEXIT_CRITICAL(&journal_anim_lock);
+    if (!changed || !effect_uses_rng(state->anim)) {
+        return;
+    }
+
+    uint32_t seed = esp_random();
+    set_effect_seed(seed);
+    char text[16];
+    int len = snprintf(text, sizeof(text), "seed:%08lx", (unsigned long)seed);
+    halo_journal_record(source, HALO_JOURNAL_F_VERBATIM, text, len, state);
+}
+
+/* Record an action that did not come through the command handler */
+static void journal_note(halo_journal_source_t source, uint8_t flags, const char *text)
+{
+    halo_journal_state_t state;
+    journal_snapshot(&state);
+    halo_journal_record(source, flags, text, strlen(text), &state);
+    journal_effect_seed(source, &state);
+}
+
 
 /* ============================================================================
    PERSISTENT STORAGE (NVS)
@@ -373,6 +526,14 @@ static void buzzer_triple_beep(void)
     buzzer_beep(1500, 120);  /* Higher pitch on third beep */
 }
 
+/* One entry per turn of the knob, with the position it stopped at */
+static void journal_encoder_blinds(void)
+{
+    char text[16];
+    snprintf(text, sizeof(text), "blinds:%d", encoder_blinds_position);
+    journal_note(HALO_JOURNAL_SRC_ENCODER, HALO_JOURNAL_F_DEVICE | HALO_JOURNAL_F_COALESCE, text);
+}
+
 /* Process encoder events and update brightness or blinds
    Returns true if value changed (gauge should show) */
 static bool process_encoder_events(void)
@@ -382,7 +543,9 @@ static bool process_encoder_events(void)
     
     /* Process all pending encoder events */
     while ((event = encoder_poll_event()) != ENCODER_EVENT_NONE) {
+        halo_mod_input_event(HALO_MOD_IN_TOUCH);
         switch (event) {
+#if CONFIG_HALO_ZIGBEE
             case ENCODER_EVENT_DOUBLE_TAP:
                 /* Double-tap: switch between LED and Blinds mode */
                 if (encoder_mode == ENCODER_MODE_LED) {
@@ -404,6 +567,7 @@ static bool process_encoder_events(void)
                     buzzer_beep(800, 100);  /* Single low beep for LED mode */
                 }
                 break;
+#endif
                 
             case ENCODER_EVENT_CW:
                 if (encoder_mode == ENCODER_MODE_LED) {
@@ -412,12 +576,16 @@ static bool process_encoder_events(void)
                     if (encoder_brightness > 1.0f) encoder_brightness = 1.0f;
                     software_brightness = 0.0f;  /* Clear software override, use encoder */
                     ESP_LOGI(TAG_ENCODER, "Brightness +5%%: %.0f%%", encoder_brightness * 100);
+                    journal_note(HALO_JOURNAL_SRC_ENCODER, HALO_JOURNAL_F_COALESCE, "encoder:brightness");
                 } else {
                     /* Blinds mode: open blinds (increase position) */
                     encoder_blinds_position += BLINDS_POSITION_STEP;
                     if (encoder_blinds_position > 100) encoder_blinds_position = 100;
                     ESP_LOGI(TAG_ENCODER, "Blinds → OPEN: %d%%", encoder_blinds_position);
+#if CONFIG_HALO_ZIGBEE
                     zigbee_blind_set_position(0, (uint8_t)encoder_blinds_position);
+#endif
+                    journal_encoder_blinds();
                 }
                 changed = true;
                 break;
@@ -429,12 +597,16 @@ static bool process_encoder_events(void)
                     if (encoder_brightness < 0.20f) encoder_brightness = 0.20f;  /* Min 20% */
                     software_brightness = 0.0f;  /* Clear software override, use encoder */
                     ESP_LOGI(TAG_ENCODER, "Brightness -5%%: %.0f%%", encoder_brightness * 100);
+                    journal_note(HALO_JOURNAL_SRC_ENCODER, HALO_JOURNAL_F_COALESCE, "encoder:brightness");
                 } else {
                     /* Blinds mode: close blinds (decrease position) */
                     encoder_blinds_position -= BLINDS_POSITION_STEP;
                     if (encoder_blinds_position < 0) encoder_blinds_position = 0;
                     ESP_LOGI(TAG_ENCODER, "Blinds → CLOSE: %d%%", encoder_blinds_position);
+#if CONFIG_HALO_ZIGBEE
                     zigbee_blind_set_position(0, (uint8_t)encoder_blinds_position);
+#endif
+                    journal_encoder_blinds();
                 }
                 changed = true;
                 break;
@@ -449,10 +621,14 @@ static bool process_encoder_events(void)
                         current_animation = ANIM_OFF;
                         ESP_LOGI(TAG_ENCODER, "LED: OFF");
                     }
+                    journal_note(HALO_JOURNAL_SRC_ENCODER, 0, "toggle");
                 } else {
                     /* In blinds mode, single press stops the blinds */
                     ESP_LOGI(TAG_ENCODER, "Blinds: STOP");
+#if CONFIG_HALO_ZIGBEE
                     zigbee_blind_stop(0);
+#endif
+                    journal_note(HALO_JOURNAL_SRC_ENCODER, HALO_JOURNAL_F_DEVICE, "blinds:stop");
                 }
                 break;
                 
@@ -467,6 +643,7 @@ static bool process_encoder_events(void)
                     anim_index = (anim_index + 1) % (sizeof(anim_cycle) / sizeof(anim_cycle[0]));
                     current_animation = anim_cycle[anim_index];
                     ESP_LOGI(TAG_ENCODER, "Animation: %d", current_animation);
+                    journal_note(HALO_JOURNAL_SRC_ENCODER, 0, animation_names[current_animation]);
                 }
                 break;
                 
@@ -675,6 +852,7 @@ static void buzzer_click(void)
     buzzer_play_melody(MELODY_BUTTON_PRESS, MELODY_BUTTON_PRESS_LEN);
 }
 
+#if CONFIG_HALO_SONGS
 /* ============================================================================
    RTTTL (Ring Tone Text Transfer Language) PARSER
    ============================================================================
@@ -825,6 +1003,7 @@ static void buzzer_play_rtttl(const char *rtttl)
         
         /* Play the note */
         if (freq > 0) {
+            halo_mod_input_event(HALO_MOD_IN_BEAT);     /* Note onsets fire beat envelopes */
             buzzer_tone(freq, note_duration_ms);
         } else {
             vTaskDelay(note_duration_ms / portTICK_PERIOD_MS);
@@ -868,6 +1047,8 @@ static volatile int current_song_index = -1;
 
 /* Queue handle for song requests */
 static QueueHandle_t melody_queue = NULL;
+static StaticQueue_t melody_queue_buf;
+static uint8_t melody_queue_storage[sizeof(int)];
 
 /* Melody task - runs in background, plays songs from queue */
 static void melody_task(void *pvParameters)
@@ -904,24 +1085,17 @@ static void melody_task(void *pvParameters)
 static void init_melody_task(void)
 {
     /* Create queue for song requests (holds 1 song at a time - no queuing multiple) */
-    melody_queue = xQueueCreate(1, sizeof(int));
+    melody_queue = xQueueCreateStatic(1, sizeof(int), melody_queue_storage, &melody_queue_buf);
     
     if (melody_queue == NULL) {
         ESP_LOGE(TAG_BUZZER, "Failed to create melody queue!");
         return;
     }
     
-    /* Create the melody task with its own stack */
-    BaseType_t result = xTaskCreate(
-        melody_task,        /* Task function */
-        "melody_task",      /* Name */
-        4096,               /* Stack size (bytes) */
-        NULL,               /* Parameters */
-        5,                  /* Priority (lower than main loop) */
-        NULL                /* Task handle (not needed) */
-    );
+    /* Create the melody task from its static stack (see halo_tasks.h) */
+    TaskHandle_t task = halo_task_create_static(HALO_TASK_MELODY, melody_task, NULL);
     
-    if (result != pdPASS) {
+    if (task == NULL) {
         ESP_LOGE(TAG_BUZZER, "Failed to create melody task!");
     } else {
         ESP_LOGI(TAG_BUZZER, "Melody task created - background playback enabled!");
@@ -957,6 +1131,11 @@ static void buzzer_play_random_song(void)
     /* Queue the song (non-blocking - if queue is full, just ignore) */
     xQueueSend(melody_queue, &song_index, 0);
 }
+#else
+/* Songs not built: the melody button does nothing */
+static void init_melody_task(void) {}
+static void buzzer_play_random_song(void) {}
+#endif
 
 /* ============================================================================
    WIFI CONNECTION
@@ -999,7 +1178,7 @@ static const char* wifi_disconnect_reason_str(uint8_t reason)
     }
 }
 
-/* WiFi event handler */
+/* WiFi event handler (logging only - conn_manager.c drives reconnects) */
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                                int32_t event_id, void* event_data)
 {
@@ -1011,28 +1190,21 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
         uint8_t reason = disconnected->reason;
         
         ESP_LOGW(TAG_WIFI, "Disconnected! Reason: %d (%s)", reason, wifi_disconnect_reason_str(reason));
-        
-        if (wifi_retry_count < WIFI_MAX_RETRY) {
-            esp_wifi_connect();
-            wifi_retry_count++;
-            ESP_LOGW(TAG_WIFI, "Connection failed, retrying... (%d/%d)", wifi_retry_count, WIFI_MAX_RETRY);
-        } else {
-            xEventGroupSetBits(wifi_event_group, WIFI_FAIL_BIT);
-            ESP_LOGE(TAG_WIFI, "Failed to connect after %d attempts", WIFI_MAX_RETRY);
-        }
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG_WIFI, "Connected! IP Address: " IPSTR, IP2STR(&event->ip_info.ip));
-        wifi_retry_count = 0;
-        wifi_connected = true;
-        xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
     }
 }
 
+/* Scan results kept for the log; the strongest are reported first */
+#define WIFI_SCAN_MAX_APS 20
+
 /* Scan for available WiFi networks (for debugging) 
    Returns true if networks were found, false if scan found nothing */
 static bool wifi_scan_networks(void)
 {
+    static wifi_ap_record_t ap_list[WIFI_SCAN_MAX_APS];
+    
     ESP_LOGI(TAG_WIFI, "");
     ESP_LOGI(TAG_WIFI, "╔══════════════════════════════════════════════════════════╗");
     ESP_LOGI(TAG_WIFI, "║  📡 SCANNING FOR WIFI NETWORKS...                        ║");
@@ -1066,12 +1238,10 @@ static bool wifi_scan_networks(void)
     
     ESP_LOGI(TAG_WIFI, "  Found %d networks:", ap_count);
     
-    wifi_ap_record_t *ap_list = malloc(sizeof(wifi_ap_record_t) * ap_count);
-    if (ap_list == NULL) {
-        ESP_LOGE(TAG_WIFI, "  Failed to allocate memory for scan results");
-        return false;
+    /* Takes the first WIFI_SCAN_MAX_APS records and frees the rest */
+    if (ap_count > WIFI_SCAN_MAX_APS) {
+        ap_count = WIFI_SCAN_MAX_APS;
     }
-    
     esp_wifi_scan_get_ap_records(&ap_count, ap_list);
     
     bool found_target = false;
@@ -1101,7 +1271,6 @@ static bool wifi_scan_networks(void)
         ESP_LOGI(TAG_WIFI, "  ✅ Target network '%s' found!", WIFI_SSID);
     }
     
-    free(ap_list);
     ESP_LOGI(TAG_WIFI, "");
     return true;  /* Networks were found */
 }
@@ -1111,8 +1280,6 @@ static void wifi_init_start(void)
 {
     ESP_LOGI(TAG_WIFI, "Initializing WiFi...");
     
-    wifi_event_group = xEventGroupCreate();
-    
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
     esp_netif_create_default_wifi_sta();
@@ -1133,6 +1300,7 @@ static void wifi_init_start(void)
                                                         &wifi_event_handler,
                                                         NULL,
                                                         &instance_got_ip));
+    ESP_ERROR_CHECK(conn_manager_init());
     
     /* Configure WiFi */
     wifi_config_t wifi_config = {
@@ -1148,6 +1316,7 @@ static void wifi_init_start(void)
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
+    ESP_ERROR_CHECK(radio_policy_init());
     
     /* Do a quick scan first to see what networks are available (helps debug) */
     vTaskDelay(100 / portTICK_PERIOD_MS);  /* Brief delay to let WiFi fully start */
@@ -1187,9 +1356,9 @@ static void wifi_init_start(void)
         }
     }
     
-    /* Now start the actual connection */
+    /* Now start the actual connection (cached BSSID first, then backoff) */
     ESP_LOGI(TAG_WIFI, "Starting connection to %s...", WIFI_SSID);
-    esp_wifi_connect();
+    conn_manager_start();
     
     ESP_LOGI(TAG_WIFI, "WiFi initialization complete, connecting...");
 }
@@ -1197,17 +1366,16 @@ static void wifi_init_start(void)
 /* Check if WiFi is connected */
 static bool wifi_is_connected(void)
 {
-    return wifi_connected;
+    return conn_manager_has_ip();
 }
 
 /* Check WiFi connection status (non-blocking) */
 static int wifi_check_status(void)
 {
-    EventBits_t bits = xEventGroupGetBits(wifi_event_group);
-    if (bits & WIFI_CONNECTED_BIT) {
+    if (conn_manager_has_ip()) {
         return 1;  /* Connected */
-    } else if (bits & WIFI_FAIL_BIT) {
-        return -1; /* Failed */
+    } else if (conn_manager_is_degraded()) {
+        return -1; /* Failed (still retrying in the background) */
     }
     return 0;  /* Still connecting */
 }
@@ -1226,13 +1394,35 @@ static int wifi_check_status(void)
    - "speed:slow" → Slow animation
    - "speed:fast" → Fast animation
    - "color:RRGGBB" → Set color (hex, e.g., "color:FF00FF" for purple)
+   - "ota:delta:URL" → Apply a delta patch (tools/delta_ota_gen.py)
+   - "ota:full:URL"  → Full-image update (for comparison)
+   - "zigbee:backup" → Publish the encrypted network backup
+   - "zigbee:restore:BASE64" → Stage a backup and reboot into it
+   - "state:MODE:RRGGBBWW:B:S" → Exact ring state (journal replay)
+   - "seed:HEX"   → Restart stars/tetris/shower from a journaled seed
+   - "journal:dump"  → Command journal as base64 (tools/journal_replay.py)
+   - "sync:leader" / "sync:follow" → Share the animation clock over the LAN
+   - "mod:meteor.tail:sine:0.4:0.25" → Modulate an effect parameter (halo_mod.h)
    ============================================================================ */
 
+/* Why the last command failed, NULL if it did not (MQTT replies report it) */
+static const char *command_error = NULL;
+
+static void command_check(esp_err_t err)
+{
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG_MQTT, "Command failed: %s", esp_err_to_name(err));
+        command_error = esp_err_to_name(err);
+    }
+}
+
 static void handle_mqtt_command(const char *data, int data_len)
 {
+    command_error = NULL;
+    
     /* Null-terminate for string operations */
-    char command[64];
-    int len = (data_len < 63) ? data_len : 63;
+    char command[MQTT_COMMAND_MAX_LEN];
+    int len = (data_len < MQTT_COMMAND_MAX_LEN - 1) ? data_len : MQTT_COMMAND_MAX_LEN - 1;
     memcpy(command, data, len);
     command[len] = '\0';
     
@@ -1287,6 +1477,11 @@ static void handle_mqtt_command(const char *data, int data_len)
         current_animation = ANIM_CYCLE;  /* Default to cycle when turned on */
         ESP_LOGI(TAG_MQTT, "Animation: ON (cycle)");
     }
+    else if (strcmp(command, "toggle") == 0) {
+        /* Same as a short encoder press */
+        current_animation = (current_animation == ANIM_OFF) ? ANIM_CYCLE : ANIM_OFF;
+        ESP_LOGI(TAG_MQTT, "Animation: %s", current_animation == ANIM_OFF ? "OFF" : "ON (cycle)");
+    }
     /* Speed commands */
     else if (strcmp(command, "speed:slow") == 0 || strcmp(command, "slow") == 0) {
         animation_speed = 0.08f;
@@ -1367,6 +1562,15 @@ static void handle_mqtt_command(const char *data, int data_len)
     /* ========================================================================
        BRIGHTNESS CONTROL (for Google Home integration)
        ======================================================================== */
+    else if (strcmp(command, "brightness:up") == 0 || strcmp(command, "brightness:down") == 0) {
+        /* One encoder click, for remotes' dim buttons */
+        float step = (command[11] == 'u') ? ENCODER_BRIGHTNESS_STEP : -ENCODER_BRIGHTNESS_STEP;
+        encoder_brightness = get_effective_brightness() + step;
+        if (encoder_brightness > 1.0f) encoder_brightness = 1.0f;
+        if (encoder_brightness < 0.20f) encoder_brightness = 0.20f;
+        software_brightness = 0.0f;
+        ESP_LOGI(TAG_MQTT, "Brightness: %.0f%%", encoder_brightness * 100);
+    }
     else if (strncmp(command, "brightness:", 11) == 0) {
         int percent = atoi(command + 11);
         if (percent < 0) percent = 0;
@@ -1427,8 +1631,10 @@ static void handle_mqtt_command(const char *data, int data_len)
             current_animation = ANIM_TETRIS;
         } else {
             ESP_LOGW(TAG_MQTT, "Unknown effect: %s", effect);
+            command_error = "unknown effect";
         }
     }
+#if CONFIG_HALO_ZIGBEE
     /* ========================================================================
        ZIGBEE BLIND CONTROL COMMANDS
        ======================================================================== */
@@ -1438,15 +1644,15 @@ static void handle_mqtt_command(const char *data, int data_len)
     }
     else if (strcmp(command, "blinds:open") == 0) {
         ESP_LOGI(TAG_MQTT, "Zigbee: Opening blinds");
-        zigbee_blind_open(0);  /* 0 = first paired blind */
+        command_check(zigbee_blind_open(0));  /* 0 = first paired blind */
     }
     else if (strcmp(command, "blinds:close") == 0) {
         ESP_LOGI(TAG_MQTT, "Zigbee: Closing blinds");
-        zigbee_blind_close(0);
+        command_check(zigbee_blind_close(0));
     }
     else if (strcmp(command, "blinds:stop") == 0) {
         ESP_LOGI(TAG_MQTT, "Zigbee: Stopping blinds");
-        zigbee_blind_stop(0);
+        command_check(zigbee_blind_stop(0));
     }
     else if (strcmp(command, "blinds:status") == 0) {
         ESP_LOGI(TAG_MQTT, "Zigbee: Printing device status...");
@@ -1456,8 +1662,11 @@ static void handle_mqtt_command(const char *data, int data_len)
         ESP_LOGI(TAG_MQTT, "Zigbee: Querying blind position...");
         zigbee_blind_query_position(0);
     }
+    else if (strcmp(command, "blinds:state") == 0) {
+        zigbee_tuya_print_status();
+    }
     else if (strcmp(command, "blinds:debug") == 0) {
-        ESP_LOGI(TAG_MQTT, "Zigbee: Starting debug mode (query every 5s)...");
+        ESP_LOGI(TAG_MQTT, "Zigbee: Starting debug mode (periodic queries)...");
         zigbee_start_debug_mode();
     }
     else if (strcmp(command, "blinds:nodebug") == 0) {
@@ -1474,9 +1683,10 @@ static void handle_mqtt_command(const char *data, int data_len)
         int percent = atoi(command + 7);
         if (percent >= 0 && percent <= 100) {
             ESP_LOGI(TAG_MQTT, "Zigbee: Setting blinds to %d%%", percent);
-            zigbee_blind_set_position(0, (uint8_t)percent);
+            command_check(zigbee_blind_set_position(0, (uint8_t)percent));
         } else {
             ESP_LOGW(TAG_MQTT, "Invalid blind position: %d", percent);
+            command_error = "invalid position";
         }
     }
     else if (strcmp(command, "zigbee:status") == 0) {
@@ -1501,6 +1711,7 @@ static void handle_mqtt_command(const char *data, int data_len)
             zigbee_start_device_scan((uint16_t)interval);
         } else {
             ESP_LOGW(TAG_MQTT, "Invalid scan interval: %d (use 1-3600)", interval);
+            command_error = "invalid interval";
         }
     }
     else if (strcmp(command, "zigbee:neighbors") == 0) {
@@ -1513,11 +1724,553 @@ static void handle_mqtt_command(const char *data, int data_len)
         zigbee_start_device_scan(ZIGBEE_FINDER_SCAN_INTERVAL);
         zigbee_permit_join(ZIGBEE_FINDER_TIMEOUT_SEC);
     }
+    else if (strcmp(command, "zigbee:backup") == 0) {
+        /* Encrypted + signed, safe to keep in a feed. Also logged for serial users. */
+        static char backup_b64[ZB_BACKUP_BASE64_MAX_LEN];
+        esp_err_t err = zigbee_backup_export_base64(backup_b64, sizeof(backup_b64));
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG_MQTT, "Zigbee backup: %s", backup_b64);
+#if CONFIG_HALO_MQTT
+            esp_mqtt_client_publish(mqtt_client, MQTT_BACKUP_TOPIC, backup_b64, 0, 1, 0);
+            ESP_LOGI(TAG_MQTT, "Backup published to %s", MQTT_BACKUP_TOPIC);
+#endif
+        } else {
+            ESP_LOGW(TAG_MQTT, "Zigbee backup failed: %s", esp_err_to_name(err));
+            command_error = esp_err_to_name(err);
+        }
+    }
+    /* ========================================================================
+       ZIGBEE LIGHTS
+       light:status
+       light:<0xADDR|room>:on / :off / :<0-100> / :color:RRGGBB
+       light:room:<room>:add:<0xADDR> / :remove:<0xADDR> / :follow:on / :follow:off
+       ======================================================================== */
+    else if (strcmp(command, "light:status") == 0) {
+        zigbee_lights_print_status();
+    }
+    else if (strncmp(command, "light:room:", 11) == 0) {
+        char room[ZB_LIGHT_ROOM_NAME_LEN];
+        const char *sep = strchr(command + 11, ':');
+        size_t name_len = sep ? (size_t)(sep - (command + 11)) : 0;
+        esp_err_t err = ESP_ERR_INVALID_ARG;
+        if (name_len > 0 && name_len < sizeof(room)) {
+            memcpy(room, command + 11, name_len);
+            room[name_len] = '\0';
+            if (strncmp(sep, ":add:", 5) == 0) {
+                err = zigbee_light_room_add(room, (uint16_t)strtol(sep + 5, NULL, 0));
+            } else if (strncmp(sep, ":remove:", 8) == 0) {
+                err = zigbee_light_room_remove(room, (uint16_t)strtol(sep + 8, NULL, 0));
+            } else if (strcmp(sep, ":follow:on") == 0) {
+                err = zigbee_light_room_follow(room, true);
+            } else if (strcmp(sep, ":follow:off") == 0) {
+                err = zigbee_light_room_follow(room, false);
+            }
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG_MQTT, "Room command failed: %s", esp_err_to_name(err));
+            command_error = esp_err_to_name(err);
+        }
+    }
+    else if (strncmp(command, "light:", 6) == 0) {
+        char name[ZB_LIGHT_ROOM_NAME_LEN];
+        const char *sep = strchr(command + 6, ':');
+        size_t name_len = sep ? (size_t)(sep - (command + 6)) : 0;
+        zigbee_light_target_t target;
+        esp_err_t err = ESP_ERR_INVALID_ARG;
+        if (name_len > 0 && name_len < sizeof(name)) {
+            memcpy(name, command + 6, name_len);
+            name[name_len] = '\0';
+            err = zigbee_light_resolve(name, &target);
+        }
+        if (err == ESP_OK) {
+            const char *action = sep + 1;
+            if (strcmp(action, "on") == 0 || strcmp(action, "off") == 0) {
+                err = zigbee_light_on_off(&target, action[1] == 'n');
+            } else if (strncmp(action, "color:", 6) == 0 && strlen(action + 6) >= 6) {
+                unsigned int rgb = (unsigned int)strtoul(action + 6, NULL, 16);
+                err = zigbee_light_set_color(&target, (rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF,
+                                             ZB_LIGHT_TRANSITION_DS);
+            } else if (action[0] >= '0' && action[0] <= '9') {
+                int percent = atoi(action);
+                if (percent > 100) percent = 100;
+                err = zigbee_light_set_level(&target, (uint8_t)percent, ZB_LIGHT_TRANSITION_DS);
+            } else {
+                err = ESP_ERR_INVALID_ARG;
+            }
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG_MQTT, "Light command failed: %s", esp_err_to_name(err));
+            command_error = esp_err_to_name(err);
+        }
+    }
+    else if (strcmp(command, "zigbee:routes") == 0) {
+        zigbee_routing_print_status();
+    }
+    else if (strcmp(command, "zigbee:routes:probe") == 0) {
+        esp_err_t err = zigbee_routing_probe();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG_MQTT, "Route probe not sent: %s", esp_err_to_name(err));
+            command_error = esp_err_to_name(err);
+        }
+    }
+    else if (strcmp(command, "zigbee:remotes") == 0) {
+        zigbee_remote_print_status();
+    }
+    else if (strncmp(command, "zigbee:restore:", 15) == 0) {
+        esp_err_t err = zigbee_backup_import_base64(command + 15);
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG_MQTT, "Zigbee restore staged - rebooting to rebuild the network...");
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            esp_restart();
+        } else {
+            ESP_LOGW(TAG_MQTT, "Zigbee restore rejected: %s", esp_err_to_name(err));
+            command_error = esp_err_to_name(err);
+        }
+    }
+#endif
+#if CONFIG_HALO_ZIGBEE_CAPTURE
+    /* ========================================================================
+       802.15.4 CAPTURE
+       zbcap:start / :stop / :status / :dump / :udp:<ip>:<port> / :udp:off
+       ======================================================================== */
+    else if (strcmp(command, "zbcap:start") == 0) {
+        zigbee_capture_start();
+    }
+    else if (strcmp(command, "zbcap:stop") == 0) {
+        zigbee_capture_stop();
+    }
+    else if (strcmp(command, "zbcap:status") == 0) {
+        zigbee_capture_print_status();
+    }
+    else if (strcmp(command, "zbcap:dump") == 0) {
+        zigbee_capture_dump();
+    }
+    else if (strcmp(command, "zbcap:udp:off") == 0) {
+        zigbee_capture_stream_stop();
+    }
+    else if (strncmp(command, "zbcap:udp:", 10) == 0) {
+        char host[16];
+        const char *sep = strchr(command + 10, ':');
+        size_t host_len = sep ? (size_t)(sep - (command + 10)) : 0;
+        esp_err_t err = ESP_ERR_INVALID_ARG;
+        if (host_len > 0 && host_len < sizeof(host)) {
+            memcpy(host, command + 10, host_len);
+            host[host_len] = '\0';
+            err = zigbee_capture_stream_udp(host, (uint16_t)atoi(sep + 1));
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG_MQTT, "Capture streaming not started: %s", esp_err_to_name(err));
+            command_error = esp_err_to_name(err);
+        }
+    }
+#endif
+    /* ========================================================================
+       FIRMWARE UPDATE COMMANDS
+       ======================================================================== */
+    else if (strncmp(command, "ota:delta:", 10) == 0) {
+        esp_err_t err = delta_ota_start_delta(command + 10);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG_MQTT, "Delta update not started: %s", esp_err_to_name(err));
+            command_error = esp_err_to_name(err);
+        }
+    }
+    else if (strncmp(command, "ota:full:", 9) == 0) {
+        esp_err_t err = delta_ota_start_full(command + 9);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG_MQTT, "Full update not started: %s", esp_err_to_name(err));
+            command_error = esp_err_to_name(err);
+        }
+    }
+    else if (strcmp(command, "ota:status") == 0) {
+        delta_ota_print_stats();
+    }
+#if CONFIG_HALO_ZIGBEE
+    else if (strcmp(command, "zbota:status") == 0) {
+        zigbee_ota_print_status();
+    }
+    else if (strncmp(command, "zbota:fetch:", 12) == 0) {
+        esp_err_t err = zigbee_ota_fetch(command + 12);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG_MQTT, "Zigbee image fetch not started: %s", esp_err_to_name(err));
+            command_error = esp_err_to_name(err);
+        }
+    }
+    else if (strcmp(command, "zbota:erase") == 0) {
+        esp_err_t err = zigbee_ota_erase();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG_MQTT, "Zigbee image erase failed: %s", esp_err_to_name(err));
+            command_error = esp_err_to_name(err);
+        }
+    }
+    else if (strncmp(command, "zbota:upgrade", 13) == 0) {
+        /* zbota:upgrade (all paired devices) or zbota:upgrade:0x1234 */
+        uint16_t addr = 0;
+        if (command[13] == ':') {
+            addr = (uint16_t)strtol(command + 14, NULL, 0);
+        }
+        esp_err_t err = zigbee_ota_upgrade(addr);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG_MQTT, "Zigbee upgrade not queued: %s", esp_err_to_name(err));
+            command_error = esp_err_to_name(err);
+        }
+    }
+#endif
+    /* ========================================================================
+       MQTT TRANSPORT DIAGNOSTICS
+       ======================================================================== */
+    else if (strcmp(command, "net:status") == 0) {
+        conn_manager_print_status();
+    }
+#if CONFIG_HALO_MQTT
+    else if (strcmp(command, "mqtt:stats") == 0) {
+        mqtt_tls_print_stats();
+        mqtt_assembler_print_status();
+    }
+    else if (strcmp(command, "mqtt:resume:on") == 0) {
+        mqtt_tls_set_resumption(true);
+    }
+    else if (strcmp(command, "mqtt:resume:off") == 0) {
+        /* Forces full handshakes so the two costs can be compared */
+        mqtt_tls_set_resumption(false);
+    }
+#endif
+    /* ========================================================================
+       RADIO POLICY COMMANDS
+       ======================================================================== */
+    else if (strcmp(command, "radio:status") == 0) {
+        radio_policy_print_stats();
+    }
+    else if (strcmp(command, "radio:probe") == 0) {
+        esp_err_t err = radio_policy_probe();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG_MQTT, "Radio probe not started: %s", esp_err_to_name(err));
+            command_error = esp_err_to_name(err);
+        }
+    }
+    else if (strncmp(command, "radio:force:", 12) == 0) {
+        /* radio:force:idle|streaming|zigbee|battery|auto */
+        radio_policy_t policy;
+        if (radio_policy_from_string(command + 12, &policy)) {
+            radio_policy_force(policy);
+        } else {
+            ESP_LOGW(TAG_MQTT, "Unknown radio policy: '%s'", command + 12);
+            command_error = "unknown policy";
+        }
+    }
+    else if (strcmp(command, "radio:battery:on") == 0) {
+        radio_policy_set_battery(true);
+    }
+    else if (strcmp(command, "radio:battery:off") == 0) {
+        radio_policy_set_battery(false);
+    }
+    /* ========================================================================
+       TASK DIAGNOSTICS
+       ======================================================================== */
+    else if (strcmp(command, "tasks:status") == 0) {
+        halo_tasks_print_stats();
+    }
+    else if (strcmp(command, "metrics") == 0) {
+        metrics_print_all();
+    }
+    else if (strcmp(command, "top") == 0) {
+        halo_tasks_print_top(1000);
+    }
+    else if (strcmp(command, "trace:dump") == 0) {
+        halo_tasks_trace_dump();
+    }
+    else if (strcmp(command, "bench:render") == 0) {
+        ESP_LOGI(TAG_MQTT, "Render benchmark queued for the next frame");
+        render_bench_requested = true;
+    }
+    else if (strcmp(command, "bench:nvs") == 0) {
+        run_nvs_bench();
+    }
+#if CONFIG_HALO_PROFILER
+    else if (strcmp(command, "prof:start") == 0) {
+        halo_profiler_start();
+    }
+    else if (strcmp(command, "prof:stop") == 0) {
+        halo_profiler_stop();
+    }
+    else if (strcmp(command, "prof:dump") == 0) {
+        halo_profiler_dump();
+    }
+    else if (strcmp(command, "prof:status") == 0) {
+        halo_profiler_print_status();
+    }
+#endif
+#if CONFIG_HALO_HEAP_TRACKER
+    else if (strcmp(command, "heap:status") == 0) {
+        halo_heap_print_status();
+    }
+    else if (strcmp(command, "heap:track:off") == 0) {
+        halo_heap_track_stop();
+        ESP_LOGI(TAG_MQTT, "Heap tagging off");
+    }
+    else if (strncmp(command, "heap:track:", 11) == 0) {
+        int every = atoi(command + 11);
+        if (every > 0) {
+            halo_heap_track_start((uint32_t)every);
+        } else {
+            ESP_LOGW(TAG_MQTT, "Invalid sample rate: %d (1 = every allocation)", every);
+            command_error = "invalid rate";
+        }
+    }
+#endif
+    else if (strcmp(command, "journal:dump") == 0) {
+        command_check(halo_journal_dump());
+    }
+    else if (strcmp(command, "journal:status") == 0) {
+        halo_journal_print_status();
+    }
+    else if (strcmp(command, "journal:clear") == 0) {
+        halo_journal_clear();
+    }
+    else if (strncmp(command, "state:", 6) == 0) {
+        /* state:<mode>:<RRGGBBWW>:<brightness 1-1000>:<speed 1-1000>
+           The whole ring state at once, as tools/journal_replay.py sends it */
+        char *mode = command + 6;
+        char *rgbw = strchr(mode, ':');
+        char *bright = rgbw ? strchr(rgbw + 1, ':') : NULL;
+        char *speed = bright ? strchr(bright + 1, ':') : NULL;
+        int anim = -1;
+        if (speed != NULL) {
+            *rgbw = '\0';
+            for (int i = 0; i <= ANIM_OFF; i++) {
+                if (strcmp(mode, animation_names[i]) == 0) {
+                    anim = i;
+                }
+            }
+        }
+        int brightness_pm = bright ? atoi(bright + 1) : 0;
+        int speed_pm = speed ? atoi(speed + 1) : 0;
+        if (anim < 0 || bright - rgbw != 9 || brightness_pm < 1 || brightness_pm > 1000 ||
+            speed_pm < 1 || speed_pm > 1000) {
+            ESP_LOGW(TAG_MQTT, "Usage: state:<mode>:<RRGGBBWW>:<brightness 1-1000>:<speed 1-1000>");
+            command_error = "invalid state";
+        } else {
+            uint32_t value = (uint32_t)strtoul(rgbw + 1, NULL, 16);
+            strip_color_r = (value >> 24) & 0xFF;
+            strip_color_g = (value >> 16) & 0xFF;
+            strip_color_b = (value >> 8) & 0xFF;
+            strip_color_w = value & 0xFF;
+            software_brightness = (float)brightness_pm / 1000.0f;
+            animation_speed = (float)speed_pm / 1000.0f;
+            current_animation = (animation_mode_t)anim;
+            ESP_LOGI(TAG_MQTT, "State: %s #%08lX, brightness %.3f, speed %.3f", mode,
+                     (unsigned long)value, software_brightness, animation_speed);
+        }
+    }
+    else if (strncmp(command, "seed:", 5) == 0) {
+        /* seed:<1-8 hex digits>, as journaled when a random effect was selected */
+        char *end = NULL;
+        unsigned long seed = strtoul(command + 5, &end, 16);
+        size_t digits = (size_t)(end - (command + 5));
+        if (digits == 0 || digits > 8 || *end != '\0') {
+            ESP_LOGW(TAG_MQTT, "Usage: seed:<hex>");
+            command_error = "invalid seed";
+        } else {
+            set_effect_seed((uint32_t)seed);
+            ESP_LOGI(TAG_MQTT, "Effect seed %08lx, random effects restart", seed);
+        }
+    }
+    /* ========================================================================
+       EFFECT PARAMETER MODULATION
+       mod:status / :clear
+       mod:<param>:sine|triangle|walk:<depth>:<hz>
+       mod:<param>:env:<input>:<depth>:<attack ms>:<release ms>
+       mod:<param>:level:<input>:<depth> / :base:<value> / :off
+       mod:input:<beat|touch|presence>[:<0-1000>]
+       ======================================================================== */
+    else if (strcmp(command, "mod:status") == 0) {
+        halo_mod_print_status();
+    }
+    else if (strcmp(command, "mod:clear") == 0) {
+        halo_mod_clear();
+        ESP_LOGI(TAG_MQTT, "Modulation cleared");
+    }
+    else if (strncmp(command, "mod:", 4) == 0) {
+        command_check(halo_mod_configure(command + 4));
+    }
+#if CONFIG_HALO_SYNC
+    /* ========================================================================
+       ANIMATION SYNC (several Halos on one LAN)
+       sync:leader / :follow / :off / :status
+       ======================================================================== */
+    else if (strcmp(command, "sync:leader") == 0) {
+        command_check(halo_sync_set_role(HALO_SYNC_LEADER));
+    }
+    else if (strcmp(command, "sync:follow") == 0) {
+        command_check(halo_sync_set_role(HALO_SYNC_FOLLOWER));
+    }
+    else if (strcmp(command, "sync:off") == 0) {
+        command_check(halo_sync_set_role(HALO_SYNC_OFF));
+    }
+    else if (strcmp(command, "sync:status") == 0) {
+        halo_sync_print_status();
+    }
+#endif
     else {
         ESP_LOGW(TAG_MQTT, "Unknown command: '%s'", command);
+        command_error = "unknown command";
+    }
+}
+
+/* Commands that drive a Zigbee blind or light: journaled even though the
+   ring does not change, and sent as-is on replay */
+static bool is_device_command(const char *data, int len)
+{
+    if (len > 7 && strncmp(data, "blinds:", 7) == 0) {
+        const char *arg = data + 7;
+        int arg_len = len - 7;
+        return (arg_len == 4 && strncmp(arg, "open", 4) == 0) ||
+               (arg_len == 5 && strncmp(arg, "close", 5) == 0) ||
+               (arg_len == 4 && strncmp(arg, "stop", 4) == 0) ||
+               (arg[0] >= '0' && arg[0] <= '9');
+    }
+    if (len > 6 && strncmp(data, "light:", 6) == 0) {
+        return !(len == 12 && strncmp(data, "light:status", 12) == 0) &&
+               !(len > 11 && strncmp(data, "light:room:", 11) == 0);
+    }
+    return false;
+}
+
+/* Commands that change no ring state but shape what it shows, or set up
+   this unit: journaled every time. The flags tell journal_replay.py what
+   to send again. */
+static uint8_t verbatim_flags(const char *data, int len)
+{
+    /* Reading a status changes nothing: not worth a journal slot */
+    if (len >= 7 && strncmp(data + len - 7, ":status", 7) == 0) {
+        return 0;
+    }
+    /* Sync role and group: replayed on a bench unit they would rewrite its NVS */
+    if (len > 5 && strncmp(data, "sync:", 5) == 0) {
+        return HALO_JOURNAL_F_LOCAL;
+    }
+    /* mod:input:presence:<n> from an automation would flush the ring otherwise */
+    if (len > 10 && strncmp(data, "mod:input:", 10) == 0 &&
+        memchr(data + 10, ':', len - 10) != NULL) {
+        return HALO_JOURNAL_F_VERBATIM | HALO_JOURNAL_F_LEVEL;
+    }
+    if ((len > 5 && strncmp(data, "seed:", 5) == 0) ||
+        (len > 4 && strncmp(data, "mod:", 4) == 0)) {
+        return HALO_JOURNAL_F_VERBATIM;
+    }
+    return 0;
+}
+
+/* Run a command and journal it if it changed the ring or drove a device */
+static void handle_journaled_command(halo_journal_source_t source, const char *data, int data_len)
+{
+    halo_journal_state_t before, after;
+    journal_snapshot(&before);
+    handle_mqtt_command(data, data_len);
+    journal_snapshot(&after);
+    
+    uint8_t flags = is_device_command(data, data_len) ? HALO_JOURNAL_F_DEVICE : 0;
+    flags |= verbatim_flags(data, data_len);
+    if (flags != 0 || memcmp(&before, &after, sizeof(before)) != 0) {
+        halo_journal_record(source, flags, data, data_len, &after);
+        journal_effect_seed(source, &after);
+    }
+}
+
+/* MQTT, the serial console and Zigbee remotes run commands one at a time */
+static SemaphoreHandle_t command_lock = NULL;
+static StaticSemaphore_t command_lock_buf;
+
+static void run_command(halo_journal_source_t source, const char *data, int data_len)
+{
+    xSemaphoreTake(command_lock, portMAX_DELAY);
+    handle_journaled_command(source, data, data_len);
+    xSemaphoreGive(command_lock);
+}
+
+static void run_console_command(const char *data, int data_len)
+{
+    run_command(HALO_JOURNAL_SRC_CONSOLE, data, data_len);
+}
+
+/* ============================================================================
+   ZIGBEE REMOTE INPUT
+   ============================================================================
+   Button presses from bound Zigbee remotes are queued by the Zigbee task and
+   run on a task of their own, through run_command() like MQTT and the
+   console, so they never interleave with another command. Mapped commands
+   can drive blinds and lights, which waits on the Zigbee lock, so they must
+   not run on the render task or the Zigbee task. The first frame pushed
+   after a command ran closes the press-to-light measurement.
+   ============================================================================ */
+
+#if CONFIG_HALO_ZIGBEE
+#define REMOTE_INPUT_WAIT_MS    1000
+
+static int64_t remote_input_pending_us = 0;    /* Oldest input not yet on the ring */
+static portMUX_TYPE remote_input_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void remote_input_task(void *pvParameters)
+{
+    zigbee_remote_input_t input;
+    char command[32];
+    
+    while (1) {
+        if (!zigbee_remote_poll(&input, REMOTE_INPUT_WAIT_MS) ||
+            !zigbee_remote_map(&input, command, sizeof(command))) {
+            continue;
+        }
+        halo_mod_input_event(HALO_MOD_IN_TOUCH);
+        run_command(HALO_JOURNAL_SRC_REMOTE, command, strlen(command));
+        
+        taskENTER_CRITICAL(&remote_input_lock);
+        if (remote_input_pending_us == 0) {
+            remote_input_pending_us = input.rx_us;
+        }
+        taskEXIT_CRITICAL(&remote_input_lock);
+    }
+}
+
+static void start_remote_inputs(void)
+{
+    if (halo_task_create_static(HALO_TASK_REMOTE, remote_input_task, NULL) == NULL) {
+        ESP_LOGE(TAG, "Failed to start the Zigbee remote input task");
+    }
+}
+
+/* Call once the frame has been pushed to the LEDs */
+static void remote_input_frame_shown(void)
+{
+    taskENTER_CRITICAL(&remote_input_lock);
+    int64_t pending_us = remote_input_pending_us;
+    remote_input_pending_us = 0;
+    taskEXIT_CRITICAL(&remote_input_lock);
+    
+    if (pending_us != 0) {
+        zigbee_remote_record_latency(pending_us);
+    }
+}
+#else
+static void remote_input_frame_shown(void) {}
+#endif
+
+#if CONFIG_HALO_MQTT
+/* "#<id> <command>" gets a reply on MQTT_RESPONSE_TOPIC (see mqtt_response.h) */
+static void run_mqtt_command(const char *data, int data_len)
+{
+    int64_t rx_us = esp_timer_get_time();
+    xSemaphoreTake(command_lock, portMAX_DELAY);
+    int skip = mqtt_response_begin(data, data_len, rx_us);
+    bool device = is_device_command(data + skip, data_len - skip);
+    if (device) {
+        mqtt_response_await_zigbee();
     }
+    handle_journaled_command(HALO_JOURNAL_SRC_MQTT, data + skip, data_len - skip);
+    mqtt_response_end(command_error, device);
+    xSemaphoreGive(command_lock);
 }
 
+static int asset_resubscribe_id = -1;
+
 /* MQTT event handler */
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, 
                                int32_t event_id, void *event_data)
@@ -1526,24 +2279,47 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
     
     switch ((esp_mqtt_event_id_t)event_id) {
         case MQTT_EVENT_CONNECTED:
-            ESP_LOGI(TAG_MQTT, "Connected to Adafruit IO!");
-            /* Subscribe to our feed */
-            esp_mqtt_client_subscribe(mqtt_client, MQTT_TOPIC, 0);
-            ESP_LOGI(TAG_MQTT, "Subscribed to: %s", MQTT_TOPIC);
+            ESP_LOGI(TAG_MQTT, "Connected to Adafruit IO! (session %s)",
+                     event->session_present ? "resumed" : "new");
+            /* A resumed persistent session still holds our subscriptions */
+            if (!event->session_present) {
+                const esp_mqtt_topic_t topics[] = {
+                    { .filter = MQTT_TOPIC, .qos = MQTT_COMMAND_QOS },
+                    { .filter = MQTT_ASSET_TOPIC, .qos = MQTT_COMMAND_QOS },
+                };
+                esp_mqtt_client_subscribe_multiple(mqtt_client, topics, 2);
+                ESP_LOGI(TAG_MQTT, "Subscribed to: %s, %s (QoS %d)", MQTT_TOPIC, MQTT_ASSET_TOPIC,
+                         MQTT_COMMAND_QOS);
+            } else {
+                /* Sessions from before asset uploads lack that one; its SUBACK is not a connect */
+                asset_resubscribe_id = esp_mqtt_client_subscribe(mqtt_client, MQTT_ASSET_TOPIC,
+                                                                 MQTT_COMMAND_QOS);
+                conn_manager_notify_mqtt_connected();  /* Commands already flowing */
+            }
+            /* Reaching the broker proves a freshly updated image works */
+            delta_ota_mark_valid();
             break;
             
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGW(TAG_MQTT, "Disconnected from Adafruit IO");
+            mqtt_assembler_reset();
+            conn_manager_notify_mqtt_disconnected();
             break;
             
         case MQTT_EVENT_SUBSCRIBED:
             ESP_LOGI(TAG_MQTT, "Subscription confirmed");
+            if (event->msg_id != asset_resubscribe_id) {
+                conn_manager_notify_mqtt_connected();
+            }
             break;
             
         case MQTT_EVENT_DATA:
-            ESP_LOGI(TAG_MQTT, "Message received on topic: %.*s", 
-                     event->topic_len, event->topic);
-            handle_mqtt_command(event->data, event->data_len);
+            /* Only the first part of a fragmented message carries the topic */
+            if (event->current_data_offset == 0) {
+                ESP_LOGI(TAG_MQTT, "Message received on topic: %.*s (%d bytes)",
+                         event->topic_len, event->topic, event->total_data_len);
+            }
+            mqtt_assembler_feed(event);
             break;
             
         case MQTT_EVENT_ERROR:
@@ -1562,18 +2338,38 @@ static void mqtt_init(void)
     ESP_LOGI(TAG_MQTT, "Username: %s", ADAFRUIT_IO_USERNAME);
     ESP_LOGI(TAG_MQTT, "Feed: %s", ADAFRUIT_IO_FEED);
     
+    /* Persistent sessions are keyed by client ID, so it must not change across boots */
+    static char client_id[24];
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(client_id, sizeof(client_id), "halo-%02x%02x%02x%02x%02x%02x",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    
     esp_mqtt_client_config_t mqtt_cfg = {
-        .broker.address.uri = "mqtt://io.adafruit.com:1883",  /* Non-SSL for simplicity */
+        .broker.address.hostname = MQTT_BROKER_HOST,
+        .broker.address.port = MQTT_BROKER_PORT_TLS,
+        .broker.address.transport = MQTT_TRANSPORT_OVER_SSL,
+        .network.transport = mqtt_tls_transport_create(),
         .credentials.username = ADAFRUIT_IO_USERNAME,
+        .credentials.client_id = client_id,
         .credentials.authentication.password = ADAFRUIT_IO_KEY,
+        .session.disable_clean_session = true,
+        .session.keepalive = MQTT_KEEPALIVE_SEC,
+        .network.reconnect_timeout_ms = CONN_MQTT_RETRY_MS,
+        .task.priority = HALO_TASK_MQTT_PRIO,
+        .task.stack_size = HALO_TASK_MQTT_STACK,
     };
     
     mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
     esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
-    esp_mqtt_client_start(mqtt_client);
+    /* Started (and restarted after link loss) by the connection manager */
+    conn_manager_attach_mqtt(mqtt_client);
+    mqtt_response_init(mqtt_client, MQTT_RESPONSE_TOPIC);
+    mqtt_assembler_init(MQTT_TOPIC, MQTT_ASSET_TOPIC, run_mqtt_command);
     
-    ESP_LOGI(TAG_MQTT, "MQTT client started, connecting...");
+    ESP_LOGI(TAG_MQTT, "MQTT client handed to connection manager");
 }
+#endif
 
 /* ============================================================================
    MATTER CALLBACKS
@@ -1582,6 +2378,8 @@ static void mqtt_init(void)
    sends commands. They interface with the existing LED and Zigbee control.
    ============================================================================ */
 
+#if CONFIG_HALO_MATTER
+
 static void matter_on_light_on_off(bool on)
 {
     ESP_LOGI(TAG, "[Matter] Light On/Off: %s", on ? "ON" : "OFF");
@@ -1592,6 +2390,7 @@ static void matter_on_light_on_off(bool on)
         /* Turn off */
         current_animation = ANIM_OFF;
     }
+    journal_note(HALO_JOURNAL_SRC_MATTER, 0, on ? "on" : "off");
 }
 
 static void matter_on_light_brightness(uint8_t brightness)
@@ -1607,6 +2406,9 @@ static void matter_on_light_brightness(uint8_t brightness)
             current_animation = ANIM_SOLID;
         }
     }
+    char text[24];
+    snprintf(text, sizeof(text), "matter:brightness:%d", brightness);
+    journal_note(HALO_JOURNAL_SRC_MATTER, 0, text);
 }
 
 static void matter_on_light_color(uint8_t r, uint8_t g, uint8_t b)
@@ -1617,6 +2419,10 @@ static void matter_on_light_color(uint8_t r, uint8_t g, uint8_t b)
     strip_color_b = b;
     strip_color_w = 0;  /* RGB mode - turn OFF white channel */
     current_animation = ANIM_SOLID;
+    
+    char text[24];
+    snprintf(text, sizeof(text), "matter:color:%02X%02X%02X", r, g, b);
+    journal_note(HALO_JOURNAL_SRC_MATTER, 0, text);
 }
 
 /* Color temperature callback - used for white mode on RGBW lights
@@ -1641,8 +2447,13 @@ static void matter_on_light_color_temp(uint16_t mireds)
     strip_color_w = 255;  /* Full white - brightness is controlled separately */
     
     current_animation = ANIM_SOLID;
+    
+    char text[28];
+    snprintf(text, sizeof(text), "matter:color_temp:%u", mireds);
+    journal_note(HALO_JOURNAL_SRC_MATTER, 0, text);
 }
 
+#if CONFIG_HALO_ZIGBEE
 static void matter_on_blinds_position(uint8_t position)
 {
     /* IMPORTANT: Matter uses INVERTED position values!
@@ -1653,20 +2464,27 @@ static void matter_on_blinds_position(uint8_t position)
     
     ESP_LOGI(TAG, "[Matter] Blinds Position: %d%% (Matter) → %d%% (Tuya)", position, tuya_position);
     
+    char text[16];
     if (tuya_position == 100) {
         zigbee_blind_open(0);    /* Fully open */
+        strcpy(text, "blinds:open");
     } else if (tuya_position == 0) {
         zigbee_blind_close(0);   /* Fully closed */
+        strcpy(text, "blinds:close");
     } else {
         zigbee_blind_set_position(0, tuya_position);
+        snprintf(text, sizeof(text), "blinds:%d", tuya_position);
     }
+    journal_note(HALO_JOURNAL_SRC_MATTER, HALO_JOURNAL_F_DEVICE, text);
 }
 
 static void matter_on_blinds_stop(void)
 {
     ESP_LOGI(TAG, "[Matter] Blinds Stop");
     zigbee_blind_stop(0);
+    journal_note(HALO_JOURNAL_SRC_MATTER, HALO_JOURNAL_F_DEVICE, "blinds:stop");
 }
+#endif
 
 /* Initialize Matter smart home integration 
  * Returns true if successful, false otherwise.
@@ -1682,8 +2500,10 @@ static bool matter_init(void)
         .light_brightness = matter_on_light_brightness,
         .light_color = matter_on_light_color,
         .light_color_temp = matter_on_light_color_temp,  /* For "warm white" / "cool white" commands */
+#if CONFIG_HALO_ZIGBEE
         .blinds_position = matter_on_blinds_position,
         .blinds_stop = matter_on_blinds_stop,
+#endif
     };
     
     esp_err_t err = matter_devices_init(&callbacks);
@@ -1703,6 +2523,7 @@ static bool matter_init(void)
         return false;
     }
 }
+#endif
 
 /* Use project configuration menu (idf.py menuconfig) to choose the GPIO to blink,
    or you can edit the following line and set a number here.
@@ -1907,6 +2728,8 @@ static void configure_rgbw_led(void)
         .flags.with_dma = false,
     };
 
+    gamma_lut_init();
+
     ESP_LOGI(TAG_RGBW, "Creating RMT device for LED strip...");
     esp_err_t ret = led_strip_new_rmt_device(&strip_config, &rmt_config, &rgbw_strip);
     
@@ -1923,8 +2746,33 @@ static void configure_rgbw_led(void)
     ESP_LOGI(TAG_RGBW, "========================================");
 }
 
+/* ============================================================================
+   IRAM RENDER PATH
+   ============================================================================
+   Every NVS commit (rotation count, Zigbee device table, Matter attributes)
+   turns the flash cache off while it writes. On this single-core chip the
+   scheduler is paused for the write too, so the part that must keep running
+   is the RMT interrupt refilling the strip's symbol memory: 45 RGBW pixels
+   need several refills per frame, and a refill that waits for the cache
+   ends the frame early on the wire - the visible hiccup. CONFIG_RMT_ISR_IRAM_SAFE
+   puts the ISR in IRAM and main/linker.lf moves the led_strip encoder the
+   ISR calls there with it.
+
+   The render task does not run during the write: CONFIG_SPI_FLASH_AUTO_SUSPEND
+   is off, so the scheduler stays paused until it ends and no placement of
+   task code changes that. The IRAM_ATTR on the pixel setter, the meteor,
+   solid and off kernels, and the gamma table in RAM only spare their
+   per-pixel loops instruction-cache misses. refresh_strip() and
+   get_master_brightness() call into flash (RMT driver, float helpers), so
+   they stay in flash too. So does halo_mod_value(), which the kernels call
+   once per frame: it reads the parameter table from flash .rodata and
+   converts with the soft-float helpers. halo_mod_tint() is integer math on
+   a RAM table, but saves cache misses only, like the rest. The other
+   animations still call libm.
+   ============================================================================ */
+
 /* Set a single pixel on the RGBW strip */
-static void set_pixel_rgbw(int index, uint8_t red, uint8_t green, uint8_t blue, uint8_t white)
+static IRAM_ATTR void set_pixel_rgbw(int index, uint8_t red, uint8_t green, uint8_t blue, uint8_t white)
 {
     if (rgbw_strip == NULL || index < 0 || index >= RGBW_LED_COUNT) {
         return;
@@ -2009,28 +2857,51 @@ static void draw_brightness_gauge(void)
 
 /* Gamma correction for perceptually smooth brightness falloff */
 #define GAMMA 2.2f
+#define GAMMA_LUT_SIZE 256   /* Segments, interpolated: at most 5e-6 off powf */
+
+/* x^GAMMA at x = i / GAMMA_LUT_SIZE, in RAM (.bss) so lookups never touch flash */
+static float gamma_lut[GAMMA_LUT_SIZE + 1];
+
+static void gamma_lut_init(void)
+{
+    for (int i = 0; i <= GAMMA_LUT_SIZE; i++) {
+        gamma_lut[i] = powf((float)i / GAMMA_LUT_SIZE, GAMMA);
+    }
+}
 
 /* Master brightness is controlled by rotary encoder OR software override
    - Rotate CCW: decrease brightness (min 20%)
    - Rotate CW: increase brightness (max 100%)
    - Software override (via MQTT/Matter brightness) takes precedence
-   Returns 0.20 to 1.0 */
+   - Scaled by the "level" parameter (halo_mod.h), read once per frame
+   Returns 0.0 to 1.0 */
+static float mod_level = 1.0f;
+
 static float get_master_brightness(void)
 {
-    return get_effective_brightness();  /* Uses software override if set */
+    return get_effective_brightness() * mod_level;  /* Uses software override if set */
 }
 
 /* Macro for all animations to use */
 #define MASTER_BRIGHTNESS (get_master_brightness())
 
-/* Apply gamma correction for perceptually smooth brightness */
-static float gamma_correct(float linear_value)
+#if CONFIG_HALO_EFFECT_METEOR || CONFIG_HALO_EFFECT_METEOR_SHOWER || CONFIG_HALO_EFFECT_BREATHING
+/* Apply gamma correction for perceptually smooth brightness (input 0-1) */
+static IRAM_ATTR float gamma_correct(float linear_value)
 {
-    return powf(linear_value, GAMMA);
+    if (linear_value <= 0.0f) return 0.0f;
+    if (linear_value >= 1.0f) return 1.0f;
+    
+    float pos = linear_value * GAMMA_LUT_SIZE;
+    int i = (int)pos;
+    float frac = pos - (float)i;
+    return gamma_lut[i] + (gamma_lut[i + 1] - gamma_lut[i]) * frac;
 }
+#endif
 
+#if CONFIG_HALO_EFFECT_METEOR
 /* Draw the meteor spinner at a given head position (floating-point for smoothness) */
-static void draw_meteor_spinner(float head_pos)
+static IRAM_ATTR void draw_meteor_spinner(float head_pos)
 {
     if (rgbw_strip == NULL) return;
     
@@ -2039,6 +2910,9 @@ static void draw_meteor_spinner(float head_pos)
     uint8_t cg = strip_color_g;
     uint8_t cb = strip_color_b;
     uint8_t cw = strip_color_w;
+    float master = MASTER_BRIGHTNESS;
+    halo_mod_tint(&cr, &cg, &cb);
+    float tail = (float)RGBW_LED_COUNT * halo_mod_value(HALO_MOD_METEOR_TAIL);
     
     for (int i = 0; i < RGBW_LED_COUNT; i++) {
         float distance_behind = head_pos - (float)i;
@@ -2046,21 +2920,22 @@ static void draw_meteor_spinner(float head_pos)
         while (distance_behind < 0) distance_behind += RGBW_LED_COUNT;
         while (distance_behind >= RGBW_LED_COUNT) distance_behind -= RGBW_LED_COUNT;
         
-        float linear_brightness = 1.0f - (distance_behind / (float)RGBW_LED_COUNT);
+        float linear_brightness = 1.0f - (distance_behind / tail);
         if (linear_brightness < 0.0f) linear_brightness = 0.0f;
         if (linear_brightness > 1.0f) linear_brightness = 1.0f;
         
-        float corrected_brightness = gamma_correct(linear_brightness);
+        float corrected_brightness = gamma_correct(linear_brightness) * master;
         
-        uint8_t pr = (uint8_t)(cr * corrected_brightness * MASTER_BRIGHTNESS);
-        uint8_t pg = (uint8_t)(cg * corrected_brightness * MASTER_BRIGHTNESS);
-        uint8_t pb = (uint8_t)(cb * corrected_brightness * MASTER_BRIGHTNESS);
-        uint8_t pw = (uint8_t)(cw * corrected_brightness * MASTER_BRIGHTNESS);
+        uint8_t pr = (uint8_t)(cr * corrected_brightness);
+        uint8_t pg = (uint8_t)(cg * corrected_brightness);
+        uint8_t pb = (uint8_t)(cb * corrected_brightness);
+        uint8_t pw = (uint8_t)(cw * corrected_brightness);
         
         set_pixel_rgbw(i, pr, pg, pb, pw);
     }
     refresh_strip();
 }
+#endif
 
 /* ============================================================================
    METEOR SHOWER ANIMATION
@@ -2069,6 +2944,7 @@ static void draw_meteor_spinner(float head_pos)
    Each meteor has varying brightness which determines tail length.
    ============================================================================ */
 
+#if CONFIG_HALO_EFFECT_METEOR_SHOWER
 #define METEOR_SHOWER_COUNT 5   /* Number of simultaneous meteors */
 #define METEOR_SHOWER_MIN_TAIL 3
 #define METEOR_SHOWER_MAX_TAIL 15
@@ -2089,9 +2965,17 @@ static void draw_meteor_shower(bool reset)
     
     static bool initialized = false;
     static uint32_t rand_seed = 98765;
+    static uint32_t seed_gen = 0;
     
     #define SHOWER_RAND() (rand_seed = rand_seed * 1103515245 + 12345, (rand_seed >> 16) & 0xFFFF)
     
+    /* A new effect seed restarts the shower from it */
+    if (seed_gen != effect_seed_gen) {
+        seed_gen = effect_seed_gen;
+        rand_seed = effect_seed ^ 98765;
+        reset = true;
+    }
+    
     /* Initialize or reset meteors */
     if (reset || !initialized) {
         for (int i = 0; i < METEOR_SHOWER_COUNT; i++) {
@@ -2217,15 +3101,22 @@ static void draw_meteor_shower(bool reset)
     
     refresh_strip();
 }
+#endif
 
+#if CONFIG_HALO_EFFECT_RAINBOW
 /* Rainbow animation - cycles through hues */
 static void draw_rainbow(float phase)
 {
     if (rgbw_strip == NULL) return;
     
+    /* Unmodulated, keep the original expression: a per-pixel step rounds differently */
+    bool spread_default = halo_mod_is_default(HALO_MOD_RAINBOW_SPREAD);
+    float hue_step = 360.0f * halo_mod_value(HALO_MOD_RAINBOW_SPREAD) / RGBW_LED_COUNT;
+    
     for (int i = 0; i < RGBW_LED_COUNT; i++) {
         /* Calculate hue for this pixel (0-360 degrees, spread across strip) */
-        float hue = fmodf(phase + (float)i * 360.0f / RGBW_LED_COUNT, 360.0f);
+        float offset = spread_default ? (float)i * 360.0f / RGBW_LED_COUNT : (float)i * hue_step;
+        float hue = fmodf(phase + offset, 360.0f);
         
         /* HSV to RGB (simplified, saturation=1, value=1) */
         float h = hue / 60.0f;
@@ -2251,20 +3142,27 @@ static void draw_rainbow(float phase)
     }
     refresh_strip();
 }
+#endif
 
+#if CONFIG_HALO_EFFECT_BREATHING
 /* Breathing animation - pulses brightness up and down */
 static void draw_breathing(float phase)
 {
     if (rgbw_strip == NULL) return;
     
-    /* Sine wave for smooth breathing (0 to 1) */
+    /* Sine wave for smooth breathing (1 - depth to 1, 0 to 1 unmodulated) */
     float brightness = 0.5f + 0.5f * sinf(phase);
+    if (!halo_mod_is_default(HALO_MOD_BREATHING_DEPTH)) {
+        float depth = halo_mod_value(HALO_MOD_BREATHING_DEPTH);
+        brightness = 1.0f - depth * (1.0f - brightness);
+    }
     brightness = gamma_correct(brightness);
     
     uint8_t cr = strip_color_r;
     uint8_t cg = strip_color_g;
     uint8_t cb = strip_color_b;
     uint8_t cw = strip_color_w;
+    halo_mod_tint(&cr, &cg, &cb);
     
     for (int i = 0; i < RGBW_LED_COUNT; i++) {
         set_pixel_rgbw(i,
@@ -2275,15 +3173,21 @@ static void draw_breathing(float phase)
     }
     refresh_strip();
 }
+#endif
 
 /* Solid color - all pixels same color */
-static void draw_solid(void)
+static IRAM_ATTR void draw_solid(void)
 {
     if (rgbw_strip == NULL) return;
     
-    uint8_t cr = (uint8_t)(strip_color_r * MASTER_BRIGHTNESS);
-    uint8_t cg = (uint8_t)(strip_color_g * MASTER_BRIGHTNESS);
-    uint8_t cb = (uint8_t)(strip_color_b * MASTER_BRIGHTNESS);
+    uint8_t tr = strip_color_r;
+    uint8_t tg = strip_color_g;
+    uint8_t tb = strip_color_b;
+    halo_mod_tint(&tr, &tg, &tb);
+    
+    uint8_t cr = (uint8_t)(tr * MASTER_BRIGHTNESS);
+    uint8_t cg = (uint8_t)(tg * MASTER_BRIGHTNESS);
+    uint8_t cb = (uint8_t)(tb * MASTER_BRIGHTNESS);
     uint8_t cw = (uint8_t)(strip_color_w * MASTER_BRIGHTNESS);
     
     for (int i = 0; i < RGBW_LED_COUNT; i++) {
@@ -2292,6 +3196,7 @@ static void draw_solid(void)
     refresh_strip();
 }
 
+#if CONFIG_HALO_EFFECT_FUSION
 /* Fusion mode - Two particles passing through each other
    
    Animation:
@@ -2327,8 +3232,8 @@ static void draw_fusion(float phase)
     float purple_pos = max_pos - eased * max_pos;
     
     /* Falloff rate - controls how quickly the trail fades
-       Higher = sharper falloff, lower = longer trail */
-    const float falloff_rate = 0.30f;  /* Doubled for faster falloff */
+       Higher = sharper falloff, lower = longer trail ("fusion.falloff", 0.30) */
+    const float falloff_rate = halo_mod_value(HALO_MOD_FUSION_FALLOFF);
     
     /* For each pixel, calculate influence from both particles */
     for (int i = 0; i < RGBW_LED_COUNT; i++) {
@@ -2371,7 +3276,9 @@ static void draw_fusion(float phase)
     
     refresh_strip();
 }
+#endif
 
+#if CONFIG_HALO_EFFECT_WAVE
 /* Wave mode - blue pulse over dark blue ocean
    - Wave starts at center with gradual fade-in
    - Expands outward with smooth motion
@@ -2394,8 +3301,8 @@ static void draw_wave(float phase)
     /* Center of the strip */
     float center = (float)(RGBW_LED_COUNT - 1) / 2.0f;
     
-    /* Wave width for soft gaussian-like falloff */
-    float wave_width = 3.0f;
+    /* Wave width for soft gaussian-like falloff ("wave.width", 3.0) */
+    float wave_width = halo_mod_value(HALO_MOD_WAVE_WIDTH);
     
     /* Max radius extends beyond edge so wave fully exits before regenerating */
     float max_radius = center + wave_width * 3.0f;
@@ -2465,7 +3372,9 @@ static void draw_wave(float phase)
     }
     refresh_strip();
 }
+#endif
 
+#if CONFIG_HALO_EFFECT_TETRIS
 /* Tetris mode - random colored pixels falling, stacking, then draining
    - Pixels "fall" from one end (left) and stack on the other (right)
    - Each pixel has a random vibrant color
@@ -2486,6 +3395,7 @@ static void draw_tetris(float phase, bool reset)
     static bool initialized = false;
     static bool draining = false;  /* false = filling, true = draining */
     static uint32_t random_seed = 12345;
+    static uint32_t seed_gen = 0;
     static int frame_count = 0;
     
     /* Simple pseudo-random number generator */
@@ -2508,6 +3418,13 @@ static void draw_tetris(float phase, bool reset)
         } \
     } while(0)
     
+    /* A new effect seed restarts the stack from it */
+    if (seed_gen != effect_seed_gen) {
+        seed_gen = effect_seed_gen;
+        random_seed = effect_seed ^ 12345;
+        reset = true;
+    }
+    
     /* Reset state if requested or first run */
     if (reset || !initialized) {
         stack_height = 0;
@@ -2607,7 +3524,9 @@ static void draw_tetris(float phase, bool reset)
     #undef TETRIS_RAND
     #undef NEW_COLOR
 }
+#endif
 
+#if CONFIG_HALO_EFFECT_STARS
 /* Stars twinkling animation - organic starry night
    - Random stars spawn and twinkle at random positions
    - Different star types with different rarities and brightness
@@ -2638,11 +3557,19 @@ static void draw_stars(bool reset)
     } stars[MAX_STARS];
     static bool initialized = false;
     static uint32_t rand_seed = 54321;
+    static uint32_t seed_gen = 0;
     static int frame_count = 0;
     static float twinkle_time = 0.0f;  /* Global time for twinkle oscillation */
     
     #define STAR_RAND() (rand_seed = rand_seed * 1103515245 + 12345, (rand_seed >> 16) & 0xFFFF)
     
+    /* A new effect seed restarts the sky from it */
+    if (seed_gen != effect_seed_gen) {
+        seed_gen = effect_seed_gen;
+        rand_seed = effect_seed ^ 54321;
+        reset = true;
+    }
+    
     if (reset || !initialized) {
         for (int i = 0; i < MAX_STARS; i++) {
             stars[i].pos = -1;
@@ -2902,9 +3829,10 @@ static void draw_stars(bool reset)
     #undef MAX_STARS
     #undef STAR_RAND
 }
+#endif
 
 /* Turn off all LEDs */
-static void draw_off(void)
+static IRAM_ATTR void draw_off(void)
 {
     if (rgbw_strip == NULL) return;
     
@@ -2914,6 +3842,167 @@ static void draw_off(void)
     refresh_strip();
 }
 
+/* ============================================================================
+   RENDER BENCHMARK
+   ============================================================================
+   Runs in the render loop (the only task that may touch the strip). Each
+   animation is drawn RENDER_BENCH_FRAMES times back to back. Draw times
+   include the LED push, which is timed on its own first so the drawing
+   cost can be read as the difference. The ring flickers through the
+   animations for about a second.
+   ============================================================================ */
+
+#define RENDER_BENCH_FRAMES 60
+
+static void bench_report(const char *name, const int64_t *samples_us)
+{
+    int64_t total = 0, max = 0;
+    for (int i = 0; i < RENDER_BENCH_FRAMES; i++) {
+        total += samples_us[i];
+        if (samples_us[i] > max) max = samples_us[i];
+    }
+    ESP_LOGI(TAG, "  %-14s avg %5lldus  max %5lldus", name, total / RENDER_BENCH_FRAMES, max);
+}
+
+static void run_render_bench(void)
+{
+    static const struct {
+        const char *name;
+        animation_mode_t mode;
+    } effects[] = {
+#if CONFIG_HALO_EFFECT_FUSION
+        { "fusion", ANIM_FUSION },
+#endif
+#if CONFIG_HALO_EFFECT_WAVE
+        { "wave", ANIM_WAVE },
+#endif
+#if CONFIG_HALO_EFFECT_TETRIS
+        { "tetris", ANIM_TETRIS },
+#endif
+#if CONFIG_HALO_EFFECT_STARS
+        { "stars", ANIM_STARS },
+#endif
+#if CONFIG_HALO_EFFECT_METEOR
+        { "meteor", ANIM_METEOR },
+#endif
+#if CONFIG_HALO_EFFECT_METEOR_SHOWER
+        { "shower", ANIM_METEOR_SHOWER },
+#endif
+#if CONFIG_HALO_EFFECT_RAINBOW
+        { "rainbow", ANIM_RAINBOW },
+#endif
+#if CONFIG_HALO_EFFECT_BREATHING
+        { "breathing", ANIM_BREATHING },
+#endif
+        { "solid", ANIM_SOLID },
+        { "off", ANIM_OFF },
+    };
+    int64_t samples_us[RENDER_BENCH_FRAMES];
+
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "  Render bench - %d frames each, %d LEDs", RENDER_BENCH_FRAMES, RGBW_LED_COUNT);
+    for (int f = 0; f < RENDER_BENCH_FRAMES; f++) {
+        int64_t start = esp_timer_get_time();
+        refresh_strip();
+        samples_us[f] = esp_timer_get_time() - start;
+    }
+    bench_report("led push", samples_us);
+
+    for (int anim = 0; anim < (int)(sizeof(effects) / sizeof(effects[0])); anim++) {
+        float phase = 0.0f;
+        for (int f = 0; f < RENDER_BENCH_FRAMES; f++) {
+            int64_t start = esp_timer_get_time();
+            switch (effects[anim].mode) {
+#if CONFIG_HALO_EFFECT_FUSION
+                case ANIM_FUSION: draw_fusion(phase); break;
+#endif
+#if CONFIG_HALO_EFFECT_WAVE
+                case ANIM_WAVE: draw_wave(phase); break;
+#endif
+#if CONFIG_HALO_EFFECT_TETRIS
+                case ANIM_TETRIS: draw_tetris(0, f == 0); break;
+#endif
+#if CONFIG_HALO_EFFECT_STARS
+                case ANIM_STARS: draw_stars(f == 0); break;
+#endif
+#if CONFIG_HALO_EFFECT_METEOR
+                case ANIM_METEOR: draw_meteor_spinner(fmodf(phase * 10.0f, RGBW_LED_COUNT)); break;
+#endif
+#if CONFIG_HALO_EFFECT_METEOR_SHOWER
+                case ANIM_METEOR_SHOWER: draw_meteor_shower(f == 0); break;
+#endif
+#if CONFIG_HALO_EFFECT_RAINBOW
+                case ANIM_RAINBOW: draw_rainbow(fmodf(phase * 50.0f, 360.0f)); break;
+#endif
+#if CONFIG_HALO_EFFECT_BREATHING
+                case ANIM_BREATHING: draw_breathing(phase); break;
+#endif
+                case ANIM_SOLID: draw_solid(); break;
+                default: draw_off(); break;
+            }
+            samples_us[f] = esp_timer_get_time() - start;
+            phase += 0.1f;
+        }
+        bench_report(effects[anim].name, samples_us);
+        halo_task_heartbeat(HALO_TASK_RENDER);  /* The whole run is longer than one deadline */
+    }
+    ESP_LOGI(TAG, "");
+}
+
+/* NVS write hammer: NVS_BENCH_WRITES commits from the caller's task while
+   the render loop keeps drawing. Each one rewrites the same key, so NVS also
+   erases a page now and then, as it does in normal use. Passes if no render
+   frame overran its budget meanwhile. */
+#define NVS_BENCH_WRITES    100
+#define NVS_BENCH_GAP_MS    20      /* Room for the render task between commits */
+
+static void run_nvs_bench(void)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open("nvs_bench", NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG_NVS, "NVS bench: open failed: %s", esp_err_to_name(err));
+        return;
+    }
+    
+    uint32_t frames_before, overruns_before;
+    halo_task_render_counts(&frames_before, &overruns_before);
+    
+    int64_t total_us = 0, max_us = 0;
+    int done = 0;
+    for (; done < NVS_BENCH_WRITES; done++) {
+        int64_t start = esp_timer_get_time();
+        err = nvs_set_u32(nvs, "n", (uint32_t)done);
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        int64_t elapsed = esp_timer_get_time() - start;
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG_NVS, "NVS bench: write %d failed: %s", done, esp_err_to_name(err));
+            break;
+        }
+        total_us += elapsed;
+        if (elapsed > max_us) max_us = elapsed;
+        vTaskDelay(pdMS_TO_TICKS(NVS_BENCH_GAP_MS));
+    }
+    
+    uint32_t frames_after, overruns_after;
+    halo_task_render_counts(&frames_after, &overruns_after);
+    
+    nvs_erase_all(nvs);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+    
+    uint32_t overruns = overruns_after - overruns_before;
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "  NVS bench - %d commits, avg %lldus  max %lldus", done,
+             done > 0 ? total_us / done : 0, max_us);
+    ESP_LOGI(TAG, "  Render: %lu frames, %lu overruns meanwhile -> %s",
+             (unsigned long)(frames_after - frames_before), (unsigned long)overruns,
+             (overruns == 0 && done == NVS_BENCH_WRITES) ? "PASS" : "FAIL");
+    ESP_LOGI(TAG, "");
+}
+
 /* ============================================================================
    ONBOARD LED (from original blink example)
    ============================================================================
@@ -3079,6 +4168,18 @@ static void configure_led(void)
 #error "unsupported LED type"
 #endif
 
+#if CONFIG_HALO_SYNC
+/* Phase an effect has at position pos (halo_sync_position(), speed permille
+   x us) when it advances by speed x step every frame_ms: the same value on
+   every unit sharing the clock (double, since pos outgrows a float's
+   precision within seconds) */
+static float clock_phase(int64_t pos, float step, int frame_ms, float period)
+{
+    double cycles = (double)pos * step / ((double)frame_ms * 1000000.0 * period);
+    return (float)((cycles - floor(cycles)) * period);
+}
+#endif
+
 /* ============================================================================
    MAIN APPLICATION
    ============================================================================ */
@@ -3095,6 +4196,26 @@ void app_main(void)
     /* Step 0: Initialize persistent storage */
     ESP_LOGI(TAG, ">>> STEP 0: Initializing persistent storage...");
     init_persistent_storage();
+    
+    command_lock = xSemaphoreCreateMutexStatic(&command_lock_buf);
+    
+    /* Keep the command journal of the boots before this one (cleared on power-on) */
+    halo_journal_init();
+    
+    /* Effect parameters at their defaults before the first frame or mod: command */
+    halo_mod_init();
+    
+#if CONFIG_HALO_HEAP_TRACKER
+    /* Tag heap use per subsystem from here on (sampled, cheap enough to leave on) */
+    halo_heap_track_start(HALO_HEAP_SAMPLE_EVERY);
+#endif
+    
+    /* Task supervisor first. The render heartbeat only starts with the
+       animation loop, so boot gets its own deadline for the first frame. */
+    halo_task_adopt_current(HALO_TASK_RENDER);
+    halo_task_arm(HALO_TASK_RENDER, HALO_TASK_RENDER_BOOT_MS);
+    halo_supervisor_start();
+    halo_jobs_start();
 
     /* Step 1: Configure the onboard LED */
     ESP_LOGI(TAG, ">>> STEP 1: Configuring onboard LED...");
@@ -3184,7 +4305,15 @@ void app_main(void)
        - LED Strip: RGB scan (R, then G, then B), then white breathing
        ======================================================================== */
     ESP_LOGI(TAG, ">>> STEP 2: Connecting to WiFi%s...", s_dev_mode ? "" : " + Testing LED strip");
+    /* Each subsystem's init allocates from app_main; charge it to the subsystem */
+    HEAP_SCOPE_BEGIN(HALO_HEAP_TAG_WIFI);
     wifi_init_start();
+    HEAP_SCOPE_END();
+#if CONFIG_HALO_SYNC
+    
+    /* Animation sync role from NVS (needs lwIP up); the task waits for an address */
+    halo_sync_init();
+#endif
     
     /* DEV MODE: Fast path - just wait for WiFi without hardware tests */
     if (s_dev_mode) {
@@ -3444,145 +4573,143 @@ wifi_done:  /* Label for dev mode fast path to skip hardware tests */
     /* Show result with smooth fade */
     if (wifi_check_status() == 1) {
         ESP_LOGI(TAG, ">>> WiFi CONNECTED!%s", s_dev_mode ? "" : " Fading to solid blue...");
+#if !CONFIG_HALO_MQTT
+        /* No MQTT connection to wait for: reaching the network is the health check */
+        delta_ota_mark_valid();
+#endif
         if (!s_dev_mode) {
             buzzer_chime_up();  /* Success chime! */
             fade_to_color(0, 0, 255, 800);  /* Fade to 100% blue */
         }
+    } else {
+        /* DEGRADED MODE: keep booting so local control (encoder, Zigbee,
+         * buttons) works. The connection manager keeps retrying and starts
+         * MQTT as soon as an IP address arrives. */
+        ESP_LOGE(TAG, ">>> WiFi FAILED! Continuing in degraded mode (local control only)");
+        if (!s_dev_mode) {
+            buzzer_error();  /* Error beeps! */
+            fade_to_color(255, 0, 0, 500);  /* Flash red, then carry on */
+            fade_to_color(0, 0, 0, 400);
+        }
+    }
+    
+#if CONFIG_HALO_MQTT
+    /* Start MQTT connection to Adafruit IO (for webhook/app control) */
+    ESP_LOGI(TAG, ">>> STEP 3a: Starting MQTT connection...");
+    HEAP_SCOPE_BEGIN(HALO_HEAP_TAG_MQTT);
+    mqtt_init();
+    HEAP_SCOPE_END();
+#endif
+    
+#if CONFIG_HALO_MATTER
+    /* Start Matter smart home (Google Home, Apple HomeKit, Alexa)
+     * This is optional - device works without it */
+    ESP_LOGI(TAG, ">>> STEP 3b: Starting Matter smart home (optional)...");
+    HEAP_SCOPE_BEGIN(HALO_HEAP_TAG_MATTER);
+    bool matter_ok = matter_init();
+    HEAP_SCOPE_END();
+    (void)matter_ok;  /* Result logged internally; boot continues either way */
+#endif
+    
+#if CONFIG_HALO_ZIGBEE
+    /* Start Zigbee coordinator for blind control */
+    ESP_LOGI(TAG, ">>> STEP 4: Starting Zigbee Hub...");
+    HEAP_SCOPE_BEGIN(HALO_HEAP_TAG_ZIGBEE);
+    esp_err_t zb_err = zigbee_hub_init();
+    HEAP_SCOPE_END();
+    if (zb_err == ESP_OK) {
+        ESP_LOGI(TAG, ">>> Zigbee Hub started successfully!");
+        start_remote_inputs();
         
-        /* Start MQTT connection to Adafruit IO (for webhook/app control) */
-        ESP_LOGI(TAG, ">>> STEP 3a: Starting MQTT connection...");
-        mqtt_init();
+        /* ================================================================
+           ZIGBEE FINDER MODE
+           ================================================================
+           Wait for Zigbee to either:
+           1. Reconnect to previously paired devices, OR
+           2. Complete finder mode (1 minute or until device pairs)
+           
+           During this time:
+           - LED strip: stays at boot state (10% warm white)
+           - Onboard LED: smooth sweeping green
+           - Buzzer: 4s sweep up + 1s sweep down
+           ================================================================ */
         
-        /* Start Matter smart home (Google Home, Apple HomeKit, Alexa)
-         * This is optional - device works without it */
-        ESP_LOGI(TAG, ">>> STEP 3b: Starting Matter smart home (optional)...");
-        bool matter_ok = matter_init();
-        (void)matter_ok;  /* Result logged internally; boot continues either way */
+        ESP_LOGI(TAG, ">>> STEP 5: Waiting for Zigbee finder mode...");
+        ESP_LOGI(TAG, "    (Searching for Zigbee devices for up to 60 seconds)");
         
-        /* Start Zigbee coordinator for blind control */
-        ESP_LOGI(TAG, ">>> STEP 4: Starting Zigbee Hub...");
-        esp_err_t zb_err = zigbee_hub_init();
-        if (zb_err == ESP_OK) {
-            ESP_LOGI(TAG, ">>> Zigbee Hub started successfully!");
-            
-            /* ================================================================
-               ZIGBEE FINDER MODE
-               ================================================================
-               Wait for Zigbee to either:
-               1. Reconnect to previously paired devices, OR
-               2. Complete finder mode (1 minute or until device pairs)
-               
-               During this time:
-               - LED strip: stays at boot state (10% warm white)
-               - Onboard LED: smooth sweeping green
-               - Buzzer: 4s sweep up + 1s sweep down
-               ================================================================ */
-            
-            ESP_LOGI(TAG, ">>> STEP 5: Waiting for Zigbee finder mode...");
-            ESP_LOGI(TAG, "    (Searching for Zigbee devices for up to 60 seconds)");
-            
-            float finder_pulse_phase = 0.0f;
-            int finder_wait_frames = 0;
-            const int finder_max_frames = 60 * 60;  /* 60 seconds at 60 FPS */
+        float finder_pulse_phase = 0.0f;
+        int finder_wait_frames = 0;
+        const int finder_max_frames = 60 * 60;  /* 60 seconds at 60 FPS */
+        
+        /* ================================================================
+           BUZZER SWEEP DURING FINDER MODE
+           ================================================================
+           - 4 seconds: Slow sweep up from 200Hz to 4000Hz
+           - 1 second: Fast sweep down from 4000Hz to 200Hz (4x faster)
+           - Then silence
+           Total: 5 seconds of buzzer, then quiet
+           ================================================================ */
+        const int SWEEP_UP_FRAMES = 4 * 60;     /* 4 seconds at 60 FPS = 240 frames */
+        const int SWEEP_DOWN_FRAMES = 1 * 60;   /* 1 second at 60 FPS = 60 frames */
+        const int SWEEP_MIN_HZ = 200;
+        const int SWEEP_MAX_HZ = 4000;
+        int buzzer_frame = 0;
+        bool buzzer_done = false;
+        
+        while (!zigbee_is_finder_complete() && finder_wait_frames < finder_max_frames) {
+            /* LED strip stays at boot state (10% warm white) - no changes needed */
             
-            /* ================================================================
-               BUZZER SWEEP DURING FINDER MODE
-               ================================================================
-               - 4 seconds: Slow sweep up from 200Hz to 4000Hz
-               - 1 second: Fast sweep down from 4000Hz to 200Hz (4x faster)
-               - Then silence
-               Total: 5 seconds of buzzer, then quiet
-               ================================================================ */
-            const int SWEEP_UP_FRAMES = 4 * 60;     /* 4 seconds at 60 FPS = 240 frames */
-            const int SWEEP_DOWN_FRAMES = 1 * 60;   /* 1 second at 60 FPS = 60 frames */
-            const int SWEEP_MIN_HZ = 200;
-            const int SWEEP_MAX_HZ = 4000;
-            int buzzer_frame = 0;
-            bool buzzer_done = false;
+            /* Onboard LED: Smooth sweeping green during finder mode */
+            finder_pulse_phase += 0.05f;
+            float brightness = (sinf(finder_pulse_phase) + 1.0f) * 0.5f;  /* 0 to 1 */
+            uint8_t green_val = (uint8_t)(brightness * 255.0f);  /* Full brightness sweep */
+            set_onboard_led_rgb(0, green_val, 0);
             
-            while (!zigbee_is_finder_complete() && finder_wait_frames < finder_max_frames) {
-                /* LED strip stays at boot state (10% warm white) - no changes needed */
-                
-                /* Onboard LED: Smooth sweeping green during finder mode */
-                finder_pulse_phase += 0.05f;
-                float brightness = (sinf(finder_pulse_phase) + 1.0f) * 0.5f;  /* 0 to 1 */
-                uint8_t green_val = (uint8_t)(brightness * 255.0f);  /* Full brightness sweep */
-                set_onboard_led_rgb(0, green_val, 0);
-                
-                /* Buzzer sweep logic (non-blocking) */
-                if (!buzzer_done && buzzer_initialized) {
-                    if (buzzer_frame < SWEEP_UP_FRAMES) {
-                        /* Sweep UP: 200Hz → 4000Hz over 4 seconds */
-                        float progress = (float)buzzer_frame / (float)SWEEP_UP_FRAMES;
-                        int freq = SWEEP_MIN_HZ + (int)(progress * (SWEEP_MAX_HZ - SWEEP_MIN_HZ));
-                        buzzer_set_freq(freq);  /* Non-blocking frequency update */
-                    } else if (buzzer_frame < SWEEP_UP_FRAMES + SWEEP_DOWN_FRAMES) {
-                        /* Sweep DOWN: 4000Hz → 200Hz over 1 second (4x faster) */
-                        int down_frame = buzzer_frame - SWEEP_UP_FRAMES;
-                        float progress = (float)down_frame / (float)SWEEP_DOWN_FRAMES;
-                        int freq = SWEEP_MAX_HZ - (int)(progress * (SWEEP_MAX_HZ - SWEEP_MIN_HZ));
-                        buzzer_set_freq(freq);  /* Non-blocking frequency update */
-                    } else {
-                        /* Done - stop buzzer */
-                        buzzer_stop();
-                        buzzer_done = true;
-                        ESP_LOGI(TAG, "    Buzzer sweep complete");
-                    }
-                    buzzer_frame++;
+            /* Buzzer sweep logic (non-blocking) */
+            if (!buzzer_done && buzzer_initialized) {
+                if (buzzer_frame < SWEEP_UP_FRAMES) {
+                    /* Sweep UP: 200Hz → 4000Hz over 4 seconds */
+                    float progress = (float)buzzer_frame / (float)SWEEP_UP_FRAMES;
+                    int freq = SWEEP_MIN_HZ + (int)(progress * (SWEEP_MAX_HZ - SWEEP_MIN_HZ));
+                    buzzer_set_freq(freq);  /* Non-blocking frequency update */
+                } else if (buzzer_frame < SWEEP_UP_FRAMES + SWEEP_DOWN_FRAMES) {
+                    /* Sweep DOWN: 4000Hz → 200Hz over 1 second (4x faster) */
+                    int down_frame = buzzer_frame - SWEEP_UP_FRAMES;
+                    float progress = (float)down_frame / (float)SWEEP_DOWN_FRAMES;
+                    int freq = SWEEP_MAX_HZ - (int)(progress * (SWEEP_MAX_HZ - SWEEP_MIN_HZ));
+                    buzzer_set_freq(freq);  /* Non-blocking frequency update */
+                } else {
+                    /* Done - stop buzzer */
+                    buzzer_stop();
+                    buzzer_done = true;
+                    ESP_LOGI(TAG, "    Buzzer sweep complete");
                 }
-                
-                finder_wait_frames++;
-                vTaskDelay(16 / portTICK_PERIOD_MS);  /* 60 FPS */
-            }
-            
-            /* Make sure buzzer is off when exiting finder mode */
-            if (buzzer_initialized && !buzzer_done) {
-                buzzer_stop();
-            }
-            
-            /* Finder mode complete - show result */
-            if (zigbee_get_device_count() > 0) {
-                ESP_LOGI(TAG, ">>> Zigbee: %d device(s) found/connected!", zigbee_get_device_count());
-                /* Flash green briefly to indicate success */
-                fade_to_color(0, 255, 0, 300);
-                vTaskDelay(500 / portTICK_PERIOD_MS);
-            } else {
-                ESP_LOGW(TAG, ">>> Zigbee: No devices found. Use 'blinds:pair' to pair later.");
+                buzzer_frame++;
             }
             
-        } else {
-            ESP_LOGE(TAG, ">>> Zigbee Hub failed to start: %s", esp_err_to_name(zb_err));
+            finder_wait_frames++;
+            vTaskDelay(16 / portTICK_PERIOD_MS);  /* 60 FPS */
         }
-    } else {
-        ESP_LOGE(TAG, ">>> WiFi FAILED!%s", s_dev_mode ? "" : " Fading to blinking red...");
-        ESP_LOGI(TAG, ">>> Press BOOT button to enter standby mode");
-        if (!s_dev_mode) {
-            buzzer_error();  /* Error beeps! */
-            fade_to_color(255, 0, 0, 500);  /* Fade to 100% red */
+        
+        /* Make sure buzzer is off when exiting finder mode */
+        if (buzzer_initialized && !buzzer_done) {
+            buzzer_stop();
         }
         
-        /* Blink red on/off - but check for power button to allow standby */
-        while (1) {
-            /* Check for power button press */
-            if (is_power_button_pressed()) {
-                vTaskDelay(50 / portTICK_PERIOD_MS);  /* Debounce */
-                if (is_power_button_pressed()) {
-                    ESP_LOGI(TAG, "Power button pressed, entering standby...");
-                    buzzer_chime_down();  /* Shutdown melody */
-                    while (is_power_button_pressed()) {
-                        vTaskDelay(50 / portTICK_PERIOD_MS);
-                    }
-                    vTaskDelay(100 / portTICK_PERIOD_MS);  /* Debounce release */
-                    enter_standby_mode();  /* Enter standby */
-                }
-            }
-            
-            fade_to_color(0, 0, 0, 400);
-            vTaskDelay(200 / portTICK_PERIOD_MS);
-            fade_to_color(255, 0, 0, 400);
-            vTaskDelay(200 / portTICK_PERIOD_MS);
+        /* Finder mode complete - show result */
+        if (zigbee_get_device_count() > 0) {
+            ESP_LOGI(TAG, ">>> Zigbee: %d device(s) found/connected!", zigbee_get_device_count());
+            /* Flash green briefly to indicate success */
+            fade_to_color(0, 255, 0, 300);
+            vTaskDelay(500 / portTICK_PERIOD_MS);
+        } else {
+            ESP_LOGW(TAG, ">>> Zigbee: No devices found. Use 'blinds:pair' to pair later.");
         }
+        
+    } else {
+        ESP_LOGE(TAG, ">>> Zigbee Hub failed to start: %s", esp_err_to_name(zb_err));
     }
+#endif
 
     /* ========================================================================
        MAIN ANIMATION LOOP
@@ -3620,10 +4747,33 @@ wifi_done:  /* Label for dev mode fast path to skip hardware tests */
         global_delay_ms \
     )
     
-    /* Cycle mode state (switches between fusion, wave, tetris every 20 seconds) */
+    /* Cycle mode state (switches between fusion, wave, tetris, stars every 20 seconds,
+       skipping any left out of the build) */
+    static const animation_mode_t cycle_modes[] = {
+#if CONFIG_HALO_EFFECT_FUSION
+        ANIM_FUSION,
+#endif
+#if CONFIG_HALO_EFFECT_WAVE
+        ANIM_WAVE,
+#endif
+#if CONFIG_HALO_EFFECT_TETRIS
+        ANIM_TETRIS,
+#endif
+#if CONFIG_HALO_EFFECT_STARS
+        ANIM_STARS,
+#endif
+#if !(CONFIG_HALO_EFFECT_FUSION || CONFIG_HALO_EFFECT_WAVE || CONFIG_HALO_EFFECT_TETRIS || CONFIG_HALO_EFFECT_STARS)
+        ANIM_SOLID,                       /* None of the four built */
+#endif
+    };
+    const int cycle_count = (int)(sizeof(cycle_modes) / sizeof(cycle_modes[0]));
     int cycle_timer_ms = 0;
     const int cycle_interval_ms = 20000;  /* 20 seconds */
-    int cycle_anim_index = 0;             /* 0=fusion, 1=wave, 2=tetris */
+    int cycle_anim_index = 0;             /* Index into cycle_modes */
+    
+    /* Local control over USB, same commands as MQTT (works without WiFi) */
+    ESP_LOGI(TAG, ">>> STEP 4b: Starting serial console...");
+    halo_console_start(run_console_command);
     
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, ">>> STEP 5: Starting animation loop...");
@@ -3631,7 +4781,9 @@ wifi_done:  /* Label for dev mode fast path to skip hardware tests */
     ESP_LOGI(TAG, "    - Brightness: controlled by rotary encoder (GPIO%d/%d) (20%% to 100%%)", 
              ENCODER_GPIO_A, ENCODER_GPIO_B);
     ESP_LOGI(TAG, "    - Lifetime rotations: %lu", (unsigned long)lifetime_rotations);
+#if CONFIG_HALO_MQTT
     ESP_LOGI(TAG, "    - MQTT: Listening for voice commands on '%s'", MQTT_TOPIC);
+#endif
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, "    Voice commands available:");
     ESP_LOGI(TAG, "      cycle, fusion, wave, tetris, stars, meteor, shower, rainbow, breathing, solid, off, on");
@@ -3641,12 +4793,39 @@ wifi_done:  /* Label for dev mode fast path to skip hardware tests */
     ESP_LOGI(TAG, "");
 
     while (1) {
+        int64_t frame_start_us = esp_timer_get_time();
+        
         /* Process rotary encoder events (brightness, on/off, animation changes) */
         /* Note: Encoder is interrupt-driven, events processed in is_encoder_adjusting() */
         
         /* Log system metrics every 30 seconds */
         log_system_metrics();
         
+        /* Modulated effect parameters, once per frame: the draw functions
+           only read the cached values. LFOs run on the shared clock when
+           there is one, so they line up across units as well. */
+        int64_t mod_now_us = frame_start_us;
+#if CONFIG_HALO_SYNC
+        if (halo_sync_active()) {
+            mod_now_us = halo_sync_now_us();
+        }
+#endif
+        halo_mod_eval(mod_now_us);
+        mod_level = halo_mod_value(HALO_MOD_LEVEL);
+        
+        if (render_bench_requested) {
+            render_bench_requested = false;
+            run_render_bench();
+            frame_start_us = esp_timer_get_time();  /* Not a frame overrun */
+        }
+        
+#if CONFIG_HALO_ZIGBEE
+        /* Rooms that follow the ring get the same state change this frame */
+        zigbee_lights_follow_ring(current_animation != ANIM_OFF,
+                                  (uint8_t)(get_effective_brightness() * 100.0f + 0.5f),
+                                  strip_color_r, strip_color_g, strip_color_b);
+#endif
+        
         /* Check if encoder is being adjusted - show brightness gauge instead of animation */
         if (is_encoder_adjusting()) {
             draw_brightness_gauge();
@@ -3692,60 +4871,105 @@ wifi_done:  /* Label for dev mode fast path to skip hardware tests */
                 }
             }
             
+            remote_input_frame_shown();
+            halo_task_render_frame((uint32_t)(esp_timer_get_time() - frame_start_us),
+                                   global_delay_ms * 1000);
             vTaskDelay(global_delay_ms / portTICK_PERIOD_MS);
             continue;  /* Skip normal animation this frame */
         }
         
         /* Get current animation mode (may change from MQTT at any time) */
         animation_mode_t mode = current_animation;
-        float speed = animation_speed;
+        float speed = animation_speed * halo_mod_value(HALO_MOD_SPEED);
         
         /* Get frame delay for current animation (may have local FPS override) */
         int frame_delay = GET_ANIM_DELAY(mode);
         
+#if CONFIG_HALO_SYNC
+        /* Units sharing a clock take their phases from it instead of counting
+           frames, so the same effect lines up on all of them. Random effects
+           (tetris, stars, shower) only share the cycle timing. The phase is
+           the anchored position (speed x time since the last speed change),
+           so a speed change carries on from the current phase. Modulating
+           the speed would move the anchor every frame: synced units run at
+           the set speed, and followers at the leader's. */
+        halo_sync_set_speed((uint32_t)(animation_speed * 1000.0f + 0.5f));
+        if (halo_sync_active()) {
+            int64_t shared_us = halo_sync_now_us();
+            int64_t pos = halo_sync_position(shared_us);
+            fusion_phase = clock_phase(pos, 0.12f, frame_delay, 2 * 3.14159f);
+            wave_phase = clock_phase(pos, 0.15f, frame_delay, 2 * 3.14159f);
+            rainbow_phase = clock_phase(pos, 5.0f, frame_delay, 360.0f);
+            breathing_phase = clock_phase(pos, 0.5f, frame_delay, 2 * 3.14159f);
+            head_position = clock_phase(pos, 1.0f, frame_delay, (float)RGBW_LED_COUNT);
+            int64_t shared_ms = shared_us / 1000;
+            cycle_anim_index = (int)((shared_ms / cycle_interval_ms) % cycle_count);
+            cycle_timer_ms = (int)(shared_ms % cycle_interval_ms);
+        }
+#endif
+        
         switch (mode) {
             case ANIM_CYCLE:
                 /* Auto-cycle between fusion, wave, tetris, stars every 20 seconds */
                 cycle_timer_ms += frame_delay;
                 if (cycle_timer_ms >= cycle_interval_ms) {
                     cycle_timer_ms = 0;
-                    cycle_anim_index = (cycle_anim_index + 1) % 4;
-                    // const char* anim_names[] = {"FUSION", "WAVE", "TETRIS", "STARS"};
-                    // ESP_LOGI(TAG, "Cycle: switching to %s", anim_names[cycle_anim_index]);  // Commented for Zigbee debug
+                    cycle_anim_index = (cycle_anim_index + 1) % cycle_count;
                 }
                 
                 /* Track previous index for reset logic */
                 static int last_cycle_index = -1;
                 bool anim_changed = (last_cycle_index != cycle_anim_index);
                 
-                if (cycle_anim_index == 0) {
-                    draw_fusion(fusion_phase);
-                    fusion_phase += speed * 0.12f;
-                    if (fusion_phase >= 2 * 3.14159f) fusion_phase -= 2 * 3.14159f;
-                } else if (cycle_anim_index == 1) {
-                    draw_wave(wave_phase);
-                    wave_phase += speed * 0.15f;
-                    if (wave_phase >= 2 * 3.14159f) wave_phase -= 2 * 3.14159f;
-                } else if (cycle_anim_index == 2) {
-                    draw_tetris(0, anim_changed && last_cycle_index != 2);
-                } else {
-                    draw_stars(anim_changed && last_cycle_index != 3);
+                switch (cycle_modes[cycle_anim_index]) {
+#if CONFIG_HALO_EFFECT_FUSION
+                    case ANIM_FUSION:
+                        draw_fusion(fusion_phase);
+                        fusion_phase += speed * 0.12f;
+                        if (fusion_phase >= 2 * 3.14159f) fusion_phase -= 2 * 3.14159f;
+                        break;
+#endif
+#if CONFIG_HALO_EFFECT_WAVE
+                    case ANIM_WAVE:
+                        draw_wave(wave_phase);
+                        wave_phase += speed * 0.15f;
+                        if (wave_phase >= 2 * 3.14159f) wave_phase -= 2 * 3.14159f;
+                        break;
+#endif
+#if CONFIG_HALO_EFFECT_TETRIS
+                    case ANIM_TETRIS:
+                        draw_tetris(0, anim_changed);
+                        break;
+#endif
+#if CONFIG_HALO_EFFECT_STARS
+                    case ANIM_STARS:
+                        draw_stars(anim_changed);
+                        break;
+#endif
+                    default:
+                        draw_solid();
+                        break;
                 }
                 last_cycle_index = cycle_anim_index;
                 break;
                 
+#if CONFIG_HALO_EFFECT_FUSION
             case ANIM_FUSION:
                 draw_fusion(fusion_phase);
                 fusion_phase += speed * 0.12f;  /* Slower pulse for gradual animation */
                 if (fusion_phase >= 2 * 3.14159f) fusion_phase -= 2 * 3.14159f;
                 break;
+#endif
             
+#if CONFIG_HALO_EFFECT_WAVE
             case ANIM_WAVE:
                 draw_wave(wave_phase);
                 wave_phase += speed * 0.15f;  /* Slower wave for longer fade-in */
                 if (wave_phase >= 2 * 3.14159f) wave_phase -= 2 * 3.14159f;
                 break;
+#endif
             
+#if CONFIG_HALO_EFFECT_TETRIS
             case ANIM_TETRIS:
                 {
                     static bool tetris_first_frame = true;
@@ -3753,7 +4977,9 @@ wifi_done:  /* Label for dev mode fast path to skip hardware tests */
                     tetris_first_frame = false;
                 }
                 break;
+#endif
             
+#if CONFIG_HALO_EFFECT_STARS
             case ANIM_STARS:
                 {
                     static bool stars_first_frame = true;
@@ -3761,7 +4987,9 @@ wifi_done:  /* Label for dev mode fast path to skip hardware tests */
                     stars_first_frame = false;
                 }
                 break;
+#endif
                 
+#if CONFIG_HALO_EFFECT_METEOR
             case ANIM_METEOR:
                 draw_meteor_spinner(head_position);
                 head_position += speed;
@@ -3770,7 +4998,9 @@ wifi_done:  /* Label for dev mode fast path to skip hardware tests */
                     increment_rotation_count();
                 }
                 break;
+#endif
             
+#if CONFIG_HALO_EFFECT_METEOR_SHOWER
             case ANIM_METEOR_SHOWER:
                 {
                     static bool meteor_shower_first_frame = true;
@@ -3778,26 +5008,32 @@ wifi_done:  /* Label for dev mode fast path to skip hardware tests */
                     meteor_shower_first_frame = false;
                 }
                 break;
+#endif
                 
+#if CONFIG_HALO_EFFECT_RAINBOW
             case ANIM_RAINBOW:
                 draw_rainbow(rainbow_phase);
                 rainbow_phase += speed * 5.0f;  /* Faster for rainbow */
                 if (rainbow_phase >= 360.0f) rainbow_phase -= 360.0f;
                 break;
+#endif
                 
+#if CONFIG_HALO_EFFECT_BREATHING
             case ANIM_BREATHING:
                 draw_breathing(breathing_phase);
                 breathing_phase += speed * 0.5f;  /* Breathing speed */
                 if (breathing_phase >= 2 * 3.14159f) breathing_phase -= 2 * 3.14159f;
                 break;
-                
-            case ANIM_SOLID:
-                draw_solid();
-                break;
+#endif
                 
             case ANIM_OFF:
                 draw_off();
                 break;
+                
+            case ANIM_SOLID:
+            default:    /* Effects left out of this build show as solid color */
+                draw_solid();
+                break;
         }
         
         /* === ONBOARD LED: Slow rainbow cycle === */
@@ -3859,6 +5095,11 @@ wifi_done:  /* Label for dev mode fast path to skip hardware tests */
             }
         }
         
+        /* Frame work time vs budget, doubles as the render heartbeat */
+        remote_input_frame_shown();
+        halo_task_render_frame((uint32_t)(esp_timer_get_time() - frame_start_us),
+                               frame_delay * 1000);
+        
         /* Wait before next frame (uses animation-specific FPS if set) */
         vTaskDelay(frame_delay / portTICK_PERIOD_MS);
     }
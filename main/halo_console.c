@@ -0,0 +1,186 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Halo Console - Serial REPL over USB-Serial-JTAG
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_console.h"
+#include "linenoise/linenoise.h"
+#include "driver/usb_serial_jtag.h"
+#include "driver/usb_serial_jtag_vfs.h"
+#include "sdkconfig.h"
+#include "halo_tasks.h"
+#include "halo_console.h"
+#if CONFIG_HALO_ZIGBEE_CAPTURE
+#include "zigbee_capture.h"
+#endif
+
+static const char *TAG = "console";
+
+static halo_console_dispatch_t s_dispatch = NULL;
+
+/* ============================================================================
+   CONSOLE COMMANDS
+   ============================================================================
+   Each one is an alias: its words are joined with ':' and handed to the
+   shared handler, so "bench render" runs "bench:render". They are only
+   registered to give "help" something to list.
+   ============================================================================ */
+
+typedef struct {
+    const char *name;
+    const char *hint;
+    const char *help;
+} console_alias_t;
+
+static const console_alias_t s_aliases[] = {
+    { "bench",   "render|nvs", "Time every animation's draw call, or hammer NVS and count frame overruns" },
+    { "trace",   "dump",    "Print the last render frames: period, work time, budget" },
+#if CONFIG_HALO_PROFILER
+    { "prof",    "start|stop|dump|status", "Sampling profiler, dump as folded stacks" },
+#endif
+#if CONFIG_HALO_HEAP_TRACKER
+    { "heap",    "status|track <n>|track off", "Heap use per subsystem, largest free block" },
+#endif
+    { "journal", "dump|status|clear", "Command journal kept across resets, dump for tools/journal_replay.py" },
+    { "mod",     "status|clear|<param> ...", "Modulate effect parameters with LFOs, envelopes and inputs" },
+#if CONFIG_HALO_SYNC
+    { "sync",    "leader|follow|off|status", "Share the animation clock with other Halos on the LAN" },
+#endif
+    { "top",     NULL,      "CPU share per task over the next second" },
+    { "metrics", NULL,      "Print every latency histogram" },
+};
+
+static int run_alias(int argc, char **argv)
+{
+    char command[HALO_CONSOLE_MAX_LINE];
+    size_t len = 0;
+
+    for (int i = 0; i < argc; i++) {
+        int n = snprintf(&command[len], sizeof(command) - len, "%s%s", i > 0 ? ":" : "", argv[i]);
+        if (n < 0 || (size_t)n >= sizeof(command) - len) {
+            return 1;
+        }
+        len += n;
+    }
+    s_dispatch(command, (int)len);
+    return 0;
+}
+
+#if CONFIG_HALO_ZIGBEE_CAPTURE
+/* "zbcap key" prints the network key here only; the rest are aliases */
+static int run_zbcap(int argc, char **argv)
+{
+    if (argc == 2 && strcmp(argv[1], "key") == 0) {
+        zigbee_capture_print_network_key();
+        return 0;
+    }
+    return run_alias(argc, argv);
+}
+#endif
+
+/* ============================================================================
+   REPL TASK
+   ============================================================================ */
+
+static void console_task(void *pvParameters)
+{
+    /* Terminals that don't answer the probe (plain serial monitors) get no line editing */
+    if (linenoiseProbe() != 0) {
+        linenoiseSetDumbMode(1);
+    }
+
+    ESP_LOGI(TAG, "Console ready - 'help' for diagnostics, any MQTT command works too");
+
+    while (1) {
+        char *line = linenoise(HALO_CONSOLE_PROMPT);
+        if (line == NULL) {
+            continue;
+        }
+        if (line[0] != '\0') {
+            linenoiseHistoryAdd(line);
+            int ret = 0;
+            esp_err_t err = esp_console_run(line, &ret);
+            if (err == ESP_ERR_NOT_FOUND) {
+                s_dispatch(line, (int)strlen(line));
+            } else if (err == ESP_OK && ret != 0) {
+                printf("Command failed (%d)\n", ret);
+            }
+        }
+        linenoiseFree(line);
+    }
+}
+
+/* ============================================================================
+   START
+   ============================================================================ */
+
+esp_err_t halo_console_start(halo_console_dispatch_t dispatch)
+{
+#if !CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG
+    (void)dispatch;
+    ESP_LOGW(TAG, "Console not started: primary console is not USB-Serial-JTAG");
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    if (dispatch == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_dispatch = dispatch;
+
+    /* Blocking, interrupt-driven reads instead of the ROM's polled output-only path */
+    setvbuf(stdin, NULL, _IONBF, 0);
+    usb_serial_jtag_vfs_set_rx_line_endings(ESP_LINE_ENDINGS_CR);
+    usb_serial_jtag_vfs_set_tx_line_endings(ESP_LINE_ENDINGS_CRLF);
+    usb_serial_jtag_driver_config_t usb_config = USB_SERIAL_JTAG_DRIVER_CONFIG_DEFAULT();
+    esp_err_t err = usb_serial_jtag_driver_install(&usb_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "USB-Serial-JTAG driver install failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    usb_serial_jtag_vfs_use_driver();
+
+    esp_console_config_t console_config = ESP_CONSOLE_CONFIG_DEFAULT();
+    console_config.max_cmdline_length = HALO_CONSOLE_MAX_LINE;
+    console_config.max_cmdline_args = HALO_CONSOLE_MAX_ARGS;
+    err = esp_console_init(&console_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_console init failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    linenoiseSetMultiLine(1);
+    linenoiseSetMaxLineLen(HALO_CONSOLE_MAX_LINE);
+    linenoiseHistorySetMaxLen(HALO_CONSOLE_HISTORY);
+    linenoiseAllowEmpty(false);
+
+    esp_console_register_help_command();
+    for (size_t i = 0; i < sizeof(s_aliases) / sizeof(s_aliases[0]); i++) {
+        const esp_console_cmd_t cmd = {
+            .command = s_aliases[i].name,
+            .help = s_aliases[i].help,
+            .hint = s_aliases[i].hint,
+            .func = run_alias,
+        };
+        esp_console_cmd_register(&cmd);
+    }
+#if CONFIG_HALO_ZIGBEE_CAPTURE
+    const esp_console_cmd_t zbcap_cmd = {
+        .command = "zbcap",
+        .help = "802.15.4 capture; 'key' prints the network key (console only)",
+        .hint = "start|stop|status|dump|key",
+        .func = run_zbcap,
+    };
+    esp_console_cmd_register(&zbcap_cmd);
+#endif
+
+    if (halo_task_create_static(HALO_TASK_CONSOLE, console_task, NULL) == NULL) {
+        ESP_LOGE(TAG, "Failed to start console task");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+#endif
+}
@@ -0,0 +1,63 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Halo Console - Serial REPL over USB-Serial-JTAG
+ *
+ * A local control path that needs no network: every line typed on the
+ * console goes through the same command handler as MQTT, so "rainbow",
+ * "blinds:state" or "zigbee:status" work as they do from the cloud.
+ *
+ * A few diagnostics are also registered as esp_console commands, so they
+ * show up in "help" and can be typed with spaces:
+ *   bench render   ->  bench:render (also bench nvs)
+ *   trace dump     ->  trace:dump
+ *   prof start     ->  prof:start (also stop, dump, status)
+ *   heap track 1   ->  heap:track:1 (also status, track off)
+ *   journal dump   ->  journal:dump (also status, clear)
+ *   mod hue sine 30 0.1  ->  mod:hue:sine:30:0.1 (also status, clear)
+ *   sync status    ->  sync:status (also leader, follow, off)
+ *   zbcap start    ->  zbcap:start (also stop, status, dump)
+ *   zbcap key      ->  prints the Zigbee network key; console only, no
+ *                      MQTT equivalent
+ *   top, metrics
+ *
+ * The REPL runs in its own low-priority task (see halo_tasks.h) and reads
+ * into fixed-size line buffers.
+ */
+
+#ifndef HALO_CONSOLE_H
+#define HALO_CONSOLE_H
+
+#include "esp_err.h"
+
+/* ============================================================================
+   HALO CONSOLE CONFIGURATION
+   ============================================================================ */
+
+#define HALO_CONSOLE_MAX_LINE       256     /* Longer lines are cut by the line editor */
+#define HALO_CONSOLE_MAX_ARGS       8
+#define HALO_CONSOLE_HISTORY        16      /* Lines kept for arrow-up */
+#define HALO_CONSOLE_PROMPT         "halo> "
+
+/* ============================================================================
+   API
+   ============================================================================ */
+
+/**
+ * @brief Command handler shared with MQTT
+ *
+ * @param command Command text (not necessarily null-terminated)
+ * @param len Command length
+ */
+typedef void (*halo_console_dispatch_t)(const char *command, int len);
+
+/**
+ * @brief Install the USB-Serial-JTAG driver and start the REPL task
+ *
+ * @param dispatch Handler for every line that is not a console command
+ * @return ESP_OK, or ESP_ERR_NOT_SUPPORTED if the console is not on USB-Serial-JTAG
+ */
+esp_err_t halo_console_start(halo_console_dispatch_t dispatch);
+
+#endif /* HALO_CONSOLE_H */
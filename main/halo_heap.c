@@ -0,0 +1,376 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Halo Heap - Per-subsystem heap accounting
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "sdkconfig.h"
+#include "halo_heap.h"
+
+static const char *TAG = "heap";
+
+#define TABLE_BITS          10
+#define TABLE_MASK          (HALO_HEAP_TABLE_SLOTS - 1)
+#define TABLE_MAX_USED      (HALO_HEAP_TABLE_SLOTS - HALO_HEAP_TABLE_SLOTS / 8)  /* Keep probes short */
+
+_Static_assert((1 << TABLE_BITS) == HALO_HEAP_TABLE_SLOTS, "TABLE_BITS must match HALO_HEAP_TABLE_SLOTS");
+
+static const char *s_tag_names[HALO_HEAP_TAG_COUNT] = {
+    [HALO_HEAP_TAG_SYSTEM] = "system",
+    [HALO_HEAP_TAG_HALO]   = "halo",
+    [HALO_HEAP_TAG_MATTER] = "matter",
+    [HALO_HEAP_TAG_ZIGBEE] = "zigbee",
+    [HALO_HEAP_TAG_MQTT]   = "mqtt",
+    [HALO_HEAP_TAG_WIFI]   = "wifi",
+};
+
+/* ============================================================================
+   STATE (hooks run in every task that allocates, under s_lock)
+   ============================================================================ */
+
+typedef struct {
+    uint32_t ptr;                   /* 0 = empty */
+    uint32_t size;
+    uint8_t tag;
+} heap_entry_t;
+
+typedef struct {
+    uint32_t allocs;                /* Every allocation, exact */
+    uint32_t live_count;            /* Remembered blocks, not scaled */
+    uint32_t live_bytes;            /* Remembered bytes, not scaled */
+    uint32_t peak_bytes;            /* Highest live_bytes, not scaled */
+} tag_stats_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static heap_entry_t *s_table = NULL;        /* s_table_buf while tracking, else NULL */
+static uint32_t s_used = 0;
+static uint32_t s_untracked = 0;            /* Sampled but the table was full */
+static uint32_t s_sample_every = HALO_HEAP_SAMPLE_EVERY;
+static uint32_t s_sample_seq = 0;
+static tag_stats_t s_stats[HALO_HEAP_TAG_COUNT];
+
+#if CONFIG_HEAP_USE_HOOKS
+
+static heap_entry_t s_table_buf[HALO_HEAP_TABLE_SLOTS];
+
+static struct {
+    TaskHandle_t task;
+    uint8_t tag;
+} s_task_cache[HALO_HEAP_TASK_CACHE];
+static uint32_t s_task_cache_used = 0;
+
+/* Tag scopes from halo_heap_tag_push(), held by one task at a time */
+static TaskHandle_t s_scope_task = NULL;
+static uint8_t s_scope_tags[HALO_HEAP_SCOPE_DEPTH];
+static uint32_t s_scope_depth = 0;
+static uint32_t s_scope_ignored = 0;        /* Pushes refused, their pops skip too */
+
+/* In DRAM: the hooks may run while the flash cache is off */
+static const DRAM_ATTR struct {
+    char prefix[12];
+    uint8_t tag;
+} s_task_tags[] = {
+    { "CHIP",       HALO_HEAP_TAG_MATTER },
+    { "zigbee",     HALO_HEAP_TAG_ZIGBEE },
+    { "zb_",        HALO_HEAP_TAG_ZIGBEE },
+    { "mqtt",       HALO_HEAP_TAG_MQTT },
+    { "wifi",       HALO_HEAP_TAG_WIFI },
+    { "tiT",        HALO_HEAP_TAG_WIFI },
+    { "main",       HALO_HEAP_TAG_HALO },
+    { "melody",     HALO_HEAP_TAG_HALO },
+    { "supervisor", HALO_HEAP_TAG_HALO },
+    { "console",    HALO_HEAP_TAG_HALO },
+    { "ota_",       HALO_HEAP_TAG_HALO },
+};
+
+/* ============================================================================
+   TAGGING
+   ============================================================================ */
+
+static IRAM_ATTR bool has_prefix(const char *name, const char *prefix)
+{
+    while (*prefix != '\0') {
+        if (*name++ != *prefix++) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Caller holds s_lock */
+static IRAM_ATTR uint8_t current_tag(void)
+{
+    if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED) {
+        return HALO_HEAP_TAG_SYSTEM;
+    }
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    if (s_scope_depth > 0 && task == s_scope_task) {
+        return s_scope_tags[s_scope_depth - 1];
+    }
+    for (uint32_t i = 0; i < s_task_cache_used; i++) {
+        if (s_task_cache[i].task == task) {
+            return s_task_cache[i].tag;
+        }
+    }
+
+    uint8_t tag = HALO_HEAP_TAG_SYSTEM;
+    const char *name = pcTaskGetName(task);
+    for (size_t i = 0; i < sizeof(s_task_tags) / sizeof(s_task_tags[0]); i++) {
+        if (has_prefix(name, s_task_tags[i].prefix)) {
+            tag = s_task_tags[i].tag;
+            break;
+        }
+    }
+    if (s_task_cache_used < HALO_HEAP_TASK_CACHE) {
+        s_task_cache[s_task_cache_used].task = task;
+        s_task_cache[s_task_cache_used].tag = tag;
+        s_task_cache_used++;
+    }
+    return tag;
+}
+
+/* ============================================================================
+   TABLE (linear probing, backward-shift delete)
+   ============================================================================ */
+
+static IRAM_ATTR uint32_t slot_of(uint32_t ptr)
+{
+    return ((ptr >> 3) * 2654435761u) >> (32 - TABLE_BITS);
+}
+
+static IRAM_ATTR void table_insert(uint32_t ptr, uint32_t size, uint8_t tag)
+{
+    uint32_t i = slot_of(ptr);
+    while (s_table[i].ptr != 0) {
+        i = (i + 1) & TABLE_MASK;
+    }
+    s_table[i].ptr = ptr;
+    s_table[i].size = size;
+    s_table[i].tag = tag;
+    s_used++;
+}
+
+static IRAM_ATTR void table_remove_at(uint32_t i)
+{
+    uint32_t j = i;
+    while (1) {
+        j = (j + 1) & TABLE_MASK;
+        if (s_table[j].ptr == 0) {
+            break;
+        }
+        /* Move j back into the hole unless its home slot lies in (i, j] */
+        uint32_t home = slot_of(s_table[j].ptr);
+        bool stays = (i <= j) ? (home > i && home <= j) : (home > i || home <= j);
+        if (!stays) {
+            s_table[i] = s_table[j];
+            i = j;
+        }
+    }
+    s_table[i].ptr = 0;
+    s_used--;
+}
+
+/* ============================================================================
+   HEAP HOOKS (called by heap_caps for every allocation and free)
+   ============================================================================ */
+
+IRAM_ATTR void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    (void)caps;
+    if (ptr == NULL || s_table == NULL) {
+        return;
+    }
+    portENTER_CRITICAL_SAFE(&s_lock);
+    if (s_table != NULL) {
+        uint8_t tag = current_tag();
+        tag_stats_t *stats = &s_stats[tag];
+        stats->allocs++;
+        if (++s_sample_seq >= s_sample_every) {
+            s_sample_seq = 0;
+            if (s_used < TABLE_MAX_USED) {
+                table_insert((uint32_t)ptr, (uint32_t)size, tag);
+                stats->live_count++;
+                stats->live_bytes += size;
+                if (stats->live_bytes > stats->peak_bytes) {
+                    stats->peak_bytes = stats->live_bytes;
+                }
+            } else {
+                s_untracked++;
+            }
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&s_lock);
+}
+
+IRAM_ATTR void esp_heap_trace_free_hook(void *ptr)
+{
+    if (ptr == NULL || s_table == NULL) {
+        return;
+    }
+    portENTER_CRITICAL_SAFE(&s_lock);
+    if (s_table != NULL) {
+        uint32_t i = slot_of((uint32_t)ptr);
+        while (s_table[i].ptr != 0) {
+            if (s_table[i].ptr == (uint32_t)ptr) {
+                tag_stats_t *stats = &s_stats[s_table[i].tag];
+                stats->live_count--;
+                stats->live_bytes -= s_table[i].size;
+                table_remove_at(i);
+                break;
+            }
+            i = (i + 1) & TABLE_MASK;
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&s_lock);
+}
+
+/* ============================================================================
+   CONTROL
+   ============================================================================ */
+
+esp_err_t halo_heap_track_start(uint32_t sample_every)
+{
+    if (sample_every == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    halo_heap_track_stop();
+
+    /* Cleared while tracking is off, so the hooks don't see it half-done */
+    memset(s_table_buf, 0, sizeof(s_table_buf));
+
+    portENTER_CRITICAL(&s_lock);
+    memset(s_stats, 0, sizeof(s_stats));
+    s_used = 0;
+    s_untracked = 0;
+    s_sample_every = sample_every;
+    s_sample_seq = 0;
+    s_task_cache_used = 0;
+    s_table = s_table_buf;
+    portEXIT_CRITICAL(&s_lock);
+
+    ESP_LOGI(TAG, "Heap tagging on, remembering 1 allocation in %lu", (unsigned long)sample_every);
+    return ESP_OK;
+}
+
+void halo_heap_track_stop(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_table = NULL;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void halo_heap_tag_push(halo_heap_tag_t tag)
+{
+    if (tag >= HALO_HEAP_TAG_COUNT || xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED) {
+        return;
+    }
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&s_lock);
+    if (s_scope_depth == 0) {
+        s_scope_task = task;
+    }
+    if (task == s_scope_task && s_scope_depth < HALO_HEAP_SCOPE_DEPTH) {
+        s_scope_tags[s_scope_depth++] = (uint8_t)tag;
+    } else if (task == s_scope_task) {
+        s_scope_ignored++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void halo_heap_tag_pop(void)
+{
+    if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED) {
+        return;
+    }
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&s_lock);
+    if (task == s_scope_task) {
+        if (s_scope_ignored > 0) {
+            s_scope_ignored--;
+        } else if (s_scope_depth > 0) {
+            s_scope_depth--;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+#else /* !CONFIG_HEAP_USE_HOOKS */
+
+esp_err_t halo_heap_track_start(uint32_t sample_every)
+{
+    (void)sample_every;
+    ESP_LOGW(TAG, "Heap tagging needs CONFIG_HEAP_USE_HOOKS");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void halo_heap_track_stop(void)
+{
+}
+
+void halo_heap_tag_push(halo_heap_tag_t tag)
+{
+    (void)tag;
+}
+
+void halo_heap_tag_pop(void)
+{
+}
+
+#endif
+
+/* ============================================================================
+   STATUS
+   ============================================================================ */
+
+void halo_heap_print_status(void)
+{
+    tag_stats_t stats[HALO_HEAP_TAG_COUNT];
+    portENTER_CRITICAL(&s_lock);
+    bool tracking = s_table != NULL;
+    memcpy(stats, s_stats, sizeof(stats));
+    uint32_t used = s_used;
+    uint32_t untracked = s_untracked;
+    uint32_t scale = s_sample_every;
+    portEXIT_CRITICAL(&s_lock);
+
+    size_t free_internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t largest_internal = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    size_t min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "╔══════════════════════════════════════════════════════════╗");
+    ESP_LOGI(TAG, "║  🧠 HEAP BY SUBSYSTEM                                     ║");
+    ESP_LOGI(TAG, "╚══════════════════════════════════════════════════════════╝");
+    ESP_LOGI(TAG, "  Internal: %u KB free, %u KB lowest, largest block %u KB (%u%% fragmented)",
+             (unsigned)(free_internal / 1024), (unsigned)(min_free / 1024),
+             (unsigned)(largest_internal / 1024),
+             free_internal > 0 ? (unsigned)(100 - largest_internal * 100 / free_internal) : 0);
+
+    if (!tracking) {
+        ESP_LOGI(TAG, "  Tagging off (heap:track:<n> to start)");
+        ESP_LOGI(TAG, "");
+        return;
+    }
+    ESP_LOGI(TAG, "  %-8s %10s %8s %10s %8s", "tag", "live", "blocks", "peak", "allocs");
+    for (int t = 0; t < HALO_HEAP_TAG_COUNT; t++) {
+        ESP_LOGI(TAG, "  %-8s %8luKB %8lu %8luKB %8lu", s_tag_names[t],
+                 (unsigned long)((uint64_t)stats[t].live_bytes * scale / 1024),
+                 (unsigned long)(stats[t].live_count * scale),
+                 (unsigned long)((uint64_t)stats[t].peak_bytes * scale / 1024),
+                 (unsigned long)stats[t].allocs);
+    }
+    if (scale > 1) {
+        ESP_LOGI(TAG, "  Live/blocks/peak estimated from 1 allocation in %lu; allocs are exact",
+                 (unsigned long)scale);
+    }
+    ESP_LOGI(TAG, "  Only allocations since tagging started. Table %lu/%d, %lu not remembered (full)",
+             (unsigned long)used, HALO_HEAP_TABLE_SLOTS, (unsigned long)untracked);
+    ESP_LOGI(TAG, "");
+}
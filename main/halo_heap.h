@@ -0,0 +1,96 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Halo Heap - Per-subsystem heap accounting
+ *
+ * The free-heap total says how much memory is left, not who holds it. With
+ * CONFIG_HALO_HEAP_TRACKER (which selects CONFIG_HEAP_USE_HOOKS), every
+ * malloc/free passes through two hooks. The
+ * alloc hook tags the block by the task that allocated it: the CHIP task
+ * is Matter, zigbee_main is Zigbee, mqtt_task is MQTT, wifi/tiT is WiFi,
+ * and Halo's own tasks are Halo. The free hook charges the bytes back to
+ * that same tag, whichever task frees them.
+ *
+ * Only one allocation in HALO_HEAP_SAMPLE_EVERY is remembered (pointer,
+ * size, tag) in a fixed table, and live bytes are scaled back up. That keeps
+ * the table small and the hooks to a counter increment for most calls.
+ * Allocation counts are exact. heap:track:1 tracks every allocation until
+ * the table fills.
+ *
+ * A task can override its own tag for a while with halo_heap_tag_push() and
+ * halo_heap_tag_pop(). app_main does this around each subsystem init, so the
+ * buffers that wifi_init_start() or zigbee_hub_init() allocate before their
+ * own tasks exist are charged to WiFi or Zigbee, not to Halo.
+ *
+ * Allocations made before tracking starts, or while the table is full, are
+ * never charged to anyone, and neither are their frees.
+ */
+
+#ifndef HALO_HEAP_H
+#define HALO_HEAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/* ============================================================================
+   HALO HEAP CONFIGURATION
+   ============================================================================ */
+
+#define HALO_HEAP_SAMPLE_EVERY      16      /* Default: remember 1 allocation in 16 */
+#define HALO_HEAP_TABLE_SLOTS       1024    /* Remembered allocations (12KB, power of two) */
+#define HALO_HEAP_TASK_CACHE        32      /* Task -> tag lookups kept */
+#define HALO_HEAP_SCOPE_DEPTH       4       /* Nested halo_heap_tag_push() scopes */
+
+typedef enum {
+    HALO_HEAP_TAG_SYSTEM = 0,   /* IDF tasks, before the scheduler, anything unknown */
+    HALO_HEAP_TAG_HALO,         /* Render loop, melody, console, OTA, supervisor */
+    HALO_HEAP_TAG_MATTER,       /* CHIP task */
+    HALO_HEAP_TAG_ZIGBEE,       /* zigbee_main, zb_capture */
+    HALO_HEAP_TAG_MQTT,         /* mqtt_task (TLS included) */
+    HALO_HEAP_TAG_WIFI,         /* wifi driver, lwIP (tiT) */
+    HALO_HEAP_TAG_COUNT,
+} halo_heap_tag_t;
+
+/* ============================================================================
+   API
+   ============================================================================ */
+
+/**
+ * @brief Start (or restart) tagging allocations
+ *
+ * Clears all counters. Allocations made earlier are not counted.
+ *
+ * @param sample_every Remember one allocation in this many (1 = all)
+ * @return ESP_OK, ESP_ERR_INVALID_ARG, or ESP_ERR_NOT_SUPPORTED without CONFIG_HEAP_USE_HOOKS
+ */
+esp_err_t halo_heap_track_start(uint32_t sample_every);
+
+/**
+ * @brief Stop tagging (the table is static and stays reserved)
+ */
+void halo_heap_track_stop(void);
+
+/**
+ * @brief Charge the calling task's allocations to a tag until the matching pop
+ *
+ * One task at a time holds scopes (app_main during boot). A push from
+ * another task while scopes are open, or past HALO_HEAP_SCOPE_DEPTH, is
+ * ignored, and so is its pop.
+ *
+ * @param tag Tag to charge
+ */
+void halo_heap_tag_push(halo_heap_tag_t tag);
+
+/**
+ * @brief Close the innermost scope opened by this task with halo_heap_tag_push()
+ */
+void halo_heap_tag_pop(void);
+
+/**
+ * @brief Log live bytes, allocation count and peak per tag, plus free heap and largest free block
+ */
+void halo_heap_print_status(void);
+
+#endif /* HALO_HEAP_H */
@@ -0,0 +1,254 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Halo Journal - Command ring in .noinit RAM, base64 export
+ */
+
+#include <string.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "mbedtls/base64.h"
+#include "halo_journal.h"
+
+static const char *TAG = "journal";
+
+#define JOURNAL_MAGIC       0x4e524a48      /* "HJRN" */
+#define JOURNAL_VERSION     1
+#define STATUS_LAST         5               /* Entries shown by journal:status */
+
+static const char *const s_source_names[] = {
+    [HALO_JOURNAL_SRC_MQTT]    = "mqtt",
+    [HALO_JOURNAL_SRC_CONSOLE] = "console",
+    [HALO_JOURNAL_SRC_REMOTE]  = "remote",
+    [HALO_JOURNAL_SRC_MATTER]  = "matter",
+    [HALO_JOURNAL_SRC_ENCODER] = "encoder",
+};
+
+/* ============================================================================
+   STORAGE
+   ============================================================================
+   Not cleared by the startup code, so the previous boot's entries are still
+   here after a software reset. The magic tells a kept journal from the
+   random contents RAM has after power-on.
+   ============================================================================ */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t head;                  /* Entries written, the ring index is head % N */
+    uint16_t boot;                  /* Current boot */
+    uint16_t reserved;
+    halo_journal_entry_t entries[HALO_JOURNAL_ENTRIES];
+} journal_store_t;
+
+static __NOINIT_ATTR journal_store_t s_store;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Dump header, followed by the entries oldest first */
+typedef struct {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t entry_size;
+    uint16_t count;
+    uint16_t boot;                  /* Boot the dump was taken in */
+    uint16_t reserved;
+    uint32_t uptime_ms;             /* When the dump was taken */
+    uint32_t wall_s;                /* Unix time at the dump, 0 if SNTP has not set it */
+} journal_dump_header_t;
+
+static void reset_store(void)
+{
+    memset(&s_store, 0, sizeof(s_store));
+    s_store.magic = JOURNAL_MAGIC;
+}
+
+static uint32_t entry_count(void)
+{
+    return s_store.head < HALO_JOURNAL_ENTRIES ? s_store.head : HALO_JOURNAL_ENTRIES;
+}
+
+void halo_journal_init(void)
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (s_store.magic != JOURNAL_MAGIC || reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT) {
+        reset_store();
+        ESP_LOGI(TAG, "New journal (%d entries)", HALO_JOURNAL_ENTRIES);
+        return;
+    }
+    s_store.boot++;
+    ESP_LOGI(TAG, "Journal kept across reset: %lu entries, boot %u",
+             (unsigned long)entry_count(), s_store.boot);
+}
+
+void halo_journal_clear(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint16_t boot = s_store.boot;
+    reset_store();
+    s_store.boot = boot;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "Journal cleared");
+}
+
+/* ============================================================================
+   RECORDING
+   ============================================================================ */
+
+/* Level updates name the same level: equal text up to the value after the last ':' */
+static bool same_level(const halo_journal_entry_t *a, const halo_journal_entry_t *b)
+{
+    int n = a->text_len;
+    while (n > 0 && a->text[n - 1] != ':') {
+        n--;
+    }
+    return n > 0 && b->text_len > n && memcmp(a->text, b->text, n) == 0 &&
+           memchr(b->text + n, ':', b->text_len - n) == NULL;
+}
+
+void halo_journal_record(halo_journal_source_t source, uint8_t flags,
+                         const char *text, int len, const halo_journal_state_t *state)
+{
+    halo_journal_entry_t e = {
+        .t_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .source = (uint8_t)source,
+        .flags = flags,
+        .anim = state->anim,
+        .r = state->r, .g = state->g, .b = state->b, .w = state->w,
+        .brightness_pm = state->brightness_pm,
+        .speed_pm = state->speed_pm,
+    };
+    if (len > HALO_JOURNAL_TEXT_LEN) {
+        len = HALO_JOURNAL_TEXT_LEN;
+        e.flags |= HALO_JOURNAL_F_TRUNCATED;
+    }
+    e.text_len = (uint8_t)len;
+    memcpy(e.text, text, len);
+
+    portENTER_CRITICAL(&s_lock);
+    e.boot = s_store.boot;
+    halo_journal_entry_t *last = s_store.head > 0 ?
+        &s_store.entries[(s_store.head - 1) % HALO_JOURNAL_ENTRIES] : NULL;
+    bool same_run = last != NULL && last->source == e.source && last->boot == e.boot;
+    if ((flags & HALO_JOURNAL_F_COALESCE) && same_run &&
+        (last->flags & HALO_JOURNAL_F_COALESCE) && e.t_ms - last->t_ms < HALO_JOURNAL_COALESCE_MS) {
+        *last = e;              /* Same gesture: keep only where it ended */
+    } else if ((flags & HALO_JOURNAL_F_LEVEL) && same_run &&
+               (last->flags & HALO_JOURNAL_F_LEVEL) && same_level(last, &e)) {
+        *last = e;              /* Only the latest level matters, however often it is fed */
+    } else {
+        s_store.entries[s_store.head % HALO_JOURNAL_ENTRIES] = e;
+        s_store.head++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/* ============================================================================
+   DUMP (base64 in the log, see tools/journal_replay.py)
+   ============================================================================ */
+
+static uint8_t s_dump_buf[HALO_JOURNAL_DUMP_CHUNK];
+static size_t s_dump_len = 0;
+
+static void dump_flush(void)
+{
+    if (s_dump_len == 0) {
+        return;
+    }
+    unsigned char b64[((HALO_JOURNAL_DUMP_CHUNK + 2) / 3) * 4 + 1];
+    size_t b64_len = 0;
+    mbedtls_base64_encode(b64, sizeof(b64), &b64_len, s_dump_buf, s_dump_len);
+    b64[b64_len] = '\0';
+    ESP_LOGI(TAG, "JOURNAL:%s", b64);
+    s_dump_len = 0;
+}
+
+static void dump_bytes(const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    while (len > 0) {
+        size_t n = HALO_JOURNAL_DUMP_CHUNK - s_dump_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(&s_dump_buf[s_dump_len], p, n);
+        s_dump_len += n;
+        p += n;
+        len -= n;
+        if (s_dump_len == HALO_JOURNAL_DUMP_CHUNK) {
+            dump_flush();
+        }
+    }
+}
+
+esp_err_t halo_journal_dump(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint32_t head = s_store.head;
+    uint32_t count = entry_count();
+    portEXIT_CRITICAL(&s_lock);
+    if (count == 0) {
+        ESP_LOGW(TAG, "Journal is empty");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    journal_dump_header_t header = {
+        .magic = JOURNAL_MAGIC,
+        .version = JOURNAL_VERSION,
+        .entry_size = sizeof(halo_journal_entry_t),
+        .count = (uint16_t)count,
+        .boot = s_store.boot,
+        .uptime_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .wall_s = tv.tv_sec >= 1600000000 ? (uint32_t)tv.tv_sec : 0,
+    };
+
+    ESP_LOGI(TAG, "JOURNAL BEGIN");
+    s_dump_len = 0;
+    dump_bytes(&header, sizeof(header));
+    for (uint32_t i = head - count; i != head; i++) {
+        halo_journal_entry_t e;
+        portENTER_CRITICAL(&s_lock);
+        e = s_store.entries[i % HALO_JOURNAL_ENTRIES];
+        portEXIT_CRITICAL(&s_lock);
+        dump_bytes(&e, sizeof(e));
+    }
+    dump_flush();
+    ESP_LOGI(TAG, "JOURNAL END %lu entries", (unsigned long)count);
+    return ESP_OK;
+}
+
+/* ============================================================================
+   STATUS
+   ============================================================================ */
+
+void halo_journal_print_status(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint32_t head = s_store.head;
+    uint32_t count = entry_count();
+    uint16_t oldest_boot = count ? s_store.entries[(head - count) % HALO_JOURNAL_ENTRIES].boot : s_store.boot;
+    portEXIT_CRITICAL(&s_lock);
+
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "  Journal: %lu/%d entries, %lu written, boots %u-%u",
+             (unsigned long)count, HALO_JOURNAL_ENTRIES, (unsigned long)head,
+             oldest_boot, s_store.boot);
+    uint32_t shown = count < STATUS_LAST ? count : STATUS_LAST;
+    for (uint32_t i = head - shown; i != head; i++) {
+        halo_journal_entry_t e;
+        portENTER_CRITICAL(&s_lock);
+        e = s_store.entries[i % HALO_JOURNAL_ENTRIES];
+        portEXIT_CRITICAL(&s_lock);
+        const char *src = e.source < sizeof(s_source_names) / sizeof(s_source_names[0]) ?
+                          s_source_names[e.source] : "?";
+        ESP_LOGI(TAG, "    boot %u %7lu.%03lus  %-7s %.*s%s", e.boot,
+                 (unsigned long)(e.t_ms / 1000), (unsigned long)(e.t_ms % 1000), src,
+                 e.text_len, e.text, (e.flags & HALO_JOURNAL_F_TRUNCATED) ? "..." : "");
+    }
+    ESP_LOGI(TAG, "");
+}
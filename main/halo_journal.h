@@ -0,0 +1,125 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Halo Journal - Timestamped record of every change to the ring and blinds
+ *
+ * Each command that changes the lighting state, from any source (MQTT,
+ * serial console, Zigbee remote, Matter, rotary encoder), is appended to a
+ * fixed-size binary ring with its time, its source, the command text and
+ * the ring state right after it ran. Commands that drive Zigbee blinds or
+ * lights are recorded even though the ring state does not change.
+ *
+ * The ring lives in .noinit RAM, so it survives a panic, the watchdog or
+ * esp_restart() and covers the boots that led up to a problem. A power-on
+ * reset starts it empty. Encoder turns are merged into one entry per
+ * gesture so a single spin does not flush the ring.
+ *
+ * Selecting an effect that draws random numbers (stars, tetris, shower,
+ * cycle) also records the "seed:<hex>" it was started with, so a replay
+ * draws the same stars, blocks and meteors.
+ *
+ *   journal:dump    ->  base64 in the log (tools/journal_replay.py decodes it,
+ *                       prints the timeline and replays it on a device)
+ *   journal:status, journal:clear
+ */
+
+#ifndef HALO_JOURNAL_H
+#define HALO_JOURNAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/* ============================================================================
+   HALO JOURNAL CONFIGURATION
+   ============================================================================ */
+
+#define HALO_JOURNAL_ENTRIES        128     /* 64 bytes each, 8KB of .noinit RAM */
+#define HALO_JOURNAL_TEXT_LEN       46      /* Longer commands are cut (flagged) */
+#define HALO_JOURNAL_COALESCE_MS    600     /* Encoder clicks closer than this merge */
+#define HALO_JOURNAL_DUMP_CHUNK     48      /* Bytes per base64 log line */
+
+/* ============================================================================
+   ENTRY FORMAT (dumped as-is, little endian - keep tools/journal_replay.py in step)
+   ============================================================================ */
+
+typedef enum {
+    HALO_JOURNAL_SRC_MQTT = 0,
+    HALO_JOURNAL_SRC_CONSOLE,
+    HALO_JOURNAL_SRC_REMOTE,        /* Zigbee remote or switch */
+    HALO_JOURNAL_SRC_MATTER,
+    HALO_JOURNAL_SRC_ENCODER,
+} halo_journal_source_t;
+
+#define HALO_JOURNAL_F_DEVICE       0x01    /* Text drives a Zigbee device, replay it as-is */
+#define HALO_JOURNAL_F_TRUNCATED    0x02    /* Text was longer than HALO_JOURNAL_TEXT_LEN */
+#define HALO_JOURNAL_F_COALESCE     0x04    /* May replace the previous entry of the same source */
+#define HALO_JOURNAL_F_VERBATIM     0x08    /* Not ring state (seed:, mod:): always recorded, replayed as-is */
+#define HALO_JOURNAL_F_LOCAL        0x10    /* This unit's own setup (sync:): on the timeline, never replayed */
+#define HALO_JOURNAL_F_LEVEL        0x20    /* Level update (mod:input:<in>:<n>): replaces the previous one for the same input */
+
+/* Ring state after the command (filled in by halo.c) */
+typedef struct {
+    uint8_t anim;                   /* animation_mode_t */
+    uint8_t r, g, b, w;
+    uint16_t brightness_pm;         /* Effective brightness, 0-1000 */
+    uint16_t speed_pm;              /* Animation speed x 1000 */
+} halo_journal_state_t;
+
+typedef struct {
+    uint32_t t_ms;                  /* Since boot */
+    uint16_t boot;                  /* Boots since the journal was created */
+    uint8_t source;                 /* halo_journal_source_t */
+    uint8_t flags;                  /* HALO_JOURNAL_F_* */
+    uint8_t anim;
+    uint8_t r, g, b, w;
+    uint8_t text_len;
+    uint16_t brightness_pm;
+    uint16_t speed_pm;
+    char text[HALO_JOURNAL_TEXT_LEN];   /* Not null-terminated */
+} halo_journal_entry_t;
+
+_Static_assert(sizeof(halo_journal_entry_t) == 64, "journal entry layout changed");
+
+/* ============================================================================
+   API
+   ============================================================================ */
+
+/**
+ * @brief Adopt the journal left in RAM by the previous boot, or start a new one
+ *
+ * Call once, early in app_main().
+ */
+void halo_journal_init(void);
+
+/**
+ * @brief Append an entry (any task, not from an ISR)
+ *
+ * @param source Where the command came from
+ * @param flags HALO_JOURNAL_F_*
+ * @param text Command text (not necessarily null-terminated)
+ * @param len Text length
+ * @param state Ring state after the command ran
+ */
+void halo_journal_record(halo_journal_source_t source, uint8_t flags,
+                         const char *text, int len, const halo_journal_state_t *state);
+
+/**
+ * @brief Log the journal as base64, oldest entry first (the journal is kept)
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE if it is empty
+ */
+esp_err_t halo_journal_dump(void);
+
+/**
+ * @brief Forget every entry
+ */
+void halo_journal_clear(void);
+
+/**
+ * @brief Log entry count, boots covered and the last few entries
+ */
+void halo_journal_print_status(void);
+
+#endif /* HALO_JOURNAL_H */
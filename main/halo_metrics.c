@@ -0,0 +1,144 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Halo Metrics - Lightweight latency histograms
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "halo_metrics.h"
+
+static const char *TAG = "metrics";
+
+/* ============================================================================
+   REGISTRY
+   ============================================================================ */
+
+static metrics_histogram_t *s_registry[METRICS_MAX_HISTOGRAMS];
+static int s_registry_count = 0;
+static portMUX_TYPE s_registry_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void registry_add(metrics_histogram_t *hist)
+{
+    taskENTER_CRITICAL_SAFE(&s_registry_lock);
+    if (!hist->registered && s_registry_count < METRICS_MAX_HISTOGRAMS) {
+        s_registry[s_registry_count++] = hist;
+        hist->registered = true;
+    }
+    taskEXIT_CRITICAL_SAFE(&s_registry_lock);
+}
+
+/* ============================================================================
+   HISTOGRAM
+   ============================================================================ */
+
+static int bucket_for(uint32_t value)
+{
+    /* 0 -> bucket 0, 1 -> 1, 2-3 -> 2, 4-7 -> 3, ... */
+    int bucket = (value == 0) ? 0 : 32 - __builtin_clz(value);
+    return bucket < METRICS_HIST_BUCKETS ? bucket : METRICS_HIST_BUCKETS - 1;
+}
+
+static uint32_t bucket_upper(int bucket)
+{
+    return (bucket == 0) ? 0 : (uint32_t)((1ULL << bucket) - 1);
+}
+
+void metrics_hist_record(metrics_histogram_t *hist, uint32_t value)
+{
+    if (!hist->registered) {
+        registry_add(hist);
+    }
+
+    taskENTER_CRITICAL_SAFE(&hist->lock);
+    hist->buckets[bucket_for(value)]++;
+    if (hist->count == 0 || value < hist->min) hist->min = value;
+    if (value > hist->max) hist->max = value;
+    hist->count++;
+    hist->sum += value;
+    taskEXIT_CRITICAL_SAFE(&hist->lock);
+}
+
+uint32_t metrics_hist_percentile(metrics_histogram_t *hist, uint8_t percentile)
+{
+    uint32_t buckets[METRICS_HIST_BUCKETS];
+    uint32_t count;
+
+    taskENTER_CRITICAL(&hist->lock);
+    memcpy(buckets, hist->buckets, sizeof(buckets));
+    count = hist->count;
+    uint32_t max = hist->max;
+    taskEXIT_CRITICAL(&hist->lock);
+
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t target = ((uint64_t)count * percentile + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < METRICS_HIST_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            uint32_t upper = bucket_upper(i);
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
+
+void metrics_hist_reset(metrics_histogram_t *hist)
+{
+    taskENTER_CRITICAL(&hist->lock);
+    memset(hist->buckets, 0, sizeof(hist->buckets));
+    hist->count = 0;
+    hist->sum = 0;
+    hist->min = 0;
+    hist->max = 0;
+    taskEXIT_CRITICAL(&hist->lock);
+}
+
+void metrics_hist_print(metrics_histogram_t *hist)
+{
+    metrics_histogram_t snap;
+
+    taskENTER_CRITICAL(&hist->lock);
+    memcpy(&snap, hist, sizeof(snap));
+    taskEXIT_CRITICAL(&hist->lock);
+
+    if (snap.count == 0) {
+        ESP_LOGI(TAG, "%s: no samples", snap.name);
+        return;
+    }
+    ESP_LOGI(TAG, "%s: n=%lu min=%lu avg=%lu p50=%lu p90=%lu p99=%lu max=%lu %s",
+             snap.name, (unsigned long)snap.count, (unsigned long)snap.min,
+             (unsigned long)(snap.sum / snap.count),
+             (unsigned long)metrics_hist_percentile(hist, 50),
+             (unsigned long)metrics_hist_percentile(hist, 90),
+             (unsigned long)metrics_hist_percentile(hist, 99),
+             (unsigned long)snap.max, snap.unit);
+    for (int i = 0; i < METRICS_HIST_BUCKETS; i++) {
+        if (snap.buckets[i] == 0) {
+            continue;
+        }
+        uint32_t lower = (i == 0) ? 0 : (1UL << (i - 1));
+        ESP_LOGI(TAG, "    %7lu..%-7lu %s  %lu",
+                 (unsigned long)lower, (unsigned long)bucket_upper(i), snap.unit,
+                 (unsigned long)snap.buckets[i]);
+    }
+}
+
+void metrics_print_all(void)
+{
+    int count;
+    taskENTER_CRITICAL(&s_registry_lock);
+    count = s_registry_count;
+    taskEXIT_CRITICAL(&s_registry_lock);
+
+    if (count == 0) {
+        ESP_LOGI(TAG, "No metrics recorded yet");
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        metrics_hist_print(s_registry[i]);
+    }
+}
@@ -0,0 +1,83 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Halo Metrics - Lightweight latency histograms
+ *
+ * Log2-bucketed histograms that are cheap enough to record from any task
+ * (a few instructions under a spinlock, no allocation). Histograms register
+ * themselves on first use so they can all be dumped with one call.
+ */
+
+#ifndef HALO_METRICS_H
+#define HALO_METRICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+
+/* ============================================================================
+   METRICS CONFIGURATION
+   ============================================================================ */
+
+#define METRICS_HIST_BUCKETS    20      /* Bucket i holds values in [2^(i-1), 2^i) */
+#define METRICS_MAX_HISTOGRAMS  32      /* Registry size for metrics_print_all() */
+
+/* ============================================================================
+   HISTOGRAM
+   ============================================================================ */
+
+typedef struct metrics_histogram {
+    const char *name;                   /* Shown in dumps */
+    const char *unit;                   /* "ms", "us", ... */
+    uint32_t buckets[METRICS_HIST_BUCKETS];
+    uint32_t count;
+    uint64_t sum;
+    uint32_t min;
+    uint32_t max;
+    bool registered;
+    portMUX_TYPE lock;
+} metrics_histogram_t;
+
+/* Static initializer: static metrics_histogram_t h = METRICS_HISTOGRAM_INIT("x", "ms"); */
+#define METRICS_HISTOGRAM_INIT(hist_name, hist_unit) { \
+    .name = (hist_name),                                \
+    .unit = (hist_unit),                                \
+    .lock = portMUX_INITIALIZER_UNLOCKED,               \
+}
+
+/**
+ * @brief Record one sample
+ *
+ * Safe from any task. Registers the histogram on first use.
+ *
+ * @param hist Histogram to update
+ * @param value Sample in the histogram's unit
+ */
+void metrics_hist_record(metrics_histogram_t *hist, uint32_t value);
+
+/**
+ * @brief Approximate percentile (upper edge of the bucket it falls in)
+ *
+ * @param hist Histogram to query
+ * @param percentile 0-100
+ * @return Value in the histogram's unit, 0 if empty
+ */
+uint32_t metrics_hist_percentile(metrics_histogram_t *hist, uint8_t percentile);
+
+/**
+ * @brief Clear all samples (keeps name and registration)
+ */
+void metrics_hist_reset(metrics_histogram_t *hist);
+
+/**
+ * @brief Log a histogram: summary line plus non-empty buckets
+ */
+void metrics_hist_print(metrics_histogram_t *hist);
+
+/**
+ * @brief Log every histogram that has recorded at least one sample
+ */
+void metrics_print_all(void);
+
+#endif /* HALO_METRICS_H */
@@ -0,0 +1,620 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Halo Mod - Effect parameter modulation
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "halo_mod.h"
+
+static const char *TAG = "halo_mod";
+
+#define Q16(x)              ((int32_t)((x) * 65536.0))
+#define Q15_ONE             32767
+#define SINE_STEPS          256         /* Per cycle, interpolated */
+
+typedef struct {
+    const char *name;
+    int32_t min;            /* Q16.16 */
+    int32_t max;
+    int32_t def;
+    float def_literal;      /* The default as the effect wrote it (Q16 rounds 0.30) */
+    bool wrap;              /* Wraps around the range instead of clamping */
+} param_info_t;
+
+#define PARAM(name, lo, hi, def, wrap)  { name, Q16(lo), Q16(hi), Q16(def), (float)(def), wrap }
+
+static const param_info_t s_params[HALO_MOD_PARAM_COUNT] = {
+    [HALO_MOD_SPEED]           = PARAM("speed",           0.0,    4.0,   1.0,  false),
+    [HALO_MOD_LEVEL]           = PARAM("level",           0.0,    1.0,   1.0,  false),
+    [HALO_MOD_HUE]             = PARAM("hue",             -180.0, 180.0, 0.0,  true),
+    [HALO_MOD_METEOR_TAIL]     = PARAM("meteor.tail",     0.05,   1.0,   1.0,  false),
+    [HALO_MOD_BREATHING_DEPTH] = PARAM("breathing.depth", 0.0,    1.0,   1.0,  false),
+    [HALO_MOD_RAINBOW_SPREAD]  = PARAM("rainbow.spread",  0.1,    4.0,   1.0,  false),
+    [HALO_MOD_FUSION_FALLOFF]  = PARAM("fusion.falloff",  0.05,   2.0,   0.30, false),
+    [HALO_MOD_WAVE_WIDTH]      = PARAM("wave.width",      0.5,    12.0,  3.0,  false),
+};
+
+static const char * const s_input_names[HALO_MOD_INPUT_COUNT] = {
+    [HALO_MOD_IN_BEAT] = "beat",
+    [HALO_MOD_IN_TOUCH] = "touch",
+    [HALO_MOD_IN_PRESENCE] = "presence",
+};
+
+typedef enum {
+    SRC_SINE = 0,
+    SRC_TRIANGLE,
+    SRC_WALK,
+    SRC_ENV,
+    SRC_LEVEL,
+    SRC_COUNT,
+} mod_source_t;
+
+static const char * const s_source_names[SRC_COUNT] = {
+    [SRC_SINE] = "sine", [SRC_TRIANGLE] = "triangle", [SRC_WALK] = "walk",
+    [SRC_ENV] = "env", [SRC_LEVEL] = "level",
+};
+
+typedef struct {
+    bool used;
+    uint8_t param;          /* halo_mod_param_t */
+    uint8_t source;         /* mod_source_t */
+    uint8_t input;          /* env, level */
+    int32_t depth;          /* Q16.16, parameter change at a modulator output of 1 */
+    uint32_t rate_mhz;      /* sine, triangle, walk */
+    uint16_t attack_ms;     /* env */
+    uint16_t release_ms;
+    uint32_t gen;           /* New on every write, resets the route's state */
+} mod_route_t;
+
+typedef enum {
+    ENV_IDLE = 0,
+    ENV_ATTACK,
+    ENV_RELEASE,
+} env_stage_t;
+
+/* Envelope state, render task only */
+typedef struct {
+    uint32_t gen;
+    uint32_t events_seen;
+    int32_t level;          /* Q15 */
+    env_stage_t stage;
+} route_state_t;
+
+/* Written by the command handlers and input sources, copied out by halo_mod_eval() */
+static mod_route_t s_routes[HALO_MOD_ROUTES];
+static int32_t s_base[HALO_MOD_PARAM_COUNT];
+static uint32_t s_events[HALO_MOD_INPUT_COUNT];
+static int32_t s_levels[HALO_MOD_INPUT_COUNT];     /* Q15 */
+static uint32_t s_next_gen = 1;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Render task only */
+static route_state_t s_state[HALO_MOD_ROUTES];
+static int64_t s_last_eval_us = 0;
+
+/* Results, read by the draw functions once per frame */
+static int32_t s_values[HALO_MOD_PARAM_COUNT];     /* Q16.16 */
+static uint32_t s_untouched;                        /* Bit per parameter: default base, no route */
+static int16_t s_sine[SINE_STEPS + 1];             /* Q15, one full cycle */
+
+static struct {
+    uint32_t evals;
+    uint64_t cycles_total;
+    uint32_t cycles_max;
+} s_cost;
+
+/* ============================================================================
+   SIGNALS (Q15)
+   ============================================================================ */
+
+/* phase: one cycle per 2^32 */
+static IRAM_ATTR int32_t sine_q15(uint32_t phase)
+{
+    uint32_t i = phase >> 24;
+    int32_t frac = (int32_t)((phase >> 8) & 0xFFFF);
+    int32_t a = s_sine[i];
+    return a + (((s_sine[i + 1] - a) * frac) >> 16);
+}
+
+/* Starts at 0 rising, like the sine */
+static int32_t triangle_q15(uint32_t phase)
+{
+    int32_t u = (int32_t)((phase + 0x40000000u) >> 16);
+    return (u < 32768) ? (2 * u - 32768) : (98303 - 2 * u);
+}
+
+/* Phase of a rate_mhz LFO at now_us, from the clock alone */
+static uint32_t lfo_phase(int64_t now_us, uint32_t rate_mhz)
+{
+    int64_t period_us = 1000000000LL / rate_mhz;    /* <= 1e8, so the shift fits */
+    int64_t rem = now_us % period_us;
+    if (rem < 0) {
+        rem += period_us;
+    }
+    return (uint32_t)(((uint64_t)rem << 32) / (uint64_t)period_us);
+}
+
+static uint32_t hash32(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+/* Smoothed random level, a new one every period. Seeded by parameter and
+   source only, so every unit on the same clock draws the same walk. */
+static int32_t walk_q15(const mod_route_t *route, int64_t now_us)
+{
+    int64_t period_us = 1000000000LL / route->rate_mhz;
+    int64_t k = now_us / period_us;
+    int64_t rem = now_us % period_us;
+    if (rem < 0) {
+        rem += period_us;
+        k--;
+    }
+    uint32_t seed = 0x9E3779B9u * (uint32_t)(route->param * SRC_COUNT + route->source + 1);
+    int32_t a = (int32_t)(hash32((uint32_t)k ^ seed) >> 16) - 32768;
+    int32_t b = (int32_t)(hash32((uint32_t)(k + 1) ^ seed) >> 16) - 32768;
+    int64_t f = (rem << 16) / period_us;                        /* Q16 */
+    int64_t s = ((f * f) >> 16) * (3 * 65536 - 2 * f) >> 16;   /* Smoothstep */
+    return a + (int32_t)(((b - a) * s) >> 16);
+}
+
+static int32_t env_q15(const mod_route_t *route, route_state_t *st, uint32_t events, int64_t dt_us)
+{
+    if (events != st->events_seen) {
+        st->events_seen = events;
+        st->stage = ENV_ATTACK;         /* Retrigger from the current level */
+    }
+    if (st->stage == ENV_ATTACK) {
+        st->level = route->attack_ms ? st->level + (int32_t)(Q15_ONE * dt_us / (route->attack_ms * 1000LL))
+                                     : Q15_ONE;
+        if (st->level >= Q15_ONE) {
+            st->level = Q15_ONE;
+            st->stage = ENV_RELEASE;
+        }
+    } else if (st->stage == ENV_RELEASE) {
+        st->level = route->release_ms ? st->level - (int32_t)(Q15_ONE * dt_us / (route->release_ms * 1000LL))
+                                      : 0;
+        if (st->level <= 0) {
+            st->level = 0;
+            st->stage = ENV_IDLE;
+        }
+    }
+    return st->level;
+}
+
+static int32_t limit(halo_mod_param_t param, int64_t v)
+{
+    const param_info_t *info = &s_params[param];
+    if (info->wrap) {
+        int64_t span = (int64_t)info->max - info->min;
+        v = (v - info->min) % span;
+        if (v < 0) {
+            v += span;
+        }
+        return (int32_t)(v + info->min);
+    }
+    if (v < info->min) return info->min;
+    if (v > info->max) return info->max;
+    return (int32_t)v;
+}
+
+/* ============================================================================
+   EVALUATION
+   ============================================================================ */
+
+void halo_mod_eval(int64_t now_us)
+{
+    uint32_t start = esp_cpu_get_cycle_count();
+    mod_route_t routes[HALO_MOD_ROUTES];
+    int64_t acc[HALO_MOD_PARAM_COUNT];
+    uint32_t events[HALO_MOD_INPUT_COUNT];
+    int32_t levels[HALO_MOD_INPUT_COUNT];
+
+    portENTER_CRITICAL(&s_lock);
+    memcpy(routes, s_routes, sizeof(routes));
+    memcpy(events, s_events, sizeof(events));
+    memcpy(levels, s_levels, sizeof(levels));
+    for (int p = 0; p < HALO_MOD_PARAM_COUNT; p++) {
+        acc[p] = s_base[p];
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    /* A sync step or a long stall must not run an envelope through at once */
+    int64_t dt_us = s_last_eval_us ? now_us - s_last_eval_us : 0;
+    if (dt_us < 0) dt_us = 0;
+    if (dt_us > HALO_MOD_MAX_STEP_US) dt_us = HALO_MOD_MAX_STEP_US;
+    s_last_eval_us = now_us;
+
+    for (int i = 0; i < HALO_MOD_ROUTES; i++) {
+        const mod_route_t *r = &routes[i];
+        if (!r->used) {
+            continue;
+        }
+        route_state_t *st = &s_state[i];
+        if (st->gen != r->gen) {
+            memset(st, 0, sizeof(*st));
+            st->gen = r->gen;
+            st->events_seen = events[r->input];     /* Past events do not fire it */
+        }
+        int32_t out;
+        switch (r->source) {
+            case SRC_SINE:     out = sine_q15(lfo_phase(now_us, r->rate_mhz)); break;
+            case SRC_TRIANGLE: out = triangle_q15(lfo_phase(now_us, r->rate_mhz)); break;
+            case SRC_WALK:     out = walk_q15(r, now_us); break;
+            case SRC_ENV:      out = env_q15(r, st, events[r->input], dt_us); break;
+            default:           out = levels[r->input]; break;
+        }
+        acc[r->param] += ((int64_t)r->depth * out) >> 15;
+    }
+
+    uint32_t untouched = 0;
+    for (int p = 0; p < HALO_MOD_PARAM_COUNT; p++) {
+        if (acc[p] == s_params[p].def) {
+            untouched |= 1u << p;
+        }
+    }
+    for (int i = 0; i < HALO_MOD_ROUTES; i++) {
+        if (routes[i].used) {
+            untouched &= ~(1u << routes[i].param);
+        }
+    }
+    for (int p = 0; p < HALO_MOD_PARAM_COUNT; p++) {
+        s_values[p] = limit((halo_mod_param_t)p, acc[p]);
+    }
+    s_untouched = untouched;
+
+    uint32_t cost = esp_cpu_get_cycle_count() - start;
+    s_cost.evals++;
+    s_cost.cycles_total += cost;
+    if (cost > s_cost.cycles_max) {
+        s_cost.cycles_max = cost;
+    }
+}
+
+float halo_mod_value(halo_mod_param_t param)
+{
+    if (s_untouched & (1u << param)) {
+        return s_params[param].def_literal;
+    }
+    return (float)s_values[param] * (1.0f / 65536.0f);
+}
+
+IRAM_ATTR bool halo_mod_is_default(halo_mod_param_t param)
+{
+    return (s_untouched & (1u << param)) != 0;
+}
+
+/* Rotation about the grey axis: keeps lightness, no float or libm */
+IRAM_ATTR void halo_mod_tint(uint8_t *r, uint8_t *g, uint8_t *b)
+{
+    int32_t hue = s_values[HALO_MOD_HUE];
+    if (hue == 0) {
+        return;
+    }
+    uint32_t phase = (uint32_t)(((int64_t)hue * 11930465) >> 16);     /* 2^32 / 360 per degree */
+    int32_t c = sine_q15(phase + 0x40000000u);
+    int32_t s = sine_q15(phase);
+    int32_t third = ((32768 - c) * 10923) >> 15;                /* (1 - cos) / 3 */
+    int32_t rs = (s * 18919) >> 15;                             /* sin x sqrt(1/3) */
+    int32_t m0 = c + third;
+    int32_t m1 = third - rs;
+    int32_t m2 = third + rs;
+
+    int32_t in_r = *r, in_g = *g, in_b = *b;
+    int32_t out[3] = {
+        (m0 * in_r + m1 * in_g + m2 * in_b) >> 15,
+        (m2 * in_r + m0 * in_g + m1 * in_b) >> 15,
+        (m1 * in_r + m2 * in_g + m0 * in_b) >> 15,
+    };
+    for (int i = 0; i < 3; i++) {
+        if (out[i] < 0) out[i] = 0;
+        if (out[i] > 255) out[i] = 255;
+    }
+    *r = (uint8_t)out[0];
+    *g = (uint8_t)out[1];
+    *b = (uint8_t)out[2];
+}
+
+/* ============================================================================
+   INPUTS
+   ============================================================================ */
+
+void halo_mod_input_event(halo_mod_input_t input)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_events[input]++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void halo_mod_input_level(halo_mod_input_t input, uint16_t permille)
+{
+    if (permille > 1000) permille = 1000;
+    int32_t level = (int32_t)permille * Q15_ONE / 1000;
+    portENTER_CRITICAL(&s_lock);
+    if (s_levels[input] == 0 && level > 0) {
+        s_events[input]++;
+    }
+    s_levels[input] = level;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/* ============================================================================
+   COMMANDS
+   ============================================================================ */
+
+static int find_name(const char * const *names, int count, const char *name)
+{
+    for (int i = 0; i < count; i++) {
+        if (strcmp(names[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int find_param(const char *name)
+{
+    for (int i = 0; i < HALO_MOD_PARAM_COUNT; i++) {
+        if (strcmp(s_params[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool parse_float(const char *text, float *value)
+{
+    char *end;
+    *value = strtof(text, &end);
+    return end != text && *end == '\0' && isfinite(*value);
+}
+
+static bool parse_ms(const char *text, uint16_t *ms)
+{
+    char *end;
+    long v = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || v < 0 || v > HALO_MOD_MAX_ENV_MS) {
+        return false;
+    }
+    *ms = (uint16_t)v;
+    return true;
+}
+
+static esp_err_t input_command(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int input = find_name(s_input_names, HALO_MOD_INPUT_COUNT, argv[1]);
+    if (input < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (argc == 2) {
+        halo_mod_input_event((halo_mod_input_t)input);
+        return ESP_OK;
+    }
+    char *end;
+    long permille = strtol(argv[2], &end, 10);
+    if (end == argv[2] || *end != '\0' || permille < 0 || permille > 1000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    halo_mod_input_level((halo_mod_input_t)input, (uint16_t)permille);
+    return ESP_OK;
+}
+
+static esp_err_t install_route(const mod_route_t *route)
+{
+    esp_err_t err = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&s_lock);
+    int slot = -1;
+    for (int i = 0; i < HALO_MOD_ROUTES; i++) {
+        if (s_routes[i].used && s_routes[i].param == route->param && s_routes[i].source == route->source) {
+            slot = i;
+            break;
+        }
+        if (!s_routes[i].used && slot < 0) {
+            slot = i;
+        }
+    }
+    if (slot >= 0) {
+        s_routes[slot] = *route;
+        s_routes[slot].used = true;
+        s_routes[slot].gen = s_next_gen++;
+        err = ESP_OK;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
+
+esp_err_t halo_mod_configure(const char *spec)
+{
+    char buf[64];
+    char *argv[6];
+    int argc = 0;
+
+    if (strlen(spec) >= sizeof(buf)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    strcpy(buf, spec);
+    for (char *p = buf; argc < 6; ) {
+        argv[argc++] = p;
+        p = strchr(p, ':');
+        if (p == NULL) {
+            break;
+        }
+        *p++ = '\0';
+    }
+
+    if (strcmp(argv[0], "input") == 0) {
+        return input_command(argc, argv);
+    }
+    int param = find_param(argv[0]);
+    if (param < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (argc < 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const param_info_t *info = &s_params[param];
+
+    if (argc == 2 && strcmp(argv[1], "off") == 0) {
+        portENTER_CRITICAL(&s_lock);
+        for (int i = 0; i < HALO_MOD_ROUTES; i++) {
+            if (s_routes[i].param == param) {
+                s_routes[i].used = false;
+            }
+        }
+        portEXIT_CRITICAL(&s_lock);
+        return ESP_OK;
+    }
+    if (argc == 3 && strcmp(argv[1], "base") == 0) {
+        float value;
+        if (!parse_float(argv[2], &value)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        int32_t base = limit((halo_mod_param_t)param, (int64_t)(value * 65536.0f));
+        portENTER_CRITICAL(&s_lock);
+        s_base[param] = base;
+        portEXIT_CRITICAL(&s_lock);
+        return ESP_OK;
+    }
+
+    mod_route_t route = { .param = (uint8_t)param };
+    int source = find_name(s_source_names, SRC_COUNT, argv[1]);
+    const char *depth_text;
+    if (source == SRC_SINE || source == SRC_TRIANGLE || source == SRC_WALK) {
+        float hz;
+        if (argc != 4 || !parse_float(argv[3], &hz)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        uint32_t rate_mhz = (hz * 1000.0f > HALO_MOD_MAX_RATE_MHZ) ? HALO_MOD_MAX_RATE_MHZ
+                                                                   : (uint32_t)(hz * 1000.0f + 0.5f);
+        route.rate_mhz = (rate_mhz < HALO_MOD_MIN_RATE_MHZ) ? HALO_MOD_MIN_RATE_MHZ : rate_mhz;
+        depth_text = argv[2];
+    } else if (source == SRC_ENV || source == SRC_LEVEL) {
+        if (argc != (source == SRC_ENV ? 6 : 4)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        int input = find_name(s_input_names, HALO_MOD_INPUT_COUNT, argv[2]);
+        if (input < 0) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        if (source == SRC_ENV &&
+            (!parse_ms(argv[4], &route.attack_ms) || !parse_ms(argv[5], &route.release_ms))) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        route.input = (uint8_t)input;
+        depth_text = argv[3];
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+    route.source = (uint8_t)source;
+
+    /* More than the whole range can only ever pin the parameter at its ends */
+    float depth;
+    if (!parse_float(depth_text, &depth)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    float span = (float)(info->max - info->min) / 65536.0f;
+    if (depth > span) depth = span;
+    if (depth < -span) depth = -span;
+    route.depth = (int32_t)(depth * 65536.0f);
+
+    return install_route(&route);
+}
+
+void halo_mod_clear(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    memset(s_routes, 0, sizeof(s_routes));
+    for (int p = 0; p < HALO_MOD_PARAM_COUNT; p++) {
+        s_base[p] = s_params[p].def;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/* ============================================================================
+   API
+   ============================================================================ */
+
+void halo_mod_init(void)
+{
+    for (int i = 0; i <= SINE_STEPS; i++) {
+        s_sine[i] = (int16_t)lrintf(Q15_ONE * sinf(2.0f * (float)M_PI * (float)i / SINE_STEPS));
+    }
+    halo_mod_clear();
+    for (int p = 0; p < HALO_MOD_PARAM_COUNT; p++) {
+        s_values[p] = s_params[p].def;
+    }
+    s_untouched = (1u << HALO_MOD_PARAM_COUNT) - 1;
+}
+
+void halo_mod_print_status(void)
+{
+    mod_route_t routes[HALO_MOD_ROUTES];
+    int32_t base[HALO_MOD_PARAM_COUNT];
+    uint32_t events[HALO_MOD_INPUT_COUNT];
+    int32_t levels[HALO_MOD_INPUT_COUNT];
+    portENTER_CRITICAL(&s_lock);
+    memcpy(routes, s_routes, sizeof(routes));
+    memcpy(base, s_base, sizeof(base));
+    memcpy(events, s_events, sizeof(events));
+    memcpy(levels, s_levels, sizeof(levels));
+    portEXIT_CRITICAL(&s_lock);
+
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "  Parameter          base       now     range");
+    for (int p = 0; p < HALO_MOD_PARAM_COUNT; p++) {
+        const param_info_t *info = &s_params[p];
+        ESP_LOGI(TAG, "  %-16s %7.3f  %8.3f     %.2f..%.2f", info->name, base[p] / 65536.0f,
+                 s_values[p] / 65536.0f, info->min / 65536.0f, info->max / 65536.0f);
+    }
+
+    int used = 0;
+    for (int i = 0; i < HALO_MOD_ROUTES; i++) {
+        const mod_route_t *r = &routes[i];
+        if (!r->used) {
+            continue;
+        }
+        used++;
+        const char *name = s_params[r->param].name;
+        float depth = r->depth / 65536.0f;
+        if (r->source == SRC_ENV) {
+            ESP_LOGI(TAG, "  Route: %-16s env on %s, depth %+.3f, attack %ums, release %ums", name,
+                     s_input_names[r->input], depth, r->attack_ms, r->release_ms);
+        } else if (r->source == SRC_LEVEL) {
+            ESP_LOGI(TAG, "  Route: %-16s level of %s, depth %+.3f", name, s_input_names[r->input], depth);
+        } else {
+            ESP_LOGI(TAG, "  Route: %-16s %s at %.3f Hz, depth %+.3f", name, s_source_names[r->source],
+                     r->rate_mhz / 1000.0f, depth);
+        }
+    }
+    ESP_LOGI(TAG, "  Routes: %d of %d", used, HALO_MOD_ROUTES);
+
+    ESP_LOGI(TAG, "  Inputs: beat %lu events, touch %lu events, presence %.3f (%lu rises)",
+             (unsigned long)events[HALO_MOD_IN_BEAT], (unsigned long)events[HALO_MOD_IN_TOUCH],
+             levels[HALO_MOD_IN_PRESENCE] / (float)Q15_ONE, (unsigned long)events[HALO_MOD_IN_PRESENCE]);
+
+    uint32_t mhz = esp_rom_get_cpu_ticks_per_us();
+    if (s_cost.evals > 0 && mhz > 0) {
+        ESP_LOGI(TAG, "  Cost per frame: avg %luns, max %luns over %lu frames",
+                 (unsigned long)(s_cost.cycles_total * 1000 / s_cost.evals / mhz),
+                 (unsigned long)((uint64_t)s_cost.cycles_max * 1000 / mhz),
+                 (unsigned long)s_cost.evals);
+    }
+    ESP_LOGI(TAG, "");
+}
@@ -0,0 +1,150 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Halo Mod - Effect parameter modulation
+ *
+ * Effects expose named parameters (meteor tail length, breathing depth, a
+ * hue shift of the strip color, ...). Each has a base value, and up to
+ * HALO_MOD_ROUTES modulators can be routed onto them:
+ *
+ *   sine, triangle  LFO at a rate in Hz, -1..1
+ *   walk            drifts to a new random level every 1/rate seconds, -1..1
+ *   env             attack/release envelope fired by an input's events, 0..1
+ *   level           an input's level as-is, 0..1
+ *
+ *   value = base + sum(depth x modulator), clamped to the parameter's range
+ *
+ * halo_mod_eval() runs once per frame from the render loop, in fixed point
+ * (Q16.16 values, Q15 signals), and caches the results. Effects read the
+ * few values they use once per frame, so modulation adds nothing to their
+ * per-pixel loops. LFO and walk outputs are a function of the clock alone:
+ * fed the shared clock of halo_sync, they line up across units.
+ *
+ * Inputs: note onsets of the melody player (beat), encoder and Zigbee
+ * remote use (touch), and a presence level set with mod:input:presence,
+ * for an automation to drive from a motion sensor.
+ *
+ * Routes live in RAM only; send them again after a reset.
+ */
+
+#ifndef HALO_MOD_H
+#define HALO_MOD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/* ============================================================================
+   HALO MOD CONFIGURATION
+   ============================================================================ */
+
+#define HALO_MOD_ROUTES             8
+#define HALO_MOD_MIN_RATE_MHZ       10      /* LFO rates: 0.01 Hz ... */
+#define HALO_MOD_MAX_RATE_MHZ       20000   /* ... 20 Hz */
+#define HALO_MOD_MAX_ENV_MS         10000   /* Longest attack or release */
+#define HALO_MOD_MAX_STEP_US        100000  /* Envelopes advance at most this much per frame */
+
+typedef enum {
+    HALO_MOD_SPEED = 0,         /* x animation speed, all effects */
+    HALO_MOD_LEVEL,             /* x brightness, all effects */
+    HALO_MOD_HUE,               /* Degrees added to the strip color (meteor, breathing, solid) */
+    HALO_MOD_METEOR_TAIL,       /* Meteor tail, share of the ring */
+    HALO_MOD_BREATHING_DEPTH,   /* How far a breath dims, 0-1 */
+    HALO_MOD_RAINBOW_SPREAD,    /* Rainbows around the ring */
+    HALO_MOD_FUSION_FALLOFF,    /* Fusion trail falloff per pixel (higher = shorter) */
+    HALO_MOD_WAVE_WIDTH,        /* Wave front width in pixels */
+    HALO_MOD_PARAM_COUNT,
+} halo_mod_param_t;
+
+typedef enum {
+    HALO_MOD_IN_BEAT = 0,       /* Each note the melody player starts */
+    HALO_MOD_IN_TOUCH,          /* Encoder turns and presses, Zigbee remote buttons */
+    HALO_MOD_IN_PRESENCE,       /* Level from mod:input:presence, an event when it rises from 0 */
+    HALO_MOD_INPUT_COUNT,
+} halo_mod_input_t;
+
+/* ============================================================================
+   API
+   ============================================================================ */
+
+/**
+ * @brief Build the sine table and set every parameter to its default
+ */
+void halo_mod_init(void);
+
+/**
+ * @brief Run the modulators and cache every parameter value (render task)
+ *
+ * @param now_us Clock the LFOs run on: halo_sync_now_us() while synced,
+ *               esp_timer time otherwise
+ */
+void halo_mod_eval(int64_t now_us);
+
+/**
+ * @brief Parameter value as of the last halo_mod_eval() (any task)
+ *
+ * The exact default (e.g. 0.30f, not its Q16.16 rounding) while the
+ * parameter is untouched. Runs from flash: the defaults are in .rodata and
+ * the conversion uses the soft-float helpers.
+ */
+float halo_mod_value(halo_mod_param_t param);
+
+/**
+ * @brief Whether a parameter is at its default, with nothing routed onto it
+ *
+ * halo_mod_value() then returns the default exactly as the effect had it
+ * before modulation, and effects keep their original expression, so an
+ * unmodulated ring draws the same pixels as before to the bit.
+ */
+bool halo_mod_is_default(halo_mod_param_t param);
+
+/**
+ * @brief Rotate a color's hue by the HALO_MOD_HUE value (integer only, any task)
+ *
+ * Left untouched when the hue shift is 0.
+ */
+void halo_mod_tint(uint8_t *r, uint8_t *g, uint8_t *b);
+
+/**
+ * @brief Count an event on an input (fires its envelopes), any task
+ */
+void halo_mod_input_event(halo_mod_input_t input);
+
+/**
+ * @brief Set an input's level, any task
+ *
+ * @param input Input
+ * @param permille 0-1000
+ */
+void halo_mod_input_level(halo_mod_input_t input, uint16_t permille);
+
+/**
+ * @brief Apply one "mod:" command, without the prefix
+ *
+ *   <param>:sine|triangle|walk:<depth>:<hz>
+ *   <param>:env:<input>:<depth>:<attack ms>:<release ms>
+ *   <param>:level:<input>:<depth>
+ *   <param>:base:<value>      <param>:off
+ *   input:<input>[:<0-1000>]  (an event without a level)
+ *
+ * A new route replaces the one with the same parameter and source.
+ *
+ * @param spec Command text after "mod:"
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a malformed command,
+ *         ESP_ERR_NOT_FOUND for an unknown parameter or input,
+ *         ESP_ERR_NO_MEM when all routes are taken
+ */
+esp_err_t halo_mod_configure(const char *spec);
+
+/**
+ * @brief Remove every route and restore the default base values
+ */
+void halo_mod_clear(void);
+
+/**
+ * @brief Log parameters, routes, inputs and the evaluation cost
+ */
+void halo_mod_print_status(void);
+
+#endif /* HALO_MOD_H */
@@ -0,0 +1,312 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Halo Profiler - Sampling CPU profiler with folded-stack export
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_memory_utils.h"
+#include "driver/gptimer.h"
+#include "sdkconfig.h"
+#include "halo_profiler.h"
+
+#if CONFIG_IDF_TARGET_ARCH_RISCV
+#include "riscv/rvruntime-frames.h"
+#include "riscv/csr.h"
+#endif
+
+static const char *TAG = "profiler";
+
+#if CONFIG_ESP_SYSTEM_USE_FRAME_POINTER
+#define PROF_HAVE_FP        1
+#else
+#define PROF_HAVE_FP        0
+#endif
+
+#define PROF_TASK_ISR       0       /* s_task_names[0] */
+
+/* ============================================================================
+   SAMPLE TABLE (written by the timer ISR only)
+   ============================================================================ */
+
+typedef struct {
+    uint32_t hash;                  /* 0 = empty slot */
+    uint32_t count;
+    uint8_t task;                   /* Index into s_task_names */
+    uint8_t depth;
+    uint32_t pc[HALO_PROF_DEPTH];   /* Leaf first */
+} prof_stack_t;
+
+static prof_stack_t s_stacks[HALO_PROF_STACKS];
+static uint32_t s_stacks_used = 0;
+
+static TaskHandle_t s_task_handles[HALO_PROF_MAX_TASKS];
+static char s_task_names[HALO_PROF_MAX_TASKS][configMAX_TASK_NAME_LEN];
+static uint32_t s_task_count = 0;
+
+static volatile bool s_running = false;
+static uint32_t s_samples = 0;
+static uint32_t s_isr_samples = 0;
+static uint32_t s_dropped = 0;              /* Table or task list full */
+static int64_t s_started_us = 0;
+static int64_t s_stopped_us = 0;
+
+static gptimer_handle_t s_timer = NULL;
+
+#if CONFIG_IDF_TARGET_ARCH_RISCV
+
+/* ============================================================================
+   SAMPLING (timer ISR)
+   ============================================================================ */
+
+static IRAM_ATTR int task_index(TaskHandle_t task)
+{
+    for (uint32_t i = 1; i < s_task_count; i++) {
+        if (s_task_handles[i] == task) {
+            return (int)i;
+        }
+    }
+    if (s_task_count >= HALO_PROF_MAX_TASKS) {
+        return -1;
+    }
+    s_task_handles[s_task_count] = task;
+    strlcpy(s_task_names[s_task_count], pcTaskGetName(task), configMAX_TASK_NAME_LEN);
+    return (int)s_task_count++;
+}
+
+/* Interrupted task context: PC from the saved frame, callers from frame pointers */
+static IRAM_ATTR int task_backtrace(TaskHandle_t task, uint32_t *pc)
+{
+    /* pxTopOfStack is the TCB's first member; the interrupt entry code stores
+     * the interrupted task's SP there, which is where it saved the frame. */
+    const RvExcFrame *frame = *(RvExcFrame * const *)task;
+    int depth = 0;
+    pc[depth++] = frame->mepc;
+
+#if PROF_HAVE_FP
+    uint32_t sp = frame->sp;
+    uint32_t fp = frame->s0;
+    while (depth < HALO_PROF_DEPTH) {
+        if (fp <= sp || fp - sp > HALO_PROF_MAX_FRAME_SPAN || (fp & 3) != 0 ||
+            !esp_ptr_in_dram((const void *)(fp - 8))) {
+            break;
+        }
+        uint32_t ra = ((const uint32_t *)fp)[-1];
+        uint32_t prev_fp = ((const uint32_t *)fp)[-2];
+        if (!esp_ptr_executable((const void *)ra)) {
+            break;
+        }
+        pc[depth++] = ra;
+        sp = fp;
+        fp = prev_fp;
+    }
+#endif
+    return depth;
+}
+
+static IRAM_ATTR void record(uint8_t task, const uint32_t *pc, int depth)
+{
+    /* FNV-1a over task + PCs */
+    uint32_t hash = 2166136261u ^ task;
+    for (int i = 0; i < depth; i++) {
+        hash = (hash ^ pc[i]) * 16777619u;
+    }
+    if (hash == 0) {
+        hash = 1;
+    }
+
+    for (uint32_t probe = 0; probe < HALO_PROF_STACKS; probe++) {
+        prof_stack_t *slot = &s_stacks[(hash + probe) % HALO_PROF_STACKS];
+        if (slot->hash == 0) {
+            slot->hash = hash;
+            slot->count = 1;
+            slot->task = task;
+            slot->depth = (uint8_t)depth;
+            memcpy(slot->pc, pc, depth * sizeof(uint32_t));
+            s_stacks_used++;
+            return;
+        }
+        if (slot->hash == hash && slot->task == task && slot->depth == depth &&
+            memcmp(slot->pc, pc, depth * sizeof(uint32_t)) == 0) {
+            slot->count++;
+            return;
+        }
+        if (s_stacks_used >= HALO_PROF_STACKS) {
+            break;
+        }
+    }
+    s_dropped++;
+}
+
+static IRAM_ATTR bool on_sample(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata,
+                                void *user_ctx)
+{
+    if (!s_running) {
+        return false;
+    }
+    uint32_t pc[HALO_PROF_DEPTH];
+    s_samples++;
+
+    if (xPortInterruptedFromISRContext()) {
+        /* Nested in another ISR: its PC is still in mepc */
+        pc[0] = RV_READ_CSR(mepc);
+        s_isr_samples++;
+        record(PROF_TASK_ISR, pc, 1);
+        return false;
+    }
+
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    int index = task_index(task);
+    if (index < 0) {
+        s_dropped++;
+        return false;
+    }
+    record((uint8_t)index, pc, task_backtrace(task, pc));
+    return false;
+}
+
+/* ============================================================================
+   CONTROL
+   ============================================================================ */
+
+static esp_err_t sample_timer_create(void)
+{
+    gptimer_config_t config = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = 1000000,
+    };
+    esp_err_t err = gptimer_new_timer(&config, &s_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    gptimer_event_callbacks_t callbacks = { .on_alarm = on_sample };
+    gptimer_register_event_callbacks(s_timer, &callbacks, NULL);
+    gptimer_alarm_config_t alarm = {
+        .alarm_count = HALO_PROF_PERIOD_US,
+        .reload_count = 0,
+        .flags.auto_reload_on_alarm = true,
+    };
+    gptimer_set_alarm_action(s_timer, &alarm);
+    return gptimer_enable(s_timer);
+}
+
+esp_err_t halo_profiler_start(void)
+{
+    if (s_running) {
+        return ESP_OK;
+    }
+    if (s_timer == NULL) {
+        esp_err_t err = sample_timer_create();
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Sample timer failed: %s", esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    memset(s_stacks, 0, sizeof(s_stacks));
+    s_stacks_used = 0;
+    s_samples = s_isr_samples = s_dropped = 0;
+    s_task_count = 1;
+    strlcpy(s_task_names[PROF_TASK_ISR], "[isr]", configMAX_TASK_NAME_LEN);
+    s_started_us = esp_timer_get_time();
+    s_stopped_us = 0;
+
+    s_running = true;
+    gptimer_set_raw_count(s_timer, 0);
+    gptimer_start(s_timer);
+
+    ESP_LOGI(TAG, "Profiling at %d Hz, %s - 'prof:dump' to stop and export",
+             1000000 / HALO_PROF_PERIOD_US,
+             PROF_HAVE_FP ? "backtraces on" : "PC only (no CONFIG_ESP_SYSTEM_USE_FRAME_POINTER)");
+    return ESP_OK;
+}
+
+void halo_profiler_stop(void)
+{
+    if (!s_running) {
+        return;
+    }
+    gptimer_stop(s_timer);
+    s_running = false;
+    s_stopped_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "Profiler stopped: %lu samples", (unsigned long)s_samples);
+}
+
+#else /* !CONFIG_IDF_TARGET_ARCH_RISCV */
+
+esp_err_t halo_profiler_start(void)
+{
+    ESP_LOGW(TAG, "Sampling profiler needs a RISC-V target");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void halo_profiler_stop(void)
+{
+}
+
+#endif
+
+/* ============================================================================
+   EXPORT
+   ============================================================================ */
+
+esp_err_t halo_profiler_dump(void)
+{
+    halo_profiler_stop();
+    if (s_samples == 0) {
+        ESP_LOGW(TAG, "Nothing sampled - run prof:start first");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ESP_LOGI(TAG, "PROF BEGIN samples=%lu period_us=%d fp=%d",
+             (unsigned long)s_samples, HALO_PROF_PERIOD_US, PROF_HAVE_FP);
+    for (uint32_t i = 0; i < HALO_PROF_STACKS; i++) {
+        const prof_stack_t *slot = &s_stacks[i];
+        if (slot->hash == 0) {
+            continue;
+        }
+        /* Folded stacks are root first */
+        char line[configMAX_TASK_NAME_LEN + HALO_PROF_DEPTH * 11 + 12];
+        int len = snprintf(line, sizeof(line), "%s", s_task_names[slot->task]);
+        for (int d = slot->depth - 1; d >= 0; d--) {
+            len += snprintf(&line[len], sizeof(line) - len, ";0x%08lx", (unsigned long)slot->pc[d]);
+        }
+        snprintf(&line[len], sizeof(line) - len, " %lu", (unsigned long)slot->count);
+        ESP_LOGI(TAG, "PROF:%s", line);
+    }
+    ESP_LOGI(TAG, "PROF END");
+    return ESP_OK;
+}
+
+/* ============================================================================
+   STATUS
+   ============================================================================ */
+
+void halo_profiler_print_status(void)
+{
+    int64_t end_us = s_running ? esp_timer_get_time() : s_stopped_us;
+
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "╔══════════════════════════════════════════════════════════╗");
+    ESP_LOGI(TAG, "║  🔥 PROFILER                                              ║");
+    ESP_LOGI(TAG, "╚══════════════════════════════════════════════════════════╝");
+    ESP_LOGI(TAG, "  State: %s, %s", s_running ? "sampling" : "stopped",
+             PROF_HAVE_FP ? "frame-pointer backtraces" : "PC only");
+    if (s_started_us != 0) {
+        ESP_LOGI(TAG, "  Samples: %lu over %llds (%lu in other ISRs, %lu dropped)",
+                 (unsigned long)s_samples, (end_us - s_started_us) / 1000000,
+                 (unsigned long)s_isr_samples, (unsigned long)s_dropped);
+        ESP_LOGI(TAG, "  Distinct stacks: %lu / %d, tasks seen: %lu",
+                 (unsigned long)s_stacks_used, HALO_PROF_STACKS, (unsigned long)(s_task_count - 1));
+    }
+    ESP_LOGI(TAG, "");
+}
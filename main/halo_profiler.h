@@ -0,0 +1,72 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Halo Profiler - Sampling CPU profiler with folded-stack export
+ *
+ * Run-time stats say which task is busy, not which function. While the
+ * profiler runs, a hardware timer interrupts the CPU about 1000 times a
+ * second. Each time, it takes the interrupted task's PC from the frame the
+ * interrupt entry code saved, and walks a few frame pointers up the task's
+ * stack. Identical stacks are counted in a fixed table, so the interrupt
+ * only hashes and increments. Only that interrupt writes the table, and it
+ * is read after sampling has stopped, so no lock is needed.
+ *
+ * prof:dump prints the table as folded stacks with raw addresses:
+ *   PROF:zigbee_main;0x42001234;0x42005678 57
+ * tools/prof_fold.py resolves the addresses against the ELF on the host.
+ * Its output feeds flamegraph.pl or speedscope.
+ *
+ * Backtraces need CONFIG_ESP_SYSTEM_USE_FRAME_POINTER=y. Without it only
+ * the interrupted PC is recorded (a flat profile). Samples that land in
+ * another interrupt are counted under "[isr]", with the interrupted ISR's PC.
+ * Code inside a critical section cannot be sampled. Its time shows up at
+ * the instruction where interrupts are re-enabled.
+ */
+
+#ifndef HALO_PROFILER_H
+#define HALO_PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/* ============================================================================
+   HALO PROFILER CONFIGURATION
+   ============================================================================ */
+
+#define HALO_PROF_PERIOD_US         1009    /* ~991 Hz, prime so it never locks to the tick or frame rate */
+#define HALO_PROF_DEPTH             6       /* PCs per sample, leaf first */
+#define HALO_PROF_STACKS            512     /* Distinct stacks kept (~18KB, static) */
+#define HALO_PROF_MAX_TASKS         24      /* Distinct task names */
+#define HALO_PROF_MAX_FRAME_SPAN    8192    /* Frame pointer must stay this close to the task SP */
+
+/* ============================================================================
+   API
+   ============================================================================ */
+
+/**
+ * @brief Clear the sample table and start sampling
+ *
+ * @return ESP_OK, a gptimer error, or ESP_ERR_NOT_SUPPORTED on non-RISC-V targets
+ */
+esp_err_t halo_profiler_start(void);
+
+/**
+ * @brief Stop sampling (the table is kept for dumping)
+ */
+void halo_profiler_stop(void);
+
+/**
+ * @brief Stop sampling and log the table as folded stacks between PROF BEGIN / PROF END
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE if nothing was sampled
+ */
+esp_err_t halo_profiler_dump(void);
+
+/**
+ * @brief Log sample counts, table use and drops
+ */
+void halo_profiler_print_status(void);
+
+#endif /* HALO_PROFILER_H */
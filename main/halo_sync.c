@@ -0,0 +1,722 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Halo Sync - Shared animation clock for several Halos on one LAN
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_mac.h"
+#include "nvs.h"
+#include "lwip/sockets.h"
+#include "halo_metrics.h"
+#include "halo_tasks.h"
+#include "halo_sync.h"
+
+static const char *TAG = "halo_sync";
+
+#define SYNC_MAGIC          0x4E595348      /* "HSYN" */
+#define SYNC_VERSION        2               /* 2: beacons carry the speed anchor */
+#define SYNC_MIN_FIT        4               /* Samples before the skew is fitted */
+#define SYNC_RETRY_MS       1000            /* Socket could not be opened (no IP yet) */
+
+#define NVS_NAMESPACE       "halo_sync"
+#define NVS_KEY_ROLE        "role"
+
+typedef enum {
+    PKT_BEACON = 1,         /* Leader -> group: t1 = leader time, plus the speed anchor */
+    PKT_REQUEST,            /* Follower -> leader: t1 = follower send time */
+    PKT_REPLY,              /* Leader -> follower: t1 echoed, t2 leader rx, t3 leader tx */
+} packet_type_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t type;
+    uint16_t seq;
+    uint32_t unit_id;       /* Sender: low 4 bytes of its WiFi MAC */
+    int64_t t1;
+    int64_t t2;
+    int64_t t3;
+    int64_t anchor_us;      /* Beacon: shared time of the last speed change */
+    int64_t anchor_pos;     /* Beacon: position at anchor_us */
+    uint32_t speed_pm;      /* Beacon: speed since anchor_us */
+} sync_packet_t;
+
+/* shared(t) = base_shared + d + d * rate_ppb / 1e9, with d = t - base_local */
+typedef struct {
+    bool valid;             /* A leader has been heard */
+    int64_t base_local;
+    int64_t base_shared;
+    int32_t rate_ppb;       /* Skew plus the slew of the current correction */
+} sync_clock_t;
+
+/* Animation position (speed x time, in speed permille x us):
+   pos(t) = pos0 + (t - t0) x speed_pm, t shared time. A speed change moves
+   the anchor to now instead of scaling the whole clock, so the phases keep
+   going from where they are. */
+typedef struct {
+    int64_t t0_us;
+    int64_t pos0;
+    uint32_t speed_pm;      /* 0 = not set yet */
+    bool from_leader;       /* Follower: taken from a beacon */
+} sync_anchor_t;
+
+/* Best exchange of one burst */
+typedef struct {
+    int64_t local_us;       /* Midpoint of t1..t4, own clock */
+    int64_t offset_us;      /* Leader minus own clock */
+    uint32_t delay_us;      /* Round trip without the leader's turnaround */
+} sync_sample_t;
+
+static volatile halo_sync_role_t s_role = HALO_SYNC_OFF;
+static TaskHandle_t s_task = NULL;
+static uint32_t s_unit_id = 0;
+
+static sync_clock_t s_clock;
+static sync_anchor_t s_anchor;      /* Under s_clock_lock too */
+static portMUX_TYPE s_clock_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Sync task only */
+static int s_sock = -1;
+static struct sockaddr_in s_group;
+static uint16_t s_seq = 0;
+
+static uint32_t s_leader_id = 0;                /* 0 = none */
+static struct sockaddr_in s_leader_addr;
+static int64_t s_leader_seen_us = 0;
+
+static sync_sample_t s_samples[HALO_SYNC_SAMPLES];
+static int s_sample_count = 0;
+static int s_sample_next = 0;
+
+static uint32_t s_recent_delays[HALO_SYNC_SAMPLES];     /* Best round trip per burst, kept or not */
+static int s_recent_count = 0;
+static int s_recent_next = 0;
+
+static sync_sample_t s_burst_best;
+static bool s_burst_has_best = false;
+static uint16_t s_burst_first_seq = 0;
+static int s_burst_sent = 0;
+static int64_t s_burst_start_us = 0;
+
+/* Last fit, for the status (written by the sync task, read as plain values) */
+static struct {
+    int32_t skew_ppb;
+    int32_t offset_us;      /* Shared minus own clock at the last poll */
+    int32_t error_us;       /* Correction the last poll asked for */
+    uint32_t residual_us;   /* RMS distance of the samples from the fitted line */
+    uint32_t delay_us;      /* Best round trip of the last burst */
+} s_fit;
+
+static struct {
+    uint32_t beacons_sent;
+    uint32_t requests_answered;
+    uint32_t bursts;
+    uint32_t bursts_discarded;      /* No reply, or a round trip too slow to trust */
+    uint32_t steps;
+    uint32_t leader_changes;
+    uint32_t other_leaders;         /* Beacons from a second leader */
+    uint32_t socket_errors;
+} s_stats;
+
+static metrics_histogram_t s_rtt_hist = METRICS_HISTOGRAM_INIT("sync_rtt", "us");
+static metrics_histogram_t s_error_hist = METRICS_HISTOGRAM_INIT("sync_error", "us");
+
+/* ============================================================================
+   CLOCK
+   ============================================================================ */
+
+static int64_t clock_at(const sync_clock_t *clock, int64_t local_us)
+{
+    int64_t d = local_us - clock->base_local;
+    return clock->base_shared + d + d * clock->rate_ppb / 1000000000LL;
+}
+
+static void clock_reset(void)
+{
+    portENTER_CRITICAL(&s_clock_lock);
+    s_clock.valid = false;
+    portEXIT_CRITICAL(&s_clock_lock);
+}
+
+/* Step straight to shared = local + offset, running at skew from here on */
+static void clock_step(int64_t local_us, int64_t offset_us, int32_t skew_ppb)
+{
+    portENTER_CRITICAL(&s_clock_lock);
+    s_clock.base_local = local_us;
+    s_clock.base_shared = local_us + offset_us;
+    s_clock.rate_ppb = skew_ppb;
+    s_clock.valid = true;
+    portEXIT_CRITICAL(&s_clock_lock);
+    s_stats.steps++;
+}
+
+/* Rebase at local_us without a jump, then run at rate_ppb */
+static void clock_set_rate(int64_t local_us, int32_t rate_ppb)
+{
+    portENTER_CRITICAL(&s_clock_lock);
+    s_clock.base_shared = clock_at(&s_clock, local_us);
+    s_clock.base_local = local_us;
+    s_clock.rate_ppb = rate_ppb;
+    portEXIT_CRITICAL(&s_clock_lock);
+}
+
+static int64_t anchor_at(const sync_anchor_t *anchor, int64_t shared_us)
+{
+    return anchor->pos0 + (shared_us - anchor->t0_us) * (int64_t)anchor->speed_pm;
+}
+
+/* ============================================================================
+   OFFSET AND SKEW ESTIMATE (follower)
+   ============================================================================ */
+
+static void samples_clear(void)
+{
+    s_sample_count = 0;
+    s_sample_next = 0;
+}
+
+/* Least-squares line through the samples: offset at the newest one, and slope */
+static void fit_samples(const sync_sample_t *newest, double *offset_us, double *skew_ppm)
+{
+    if (s_sample_count < SYNC_MIN_FIT) {
+        *offset_us = (double)newest->offset_us;
+        *skew_ppm = s_fit.skew_ppb / 1000.0;
+        s_fit.residual_us = 0;
+        return;
+    }
+
+    double xm = 0, ym = 0;
+    for (int i = 0; i < s_sample_count; i++) {
+        xm += (s_samples[i].local_us - newest->local_us) / 1e6;
+        ym += (double)(s_samples[i].offset_us - newest->offset_us);
+    }
+    xm /= s_sample_count;
+    ym /= s_sample_count;
+
+    double sxx = 0, sxy = 0;
+    for (int i = 0; i < s_sample_count; i++) {
+        double x = (s_samples[i].local_us - newest->local_us) / 1e6 - xm;
+        double y = (double)(s_samples[i].offset_us - newest->offset_us) - ym;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    double slope = sxx > 0 ? sxy / sxx : 0;     /* us per s = ppm */
+    if (slope > HALO_SYNC_MAX_SKEW_PPM || slope < -HALO_SYNC_MAX_SKEW_PPM) {
+        ESP_LOGW(TAG, "Fitted skew %.0f ppm out of range, ignored", slope);
+        slope = s_fit.skew_ppb / 1000.0;
+    }
+    *offset_us = newest->offset_us + ym - slope * xm;
+    *skew_ppm = slope;
+
+    double sum_sq = 0;
+    for (int i = 0; i < s_sample_count; i++) {
+        double x = (s_samples[i].local_us - newest->local_us) / 1e6 - xm;
+        double y = (double)(s_samples[i].offset_us - newest->offset_us) - ym;
+        sum_sq += (y - slope * x) * (y - slope * x);
+    }
+    s_fit.residual_us = (uint32_t)sqrt(sum_sq / s_sample_count);
+}
+
+/* Whether a burst's best round trip is close enough to the recent best */
+static bool delay_trusted(uint32_t delay_us)
+{
+    if (delay_us > HALO_SYNC_MAX_DELAY_US) {
+        return false;
+    }
+    s_recent_delays[s_recent_next] = delay_us;
+    s_recent_next = (s_recent_next + 1) % HALO_SYNC_SAMPLES;
+    if (s_recent_count < HALO_SYNC_SAMPLES) {
+        s_recent_count++;
+    }
+    uint32_t best = delay_us;
+    for (int i = 0; i < s_recent_count; i++) {
+        if (s_recent_delays[i] < best) {
+            best = s_recent_delays[i];
+        }
+    }
+    return delay_us <= 2 * best + HALO_SYNC_GATE_SLACK_US;
+}
+
+/* A burst is over: keep its best exchange and steer the clock towards the new estimate */
+static void finish_burst(void)
+{
+    s_stats.bursts++;
+    if (!s_burst_has_best || !delay_trusted(s_burst_best.delay_us)) {
+        /* The last correction is worked off by now: run on the skew alone */
+        s_stats.bursts_discarded++;
+        clock_set_rate(esp_timer_get_time(), s_fit.skew_ppb);
+        return;
+    }
+    sync_sample_t sample = s_burst_best;
+    s_fit.delay_us = sample.delay_us;
+    metrics_hist_record(&s_rtt_hist, sample.delay_us);
+
+    /* Far off the line: the leader restarted or changed, start the fit over */
+    if (s_sample_count >= SYNC_MIN_FIT) {
+        int64_t predicted = clock_at(&s_clock, sample.local_us) - sample.local_us;
+        int64_t jump = sample.offset_us - predicted;
+        if (jump > HALO_SYNC_STEP_US || jump < -HALO_SYNC_STEP_US) {
+            ESP_LOGW(TAG, "Leader clock jumped by %lldms, resyncing", (long long)(jump / 1000));
+            samples_clear();
+        }
+    }
+    s_samples[s_sample_next] = sample;
+    s_sample_next = (s_sample_next + 1) % HALO_SYNC_SAMPLES;
+    if (s_sample_count < HALO_SYNC_SAMPLES) {
+        s_sample_count++;
+    }
+
+    double offset_us, skew_ppm;
+    fit_samples(&sample, &offset_us, &skew_ppm);
+    int32_t skew_ppb = (int32_t)(skew_ppm * 1000.0);
+    s_fit.skew_ppb = skew_ppb;
+
+    int64_t now = esp_timer_get_time();
+    int64_t target = now + (int64_t)offset_us + (int64_t)(skew_ppm * (now - sample.local_us) / 1e6);
+    int64_t error = target - clock_at(&s_clock, now);
+    s_fit.offset_us = (int32_t)(target - now);
+    s_fit.error_us = (int32_t)error;
+    metrics_hist_record(&s_error_hist, (uint32_t)(error < 0 ? -error : error));
+
+    if (error > HALO_SYNC_STEP_US || error < -HALO_SYNC_STEP_US) {
+        clock_step(now, target - now, skew_ppb);
+        ESP_LOGI(TAG, "Stepped clock by %lldms", (long long)(error / 1000));
+        return;
+    }
+
+    /* Work the error off by the next poll, never faster than MAX_SLEW */
+    int64_t slew_ppb = error * 1000000000LL / ((int64_t)HALO_SYNC_POLL_MS * 1000);
+    const int64_t max_slew_ppb = (int64_t)HALO_SYNC_MAX_SLEW_PPM * 1000;
+    if (slew_ppb > max_slew_ppb) {
+        slew_ppb = max_slew_ppb;
+    } else if (slew_ppb < -max_slew_ppb) {
+        slew_ppb = -max_slew_ppb;
+    }
+    clock_set_rate(now, skew_ppb + (int32_t)slew_ppb);
+}
+
+/* ============================================================================
+   SOCKET
+   ============================================================================ */
+
+static void socket_close(void)
+{
+    if (s_sock >= 0) {
+        close(s_sock);
+        s_sock = -1;
+    }
+}
+
+static bool socket_open(void)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        return false;
+    }
+    int yes = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(HALO_SYNC_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    struct ip_mreq mreq = {
+        .imr_interface.s_addr = htonl(INADDR_ANY),
+    };
+    inet_pton(AF_INET, HALO_SYNC_GROUP, &mreq.imr_multiaddr);
+    uint8_t ttl = 1;            /* Never leave the subnet */
+
+    /* Joining fails until the station has an address: retried by the task */
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0) {
+        close(sock);
+        return false;
+    }
+
+    s_group = (struct sockaddr_in){
+        .sin_family = AF_INET,
+        .sin_port = htons(HALO_SYNC_PORT),
+        .sin_addr = mreq.imr_multiaddr,
+    };
+    s_sock = sock;
+    ESP_LOGI(TAG, "Listening on %s:%d", HALO_SYNC_GROUP, HALO_SYNC_PORT);
+    return true;
+}
+
+static void send_packet(sync_packet_t *pkt, const struct sockaddr_in *to)
+{
+    pkt->magic = SYNC_MAGIC;
+    pkt->version = SYNC_VERSION;
+    pkt->unit_id = s_unit_id;
+    if (pkt->type != PKT_REQUEST) {
+        /* Taken as late as possible: it is the leader's transmit time */
+        int64_t now = esp_timer_get_time();
+        if (pkt->type == PKT_BEACON) {
+            pkt->t1 = now;
+            portENTER_CRITICAL(&s_clock_lock);
+            pkt->anchor_us = s_anchor.t0_us;
+            pkt->anchor_pos = s_anchor.pos0;
+            pkt->speed_pm = s_anchor.speed_pm;
+            portEXIT_CRITICAL(&s_clock_lock);
+        } else {
+            pkt->t3 = now;
+        }
+    }
+    if (sendto(s_sock, pkt, sizeof(*pkt), 0, (const struct sockaddr *)to, sizeof(*to)) < 0) {
+        /* Usually the network went away: reopen (and rejoin) once it is back */
+        ESP_LOGW(TAG, "Send failed: errno %d", errno);
+        s_stats.socket_errors++;
+        socket_close();
+    }
+}
+
+/* ============================================================================
+   PROTOCOL
+   ============================================================================ */
+
+static void forget_leader(void)
+{
+    s_leader_id = 0;
+    s_burst_sent = 0;
+    s_burst_has_best = false;
+    s_recent_count = 0;
+    s_recent_next = 0;
+    samples_clear();
+}
+
+static void handle_packet(const sync_packet_t *pkt, const struct sockaddr_in *from, int64_t rx_us)
+{
+    halo_sync_role_t role = s_role;
+
+    if (pkt->type == PKT_BEACON) {
+        if (role == HALO_SYNC_LEADER) {
+            s_stats.other_leaders++;
+            if (s_stats.other_leaders == 1) {
+                ESP_LOGW(TAG, "Another leader (%08lx) on the network, followers may pick either",
+                         (unsigned long)pkt->unit_id);
+            }
+            return;
+        }
+        if (s_leader_id != 0 && s_leader_id != pkt->unit_id) {
+            s_stats.other_leaders++;
+            return;         /* Stay with the leader we have */
+        }
+        if (s_leader_id == 0) {
+            char ip[16];
+            inet_ntop(AF_INET, &from->sin_addr, ip, sizeof(ip));
+            ESP_LOGI(TAG, "Following leader %08lx at %s", (unsigned long)pkt->unit_id, ip);
+            s_leader_id = pkt->unit_id;
+            s_leader_addr = *from;
+            s_stats.leader_changes++;
+            s_burst_start_us = rx_us - (int64_t)HALO_SYNC_POLL_MS * 1000;   /* Poll now */
+            if (!s_clock.valid) {
+                /* Coarse until the first burst: off by the one-way delay */
+                clock_step(rx_us, pkt->t1 - rx_us, 0);
+            }
+        }
+        s_leader_seen_us = rx_us;
+        if (pkt->speed_pm != 0) {
+            /* Run at the leader's speed, from the leader's anchor */
+            portENTER_CRITICAL(&s_clock_lock);
+            s_anchor.t0_us = pkt->anchor_us;
+            s_anchor.pos0 = pkt->anchor_pos;
+            s_anchor.speed_pm = pkt->speed_pm;
+            s_anchor.from_leader = true;
+            portEXIT_CRITICAL(&s_clock_lock);
+        }
+    } else if (pkt->type == PKT_REQUEST && role == HALO_SYNC_LEADER) {
+        sync_packet_t reply = {
+            .type = PKT_REPLY,
+            .seq = pkt->seq,
+            .t1 = pkt->t1,
+            .t2 = rx_us,
+        };
+        send_packet(&reply, from);
+        s_stats.requests_answered++;
+    } else if (pkt->type == PKT_REPLY && role == HALO_SYNC_FOLLOWER && pkt->unit_id == s_leader_id) {
+        if ((uint16_t)(pkt->seq - s_burst_first_seq) >= (uint16_t)s_burst_sent) {
+            return;         /* Late reply from an earlier burst */
+        }
+        int64_t delay = (rx_us - pkt->t1) - (pkt->t3 - pkt->t2);
+        if (delay < 0) {
+            return;
+        }
+        if (!s_burst_has_best || delay < s_burst_best.delay_us) {
+            s_burst_best.local_us = pkt->t1 + (rx_us - pkt->t1) / 2;
+            s_burst_best.offset_us = ((pkt->t2 - pkt->t1) + (pkt->t3 - rx_us)) / 2;
+            s_burst_best.delay_us = (uint32_t)delay;
+            s_burst_has_best = true;
+        }
+    }
+}
+
+/* Send whatever is due; returns the time until the next thing is due */
+static int64_t run_timers(int64_t now)
+{
+    static int64_t next_beacon_us = 0;
+    halo_sync_role_t role = s_role;
+
+    if (role == HALO_SYNC_LEADER) {
+        if (now >= next_beacon_us) {
+            sync_packet_t beacon = { .type = PKT_BEACON, .seq = s_seq++ };
+            send_packet(&beacon, &s_group);
+            s_stats.beacons_sent++;
+            next_beacon_us = now + (int64_t)HALO_SYNC_BEACON_MS * 1000;
+        }
+        return next_beacon_us - now;
+    }
+
+    if (s_leader_id == 0) {
+        return (int64_t)HALO_SYNC_BEACON_MS * 1000;
+    }
+    if (now - s_leader_seen_us > (int64_t)HALO_SYNC_LEADER_LOST_MS * 1000) {
+        ESP_LOGW(TAG, "Leader %08lx lost, keeping its clock until one is heard",
+                 (unsigned long)s_leader_id);
+        clock_set_rate(now, s_fit.skew_ppb);    /* Drop the slew, keep the skew */
+        forget_leader();
+        return (int64_t)HALO_SYNC_BEACON_MS * 1000;
+    }
+
+    /* Burst: HALO_SYNC_BURST requests, then one more gap for the last reply */
+    int64_t due = s_burst_sent == 0 ? s_burst_start_us + (int64_t)HALO_SYNC_POLL_MS * 1000
+                                    : s_burst_start_us + (int64_t)s_burst_sent * HALO_SYNC_BURST_GAP_MS * 1000;
+    if (now < due) {
+        return due - now;
+    }
+    if (s_burst_sent == HALO_SYNC_BURST) {
+        finish_burst();
+        s_burst_sent = 0;
+        return s_burst_start_us + (int64_t)HALO_SYNC_POLL_MS * 1000 - now;
+    }
+    if (s_burst_sent == 0) {
+        s_burst_start_us = now;
+        s_burst_first_seq = s_seq;
+        s_burst_has_best = false;
+    }
+    sync_packet_t request = { .type = PKT_REQUEST, .seq = s_seq++ };
+    request.t1 = esp_timer_get_time();
+    send_packet(&request, &s_leader_addr);
+    s_burst_sent++;
+    return (int64_t)HALO_SYNC_BURST_GAP_MS * 1000;
+}
+
+static void sync_task(void *pvParameters)
+{
+    halo_sync_role_t running = HALO_SYNC_OFF;
+
+    while (1) {
+        halo_sync_role_t role = s_role;
+        if (role != running) {
+            forget_leader();
+            clock_reset();
+            running = role;
+        }
+        if (role == HALO_SYNC_OFF) {
+            socket_close();
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        if (s_sock < 0 && !socket_open()) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SYNC_RETRY_MS));
+            continue;
+        }
+
+        int64_t wait_us = run_timers(esp_timer_get_time());
+        if (s_sock < 0) {
+            continue;
+        }
+        if (wait_us < 1000) {
+            wait_us = 1000;
+        }
+        /* Wake up for a role change at least once per beacon period */
+        if (wait_us > (int64_t)HALO_SYNC_BEACON_MS * 1000) {
+            wait_us = (int64_t)HALO_SYNC_BEACON_MS * 1000;
+        }
+
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(s_sock, &readable);
+        struct timeval tv = {
+            .tv_sec = (time_t)(wait_us / 1000000),
+            .tv_usec = (suseconds_t)(wait_us % 1000000),
+        };
+        if (select(s_sock + 1, &readable, NULL, NULL, &tv) <= 0) {
+            continue;
+        }
+
+        sync_packet_t pkt;
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int len = recvfrom(s_sock, &pkt, sizeof(pkt), 0, (struct sockaddr *)&from, &from_len);
+        int64_t rx_us = esp_timer_get_time();
+        if (len != (int)sizeof(pkt) || pkt.magic != SYNC_MAGIC || pkt.version != SYNC_VERSION ||
+            pkt.unit_id == s_unit_id) {
+            continue;       /* Not ours, or our own multicast looped back */
+        }
+        handle_packet(&pkt, &from, rx_us);
+    }
+}
+
+/* ============================================================================
+   API
+   ============================================================================ */
+
+static esp_err_t start_task(void)
+{
+    if (s_task != NULL) {
+        xTaskNotifyGive(s_task);
+        return ESP_OK;
+    }
+    s_task = halo_task_create_static(HALO_TASK_SYNC, sync_task, NULL);
+    if (s_task == NULL) {
+        ESP_LOGE(TAG, "Failed to start sync task");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static const char *role_name(halo_sync_role_t role)
+{
+    switch (role) {
+        case HALO_SYNC_LEADER:   return "leader";
+        case HALO_SYNC_FOLLOWER: return "follower";
+        default:                 return "off";
+    }
+}
+
+esp_err_t halo_sync_init(void)
+{
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    s_unit_id = ((uint32_t)mac[2] << 24) | ((uint32_t)mac[3] << 16) |
+                ((uint32_t)mac[4] << 8) | mac[5];
+
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        uint8_t role = HALO_SYNC_OFF;
+        if (nvs_get_u8(nvs, NVS_KEY_ROLE, &role) == ESP_OK && role <= HALO_SYNC_FOLLOWER) {
+            s_role = (halo_sync_role_t)role;
+        }
+        nvs_close(nvs);
+    }
+    if (s_role == HALO_SYNC_OFF) {
+        return ESP_OK;
+    }
+    ESP_LOGI(TAG, "Animation sync: %s (unit %08lx)", role_name(s_role), (unsigned long)s_unit_id);
+    return start_task();
+}
+
+esp_err_t halo_sync_set_role(halo_sync_role_t role)
+{
+    if (role > HALO_SYNC_FOLLOWER) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_role = role;
+    portENTER_CRITICAL(&s_clock_lock);
+    s_anchor.from_leader = false;   /* Back to the own speed until a leader's beacon */
+    portEXIT_CRITICAL(&s_clock_lock);
+
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_set_u8(nvs, NVS_KEY_ROLE, (uint8_t)role);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    ESP_LOGI(TAG, "Animation sync: %s", role_name(role));
+    if (role == HALO_SYNC_OFF && s_task == NULL) {
+        return ESP_OK;
+    }
+    return start_task();
+}
+
+halo_sync_role_t halo_sync_get_role(void)
+{
+    return s_role;
+}
+
+bool halo_sync_active(void)
+{
+    halo_sync_role_t role = s_role;
+    return role == HALO_SYNC_LEADER || (role == HALO_SYNC_FOLLOWER && s_clock.valid);
+}
+
+void halo_sync_set_speed(uint32_t speed_pm)
+{
+    int64_t now = halo_sync_now_us();
+    portENTER_CRITICAL(&s_clock_lock);
+    bool follow = s_role == HALO_SYNC_FOLLOWER && s_anchor.from_leader;
+    if (!follow && speed_pm != s_anchor.speed_pm) {
+        s_anchor.pos0 = s_anchor.speed_pm != 0 ? anchor_at(&s_anchor, now) : now * (int64_t)speed_pm;
+        s_anchor.t0_us = now;
+        s_anchor.speed_pm = speed_pm;
+        s_anchor.from_leader = false;
+    }
+    portEXIT_CRITICAL(&s_clock_lock);
+}
+
+int64_t halo_sync_position(int64_t shared_us)
+{
+    portENTER_CRITICAL(&s_clock_lock);
+    int64_t pos = anchor_at(&s_anchor, shared_us);
+    portEXIT_CRITICAL(&s_clock_lock);
+    return pos;
+}
+
+int64_t halo_sync_now_us(void)
+{
+    int64_t now = esp_timer_get_time();
+    if (s_role != HALO_SYNC_FOLLOWER) {
+        return now;
+    }
+    portENTER_CRITICAL(&s_clock_lock);
+    int64_t shared = s_clock.valid ? clock_at(&s_clock, now) : now;
+    portEXIT_CRITICAL(&s_clock_lock);
+    return shared;
+}
+
+void halo_sync_print_status(void)
+{
+    halo_sync_role_t role = s_role;
+
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "  Role: %s (unit %08lx), socket %s", role_name(role), (unsigned long)s_unit_id,
+             s_sock >= 0 ? "open" : "closed");
+    if (role == HALO_SYNC_LEADER) {
+        ESP_LOGI(TAG, "  Beacons sent: %lu, requests answered: %lu",
+                 (unsigned long)s_stats.beacons_sent, (unsigned long)s_stats.requests_answered);
+    } else if (role == HALO_SYNC_FOLLOWER) {
+        if (s_leader_id != 0) {
+            char ip[16];
+            inet_ntop(AF_INET, &s_leader_addr.sin_addr, ip, sizeof(ip));
+            ESP_LOGI(TAG, "  Leader: %08lx at %s, beacon %lums ago", (unsigned long)s_leader_id, ip,
+                     (unsigned long)((esp_timer_get_time() - s_leader_seen_us) / 1000));
+        } else {
+            ESP_LOGI(TAG, "  Leader: none heard%s", s_clock.valid ? " (running on the last one's clock)" : "");
+        }
+        ESP_LOGI(TAG, "  Offset: %ldus, skew %+.3f ppm, last correction %ldus",
+                 (long)s_fit.offset_us, s_fit.skew_ppb / 1000.0, (long)s_fit.error_us);
+        ESP_LOGI(TAG, "  Round trip: %luus, fit residual %luus over %d samples",
+                 (unsigned long)s_fit.delay_us, (unsigned long)s_fit.residual_us, s_sample_count);
+        ESP_LOGI(TAG, "  Bursts: %lu (%lu discarded), steps %lu, leader changes %lu",
+                 (unsigned long)s_stats.bursts, (unsigned long)s_stats.bursts_discarded,
+                 (unsigned long)s_stats.steps, (unsigned long)s_stats.leader_changes);
+    }
+    ESP_LOGI(TAG, "  Speed: %lu.%03lu (%s), anchored %llds ago", (unsigned long)(s_anchor.speed_pm / 1000),
+             (unsigned long)(s_anchor.speed_pm % 1000), s_anchor.from_leader ? "leader's" : "own",
+             (long long)((halo_sync_now_us() - s_anchor.t0_us) / 1000000));
+    if (s_stats.other_leaders > 0 || s_stats.socket_errors > 0) {
+        ESP_LOGI(TAG, "  Beacons from other leaders: %lu, socket errors: %lu",
+                 (unsigned long)s_stats.other_leaders, (unsigned long)s_stats.socket_errors);
+    }
+    ESP_LOGI(TAG, "");
+}
@@ -0,0 +1,143 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Halo Sync - Shared animation clock for several Halos on one LAN
+ *
+ * Each Halo draws its effects from its own timer, so two rings showing the
+ * same effect drift apart within minutes. With sync on, one unit is the
+ * leader and the others follow its clock:
+ *
+ *   leader    multicasts a beacon with its time every HALO_SYNC_BEACON_MS
+ *             and answers time requests
+ *   follower  learns the leader from its beacons, then every
+ *             HALO_SYNC_POLL_MS sends a burst of NTP-style requests
+ *             (t1 sent, t2 leader rx, t3 leader tx, t4 received):
+ *               offset = ((t2 - t1) + (t3 - t4)) / 2
+ *               delay  = (t4 - t1) - (t3 - t2)
+ *             The request with the smallest delay in each burst is kept,
+ *             unless even that one was much slower than usual (queued
+ *             somewhere, so its offset is off). A line fitted through the
+ *             last HALO_SYNC_SAMPLES of them gives the offset and the skew
+ *             (crystal ppm) to the leader.
+ *
+ * Effect phases come from a position, speed x time, rather than from the
+ * time alone: each speed change anchors it (time, position, new speed), so
+ * the phases carry on from where they are instead of jumping. The leader's
+ * beacon carries its anchor and followers run from it, at the leader's
+ * speed.
+ *
+ * halo_sync_now_us() is the leader's esp_timer time on every unit. The
+ * follower steers towards a new estimate by running slightly fast or slow
+ * until the next poll (steps only past HALO_SYNC_STEP_US), so small
+ * corrections don't make effects stutter. Between polls it runs at the
+ * fitted skew, and keeps running on it if the leader goes away.
+ *
+ * The role is kept in NVS. All units must be on the same subnet (the
+ * multicast group is not routed). tools/sync_sim.py simulates the same
+ * estimator over a jittery network and reports the residual phase error.
+ */
+
+#ifndef HALO_SYNC_H
+#define HALO_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/* ============================================================================
+   HALO SYNC CONFIGURATION
+   ============================================================================ */
+
+#define HALO_SYNC_GROUP             "239.255.72.76"     /* Site-local multicast */
+#define HALO_SYNC_PORT              47476
+#define HALO_SYNC_BEACON_MS         1000    /* Leader beacon period */
+#define HALO_SYNC_LEADER_LOST_MS    5000    /* No beacon for this long: look for a leader again */
+#define HALO_SYNC_POLL_MS           2000    /* Follower: one burst per poll */
+#define HALO_SYNC_BURST             4       /* Requests per burst, best one kept */
+#define HALO_SYNC_BURST_GAP_MS      25
+#define HALO_SYNC_MAX_DELAY_US      30000   /* Burst discarded if even its best round trip is longer */
+#define HALO_SYNC_SAMPLES           32      /* Burst results in the offset/skew fit (~1 min) */
+#define HALO_SYNC_GATE_SLACK_US     1000    /* Kept if round trip <= 2 x recent best + this */
+#define HALO_SYNC_STEP_US           50000   /* Larger errors are stepped, smaller ones slewed */
+#define HALO_SYNC_MAX_SLEW_PPM      5000    /* 0.5% faster or slower, not visible in an effect */
+#define HALO_SYNC_MAX_SKEW_PPM      500     /* Fitted skew beyond this is a bad fit */
+
+typedef enum {
+    HALO_SYNC_OFF = 0,          /* Own clock, no traffic */
+    HALO_SYNC_LEADER,
+    HALO_SYNC_FOLLOWER,
+} halo_sync_role_t;
+
+/* ============================================================================
+   API
+   ============================================================================ */
+
+/**
+ * @brief Load the role from NVS and start the sync task if it is not off
+ *
+ * Call once NVS is up. The socket is opened (and reopened after a network
+ * loss) by the sync task itself, so WiFi need not be connected yet.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t halo_sync_init(void);
+
+/**
+ * @brief Change role, save it in NVS
+ *
+ * A follower starts from scratch: it looks for a leader and steps to its
+ * clock on the first beacon.
+ *
+ * @param role New role
+ * @return ESP_OK, or an error if the sync task could not be started
+ */
+esp_err_t halo_sync_set_role(halo_sync_role_t role);
+
+/**
+ * @brief Current role
+ */
+halo_sync_role_t halo_sync_get_role(void);
+
+/**
+ * @brief Whether effects should run on the shared clock
+ *
+ * True on the leader, and on a follower once it has heard a leader.
+ */
+bool halo_sync_active(void);
+
+/**
+ * @brief Shared time in microseconds (the leader's esp_timer time)
+ *
+ * Own esp_timer time when sync is off or no leader has been heard yet.
+ * Only jumps when a follower steps (first leader, or an error past
+ * HALO_SYNC_STEP_US). Safe from any task.
+ */
+int64_t halo_sync_now_us(void);
+
+/**
+ * @brief Animation speed set on this unit, in permille (render task)
+ *
+ * Call every frame: a change re-anchors the position at the current shared
+ * time. Ignored on a follower that has the leader's anchor.
+ *
+ * @param speed_pm Speed x 1000
+ */
+void halo_sync_set_speed(uint32_t speed_pm);
+
+/**
+ * @brief Animation position at a shared time, in speed permille x us
+ *
+ * pos = pos0 + (shared_us - t0) x speed, from the last anchor: the same on
+ * every unit following one leader, and continuous across speed changes.
+ *
+ * @param shared_us Time from halo_sync_now_us()
+ */
+int64_t halo_sync_position(int64_t shared_us);
+
+/**
+ * @brief Log role, leader, offset, skew, round trip, fit residual and speed anchor
+ */
+void halo_sync_print_status(void);
+
+#endif /* HALO_SYNC_H */
@@ -0,0 +1,635 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Halo Tasks - Central task table and starvation supervisor
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include "sdkconfig.h"
+#include "halo_metrics.h"
+#include "halo_tasks.h"
+
+static const char *TAG = "tasks";
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+#define HALO_HAVE_RUN_TIME_STATS    1
+#else
+#define HALO_HAVE_RUN_TIME_STATS    0
+#endif
+
+#define HALO_STATS_MAX_TASKS        32      /* Snapshot size for run-time stats */
+#define HALO_STATS_SAMPLE_PERIODS   10      /* Supervisor periods between CPU snapshots */
+#define HALO_STATS_TOP_N            3       /* CPU users listed on a missed deadline */
+
+/* ============================================================================
+   STATIC STORAGE (StackType_t is one byte on ESP-IDF)
+   ============================================================================ */
+
+#if CONFIG_HALO_ZIGBEE
+static StackType_t s_zigbee_stack[HALO_TASK_ZIGBEE_STACK];
+static StaticTask_t s_zigbee_tcb;
+static StackType_t s_remote_stack[HALO_TASK_REMOTE_STACK];
+static StaticTask_t s_remote_tcb;
+#define ZIGBEE_STORAGE          s_zigbee_stack, &s_zigbee_tcb
+#define REMOTE_STORAGE          s_remote_stack, &s_remote_tcb
+#else
+#define ZIGBEE_STORAGE          NULL, NULL      /* Not built, no stack reserved */
+#define REMOTE_STORAGE          NULL, NULL
+#endif
+#if CONFIG_HALO_SONGS
+static StackType_t s_melody_stack[HALO_TASK_MELODY_STACK];
+static StaticTask_t s_melody_tcb;
+#define MELODY_STORAGE          s_melody_stack, &s_melody_tcb
+#else
+#define MELODY_STORAGE          NULL, NULL
+#endif
+static StackType_t s_supervisor_stack[HALO_TASK_SUPERVISOR_STACK];
+static StaticTask_t s_supervisor_tcb;
+#if CONFIG_HALO_ZIGBEE_CAPTURE
+static StackType_t s_zb_capture_stack[HALO_TASK_ZB_CAPTURE_STACK];
+static StaticTask_t s_zb_capture_tcb;
+#define ZB_CAPTURE_STORAGE      s_zb_capture_stack, &s_zb_capture_tcb
+#else
+#define ZB_CAPTURE_STORAGE      NULL, NULL
+#endif
+#if CONFIG_HALO_SYNC
+static StackType_t s_sync_stack[HALO_TASK_SYNC_STACK];
+static StaticTask_t s_sync_tcb;
+#define SYNC_STORAGE            s_sync_stack, &s_sync_tcb
+#else
+#define SYNC_STORAGE            NULL, NULL
+#endif
+static StackType_t s_console_stack[HALO_TASK_CONSOLE_STACK];
+static StaticTask_t s_console_tcb;
+static StackType_t s_ota_stack[HALO_TASK_OTA_STACK];
+static StaticTask_t s_ota_tcb;
+
+typedef struct {
+    halo_job_fn_t fn;
+    void *arg;
+} halo_job_t;
+
+static StaticQueue_t s_job_queue_buf;
+static uint8_t s_job_queue_storage[HALO_JOB_QUEUE_LEN * sizeof(halo_job_t)];
+static QueueHandle_t s_job_queue = NULL;
+
+/* uxTaskGetSystemState() snapshots for the status commands (command handler only) */
+#if HALO_HAVE_RUN_TIME_STATS
+static TaskStatus_t s_report_buf[HALO_STATS_MAX_TASKS * 2];
+#endif
+
+/* ============================================================================
+   TASK TABLE
+   ============================================================================ */
+
+typedef struct {
+    const char *name;           /* FreeRTOS task name */
+    UBaseType_t priority;
+    uint32_t stack_size;        /* Bytes, 0 = owned by someone else */
+    BaseType_t core;
+    uint32_t heartbeat_ms;      /* Deadline between heartbeats, 0 = not supervised */
+    StackType_t *stack;         /* Static storage, NULL = not created from the table */
+    StaticTask_t *tcb;
+} halo_task_def_t;
+
+static const halo_task_def_t s_task_table[HALO_TASK_COUNT] = {
+    [HALO_TASK_RENDER] = {
+        "main", HALO_TASK_RENDER_PRIO, CONFIG_ESP_MAIN_TASK_STACK_SIZE, tskNO_AFFINITY,
+        HALO_TASK_RENDER_HEARTBEAT_MS, NULL, NULL,
+    },
+    [HALO_TASK_ZIGBEE] = {
+        "zigbee_main", HALO_TASK_ZIGBEE_PRIO, HALO_TASK_ZIGBEE_STACK, tskNO_AFFINITY,
+        HALO_TASK_ZIGBEE_HEARTBEAT_MS, ZIGBEE_STORAGE,
+    },
+    [HALO_TASK_MELODY] = {
+        "melody_task", HALO_TASK_MELODY_PRIO, HALO_TASK_MELODY_STACK, tskNO_AFFINITY,
+        0, MELODY_STORAGE,
+    },
+    [HALO_TASK_MQTT] = {
+        "mqtt_task", HALO_TASK_MQTT_PRIO, HALO_TASK_MQTT_STACK, tskNO_AFFINITY,
+        0, NULL, NULL,
+    },
+    [HALO_TASK_CHIP] = {
+        "CHIP", 0, CONFIG_CHIP_TASK_STACK_SIZE, tskNO_AFFINITY,
+        0, NULL, NULL,
+    },
+    [HALO_TASK_OTA] = {
+        "ota_jobs", HALO_TASK_OTA_PRIO, HALO_TASK_OTA_STACK, tskNO_AFFINITY,
+        0, s_ota_stack, &s_ota_tcb,
+    },
+    [HALO_TASK_SUPERVISOR] = {
+        "supervisor", HALO_TASK_SUPERVISOR_PRIO, HALO_TASK_SUPERVISOR_STACK, tskNO_AFFINITY,
+        0, s_supervisor_stack, &s_supervisor_tcb,
+    },
+    [HALO_TASK_ZB_CAPTURE] = {
+        "zb_capture", HALO_TASK_ZB_CAPTURE_PRIO, HALO_TASK_ZB_CAPTURE_STACK, tskNO_AFFINITY,
+        0, ZB_CAPTURE_STORAGE,
+    },
+    [HALO_TASK_CONSOLE] = {
+        "console", HALO_TASK_CONSOLE_PRIO, HALO_TASK_CONSOLE_STACK, tskNO_AFFINITY,
+        0, s_console_stack, &s_console_tcb,
+    },
+    [HALO_TASK_SYNC] = {
+        "halo_sync", HALO_TASK_SYNC_PRIO, HALO_TASK_SYNC_STACK, tskNO_AFFINITY,
+        0, SYNC_STORAGE,
+    },
+    [HALO_TASK_REMOTE] = {
+        "zb_remote", HALO_TASK_REMOTE_PRIO, HALO_TASK_REMOTE_STACK, tskNO_AFFINITY,
+        0, REMOTE_STORAGE,
+    },
+};
+
+/* ============================================================================
+   RUNTIME STATE
+   ============================================================================ */
+
+typedef struct {
+    TaskHandle_t handle;
+    volatile int64_t last_heartbeat_us;     /* 0 = supervision not armed yet */
+    int64_t armed_us;                       /* halo_task_arm(): waiting for the first heartbeat */
+    int64_t first_due_us;                   /* 0 = not armed before the first heartbeat */
+    bool overdue;                           /* Currently past its deadline */
+    int64_t overdue_since_us;
+    uint32_t missed;                        /* Deadlines missed since boot */
+} halo_task_state_t;
+
+static halo_task_state_t s_state[HALO_TASK_COUNT];
+
+static uint32_t s_render_frames = 0;
+static uint32_t s_render_overruns = 0;
+static metrics_histogram_t s_render_work = METRICS_HISTOGRAM_INIT("render_work", "us");
+static metrics_histogram_t s_task_stall = METRICS_HISTOGRAM_INIT("task_stall", "ms");
+
+/* Last frames of the render loop, written by the render task only */
+typedef struct {
+    int64_t end_us;
+    uint32_t work_us;
+    uint32_t budget_us;
+} frame_trace_t;
+
+static frame_trace_t s_frame_trace[HALO_TRACE_FRAMES];
+
+static esp_timer_handle_t s_timer_probe = NULL;
+static int64_t s_timer_probe_due_us = 0;
+static uint32_t s_timer_lag_max_us = 0;
+static metrics_histogram_t s_timer_lag = METRICS_HISTOGRAM_INIT("esp_timer_lag", "us");
+
+#if HALO_HAVE_RUN_TIME_STATS
+/* Run-time counters from the last snapshot, used to get CPU share per window */
+typedef struct {
+    TaskHandle_t handle;
+    configRUN_TIME_COUNTER_TYPE counter;
+} cpu_sample_t;
+
+static cpu_sample_t s_cpu_prev[HALO_STATS_MAX_TASKS];
+static UBaseType_t s_cpu_prev_count = 0;
+static configRUN_TIME_COUNTER_TYPE s_cpu_prev_total = 0;
+static TaskStatus_t s_status_buf[HALO_STATS_MAX_TASKS];     /* Supervisor task only */
+#endif
+
+/* ============================================================================
+   CREATION
+   ============================================================================ */
+
+TaskHandle_t halo_task_create_static(halo_task_id_t id, TaskFunction_t fn, void *arg)
+{
+    if (id >= HALO_TASK_COUNT || s_task_table[id].stack == NULL || s_state[id].handle != NULL) {
+        return NULL;
+    }
+    const halo_task_def_t *def = &s_task_table[id];
+    TaskHandle_t handle = xTaskCreateStaticPinnedToCore(fn, def->name, def->stack_size, arg,
+                                                        def->priority, def->stack, def->tcb,
+                                                        def->core);
+    s_state[id].handle = handle;
+    return handle;
+}
+
+void halo_task_adopt_current(halo_task_id_t id)
+{
+    if (id >= HALO_TASK_COUNT) {
+        return;
+    }
+    s_state[id].handle = xTaskGetCurrentTaskHandle();
+    if (s_task_table[id].priority > 0) {
+        vTaskPrioritySet(NULL, s_task_table[id].priority);
+    }
+}
+
+/* ============================================================================
+   HEARTBEATS
+   ============================================================================ */
+
+void halo_task_heartbeat(halo_task_id_t id)
+{
+    if (id < HALO_TASK_COUNT) {
+        s_state[id].last_heartbeat_us = esp_timer_get_time();
+    }
+}
+
+void halo_task_arm(halo_task_id_t id, uint32_t first_within_ms)
+{
+    if (id < HALO_TASK_COUNT && s_task_table[id].heartbeat_ms > 0) {
+        s_state[id].armed_us = esp_timer_get_time();
+        s_state[id].first_due_us = s_state[id].armed_us + (int64_t)first_within_ms * 1000;
+    }
+}
+
+void halo_task_render_frame(uint32_t work_us, uint32_t budget_us)
+{
+    s_state[HALO_TASK_RENDER].last_heartbeat_us = esp_timer_get_time();
+    frame_trace_t *trace = &s_frame_trace[s_render_frames % HALO_TRACE_FRAMES];
+    trace->end_us = s_state[HALO_TASK_RENDER].last_heartbeat_us;
+    trace->work_us = work_us;
+    trace->budget_us = budget_us;
+    s_render_frames++;
+    if (work_us > budget_us) {
+        s_render_overruns++;
+    }
+    metrics_hist_record(&s_render_work, work_us);
+}
+
+void halo_task_render_counts(uint32_t *frames, uint32_t *overruns)
+{
+    if (frames) {
+        *frames = s_render_frames;
+    }
+    if (overruns) {
+        *overruns = s_render_overruns;
+    }
+}
+
+/* ============================================================================
+   RUN-TIME STATS
+   ============================================================================ */
+
+#if HALO_HAVE_RUN_TIME_STATS
+static configRUN_TIME_COUNTER_TYPE cpu_prev_counter(TaskHandle_t handle)
+{
+    for (UBaseType_t i = 0; i < s_cpu_prev_count; i++) {
+        if (s_cpu_prev[i].handle == handle) {
+            return s_cpu_prev[i].counter;
+        }
+    }
+    return 0;
+}
+
+/* Take a new snapshot; optionally log the top CPU users since the previous one */
+static void cpu_sample(bool report)
+{
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t n = uxTaskGetSystemState(s_status_buf, HALO_STATS_MAX_TASKS, &total);
+    configRUN_TIME_COUNTER_TYPE window = total - s_cpu_prev_total;
+
+    if (report && window > 0) {
+        /* Partial selection sort - only the top few are printed */
+        bool used[HALO_STATS_MAX_TASKS] = { 0 };
+        ESP_LOGW(TAG, "  CPU since last sample (%lu ms):",
+                 (unsigned long)(window / (configRUN_TIME_COUNTER_TYPE)1000));
+        for (int rank = 0; rank < HALO_STATS_TOP_N; rank++) {
+            int best = -1;
+            configRUN_TIME_COUNTER_TYPE best_delta = 0;
+            for (UBaseType_t i = 0; i < n; i++) {
+                configRUN_TIME_COUNTER_TYPE delta =
+                    s_status_buf[i].ulRunTimeCounter - cpu_prev_counter(s_status_buf[i].xHandle);
+                if (!used[i] && (best < 0 || delta > best_delta)) {
+                    best = (int)i;
+                    best_delta = delta;
+                }
+            }
+            if (best < 0) {
+                break;
+            }
+            used[best] = true;
+            const TaskStatus_t *t = &s_status_buf[best];
+            ESP_LOGW(TAG, "    %-16s prio %2u  %3lu%%  stack free %5lu B",
+                     t->pcTaskName, (unsigned)t->uxCurrentPriority,
+                     (unsigned long)((uint64_t)best_delta * 100 / window),
+                     (unsigned long)t->usStackHighWaterMark);
+        }
+    }
+
+    for (UBaseType_t i = 0; i < n; i++) {
+        s_cpu_prev[i].handle = s_status_buf[i].xHandle;
+        s_cpu_prev[i].counter = s_status_buf[i].ulRunTimeCounter;
+    }
+    s_cpu_prev_count = n;
+    s_cpu_prev_total = total;
+}
+#endif
+
+static const char *task_state_to_string(eTaskState state)
+{
+    switch (state) {
+        case eRunning:   return "running";
+        case eReady:     return "ready";
+        case eBlocked:   return "blocked";
+        case eSuspended: return "suspended";
+        case eDeleted:   return "deleted";
+        default:         return "?";
+    }
+}
+
+/* ============================================================================
+   SUPERVISOR
+   ============================================================================ */
+
+static void report_overdue(halo_task_id_t id, uint32_t silent_ms, uint32_t deadline_ms)
+{
+    const halo_task_def_t *def = &s_task_table[id];
+    TaskHandle_t handle = s_state[id].handle;
+
+    ESP_LOGW(TAG, "");
+    ESP_LOGW(TAG, "╔══════════════════════════════════════════════════════════╗");
+    ESP_LOGW(TAG, "║  ⏱️  MISSED DEADLINE: %-16s                   ║", def->name);
+    ESP_LOGW(TAG, "╚══════════════════════════════════════════════════════════╝");
+    ESP_LOGW(TAG, "  No heartbeat for %lums (deadline %lums, missed %lu so far)",
+             (unsigned long)silent_ms, (unsigned long)deadline_ms,
+             (unsigned long)s_state[id].missed);
+    if (handle != NULL) {
+        ESP_LOGW(TAG, "  %s is %s at prio %u, stack free %lu B", def->name,
+                 task_state_to_string(eTaskGetState(handle)),
+                 (unsigned)uxTaskPriorityGet(handle),
+                 (unsigned long)uxTaskGetStackHighWaterMark(handle));
+    }
+    if (id == HALO_TASK_RENDER) {
+        ESP_LOGW(TAG, "  Render: %lu/%lu frames over budget",
+                 (unsigned long)s_render_overruns, (unsigned long)s_render_frames);
+    }
+#if HALO_HAVE_RUN_TIME_STATS
+    cpu_sample(true);
+#else
+    ESP_LOGW(TAG, "  (enable CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS to see who held the CPU)");
+#endif
+}
+
+static void supervisor_task(void *pvParameters)
+{
+    uint32_t ticks = 0;
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (1) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(HALO_SUPERVISOR_PERIOD_MS));
+        int64_t now = esp_timer_get_time();
+
+        for (int id = 0; id < HALO_TASK_COUNT; id++) {
+            const halo_task_def_t *def = &s_task_table[id];
+            halo_task_state_t *st = &s_state[id];
+            int64_t last = st->last_heartbeat_us;
+            if (def->heartbeat_ms == 0) {
+                continue;
+            }
+            if (last == 0) {
+                /* Armed before its loop started: the first heartbeat is late */
+                if (st->first_due_us != 0 && !st->overdue && now > st->first_due_us) {
+                    st->overdue = true;
+                    st->overdue_since_us = st->armed_us;
+                    st->missed++;
+                    report_overdue((halo_task_id_t)id, (uint32_t)((now - st->armed_us) / 1000),
+                                   (uint32_t)((st->first_due_us - st->armed_us) / 1000));
+                }
+                continue;
+            }
+            uint32_t silent_ms = (uint32_t)((now - last) / 1000);
+
+            if (!st->overdue && silent_ms > def->heartbeat_ms) {
+                st->overdue = true;
+                st->overdue_since_us = last;
+                st->missed++;
+                report_overdue((halo_task_id_t)id, silent_ms, def->heartbeat_ms);
+            } else if (st->overdue && silent_ms <= def->heartbeat_ms) {
+                uint32_t stall_ms = (uint32_t)((last - st->overdue_since_us) / 1000);
+                st->overdue = false;
+                metrics_hist_record(&s_task_stall, stall_ms);
+                ESP_LOGW(TAG, "%s recovered after a %lums stall", def->name, (unsigned long)stall_ms);
+            }
+        }
+
+#if HALO_HAVE_RUN_TIME_STATS
+        if (++ticks % HALO_STATS_SAMPLE_PERIODS == 0) {
+            cpu_sample(false);
+        }
+#else
+        (void)ticks;
+#endif
+    }
+}
+
+/* esp_timer task. A periodic timer's alarms stay on the original grid even
+   when one fires late, so the due time simply advances by one period. */
+static void timer_probe_cb(void *arg)
+{
+    int64_t lag = esp_timer_get_time() - s_timer_probe_due_us;
+    s_timer_probe_due_us += HALO_TIMER_PROBE_PERIOD_MS * 1000LL;
+
+    uint32_t lag_us = lag > 0 ? (uint32_t)lag : 0;
+    if (lag_us > s_timer_lag_max_us) {
+        s_timer_lag_max_us = lag_us;
+    }
+    metrics_hist_record(&s_timer_lag, lag_us);
+}
+
+static void timer_probe_start(void)
+{
+    esp_timer_create_args_t args = {
+        .callback = timer_probe_cb,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "timer_probe",
+    };
+    if (esp_timer_create(&args, &s_timer_probe) != ESP_OK) {
+        ESP_LOGW(TAG, "esp_timer lag probe not started");
+        return;
+    }
+    s_timer_probe_due_us = esp_timer_get_time() + HALO_TIMER_PROBE_PERIOD_MS * 1000LL;
+    esp_timer_start_periodic(s_timer_probe, HALO_TIMER_PROBE_PERIOD_MS * 1000ULL);
+}
+
+esp_err_t halo_supervisor_start(void)
+{
+    if (halo_task_create_static(HALO_TASK_SUPERVISOR, supervisor_task, NULL) == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer_probe_start();
+    ESP_LOGI(TAG, "Supervisor started (period %dms)", HALO_SUPERVISOR_PERIOD_MS);
+    return ESP_OK;
+}
+
+/* ============================================================================
+   BACKGROUND JOBS
+   ============================================================================ */
+
+static void job_task(void *pvParameters)
+{
+    halo_job_t job;
+    while (1) {
+        if (xQueueReceive(s_job_queue, &job, portMAX_DELAY) == pdTRUE) {
+            job.fn(job.arg);
+        }
+    }
+}
+
+esp_err_t halo_jobs_start(void)
+{
+    if (s_job_queue != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_job_queue = xQueueCreateStatic(HALO_JOB_QUEUE_LEN, sizeof(halo_job_t),
+                                     s_job_queue_storage, &s_job_queue_buf);
+    if (halo_task_create_static(HALO_TASK_OTA, job_task, NULL) == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t halo_job_submit(halo_job_fn_t fn, void *arg)
+{
+    if (s_job_queue == NULL || fn == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    halo_job_t job = { .fn = fn, .arg = arg };
+    return xQueueSend(s_job_queue, &job, 0) == pdTRUE ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+/* ============================================================================
+   STATUS
+   ============================================================================ */
+
+void halo_tasks_print_stats(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "╔══════════════════════════════════════════════════════════╗");
+    ESP_LOGI(TAG, "║  🧵 TASKS                                                ║");
+    ESP_LOGI(TAG, "╚══════════════════════════════════════════════════════════╝");
+    ESP_LOGI(TAG, "  %-12s %4s %6s %6s %9s %6s", "task", "prio", "stack", "free", "heartbeat", "missed");
+    for (int id = 0; id < HALO_TASK_COUNT; id++) {
+        const halo_task_def_t *def = &s_task_table[id];
+        const halo_task_state_t *st = &s_state[id];
+        TaskHandle_t handle = st->handle != NULL ? st->handle : xTaskGetHandle(def->name);
+
+        char age[12] = "-";
+        if (def->heartbeat_ms > 0 && st->last_heartbeat_us != 0) {
+            snprintf(age, sizeof(age), "%lums",
+                     (unsigned long)((now - st->last_heartbeat_us) / 1000));
+        }
+        if (handle == NULL) {
+            ESP_LOGI(TAG, "  %-12s %4u %6lu %6s %9s %6lu", def->name, (unsigned)def->priority,
+                     (unsigned long)def->stack_size, "-", age, (unsigned long)st->missed);
+        } else {
+            ESP_LOGI(TAG, "  %-12s %4u %6lu %6lu %9s %6lu", def->name,
+                     (unsigned)uxTaskPriorityGet(handle), (unsigned long)def->stack_size,
+                     (unsigned long)uxTaskGetStackHighWaterMark(handle), age,
+                     (unsigned long)st->missed);
+        }
+    }
+    ESP_LOGI(TAG, "  Render: %lu frames, %lu over budget, work p50=%luus p99=%luus",
+             (unsigned long)s_render_frames, (unsigned long)s_render_overruns,
+             (unsigned long)metrics_hist_percentile(&s_render_work, 50),
+             (unsigned long)metrics_hist_percentile(&s_render_work, 99));
+    if (s_timer_lag.count > 0) {
+        ESP_LOGI(TAG, "  esp_timer dispatch lag: p50=%luus p99=%luus max=%luus",
+                 (unsigned long)metrics_hist_percentile(&s_timer_lag, 50),
+                 (unsigned long)metrics_hist_percentile(&s_timer_lag, 99),
+                 (unsigned long)s_timer_lag_max_us);
+    }
+
+#if HALO_HAVE_RUN_TIME_STATS
+    /* Whole-system CPU share since boot */
+    TaskStatus_t *status = s_report_buf;
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t n = uxTaskGetSystemState(status, HALO_STATS_MAX_TASKS, &total);
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "  %-16s %4s %9s %5s %6s", "all tasks", "prio", "state", "cpu", "free");
+    for (UBaseType_t i = 0; i < n && total > 0; i++) {
+        ESP_LOGI(TAG, "  %-16s %4u %9s %4lu%% %6lu", status[i].pcTaskName,
+                 (unsigned)status[i].uxCurrentPriority,
+                 task_state_to_string(status[i].eCurrentState),
+                 (unsigned long)((uint64_t)status[i].ulRunTimeCounter * 100 / total),
+                 (unsigned long)status[i].usStackHighWaterMark);
+    }
+#endif
+    ESP_LOGI(TAG, "");
+}
+
+void halo_tasks_print_top(uint32_t window_ms)
+{
+#if HALO_HAVE_RUN_TIME_STATS
+    TaskStatus_t *before = s_report_buf;
+    TaskStatus_t *after = before + HALO_STATS_MAX_TASKS;
+    configRUN_TIME_COUNTER_TYPE total_before = 0;
+    configRUN_TIME_COUNTER_TYPE total_after = 0;
+
+    UBaseType_t n_before = uxTaskGetSystemState(before, HALO_STATS_MAX_TASKS, &total_before);
+    vTaskDelay(pdMS_TO_TICKS(window_ms));
+    UBaseType_t n = uxTaskGetSystemState(after, HALO_STATS_MAX_TASKS, &total_after);
+    configRUN_TIME_COUNTER_TYPE window = total_after - total_before;
+
+    /* Turn the second snapshot's counters into deltas; tasks created in the window count from 0 */
+    for (UBaseType_t i = 0; i < n; i++) {
+        for (UBaseType_t j = 0; j < n_before; j++) {
+            if (before[j].xHandle == after[i].xHandle) {
+                after[i].ulRunTimeCounter -= before[j].ulRunTimeCounter;
+                break;
+            }
+        }
+    }
+
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "  top - CPU over %lums", (unsigned long)window_ms);
+    ESP_LOGI(TAG, "  %-16s %4s %9s %5s %6s", "task", "prio", "state", "cpu", "free");
+    for (UBaseType_t rank = 0; rank < n && window > 0; rank++) {
+        /* Selection sort in place, busiest first */
+        UBaseType_t best = rank;
+        for (UBaseType_t i = rank + 1; i < n; i++) {
+            if (after[i].ulRunTimeCounter > after[best].ulRunTimeCounter) {
+                best = i;
+            }
+        }
+        TaskStatus_t t = after[best];
+        after[best] = after[rank];
+        after[rank] = t;
+        ESP_LOGI(TAG, "  %-16s %4u %9s %4lu%% %6lu", t.pcTaskName,
+                 (unsigned)t.uxCurrentPriority, task_state_to_string(t.eCurrentState),
+                 (unsigned long)((uint64_t)t.ulRunTimeCounter * 100 / window),
+                 (unsigned long)t.usStackHighWaterMark);
+    }
+    ESP_LOGI(TAG, "");
+#else
+    (void)window_ms;
+    ESP_LOGW(TAG, "top needs CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS");
+#endif
+}
+
+void halo_tasks_trace_dump(void)
+{
+    /* Copy first: the render task keeps writing while we log */
+    static frame_trace_t trace[HALO_TRACE_FRAMES];
+    uint32_t frames = s_render_frames;
+    memcpy(trace, s_frame_trace, sizeof(trace));
+
+    uint32_t count = frames < HALO_TRACE_FRAMES ? frames : HALO_TRACE_FRAMES;
+    uint32_t first = frames - count;
+
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "  Render trace - last %lu frames (period = time since previous frame end)",
+             (unsigned long)count);
+    ESP_LOGI(TAG, "  %8s %10s %8s %8s %8s", "frame", "end_ms", "period", "work", "budget");
+    for (uint32_t f = first; f < frames; f++) {
+        const frame_trace_t *t = &trace[f % HALO_TRACE_FRAMES];
+        const frame_trace_t *prev = &trace[(f - 1) % HALO_TRACE_FRAMES];
+        char period[12] = "-";
+        if (f > first) {
+            snprintf(period, sizeof(period), "%luus", (unsigned long)(t->end_us - prev->end_us));
+        }
+        ESP_LOGI(TAG, "  %8lu %10lu %8s %6luus %6luus%s", (unsigned long)f,
+                 (unsigned long)(t->end_us / 1000), period, (unsigned long)t->work_us,
+                 (unsigned long)t->budget_us, t->work_us > t->budget_us ? "  OVER" : "");
+    }
+    ESP_LOGI(TAG, "");
+}
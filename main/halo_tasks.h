@@ -0,0 +1,229 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Halo Tasks - Central task table and starvation supervisor
+ *
+ * Every task the firmware creates or tunes is listed here with its priority,
+ * stack and core affinity, so the whole topology can be read in one place.
+ * Halo's own tasks are created from static buffers. One-off background work
+ * (OTA downloads) runs as a job on a single long-lived task instead of a
+ * task created and deleted per download.
+ *
+ * Supervised tasks call halo_task_heartbeat() from their loop. A supervisor
+ * task, running above everything else, flags any task whose heartbeat is
+ * overdue (render loop stalled, Zigbee stack stalled) and logs which tasks
+ * used the CPU during that window, taken from FreeRTOS run-time stats.
+ *
+ * A periodic esp_timer probe measures how late the shared esp_timer task
+ * dispatches callbacks. Any callback that blocks or logs heavily there
+ * delays every other timer in the system, and shows up as lag.
+ */
+
+#ifndef HALO_TASKS_H
+#define HALO_TASKS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/* ============================================================================
+   TASK TABLE
+   ============================================================================
+   Priorities (higher runs first, ESP-IDF's own tasks shown for reference):
+     23  wifi                    (IDF)
+     22  esp_timer               (IDF)
+     20  sys_evt                 (IDF default event loop)
+     18  tiT                     (IDF lwIP)
+     12  supervisor              - must outrank anything it watches
+      7  halo_sync               - timestamps clock-sync packets, asleep otherwise
+      6  melody                  - short bursts, note timing is audible
+      5  zigbee_main, mqtt_task, zb_remote
+      4  render (main task)      - 60 FPS ring animation
+      2  CHIP                    (Matter, set via CONFIG_CHIP_TASK_PRIORITY)
+      2  zb_capture              - drains the 802.15.4 capture ring over UDP
+      1  ota_jobs                - background downloads, may take minutes
+      1  console                 - serial REPL, runs the shared command handler
+   Stacks are in bytes. The ESP32-C6 has a single core, so every task uses
+   tskNO_AFFINITY; the column is kept for dual-core targets.
+   ============================================================================ */
+
+#define HALO_TASK_RENDER_PRIO           4
+#define HALO_TASK_RENDER_HEARTBEAT_MS   1000    /* Button handling may hold a frame ~0.5s */
+#define HALO_TASK_RENDER_BOOT_MS        180000  /* First frame due: WiFi wait up to DEGRADED + 60s Zigbee finder */
+
+#define HALO_TASK_ZIGBEE_PRIO           5
+#define HALO_TASK_ZIGBEE_STACK          8192
+#define HALO_TASK_ZIGBEE_HEARTBEAT_MS   2000
+#define HALO_ZIGBEE_HEARTBEAT_PERIOD_MS 500     /* Scheduler alarm in the Zigbee task */
+
+#define HALO_TASK_MELODY_PRIO           6
+#define HALO_TASK_MELODY_STACK          4096
+
+#define HALO_TASK_MQTT_PRIO             5
+#define HALO_TASK_MQTT_STACK            6144
+
+#define HALO_TASK_OTA_PRIO              1
+#define HALO_TASK_OTA_STACK             6144
+#define HALO_JOB_QUEUE_LEN              2       /* Firmware OTA + Zigbee OTA fetch */
+
+#define HALO_TASK_SUPERVISOR_PRIO       12
+#define HALO_TASK_SUPERVISOR_STACK      3072
+#define HALO_SUPERVISOR_PERIOD_MS       100
+
+#define HALO_TASK_ZB_CAPTURE_PRIO       2
+#define HALO_TASK_ZB_CAPTURE_STACK      3072
+
+#define HALO_TASK_SYNC_PRIO             7       /* Scheduling delay shows up as clock error */
+#define HALO_TASK_SYNC_STACK            3072
+
+#define HALO_TASK_REMOTE_PRIO           5       /* Above render: a press shows up on the next frame */
+#define HALO_TASK_REMOTE_STACK          6144    /* Same as mqtt_task: runs the same handler */
+
+#define HALO_TASK_CONSOLE_PRIO          1
+#define HALO_TASK_CONSOLE_STACK         6144    /* Same as mqtt_task: runs the same handler */
+
+#define HALO_TIMER_PROBE_PERIOD_MS      50      /* esp_timer dispatch lag probe */
+#define HALO_TRACE_FRAMES               64      /* Render frames kept for trace:dump */
+
+typedef enum {
+    HALO_TASK_RENDER = 0,       /* app_main, turned into the render loop */
+    HALO_TASK_ZIGBEE,           /* "zigbee_main" - ZBOSS main loop */
+    HALO_TASK_MELODY,           /* "melody_task" - RTTTL playback */
+    HALO_TASK_MQTT,             /* "mqtt_task" - created by esp-mqtt */
+    HALO_TASK_CHIP,             /* "CHIP" - created by esp_matter */
+    HALO_TASK_OTA,              /* "ota_jobs" - runs halo_job_submit() work */
+    HALO_TASK_SUPERVISOR,       /* "supervisor" */
+    HALO_TASK_ZB_CAPTURE,       /* "zb_capture" - created on first zbcap:udp */
+    HALO_TASK_CONSOLE,          /* "console" - serial REPL */
+    HALO_TASK_SYNC,             /* "halo_sync" - created when sync is turned on */
+    HALO_TASK_REMOTE,           /* "zb_remote" - runs Zigbee remote button commands */
+    HALO_TASK_COUNT,
+} halo_task_id_t;
+
+/* ============================================================================
+   CREATION
+   ============================================================================ */
+
+/**
+ * @brief Create a table task from its static stack and TCB
+ *
+ * Only for long-lived tasks that never delete themselves (zigbee, melody,
+ * supervisor). A static stack can't be reused safely after vTaskDelete(),
+ * so one-off work goes through halo_job_submit() instead.
+ *
+ * @param id Task table entry
+ * @param fn Task function
+ * @param arg Task argument
+ * @return Task handle, NULL if the entry has no static storage or already exists
+ */
+TaskHandle_t halo_task_create_static(halo_task_id_t id, TaskFunction_t fn, void *arg);
+
+/**
+ * @brief Adopt the calling task as a table entry and apply its priority
+ *
+ * Used for the main task, which ESP-IDF creates before app_main().
+ */
+void halo_task_adopt_current(halo_task_id_t id);
+
+/* ============================================================================
+   SUPERVISION
+   ============================================================================ */
+
+/**
+ * @brief Start the supervisor task and the esp_timer lag probe
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t halo_supervisor_start(void);
+
+/**
+ * @brief Report that a supervised task is alive
+ *
+ * The first heartbeat arms supervision for that task. Safe from any task.
+ */
+void halo_task_heartbeat(halo_task_id_t id);
+
+/**
+ * @brief Supervise a task before its first heartbeat
+ *
+ * Without this, supervision starts at the first heartbeat, so a task that
+ * hangs before its loop is never reported. Reported once if no heartbeat
+ * arrives within first_within_ms.
+ *
+ * @param id Task table entry (must have a heartbeat deadline)
+ * @param first_within_ms Time allowed until the first heartbeat
+ */
+void halo_task_arm(halo_task_id_t id, uint32_t first_within_ms);
+
+/**
+ * @brief Report one render frame: CPU time spent drawing vs the frame budget
+ *
+ * Also counts as the render heartbeat.
+ *
+ * @param work_us Time from frame start to just before the frame delay
+ * @param budget_us Frame period the animation is aiming for
+ */
+void halo_task_render_frame(uint32_t work_us, uint32_t budget_us);
+
+/* ============================================================================
+   BACKGROUND JOBS
+   ============================================================================ */
+
+/**
+ * @brief Function run on the job task
+ *
+ * May block for as long as it needs (downloads); jobs run one at a time.
+ */
+typedef void (*halo_job_fn_t)(void *arg);
+
+/**
+ * @brief Create the job task (HALO_TASK_OTA) and its queue
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE if already started
+ */
+esp_err_t halo_jobs_start(void);
+
+/**
+ * @brief Queue a job for the job task
+ *
+ * @param fn Job function
+ * @param arg Passed to fn
+ * @return ESP_OK, ESP_ERR_INVALID_STATE before halo_jobs_start(), ESP_ERR_NO_MEM if the queue is full
+ */
+esp_err_t halo_job_submit(halo_job_fn_t fn, void *arg);
+
+/* ============================================================================
+   STATUS
+   ============================================================================ */
+
+/**
+ * @brief Render frames and overruns since boot (for before/after comparisons)
+ *
+ * @param frames Frames reported so far (may be NULL)
+ * @param overruns Frames whose work exceeded their budget (may be NULL)
+ */
+void halo_task_render_counts(uint32_t *frames, uint32_t *overruns);
+
+/**
+ * @brief Log the task table, missed deadlines, frame overruns, esp_timer lag and per-task CPU/stack
+ */
+void halo_tasks_print_stats(void);
+
+/**
+ * @brief Measure CPU share per task over a window and log it, busiest first
+ *
+ * Blocks the caller for the window.
+ *
+ * @param window_ms Measurement window
+ */
+void halo_tasks_print_top(uint32_t window_ms);
+
+/**
+ * @brief Log the last HALO_TRACE_FRAMES render frames: period, work time, budget
+ */
+void halo_tasks_trace_dump(void);
+
+#endif /* HALO_TASKS_H */
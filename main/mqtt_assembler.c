@@ -0,0 +1,317 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * MQTT Assembler - Reassembly of fragmented MQTT messages, per topic
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "mqtt_assembler.h"
+
+static const char *TAG = "mqtt_asm";
+
+#define ASSET_MAGIC         0x54534148      /* "HAST" */
+
+/* First bytes of the asset partition, written once the upload is complete */
+typedef struct {
+    uint32_t magic;
+    uint32_t size;              /* Data bytes from MQTT_ASSET_DATA_OFFSET */
+    uint32_t crc32;             /* esp_rom_crc32_le(0, data, size) */
+    uint32_t seq;               /* Uploads stored so far */
+} asset_header_t;
+
+typedef enum {
+    ROUTE_NONE = 0,             /* No message in progress */
+    ROUTE_COMMAND,
+    ROUTE_ASSET,
+    ROUTE_DROP,                 /* Rest of a refused message */
+} route_t;
+
+static const char *s_command_topic = NULL;
+static const char *s_asset_topic = NULL;
+static mqtt_assembler_command_fn s_on_command = NULL;
+static const esp_partition_t *s_partition = NULL;
+
+/* Message in progress (only the MQTT task touches these) */
+static route_t s_route = ROUTE_NONE;
+static int s_total = 0;
+static int s_received = 0;
+static uint32_t s_erased = 0;           /* Asset bytes erased ahead, from MQTT_ASSET_DATA_OFFSET */
+static uint32_t s_crc = 0;
+static int64_t s_start_us = 0;
+static char s_buf[MQTT_ASSEMBLY_MAX_LEN];
+
+static asset_header_t s_asset;          /* Last complete asset, magic 0 if none */
+
+static struct {
+    uint32_t single;                    /* Messages that came in one event */
+    uint32_t reassembled;               /* Messages put back together */
+    uint32_t fragments;                 /* Events that were part of a larger message */
+    uint32_t too_large;                 /* Refused: over the limit for their topic */
+    uint32_t broken;                    /* Gap in the offsets, disconnect or flash error */
+    uint32_t unknown_topic;
+    uint32_t largest;                   /* Bytes, any topic */
+    uint32_t last_asset_ms;             /* Upload time of the last asset */
+} s_stats;
+
+/* ============================================================================
+   ASSET PARTITION
+   ============================================================================ */
+
+static void load_asset_header(void)
+{
+    memset(&s_asset, 0, sizeof(s_asset));
+    asset_header_t hdr;
+    if (esp_partition_read(s_partition, 0, &hdr, sizeof(hdr)) == ESP_OK &&
+        hdr.magic == ASSET_MAGIC && hdr.size <= s_partition->size - MQTT_ASSET_DATA_OFFSET) {
+        s_asset = hdr;
+    }
+}
+
+static esp_err_t asset_begin(void)
+{
+    /* The old asset stops being valid as soon as the new one starts */
+    esp_err_t err = esp_partition_erase_range(s_partition, 0, MQTT_ASSET_SECTOR);
+    s_asset.magic = 0;
+    s_erased = 0;
+    s_crc = 0;
+    return err;
+}
+
+static esp_err_t asset_write(const char *data, int len)
+{
+    uint32_t off = MQTT_ASSET_DATA_OFFSET + (uint32_t)s_received;
+    /* Erase sector by sector just ahead of the write */
+    while (MQTT_ASSET_DATA_OFFSET + s_erased < off + len) {
+        esp_err_t err = esp_partition_erase_range(s_partition, MQTT_ASSET_DATA_OFFSET + s_erased,
+                                                  MQTT_ASSET_SECTOR);
+        if (err != ESP_OK) {
+            return err;
+        }
+        s_erased += MQTT_ASSET_SECTOR;
+    }
+    s_crc = esp_rom_crc32_le(s_crc, (const uint8_t *)data, len);
+    return esp_partition_write(s_partition, off, data, len);
+}
+
+static esp_err_t asset_finish(void)
+{
+    asset_header_t hdr = {
+        .magic = ASSET_MAGIC,
+        .size = (uint32_t)s_total,
+        .crc32 = s_crc,
+        .seq = s_asset.seq + 1,
+    };
+    esp_err_t err = esp_partition_write(s_partition, 0, &hdr, sizeof(hdr));
+    if (err == ESP_OK) {
+        s_asset = hdr;
+    }
+    return err;
+}
+
+/* ============================================================================
+   REASSEMBLY
+   ============================================================================ */
+
+static bool topic_is(esp_mqtt_event_handle_t event, const char *topic)
+{
+    return topic != NULL && event->topic_len == (int)strlen(topic) &&
+           strncmp(event->topic, topic, event->topic_len) == 0;
+}
+
+/* First event of a message: pick where it goes */
+static route_t start_message(esp_mqtt_event_handle_t event)
+{
+    s_total = event->total_data_len;
+    s_received = 0;
+    s_start_us = esp_timer_get_time();
+    if ((uint32_t)s_total > s_stats.largest) {
+        s_stats.largest = (uint32_t)s_total;
+    }
+
+    if (topic_is(event, s_command_topic)) {
+        if (s_total > MQTT_ASSEMBLY_MAX_LEN) {
+            ESP_LOGW(TAG, "Command of %d bytes dropped (max %d)", s_total, MQTT_ASSEMBLY_MAX_LEN);
+            s_stats.too_large++;
+            return ROUTE_DROP;
+        }
+        return ROUTE_COMMAND;
+    }
+    if (topic_is(event, s_asset_topic)) {
+        if (s_partition == NULL ||
+            (uint32_t)s_total > s_partition->size - MQTT_ASSET_DATA_OFFSET) {
+            ESP_LOGW(TAG, "Asset of %d bytes dropped (%s)", s_total,
+                     s_partition ? "larger than the partition" : "no partition");
+            s_stats.too_large++;
+            return ROUTE_DROP;
+        }
+        esp_err_t err = asset_begin();
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Asset erase failed: %s", esp_err_to_name(err));
+            s_stats.broken++;
+            return ROUTE_DROP;
+        }
+        ESP_LOGI(TAG, "Receiving asset: %d bytes", s_total);
+        return ROUTE_ASSET;
+    }
+    ESP_LOGW(TAG, "Message on unexpected topic %.*s dropped", event->topic_len, event->topic);
+    s_stats.unknown_topic++;
+    return ROUTE_DROP;
+}
+
+void mqtt_assembler_feed(esp_mqtt_event_handle_t event)
+{
+    bool first = event->current_data_offset == 0;
+    bool whole = first && event->data_len == event->total_data_len;
+
+    /* The common case: a command that fit in one event, no copy. The
+       client buffer holds more than the limit, so oversized ones still
+       go through start_message() to be refused. */
+    if (whole && event->data_len <= MQTT_ASSEMBLY_MAX_LEN && topic_is(event, s_command_topic)) {
+        if (s_route != ROUTE_NONE) {
+            s_stats.broken++;           /* Previous message never finished */
+            s_route = ROUTE_NONE;
+        }
+        s_stats.single++;
+        if ((uint32_t)event->data_len > s_stats.largest) {
+            s_stats.largest = (uint32_t)event->data_len;
+        }
+        s_on_command(event->data, event->data_len);
+        return;
+    }
+    if (!whole) {
+        s_stats.fragments++;
+    }
+
+    if (first) {
+        if (s_route != ROUTE_NONE) {
+            s_stats.broken++;
+        }
+        s_route = start_message(event);
+    } else if (s_route == ROUTE_NONE || event->current_data_offset != s_received ||
+               event->total_data_len != s_total) {
+        /* Continuation of a message we did not see start, or a gap */
+        if (s_route != ROUTE_NONE && s_route != ROUTE_DROP) {
+            ESP_LOGW(TAG, "Fragment at %d, expected %d - message dropped",
+                     event->current_data_offset, s_received);
+            s_stats.broken++;
+        }
+        s_route = ROUTE_DROP;
+        s_total = event->total_data_len;
+        s_received = event->current_data_offset;
+    }
+
+    esp_err_t err = ESP_OK;
+    switch (s_route) {
+        case ROUTE_COMMAND:
+            memcpy(s_buf + s_received, event->data, event->data_len);
+            break;
+        case ROUTE_ASSET:
+            err = asset_write(event->data, event->data_len);
+            break;
+        default:
+            break;
+    }
+    s_received += event->data_len;
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Asset write failed at %d: %s", s_received, esp_err_to_name(err));
+        s_stats.broken++;
+        s_route = ROUTE_DROP;
+    }
+    if (s_received < s_total) {
+        return;
+    }
+
+    /* Message complete */
+    route_t route = s_route;
+    s_route = ROUTE_NONE;
+    if (route == ROUTE_COMMAND) {
+        s_stats.reassembled++;      /* Whole commands took the shortcut above */
+        s_on_command(s_buf, s_total);
+    } else if (route == ROUTE_ASSET) {
+        err = asset_finish();
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Asset header write failed: %s", esp_err_to_name(err));
+            s_stats.broken++;
+            return;
+        }
+        if (whole) {
+            s_stats.single++;
+        } else {
+            s_stats.reassembled++;
+        }
+        s_stats.last_asset_ms = (uint32_t)((esp_timer_get_time() - s_start_us) / 1000);
+        ESP_LOGI(TAG, "Asset %lu stored: %d bytes, crc32 %08lx, %lums",
+                 (unsigned long)s_asset.seq, s_total, (unsigned long)s_asset.crc32,
+                 (unsigned long)s_stats.last_asset_ms);
+    }
+}
+
+void mqtt_assembler_reset(void)
+{
+    if (s_route != ROUTE_NONE) {
+        if (s_route != ROUTE_DROP) {
+            ESP_LOGW(TAG, "Message cut at %d of %d bytes", s_received, s_total);
+            s_stats.broken++;
+        }
+        s_route = ROUTE_NONE;
+    }
+}
+
+/* ============================================================================
+   API
+   ============================================================================ */
+
+esp_err_t mqtt_assembler_init(const char *command_topic, const char *asset_topic,
+                              mqtt_assembler_command_fn on_command)
+{
+    s_command_topic = command_topic;
+    s_asset_topic = asset_topic;
+    s_on_command = on_command;
+
+    s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                           MQTT_ASSET_PARTITION_LABEL);
+    if (s_partition == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition - asset uploads disabled", MQTT_ASSET_PARTITION_LABEL);
+        return ESP_OK;
+    }
+    load_asset_header();
+    return ESP_OK;
+}
+
+esp_err_t mqtt_assembler_get_asset(const esp_partition_t **partition, uint32_t *offset, uint32_t *size)
+{
+    if (s_partition == NULL || s_asset.magic != ASSET_MAGIC) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *partition = s_partition;
+    *offset = MQTT_ASSET_DATA_OFFSET;
+    *size = s_asset.size;
+    return ESP_OK;
+}
+
+void mqtt_assembler_print_status(void)
+{
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "  Messages: %lu whole, %lu reassembled from %lu fragments, largest %lu bytes",
+             (unsigned long)s_stats.single, (unsigned long)s_stats.reassembled,
+             (unsigned long)s_stats.fragments, (unsigned long)s_stats.largest);
+    ESP_LOGI(TAG, "  Dropped:  %lu too large, %lu broken, %lu unknown topic",
+             (unsigned long)s_stats.too_large, (unsigned long)s_stats.broken,
+             (unsigned long)s_stats.unknown_topic);
+    if (s_partition == NULL) {
+        ESP_LOGI(TAG, "  Assets:   no '%s' partition", MQTT_ASSET_PARTITION_LABEL);
+    } else if (s_asset.magic != ASSET_MAGIC) {
+        ESP_LOGI(TAG, "  Assets:   none stored (%lu KB partition)",
+                 (unsigned long)(s_partition->size / 1024));
+    } else {
+        ESP_LOGI(TAG, "  Assets:   #%lu, %lu bytes, crc32 %08lx (%lu KB partition)",
+                 (unsigned long)s_asset.seq, (unsigned long)s_asset.size,
+                 (unsigned long)s_asset.crc32, (unsigned long)(s_partition->size / 1024));
+    }
+    ESP_LOGI(TAG, "");
+}
@@ -0,0 +1,95 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * MQTT Assembler - Reassembly of fragmented MQTT messages, per topic
+ *
+ * esp-mqtt hands over a message larger than its receive buffer as several
+ * MQTT_EVENT_DATA events (current_data_offset / total_data_len), and only
+ * the first one carries the topic. The assembler puts them back together
+ * according to the topic the message came in on:
+ *
+ *   commands feed  ->  static RAM buffer (MQTT_ASSEMBLY_MAX_LEN), then the
+ *                      command handler. Single-event messages go straight
+ *                      through without a copy.
+ *   asset feed     ->  streamed into the "assets" flash partition as it
+ *                      arrives, erasing just ahead of each write. The
+ *                      header is written last, so only complete uploads
+ *                      become visible.
+ *
+ * Nothing is allocated: a message that does not fit is dropped as a whole
+ * and counted. Flash writes run in the MQTT task, which stops reading the
+ * socket meanwhile, so TCP flow control slows the broker down instead of
+ * data piling up in RAM.
+ */
+
+#ifndef MQTT_ASSEMBLER_H
+#define MQTT_ASSEMBLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "mqtt_client.h"
+
+/* ============================================================================
+   MQTT ASSEMBLER CONFIGURATION
+   ============================================================================ */
+
+#define MQTT_ASSEMBLY_MAX_LEN       767     /* Largest command: MQTT_COMMAND_MAX_LEN - 1, the
+                                               handler's buffer keeps room for the NUL */
+#define MQTT_ASSET_PARTITION_LABEL  "assets"
+#define MQTT_ASSET_DATA_OFFSET      4096    /* Header sector, then the data */
+#define MQTT_ASSET_SECTOR           4096    /* Flash erase unit */
+
+/* ============================================================================
+   API
+   ============================================================================ */
+
+/**
+ * @brief Complete message from the commands topic
+ *
+ * @param data Payload (not null-terminated, valid during the call)
+ * @param len Payload length
+ */
+typedef void (*mqtt_assembler_command_fn)(const char *data, int len);
+
+/**
+ * @brief Set up routing by topic and find the asset partition
+ *
+ * Without an "assets" partition, messages on the asset topic are dropped.
+ *
+ * @param command_topic Topic whose messages are commands (kept by pointer)
+ * @param asset_topic Topic whose messages are stored in flash (kept by pointer)
+ * @param on_command Called from the MQTT task for each complete command
+ * @return ESP_OK (the commands path works even without the partition)
+ */
+esp_err_t mqtt_assembler_init(const char *command_topic, const char *asset_topic,
+                              mqtt_assembler_command_fn on_command);
+
+/**
+ * @brief Feed one MQTT_EVENT_DATA event
+ */
+void mqtt_assembler_feed(esp_mqtt_event_handle_t event);
+
+/**
+ * @brief Forget a partly received message (call on disconnect)
+ */
+void mqtt_assembler_reset(void);
+
+/**
+ * @brief Where the last complete asset upload is stored
+ *
+ * @param partition Asset partition
+ * @param offset Start of the data in the partition
+ * @param size Data length
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND if there is no complete asset
+ */
+esp_err_t mqtt_assembler_get_asset(const esp_partition_t **partition, uint32_t *offset, uint32_t *size);
+
+/**
+ * @brief Log message, fragment and drop counts and the stored asset
+ */
+void mqtt_assembler_print_status(void);
+
+#endif /* MQTT_ASSEMBLER_H */
@@ -0,0 +1,245 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * MQTT Response - Correlation IDs and timing for MQTT commands
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "halo_metrics.h"
+#include "radio_policy.h"
+#include "mqtt_response.h"
+
+static const char *TAG = "mqtt_resp";
+
+typedef struct {
+    char id[MQTT_RESPONSE_ID_MAX + 1];
+    int64_t rx_us;
+    uint32_t apply_us;
+} reply_t;
+
+static esp_mqtt_client_handle_t s_client = NULL;
+static const char *s_topic = NULL;
+
+/* Command running now (only touched under halo.c's command lock) */
+static reply_t s_open;
+static bool s_open_valid = false;
+
+/* Reply waiting for a Zigbee response (also touched by the txn callback).
+   It is parked before its command runs, so a response that arrives while
+   the handler is still busy is held until mqtt_response_end(). */
+static reply_t s_waiting;
+static bool s_waiting_valid = false;
+static bool s_waiting_running = false;      /* Its command has not returned yet */
+static uint32_t s_waiting_after = 0;        /* Transactions with a higher ID answer it */
+static struct {
+    bool valid;
+    radio_policy_txn_result_t result;
+    uint8_t zcl_status;
+    uint32_t ack_ms;
+} s_held;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static metrics_histogram_t s_apply_hist = METRICS_HISTOGRAM_INIT("mqtt_cmd_apply", "us");
+static metrics_histogram_t s_ack_hist = METRICS_HISTOGRAM_INIT("mqtt_cmd_to_ack", "ms");
+
+/* ============================================================================
+   PUBLISH
+   ============================================================================ */
+
+/* ack: NULL = no Zigbee command, "" = acked after ack_ms, else the reason it was not */
+static void publish(const reply_t *reply, const char *error, const char *ack, uint32_t ack_ms)
+{
+    char json[MQTT_RESPONSE_MAX_LEN];
+    int n = snprintf(json, sizeof(json), "{\"id\":\"%s\",\"status\":\"%s\"",
+                     reply->id, error ? "error" : "ok");
+    if (error != NULL) {
+        n += snprintf(json + n, sizeof(json) - n, ",\"error\":\"%s\"", error);
+    }
+    n += snprintf(json + n, sizeof(json) - n, ",\"apply_us\":%lu", (unsigned long)reply->apply_us);
+    if (ack != NULL && ack[0] == '\0') {
+        n += snprintf(json + n, sizeof(json) - n, ",\"ack_ms\":%lu", (unsigned long)ack_ms);
+    } else if (ack != NULL) {
+        n += snprintf(json + n, sizeof(json) - n, ",\"ack\":\"%s\"", ack);
+    }
+    n += snprintf(json + n, sizeof(json) - n, "}");
+    if (n >= (int)sizeof(json)) {
+        ESP_LOGW(TAG, "Reply for '%s' too long, dropped", reply->id);
+        return;
+    }
+
+    /* Queued and sent by the MQTT task: the caller may be the Zigbee or timer task */
+    int msg_id = esp_mqtt_client_enqueue(s_client, s_topic, json, n, MQTT_RESPONSE_QOS, 0, true);
+    if (msg_id < 0) {
+        ESP_LOGW(TAG, "Reply for '%s' not queued", reply->id);
+    } else {
+        ESP_LOGI(TAG, "Reply: %s", json);
+    }
+}
+
+/* ============================================================================
+   ZIGBEE COMPLETION
+   ============================================================================ */
+
+static void publish_result(const reply_t *reply, radio_policy_txn_result_t result,
+                           uint8_t zcl_status, uint32_t ack_ms)
+{
+    if (result == RADIO_ZB_TXN_ACKED) {
+        metrics_hist_record(&s_ack_hist, ack_ms);
+        publish(reply, NULL, "", ack_ms);
+    } else if (result == RADIO_ZB_TXN_FAILED) {
+        /* The device answered, but refused the command */
+        char error[24];
+        snprintf(error, sizeof(error), "ZCL_STATUS_0x%02X", zcl_status);
+        publish(reply, error, "", ack_ms);
+    } else {
+        publish(reply, NULL, "timeout", 0);
+    }
+}
+
+static void on_zigbee_txn(uint32_t txn_id, radio_policy_txn_result_t result, uint8_t zcl_status,
+                          uint32_t latency_ms)
+{
+    (void)latency_ms;   /* From the Zigbee send; the reply counts from arrival */
+    int64_t now = esp_timer_get_time();
+    reply_t reply;
+    bool publish_now = false;
+    portENTER_CRITICAL(&s_lock);
+    /* Results of transactions begun before the reply was parked are not its own */
+    bool ours = s_waiting_valid && (int32_t)(txn_id - s_waiting_after) > 0;
+    uint32_t ack_ms = ours ? (uint32_t)((now - s_waiting.rx_us) / 1000) : 0;
+    if (ours && s_waiting_running) {
+        /* apply_us is not known yet: mqtt_response_end() publishes it */
+        s_held.valid = true;
+        s_held.result = result;
+        s_held.zcl_status = zcl_status;
+        s_held.ack_ms = ack_ms;
+    } else if (ours) {
+        reply = s_waiting;
+        s_waiting_valid = false;
+        publish_now = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (publish_now) {
+        publish_result(&reply, result, zcl_status, ack_ms);
+    }
+}
+
+/* ============================================================================
+   API
+   ============================================================================ */
+
+void mqtt_response_init(esp_mqtt_client_handle_t client, const char *topic)
+{
+    s_client = client;
+    s_topic = topic;
+    radio_policy_set_txn_callback(on_zigbee_txn);
+}
+
+static bool id_char_ok(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '-' || c == '_' || c == '.';
+}
+
+int mqtt_response_begin(const char *data, int len, int64_t rx_us)
+{
+    s_open_valid = false;
+    if (len < 3 || data[0] != '#') {
+        return 0;
+    }
+
+    int id_len = 0;
+    while (1 + id_len < len && id_char_ok(data[1 + id_len])) {
+        id_len++;
+    }
+    int offset = 1 + id_len;
+    if (id_len == 0 || id_len > MQTT_RESPONSE_ID_MAX || offset >= len || data[offset] != ' ') {
+        return 0;   /* Not an ID: the whole payload is the command */
+    }
+    while (offset < len && data[offset] == ' ') {
+        offset++;
+    }
+
+    memcpy(s_open.id, data + 1, id_len);
+    s_open.id[id_len] = '\0';
+    s_open.rx_us = rx_us;
+    s_open.apply_us = 0;
+    s_open_valid = s_client != NULL;
+    return offset;
+}
+
+void mqtt_response_await_zigbee(void)
+{
+    if (!s_open_valid) {
+        return;
+    }
+
+    reply_t superseded;
+    uint32_t after = radio_policy_zigbee_txn_id();
+    portENTER_CRITICAL(&s_lock);
+    bool had_waiting = s_waiting_valid;
+    if (had_waiting) {
+        superseded = s_waiting;     /* Its transaction is replaced by this one's */
+    }
+    s_waiting = s_open;
+    s_waiting_valid = true;
+    s_waiting_running = true;
+    s_waiting_after = after;
+    s_held.valid = false;
+    portEXIT_CRITICAL(&s_lock);
+    if (had_waiting) {
+        publish(&superseded, NULL, "superseded", 0);
+    }
+}
+
+void mqtt_response_end(const char *error, bool zigbee_sent)
+{
+    if (!s_open_valid) {
+        return;
+    }
+    s_open_valid = false;
+    s_open.apply_us = (uint32_t)(esp_timer_get_time() - s_open.rx_us);
+    metrics_hist_record(&s_apply_hist, s_open.apply_us);
+
+    if (!zigbee_sent) {
+        publish(&s_open, error, NULL, 0);
+        return;
+    }
+
+    /* The reply was parked by mqtt_response_await_zigbee(): finish it now
+       if the response already came, or if nothing went out (no device, or
+       a command without a response) */
+    bool nothing_sent = radio_policy_zigbee_txn_id() == s_waiting_after;
+    reply_t reply;
+    bool publish_now = false;
+    bool held = false;
+    portENTER_CRITICAL(&s_lock);
+    if (s_waiting_valid && s_waiting_running) {
+        s_waiting.apply_us = s_open.apply_us;
+        s_waiting_running = false;
+        held = s_held.valid;
+        if (error != NULL || held || nothing_sent) {
+            reply = s_waiting;
+            s_waiting_valid = false;
+            publish_now = true;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!publish_now) {
+        return;
+    }
+    if (error != NULL) {
+        publish(&reply, error, NULL, 0);
+    } else if (held) {
+        publish_result(&reply, s_held.result, s_held.zcl_status, s_held.ack_ms);
+    } else {
+        publish(&reply, NULL, "none", 0);
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * MQTT Response - Correlation IDs and timing for MQTT commands
+ *
+ * A command on the commands feed may start with "#<id> ", e.g.
+ * "#k3f9 blinds:40". Commands with an ID get one JSON reply on the
+ * response topic once they are done:
+ *
+ *   {"id":"k3f9","status":"ok","apply_us":412,"ack_ms":183}
+ *   {"id":"x1","status":"error","error":"ESP_ERR_NOT_FOUND","apply_us":95}
+ *
+ * apply_us runs from the moment the message arrived to the moment the
+ * handler returned (waiting for a command already running included).
+ * Commands that send a Zigbee command (blinds, lights) are answered when
+ * the device responds, with ack_ms from arrival to the response, or with
+ * "ack":"timeout" after RADIO_ZB_TXN_TIMEOUT_MS ("ack":"none" if no
+ * Zigbee command went out). A device that answers with an error status
+ * gets "status":"error" and e.g. "error":"ZCL_STATUS_0x81", with ack_ms.
+ * Commands without an ID are not answered, so existing clients see no
+ * change.
+ *
+ * One command runs at a time (command lock in halo.c), and one reply can
+ * wait for a Zigbee response: a newer one sends the older reply out with
+ * "ack":"superseded". The reply starts waiting before its command runs,
+ * so a response that arrives while the handler is still busy counts.
+ * Only transactions begun after that answer it.
+ */
+
+#ifndef MQTT_RESPONSE_H
+#define MQTT_RESPONSE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+
+/* ============================================================================
+   MQTT RESPONSE CONFIGURATION
+   ============================================================================ */
+
+#define MQTT_RESPONSE_ID_MAX        24      /* Longer IDs are refused (no reply) */
+#define MQTT_RESPONSE_QOS           1
+#define MQTT_RESPONSE_MAX_LEN       160     /* Longest JSON reply */
+
+/* ============================================================================
+   API
+   ============================================================================ */
+
+/**
+ * @brief Publish replies through this client, on this topic
+ *
+ * Also registers for Zigbee command completions (radio_policy).
+ *
+ * @param client MQTT client (replies are queued, never sent from the caller's task)
+ * @param topic Response topic (kept by pointer)
+ */
+void mqtt_response_init(esp_mqtt_client_handle_t client, const char *topic);
+
+/**
+ * @brief Strip a "#<id> " prefix and open a reply for it
+ *
+ * Call with the command lock held, before running the command.
+ *
+ * @param data Message payload (not necessarily null-terminated)
+ * @param len Payload length
+ * @param rx_us esp_timer_get_time() when the message arrived
+ * @return Offset of the command in data, 0 if there is no ID
+ */
+int mqtt_response_begin(const char *data, int len, int64_t rx_us);
+
+/**
+ * @brief The open command drives a Zigbee device: wait for its response
+ *
+ * Call after mqtt_response_begin() and before running the command.
+ */
+void mqtt_response_await_zigbee(void);
+
+/**
+ * @brief Close the open reply, if any
+ *
+ * @param error NULL on success, else a short static reason
+ * @param zigbee_sent mqtt_response_await_zigbee() was called: reply when
+ *                    the device responds ("ack":"none" if nothing was sent)
+ */
+void mqtt_response_end(const char *error, bool zigbee_sent);
+
+#endif /* MQTT_RESPONSE_H */
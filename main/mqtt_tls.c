@@ -0,0 +1,286 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * MQTT TLS Transport - esp-tls transport with TLS session resumption
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_tls.h"
+#include "esp_crt_bundle.h"
+#include "esp_transport.h"
+#include "mqtt_tls.h"
+
+static const char *TAG = "mqtt_tls";
+
+/* ============================================================================
+   STATE
+   ============================================================================ */
+
+typedef struct {
+    esp_tls_t *tls;
+} tls_transport_ctx_t;
+
+/* One MQTT connection, so one transport context */
+static tls_transport_ctx_t s_ctx;
+static bool s_ctx_in_use = false;
+
+/* Session from the last successful handshake (ticket and/or session ID).
+   Only touched from the MQTT task, apart from mqtt_tls_set_resumption(). */
+static esp_tls_client_session_t *s_session = NULL;
+static volatile bool s_resumption_enabled = true;
+static mqtt_tls_stats_t s_stats = { 0 };
+
+/* ============================================================================
+   STATISTICS
+   ============================================================================ */
+
+static void stats_record(mqtt_tls_handshake_stats_t *hs, bool ok, uint32_t ms, uint32_t heap_peak)
+{
+    if (!ok) {
+        hs->failures++;
+        return;
+    }
+    hs->count++;
+    hs->last_ms = ms;
+    hs->total_ms += ms;
+    if (hs->count == 1 || ms < hs->min_ms) hs->min_ms = ms;
+    if (ms > hs->max_ms) hs->max_ms = ms;
+    if (heap_peak > hs->heap_peak_bytes) hs->heap_peak_bytes = heap_peak;
+}
+
+static void stats_print_line(const char *label, const mqtt_tls_handshake_stats_t *hs)
+{
+    if (hs->count == 0) {
+        ESP_LOGI(TAG, "  %-8s  no handshakes yet (%lu failed)", label, (unsigned long)hs->failures);
+        return;
+    }
+    ESP_LOGI(TAG, "  %-8s  n=%-4lu last=%4lums avg=%4lums min=%4lums max=%4lums heap peak=%5lu B fail=%lu",
+             label, (unsigned long)hs->count, (unsigned long)hs->last_ms,
+             (unsigned long)(hs->total_ms / hs->count), (unsigned long)hs->min_ms,
+             (unsigned long)hs->max_ms, (unsigned long)hs->heap_peak_bytes,
+             (unsigned long)hs->failures);
+}
+
+/* ============================================================================
+   TRANSPORT CALLBACKS
+   ============================================================================
+   Same contract as esp-mqtt's transport_ssl: read/write return a byte count
+   or a negative ERR_TCP_TRANSPORT_* code, poll returns >0 when ready.
+   ============================================================================ */
+
+static int tls_poll(esp_transport_handle_t t, int timeout_ms, bool for_write)
+{
+    tls_transport_ctx_t *ctx = esp_transport_get_context_data(t);
+    int sockfd = -1;
+    if (ctx->tls == NULL || esp_tls_get_conn_sockfd(ctx->tls, &sockfd) != ESP_OK || sockfd < 0) {
+        return -1;
+    }
+
+    fd_set ready, errors;
+    FD_ZERO(&ready);
+    FD_ZERO(&errors);
+    FD_SET(sockfd, &ready);
+    FD_SET(sockfd, &errors);
+
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    int ret = select(sockfd + 1, for_write ? NULL : &ready, for_write ? &ready : NULL,
+                     &errors, timeout_ms < 0 ? NULL : &tv);
+    if (ret > 0 && FD_ISSET(sockfd, &errors)) {
+        int sock_errno = 0;
+        socklen_t optlen = sizeof(sock_errno);
+        getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &sock_errno, &optlen);
+        ESP_LOGD(TAG, "Socket error %d", sock_errno);
+        return -1;
+    }
+    return ret;
+}
+
+static int tls_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    tls_transport_ctx_t *ctx = esp_transport_get_context_data(t);
+    /* Data already decrypted inside mbedTLS never shows up on the socket */
+    if (ctx->tls != NULL && esp_tls_get_bytes_avail(ctx->tls) > 0) {
+        return 1;
+    }
+    return tls_poll(t, timeout_ms, false);
+}
+
+static int tls_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    return tls_poll(t, timeout_ms, true);
+}
+
+static int tls_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    tls_transport_ctx_t *ctx = esp_transport_get_context_data(t);
+
+    ctx->tls = esp_tls_init();
+    if (ctx->tls == NULL) {
+        return ERR_TCP_TRANSPORT_NO_MEM;
+    }
+
+    if (!s_resumption_enabled && s_session != NULL) {
+        esp_tls_free_client_session(s_session);
+        s_session = NULL;
+    }
+    bool offer_session = s_resumption_enabled && s_session != NULL;
+    esp_tls_cfg_t cfg = {
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .timeout_ms = timeout_ms,
+        .client_session = offer_session ? s_session : NULL,
+    };
+
+    size_t heap_before = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    heap_caps_monitor_local_minimum_free_size_start();
+    int64_t start_us = esp_timer_get_time();
+
+    int ret = esp_tls_conn_new_sync(host, strlen(host), port, &cfg, ctx->tls);
+
+    uint32_t elapsed_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    size_t heap_min = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+    heap_caps_monitor_local_minimum_free_size_stop();
+    uint32_t heap_peak = heap_before > heap_min ? (uint32_t)(heap_before - heap_min) : 0;
+
+    mqtt_tls_handshake_stats_t *hs = offer_session ? &s_stats.resumed : &s_stats.full;
+    if (ret <= 0) {
+        stats_record(hs, false, 0, 0);
+        ESP_LOGW(TAG, "TLS handshake with %s:%d failed after %lums",
+                 host, port, (unsigned long)elapsed_ms);
+        esp_tls_conn_destroy(ctx->tls);
+        ctx->tls = NULL;
+        /* A stale ticket must not keep breaking reconnects */
+        if (offer_session) {
+            esp_tls_free_client_session(s_session);
+            s_session = NULL;
+        }
+        return -1;
+    }
+    stats_record(hs, true, elapsed_ms, heap_peak);
+    ESP_LOGI(TAG, "TLS handshake (%s) %lums, heap peak %lu bytes",
+             offer_session ? "session offered" : "full", (unsigned long)elapsed_ms,
+             (unsigned long)heap_peak);
+
+    /* Keep the newest session for the next reconnect */
+    if (s_resumption_enabled) {
+        esp_tls_client_session_t *session = esp_tls_get_client_session(ctx->tls);
+        if (session != NULL) {
+            if (s_session != NULL) {
+                esp_tls_free_client_session(s_session);
+            }
+            s_session = session;
+        }
+    }
+    return 0;
+}
+
+static int tls_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    tls_transport_ctx_t *ctx = esp_transport_get_context_data(t);
+    int poll = tls_poll_read(t, timeout_ms);
+    if (poll == 0) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    if (poll < 0) {
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+
+    int ret = esp_tls_conn_read(ctx->tls, (unsigned char *)buffer, len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_TIMEOUT) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    if (ret == 0) {
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    }
+    return ret;
+}
+
+static int tls_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    tls_transport_ctx_t *ctx = esp_transport_get_context_data(t);
+    int poll = tls_poll_write(t, timeout_ms);
+    if (poll <= 0) {
+        return poll == 0 ? ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT : ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+
+    int ret = esp_tls_conn_write(ctx->tls, (const unsigned char *)buffer, len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_WRITE || ret == ESP_TLS_ERR_SSL_WANT_READ) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    return ret;
+}
+
+static int tls_close(esp_transport_handle_t t)
+{
+    tls_transport_ctx_t *ctx = esp_transport_get_context_data(t);
+    if (ctx->tls != NULL) {
+        esp_tls_conn_destroy(ctx->tls);
+        ctx->tls = NULL;
+    }
+    return 0;
+}
+
+static esp_err_t tls_destroy(esp_transport_handle_t t)
+{
+    tls_close(t);
+    s_ctx_in_use = false;
+    return ESP_OK;
+}
+
+/* ============================================================================
+   PUBLIC API
+   ============================================================================ */
+
+esp_transport_handle_t mqtt_tls_transport_create(void)
+{
+    esp_transport_handle_t t = esp_transport_init();
+    if (t == NULL) {
+        return NULL;
+    }
+    if (s_ctx_in_use) {
+        esp_transport_destroy(t);
+        return NULL;
+    }
+    memset(&s_ctx, 0, sizeof(s_ctx));
+    s_ctx_in_use = true;
+    esp_transport_set_context_data(t, &s_ctx);
+    esp_transport_set_func(t, tls_connect, tls_read, tls_write, tls_close,
+                           tls_poll_read, tls_poll_write, tls_destroy);
+    esp_transport_set_default_port(t, 8883);
+    return t;
+}
+
+void mqtt_tls_set_resumption(bool enable)
+{
+    s_resumption_enabled = enable;
+    ESP_LOGI(TAG, "TLS session resumption %s", enable ? "enabled" : "disabled");
+    /* The cached session is freed on the next connect rather than here -
+       the MQTT task may be in the middle of a handshake that uses it */
+}
+
+bool mqtt_tls_resumption_enabled(void)
+{
+    return s_resumption_enabled;
+}
+
+void mqtt_tls_get_stats(mqtt_tls_stats_t *out)
+{
+    *out = s_stats;
+}
+
+void mqtt_tls_print_stats(void)
+{
+    ESP_LOGI(TAG, "TLS reconnect cost (resumption %s, session %s):",
+             s_resumption_enabled ? "on" : "off", s_session != NULL ? "cached" : "none");
+    stats_print_line("full", &s_stats.full);
+    stats_print_line("resumed", &s_stats.resumed);
+}
@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * MQTT TLS Transport - esp-tls transport with TLS session resumption
+ *
+ * esp-mqtt's built-in SSL transport does a full handshake on every reconnect.
+ * This transport keeps the TLS session (ticket or session ID) from the last
+ * handshake in RAM and offers it on the next connect, so a WiFi blip costs an
+ * abbreviated handshake instead of a full certificate exchange.
+ */
+
+#ifndef MQTT_TLS_H
+#define MQTT_TLS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_transport.h"
+
+/* ============================================================================
+   HANDSHAKE STATISTICS
+   ============================================================================
+   Kept separately for handshakes that offered a cached session and ones that
+   did not, so the cost of each can be compared on the same device.
+   ============================================================================ */
+
+typedef struct {
+    uint32_t count;             /* Successful handshakes */
+    uint32_t failures;          /* Failed handshakes */
+    uint32_t last_ms;           /* Duration of the most recent handshake */
+    uint32_t min_ms;
+    uint32_t max_ms;
+    uint64_t total_ms;          /* For the average */
+    uint32_t heap_peak_bytes;   /* Largest heap drop seen during one handshake */
+} mqtt_tls_handshake_stats_t;
+
+typedef struct {
+    mqtt_tls_handshake_stats_t full;        /* No cached session offered */
+    mqtt_tls_handshake_stats_t resumed;     /* Cached session offered */
+} mqtt_tls_stats_t;
+
+/* ============================================================================
+   TRANSPORT
+   ============================================================================ */
+
+/**
+ * @brief Create the TLS transport for esp_mqtt_client_config_t.network.transport
+ *
+ * Certificates are verified with the ESP-IDF certificate bundle.
+ * The MQTT client owns the handle once configured.
+ *
+ * @return Transport handle, or NULL on allocation failure
+ */
+esp_transport_handle_t mqtt_tls_transport_create(void);
+
+/**
+ * @brief Enable or disable offering the cached session on reconnect
+ *
+ * Disabling forces full handshakes (for measuring the difference).
+ * The cached session is dropped when disabled.
+ *
+ * @param enable true to resume sessions (default), false for full handshakes
+ */
+void mqtt_tls_set_resumption(bool enable);
+
+/**
+ * @brief Check whether session resumption is enabled
+ */
+bool mqtt_tls_resumption_enabled(void);
+
+/**
+ * @brief Get a copy of the handshake statistics
+ */
+void mqtt_tls_get_stats(mqtt_tls_stats_t *out);
+
+/**
+ * @brief Log handshake time and heap cost with and without resumption
+ */
+void mqtt_tls_print_stats(void);
+
+#endif /* MQTT_TLS_H */
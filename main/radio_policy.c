@@ -0,0 +1,567 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Radio Policy - Activity-driven WiFi power save and WiFi/802.15.4 coexistence
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "nvs.h"
+#include "ping/ping_sock.h"
+#include "lwip/ip_addr.h"
+#include "sdkconfig.h"
+#if CONFIG_ESP_COEX_SW_COEXIST_ENABLE
+#include "esp_ieee802154.h"
+#endif
+#include "halo_metrics.h"
+#include "radio_policy.h"
+
+static const char *TAG = "radio";
+
+#define RADIO_NVS_NAMESPACE     "radio"
+#define RADIO_NVS_KEY_BATTERY   "battery"
+
+/* ============================================================================
+   POLICY TABLE
+   ============================================================================
+   WiFi/802.15.4 coexistence needs modem sleep: the coex scheduler hands the
+   802.15.4 side the slots where WiFi is asleep. With a Zigbee network up the
+   WiFi driver may refuse WIFI_PS_NONE, in which case STREAMING falls back to
+   MIN_MODEM and relies on the 802.15.4 side yielding (low coex priority).
+   ============================================================================ */
+
+typedef struct {
+    const char *name;
+    wifi_ps_type_t ps;
+#if CONFIG_ESP_COEX_SW_COEXIST_ENABLE
+    esp_ieee802154_coex_config_t coex;
+#endif
+} radio_policy_cfg_t;
+
+#if CONFIG_ESP_COEX_SW_COEXIST_ENABLE
+#define COEX(i, t, a)   .coex = { .idle = (i), .txrx = (t), .txrx_at = (a) },
+#else
+#define COEX(i, t, a)
+#endif
+
+static const radio_policy_cfg_t s_policy_cfg[RADIO_POLICY_COUNT] = {
+    [RADIO_POLICY_IDLE] = {
+        .name = "idle", .ps = WIFI_PS_MIN_MODEM,
+        COEX(IEEE802154_IDLE, IEEE802154_LOW, IEEE802154_MIDDLE)        /* IDF default */
+    },
+    [RADIO_POLICY_STREAMING] = {
+        .name = "streaming", .ps = WIFI_PS_NONE,
+        COEX(IEEE802154_IDLE, IEEE802154_LOW, IEEE802154_LOW)
+    },
+    [RADIO_POLICY_ZIGBEE] = {
+        .name = "zigbee", .ps = WIFI_PS_MIN_MODEM,
+        COEX(IEEE802154_LOW, IEEE802154_MIDDLE, IEEE802154_HIGH)
+    },
+    [RADIO_POLICY_BATTERY] = {
+        .name = "battery", .ps = WIFI_PS_MAX_MODEM,
+        COEX(IEEE802154_IDLE, IEEE802154_LOW, IEEE802154_MIDDLE)
+    },
+};
+
+static const char *ps_to_string(wifi_ps_type_t ps)
+{
+    switch (ps) {
+        case WIFI_PS_NONE:      return "none";
+        case WIFI_PS_MIN_MODEM: return "min_modem";
+        case WIFI_PS_MAX_MODEM: return "max_modem";
+        default:                return "?";
+    }
+}
+
+/* ============================================================================
+   STATE
+   ============================================================================ */
+
+typedef struct {
+    uint32_t entries;           /* Times this policy was applied */
+    uint64_t time_us;           /* Time spent in it (excluding the current stint) */
+    uint32_t zb_sent;           /* Zigbee commands sent while active */
+    uint32_t zb_failed;         /* ...answered with an error status */
+    uint32_t zb_lost;           /* ...with no response within RADIO_ZB_TXN_TIMEOUT_MS */
+    uint32_t ping_sent;
+    uint32_t ping_lost;
+} radio_policy_stats_t;
+
+static StaticSemaphore_t s_lock_buf;
+static SemaphoreHandle_t s_lock = NULL;     /* Serializes evaluate + apply */
+
+static radio_policy_t s_current = RADIO_POLICY_IDLE;
+static radio_policy_t s_forced = RADIO_POLICY_AUTO;
+static wifi_ps_type_t s_applied_ps = WIFI_PS_MIN_MODEM;
+static int64_t s_entered_us = 0;
+
+static int s_streaming_refs = 0;
+static bool s_on_battery = false;
+
+static int64_t s_txn_start_us = 0;          /* 0 = no Zigbee command pending */
+static uint32_t s_txn_id = 0;               /* Transactions begun */
+static radio_policy_t s_txn_policy = RADIO_POLICY_IDLE;
+static bool s_txn_sent = false;             /* Destination and TSN below are known */
+static uint16_t s_txn_addr = 0;
+static uint8_t s_txn_tsn = 0;
+static esp_timer_handle_t s_txn_timer = NULL;
+static radio_policy_txn_cb_t s_txn_cb = NULL;
+
+static esp_ping_handle_t s_ping = NULL;
+static volatile bool s_probe_running = false;
+static radio_policy_t s_probe_policy = RADIO_POLICY_IDLE;
+
+static radio_policy_stats_t s_stats[RADIO_POLICY_COUNT];
+
+static metrics_histogram_t s_zb_latency[RADIO_POLICY_COUNT] = {
+    [RADIO_POLICY_IDLE]      = METRICS_HISTOGRAM_INIT("zb_cmd_idle", "ms"),
+    [RADIO_POLICY_STREAMING] = METRICS_HISTOGRAM_INIT("zb_cmd_streaming", "ms"),
+    [RADIO_POLICY_ZIGBEE]    = METRICS_HISTOGRAM_INIT("zb_cmd_zigbee", "ms"),
+    [RADIO_POLICY_BATTERY]   = METRICS_HISTOGRAM_INIT("zb_cmd_battery", "ms"),
+};
+
+static metrics_histogram_t s_ping_rtt[RADIO_POLICY_COUNT] = {
+    [RADIO_POLICY_IDLE]      = METRICS_HISTOGRAM_INIT("gw_rtt_idle", "ms"),
+    [RADIO_POLICY_STREAMING] = METRICS_HISTOGRAM_INIT("gw_rtt_streaming", "ms"),
+    [RADIO_POLICY_ZIGBEE]    = METRICS_HISTOGRAM_INIT("gw_rtt_zigbee", "ms"),
+    [RADIO_POLICY_BATTERY]   = METRICS_HISTOGRAM_INIT("gw_rtt_battery", "ms"),
+};
+
+/* ============================================================================
+   EVALUATE & APPLY (call with s_lock held)
+   ============================================================================ */
+
+static radio_policy_t evaluate(void)
+{
+    if (s_forced != RADIO_POLICY_AUTO) {
+        return s_forced;
+    }
+    /* A pending Zigbee command outranks streaming: it lasts at most
+       RADIO_ZB_TXN_TIMEOUT_MS and a user is usually waiting on it */
+    if (s_txn_start_us != 0) {
+        return RADIO_POLICY_ZIGBEE;
+    }
+    if (s_streaming_refs > 0) {
+        return RADIO_POLICY_STREAMING;
+    }
+    return s_on_battery ? RADIO_POLICY_BATTERY : RADIO_POLICY_IDLE;
+}
+
+static void apply(radio_policy_t policy)
+{
+    const radio_policy_cfg_t *cfg = &s_policy_cfg[policy];
+
+    wifi_ps_type_t ps = cfg->ps;
+    esp_err_t err = esp_wifi_set_ps(ps);
+    if (err != ESP_OK && ps == WIFI_PS_NONE) {
+        ps = WIFI_PS_MIN_MODEM;
+        err = esp_wifi_set_ps(ps);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "esp_wifi_set_ps(%s) failed: %s", ps_to_string(ps), esp_err_to_name(err));
+    } else {
+        s_applied_ps = ps;
+    }
+
+#if CONFIG_ESP_COEX_SW_COEXIST_ENABLE
+    err = esp_ieee802154_coex_config_set(cfg->coex);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "802.15.4 coex config failed: %s", esp_err_to_name(err));
+    }
+#endif
+
+    int64_t now = esp_timer_get_time();
+    s_stats[s_current].time_us += now - s_entered_us;
+    s_entered_us = now;
+    s_current = policy;
+    s_stats[policy].entries++;
+
+    ESP_LOGD(TAG, "Policy -> %s (ps=%s)", cfg->name, ps_to_string(s_applied_ps));
+}
+
+static void reevaluate(void)
+{
+    radio_policy_t next = evaluate();
+    if (next != s_current) {
+        apply(next);
+    }
+}
+
+/* ============================================================================
+   ZIGBEE TRANSACTION TIMEOUT
+   ============================================================================ */
+
+static void txn_timeout_cb(void *arg)
+{
+    /* Runs on the shared esp_timer task: never block it behind a slow
+       apply(), try again shortly instead */
+    if (xSemaphoreTake(s_lock, pdMS_TO_TICKS(RADIO_LOCK_WAIT_MS)) != pdTRUE) {
+        esp_timer_start_once(s_txn_timer, RADIO_LOCK_WAIT_MS * 1000ULL);
+        return;
+    }
+    bool lost = s_txn_start_us != 0;
+    uint32_t id = s_txn_id;
+    uint32_t ms = lost ? (uint32_t)((esp_timer_get_time() - s_txn_start_us) / 1000) : 0;
+    if (lost) {
+        s_stats[s_txn_policy].zb_lost++;
+        s_txn_start_us = 0;
+        s_txn_sent = false;
+        ESP_LOGD(TAG, "Zigbee command got no response within %dms", RADIO_ZB_TXN_TIMEOUT_MS);
+        reevaluate();
+    }
+    radio_policy_txn_cb_t cb = s_txn_cb;
+    xSemaphoreGive(s_lock);
+    
+    if (lost && cb != NULL) {
+        cb(id, RADIO_ZB_TXN_LOST, 0, ms);
+    }
+}
+
+/* ============================================================================
+   GATEWAY PING PROBE
+   ============================================================================ */
+
+static void ping_success_cb(esp_ping_handle_t hdl, void *args)
+{
+    uint32_t elapsed_ms = 0;
+    esp_ping_get_profile(hdl, ESP_PING_PROF_TIMEGAP, &elapsed_ms, sizeof(elapsed_ms));
+    metrics_hist_record(&s_ping_rtt[s_probe_policy], elapsed_ms);
+}
+
+static void ping_end_cb(esp_ping_handle_t hdl, void *args)
+{
+    uint32_t sent = 0, received = 0;
+    esp_ping_get_profile(hdl, ESP_PING_PROF_REQUEST, &sent, sizeof(sent));
+    esp_ping_get_profile(hdl, ESP_PING_PROF_REPLY, &received, sizeof(received));
+
+    s_stats[s_probe_policy].ping_sent += sent;
+    s_stats[s_probe_policy].ping_lost += sent - received;
+    ESP_LOGI(TAG, "Probe (%s): %lu/%lu replies, p50 %lums, p99 %lums",
+             s_policy_cfg[s_probe_policy].name, (unsigned long)received, (unsigned long)sent,
+             (unsigned long)metrics_hist_percentile(&s_ping_rtt[s_probe_policy], 50),
+             (unsigned long)metrics_hist_percentile(&s_ping_rtt[s_probe_policy], 99));
+    /* The session is deleted by the next probe - not from its own task */
+    s_probe_running = false;
+}
+
+/* ============================================================================
+   PUBLIC API
+   ============================================================================ */
+
+esp_err_t radio_policy_init(void)
+{
+    if (s_lock != NULL) {
+        return ESP_OK;
+    }
+    s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+
+    nvs_handle_t nvs;
+    if (nvs_open(RADIO_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        uint8_t battery = 0;
+        if (nvs_get_u8(nvs, RADIO_NVS_KEY_BATTERY, &battery) == ESP_OK) {
+            s_on_battery = battery != 0;
+        }
+        nvs_close(nvs);
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = txn_timeout_cb,
+        .name = "radio_zb_txn",
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &s_txn_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_entered_us = esp_timer_get_time();
+    s_current = evaluate();
+    apply(s_current);
+    xSemaphoreGive(s_lock);
+
+    ESP_LOGI(TAG, "Radio policy: %s (ps=%s)%s", s_policy_cfg[s_current].name,
+             ps_to_string(s_applied_ps), s_on_battery ? " - battery mode" : "");
+    return ESP_OK;
+}
+
+void radio_policy_streaming_begin(void)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_streaming_refs++;
+    reevaluate();
+    xSemaphoreGive(s_lock);
+}
+
+void radio_policy_streaming_end(void)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_streaming_refs > 0) {
+        s_streaming_refs--;
+    }
+    reevaluate();
+    xSemaphoreGive(s_lock);
+}
+
+void radio_policy_zigbee_txn_begin(void)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_txn_start_us = esp_timer_get_time();
+    s_txn_id++;
+    s_txn_sent = false;
+    esp_timer_stop(s_txn_timer);
+    esp_timer_start_once(s_txn_timer, RADIO_ZB_TXN_TIMEOUT_MS * 1000ULL);
+    reevaluate();
+    /* Latency is charged to the policy the command actually goes out under:
+       ZIGBEE in auto mode, the pinned one under radio_policy_force(), which
+       is how policies are compared */
+    s_txn_policy = s_current;
+    s_stats[s_txn_policy].zb_sent++;
+    xSemaphoreGive(s_lock);
+}
+
+void radio_policy_zigbee_txn_sent(uint16_t short_addr, uint8_t tsn)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_txn_start_us != 0) {
+        s_txn_addr = short_addr;
+        s_txn_tsn = tsn;
+        s_txn_sent = true;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void radio_policy_zigbee_txn_end(uint16_t short_addr, uint8_t tsn, uint8_t zcl_status)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool matched = s_txn_start_us != 0 && s_txn_sent &&
+                   s_txn_addr == short_addr && s_txn_tsn == tsn;
+    uint32_t id = s_txn_id;
+    uint32_t ms = matched ? (uint32_t)((esp_timer_get_time() - s_txn_start_us) / 1000) : 0;
+    if (matched) {
+        metrics_hist_record(&s_zb_latency[s_txn_policy], ms);
+        if (zcl_status != 0) {
+            s_stats[s_txn_policy].zb_failed++;
+        }
+        s_txn_start_us = 0;
+        s_txn_sent = false;
+        esp_timer_stop(s_txn_timer);
+        reevaluate();
+    }
+    radio_policy_txn_cb_t cb = s_txn_cb;
+    xSemaphoreGive(s_lock);
+    
+    /* Outside the lock: the callback may publish */
+    if (matched && cb != NULL) {
+        cb(id, zcl_status == 0 ? RADIO_ZB_TXN_ACKED : RADIO_ZB_TXN_FAILED, zcl_status, ms);
+    } else if (!matched) {
+        ESP_LOGD(TAG, "Zigbee response from 0x%04x tsn %u matches no pending command",
+                 short_addr, tsn);
+    }
+}
+
+void radio_policy_set_txn_callback(radio_policy_txn_cb_t cb)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_txn_cb = cb;
+    xSemaphoreGive(s_lock);
+}
+
+bool radio_policy_zigbee_txn_pending(void)
+{
+    if (s_lock == NULL) {
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool pending = s_txn_start_us != 0;
+    xSemaphoreGive(s_lock);
+    return pending;
+}
+
+uint32_t radio_policy_zigbee_txn_id(void)
+{
+    if (s_lock == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t id = s_txn_id;
+    xSemaphoreGive(s_lock);
+    return id;
+}
+
+void radio_policy_set_battery(bool on_battery)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_on_battery = on_battery;
+    reevaluate();
+    xSemaphoreGive(s_lock);
+
+    nvs_handle_t nvs;
+    if (nvs_open(RADIO_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_set_u8(nvs, RADIO_NVS_KEY_BATTERY, on_battery ? 1 : 0);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    ESP_LOGI(TAG, "Battery mode %s", on_battery ? "on" : "off");
+}
+
+void radio_policy_force(radio_policy_t policy)
+{
+    if (s_lock == NULL || policy > RADIO_POLICY_AUTO || policy == RADIO_POLICY_COUNT) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_forced = policy;
+    reevaluate();
+    xSemaphoreGive(s_lock);
+
+    if (policy == RADIO_POLICY_AUTO) {
+        ESP_LOGI(TAG, "Radio policy follows activity again");
+    } else {
+        ESP_LOGI(TAG, "Radio policy pinned to %s (ps=%s) - take current readings now",
+                 s_policy_cfg[policy].name, ps_to_string(s_applied_ps));
+    }
+}
+
+esp_err_t radio_policy_probe(void)
+{
+    if (s_lock == NULL || s_probe_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    esp_netif_ip_info_t ip_info;
+    if (netif == NULL || esp_netif_get_ip_info(netif, &ip_info) != ESP_OK ||
+        ip_info.gw.addr == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (s_ping != NULL) {
+        esp_ping_delete_session(s_ping);
+        s_ping = NULL;
+    }
+
+    esp_ping_config_t cfg = ESP_PING_DEFAULT_CONFIG();
+    cfg.target_addr.type = IPADDR_TYPE_V4;
+    cfg.target_addr.u_addr.ip4.addr = ip_info.gw.addr;
+    cfg.count = RADIO_PROBE_COUNT;
+    cfg.interval_ms = RADIO_PROBE_INTERVAL_MS;
+    cfg.timeout_ms = RADIO_PROBE_TIMEOUT_MS;
+
+    esp_ping_callbacks_t cbs = {
+        .on_ping_success = ping_success_cb,
+        .on_ping_end = ping_end_cb,
+    };
+    esp_err_t err = esp_ping_new_session(&cfg, &cbs, &s_ping);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    s_probe_policy = s_current;
+    s_probe_running = true;
+    ESP_LOGI(TAG, "Probing gateway " IPSTR " under %s policy (%d pings)",
+             IP2STR(&ip_info.gw), s_policy_cfg[s_probe_policy].name, RADIO_PROBE_COUNT);
+    err = esp_ping_start(s_ping);
+    if (err != ESP_OK) {
+        s_probe_running = false;
+    }
+    return err;
+}
+
+radio_policy_t radio_policy_get(void)
+{
+    return s_current;
+}
+
+const char* radio_policy_to_string(radio_policy_t policy)
+{
+    if (policy == RADIO_POLICY_AUTO) {
+        return "auto";
+    }
+    return policy < RADIO_POLICY_COUNT ? s_policy_cfg[policy].name : "?";
+}
+
+bool radio_policy_from_string(const char *name, radio_policy_t *out)
+{
+    if (strcmp(name, "auto") == 0) {
+        *out = RADIO_POLICY_AUTO;
+        return true;
+    }
+    for (int i = 0; i < RADIO_POLICY_COUNT; i++) {
+        if (strcmp(name, s_policy_cfg[i].name) == 0) {
+            *out = (radio_policy_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void radio_policy_print_stats(void)
+{
+    if (s_lock == NULL) {
+        ESP_LOGI(TAG, "Radio policy not initialized");
+        return;
+    }
+
+    radio_policy_stats_t stats[RADIO_POLICY_COUNT];
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    memcpy(stats, s_stats, sizeof(stats));
+    stats[s_current].time_us += esp_timer_get_time() - s_entered_us;
+    radio_policy_t current = s_current;
+    radio_policy_t forced = s_forced;
+    int streaming = s_streaming_refs;
+    bool txn_pending = s_txn_start_us != 0;
+    xSemaphoreGive(s_lock);
+
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "╔══════════════════════════════════════════════════════════╗");
+    ESP_LOGI(TAG, "║  📡 RADIO POLICY                                         ║");
+    ESP_LOGI(TAG, "╚══════════════════════════════════════════════════════════╝");
+    ESP_LOGI(TAG, "  Current: %s (ps=%s), mode: %s", s_policy_cfg[current].name,
+             ps_to_string(s_applied_ps), radio_policy_to_string(forced));
+    ESP_LOGI(TAG, "  Inputs:  streaming=%d zigbee_pending=%s battery=%s",
+             streaming, txn_pending ? "yes" : "no", s_on_battery ? "yes" : "no");
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "  %-9s %8s %6s | %-26s | %-22s", "policy", "time(s)", "enter",
+             "zigbee sent/fail/lost p50/p99", "ping sent/lost p50/p99");
+    for (int i = 0; i < RADIO_POLICY_COUNT; i++) {
+        const radio_policy_stats_t *s = &stats[i];
+        ESP_LOGI(TAG, "  %-9s %8lu %6lu | %4lu/%-3lu/%-3lu %5lu/%-5lums | %4lu/%-3lu %5lu/%-5lums",
+                 s_policy_cfg[i].name, (unsigned long)(s->time_us / 1000000),
+                 (unsigned long)s->entries,
+                 (unsigned long)s->zb_sent, (unsigned long)s->zb_failed,
+                 (unsigned long)s->zb_lost,
+                 (unsigned long)metrics_hist_percentile(&s_zb_latency[i], 50),
+                 (unsigned long)metrics_hist_percentile(&s_zb_latency[i], 99),
+                 (unsigned long)s->ping_sent, (unsigned long)s->ping_lost,
+                 (unsigned long)metrics_hist_percentile(&s_ping_rtt[i], 50),
+                 (unsigned long)metrics_hist_percentile(&s_ping_rtt[i], 99));
+    }
+    ESP_LOGI(TAG, "");
+}
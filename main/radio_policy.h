@@ -0,0 +1,203 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Radio Policy - Activity-driven WiFi power save and WiFi/802.15.4 coexistence
+ *
+ * WiFi and Zigbee share one 2.4GHz radio on the ESP32-C6. The policy picks
+ * the WiFi power-save mode and the 802.15.4 coexistence priority from what
+ * the hub is doing right now:
+ *
+ *   STREAMING  - bulk/low-latency WiFi traffic (OTA download, pixel stream)
+ *   ZIGBEE     - a Zigbee command is waiting for its response
+ *   BATTERY    - running from battery, save power whenever nothing is active
+ *   IDLE       - default
+ *
+ * Every policy keeps its own numbers (time spent, Zigbee command latency and
+ * loss, gateway ping RTT and loss). In auto mode a Zigbee command always
+ * goes out under ZIGBEE, so its numbers land there; to compare how commands
+ * fare under another policy, pin it with radio_policy_force(). Current draw
+ * cannot be measured on-chip either: pin a policy and read an external
+ * meter.
+ */
+
+#ifndef RADIO_POLICY_H
+#define RADIO_POLICY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/* ============================================================================
+   RADIO POLICY CONFIGURATION
+   ============================================================================ */
+
+#define RADIO_ZB_TXN_TIMEOUT_MS     1500    /* Zigbee command counted as lost after this */
+#define RADIO_LOCK_WAIT_MS          10      /* Timer callbacks wait this long for the lock, then retry */
+#define RADIO_PROBE_COUNT           20      /* Gateway pings per radio_policy_probe() */
+#define RADIO_PROBE_INTERVAL_MS     100     /* Gap between probe pings */
+#define RADIO_PROBE_TIMEOUT_MS      1000    /* Per-ping timeout */
+
+/* ============================================================================
+   POLICIES
+   ============================================================================ */
+
+typedef enum {
+    RADIO_POLICY_IDLE = 0,      /* MIN_MODEM, balanced coexistence */
+    RADIO_POLICY_STREAMING,     /* No power save, WiFi preferred */
+    RADIO_POLICY_ZIGBEE,        /* MIN_MODEM, 802.15.4 preferred */
+    RADIO_POLICY_BATTERY,       /* MAX_MODEM, balanced coexistence */
+    RADIO_POLICY_COUNT,
+    RADIO_POLICY_AUTO,          /* radio_policy_force(): follow activity again */
+} radio_policy_t;
+
+/* ============================================================================
+   LIFECYCLE
+   ============================================================================ */
+
+/**
+ * @brief Load the battery flag and apply the initial policy
+ *
+ * Call after esp_wifi_start().
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t radio_policy_init(void);
+
+/* ============================================================================
+   ACTIVITY INPUTS
+   ============================================================================ */
+
+/**
+ * @brief Begin a WiFi streaming activity (reference counted)
+ */
+void radio_policy_streaming_begin(void);
+
+/**
+ * @brief End a WiFi streaming activity
+ */
+void radio_policy_streaming_end(void);
+
+/**
+ * @brief A Zigbee command is about to be sent and a response is expected
+ *
+ * Switches to the ZIGBEE policy until radio_policy_zigbee_txn_end() or
+ * RADIO_ZB_TXN_TIMEOUT_MS, whichever comes first. Follow the send with
+ * radio_policy_zigbee_txn_sent() so the response can be recognized.
+ */
+void radio_policy_zigbee_txn_begin(void);
+
+/**
+ * @brief The pending Zigbee command went out
+ *
+ * Call with the Zigbee lock still held, so the response cannot be handled
+ * before the transaction knows what to wait for.
+ *
+ * @param short_addr Destination short address
+ * @param tsn ZCL transaction sequence number returned by the send call
+ */
+void radio_policy_zigbee_txn_sent(uint16_t short_addr, uint8_t tsn);
+
+/**
+ * @brief A response to a Zigbee command arrived
+ *
+ * Ends the pending transaction only if the response comes from the device
+ * it was sent to and carries its sequence number; anything else (a late
+ * response, an unrelated device, a report) is ignored. Records the latency
+ * against the policy that was active when the command was sent. Safe to
+ * call when nothing is pending.
+ *
+ * @param short_addr Sender short address
+ * @param tsn ZCL transaction sequence number of the command answered
+ * @param zcl_status ZCL status of the response (0 = SUCCESS)
+ */
+void radio_policy_zigbee_txn_end(uint16_t short_addr, uint8_t tsn, uint8_t zcl_status);
+
+typedef enum {
+    RADIO_ZB_TXN_ACKED = 0,     /* Answered with SUCCESS */
+    RADIO_ZB_TXN_FAILED,        /* Answered with an error status */
+    RADIO_ZB_TXN_LOST,          /* No response within RADIO_ZB_TXN_TIMEOUT_MS */
+} radio_policy_txn_result_t;
+
+/**
+ * @brief How a Zigbee command ended
+ *
+ * @param txn_id ID of the transaction (see radio_policy_zigbee_txn_id())
+ * @param result Acked, failed or lost
+ * @param zcl_status ZCL status of the response (RADIO_ZB_TXN_FAILED only)
+ * @param latency_ms Time since radio_policy_zigbee_txn_begin()
+ */
+typedef void (*radio_policy_txn_cb_t)(uint32_t txn_id, radio_policy_txn_result_t result,
+                                      uint8_t zcl_status, uint32_t latency_ms);
+
+/**
+ * @brief Be told when each Zigbee command is answered or lost (NULL to stop)
+ *
+ * Runs in the Zigbee task, or the esp_timer task on timeout: keep it short.
+ */
+void radio_policy_set_txn_callback(radio_policy_txn_cb_t cb);
+
+/**
+ * @brief True while a Zigbee command is waiting for its response
+ */
+bool radio_policy_zigbee_txn_pending(void);
+
+/**
+ * @brief ID of the last Zigbee transaction begun (counts up from 1, 0 = none yet)
+ *
+ * A transaction begun after this call gets a higher ID, so a caller can
+ * tell its own commands' results from older ones.
+ */
+uint32_t radio_policy_zigbee_txn_id(void);
+
+/**
+ * @brief Mark the hub as battery powered (persisted in NVS)
+ */
+void radio_policy_set_battery(bool on_battery);
+
+/**
+ * @brief Pin a policy regardless of activity, or RADIO_POLICY_AUTO to release
+ *
+ * Used to take current-draw readings for one policy at a time.
+ */
+void radio_policy_force(radio_policy_t policy);
+
+/* ============================================================================
+   MEASUREMENT & STATUS
+   ============================================================================ */
+
+/**
+ * @brief Ping the default gateway RADIO_PROBE_COUNT times (non-blocking)
+ *
+ * RTT and loss are recorded against the policy active when the probe starts.
+ *
+ * @return ESP_OK if the probe started, ESP_ERR_INVALID_STATE without an IP
+ *         or while another probe is running
+ */
+esp_err_t radio_policy_probe(void);
+
+/**
+ * @brief Get the policy currently applied to the radio
+ */
+radio_policy_t radio_policy_get(void);
+
+/**
+ * @brief Get a policy name ("idle", "streaming", "zigbee", "battery", "auto")
+ */
+const char* radio_policy_to_string(radio_policy_t policy);
+
+/**
+ * @brief Parse a policy name ("auto" parses to RADIO_POLICY_AUTO)
+ *
+ * @param name Policy name
+ * @param out Parsed policy
+ * @return true if the name is known
+ */
+bool radio_policy_from_string(const char *name, radio_policy_t *out);
+
+/**
+ * @brief Log current inputs and the per-policy comparison table
+ */
+void radio_policy_print_stats(void);
+
+#endif /* RADIO_POLICY_H */
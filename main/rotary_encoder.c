@@ -41,6 +41,8 @@ static volatile int64_t s_last_rotation_time = 0;
 /* Event queue */
 static QueueHandle_t s_event_queue = NULL;
 #define EVENT_QUEUE_SIZE    16
+static StaticQueue_t s_event_queue_buf;
+static uint8_t s_event_queue_storage[EVENT_QUEUE_SIZE * sizeof(encoder_event_t)];
 
 /* ============================================================================
    QUADRATURE DECODING
@@ -189,7 +191,8 @@ esp_err_t encoder_init(void)
     ESP_LOGI(TAG, "  SW:      GPIO%d", ENCODER_GPIO_SW);
     
     /* Create event queue */
-    s_event_queue = xQueueCreate(EVENT_QUEUE_SIZE, sizeof(encoder_event_t));
+    s_event_queue = xQueueCreateStatic(EVENT_QUEUE_SIZE, sizeof(encoder_event_t),
+                                       s_event_queue_storage, &s_event_queue_buf);
     if (s_event_queue == NULL) {
         ESP_LOGE(TAG, "Failed to create event queue");
         return ESP_ERR_NO_MEM;
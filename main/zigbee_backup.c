@@ -0,0 +1,487 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee Backup - Coordinator state export/import implementation
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_random.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "mbedtls/md.h"
+#include "mbedtls/aes.h"
+#include "mbedtls/base64.h"
+
+#include "esp_zigbee_core.h"
+
+#include "zigbee_backup.h"
+#include "zigbee_devices.h"
+#include "credentials.h"
+
+static const char *TAG = "zigbee_backup";
+
+/* Older credentials.h files predate the backup secret. They still build,
+   but backup and restore stay refused until it is set. */
+#ifndef ZIGBEE_BACKUP_SECRET
+#define ZIGBEE_BACKUP_SECRET        ""
+#endif
+#define ZB_BACKUP_SECRET_TEMPLATE   "change-me-to-a-long-random-string"
+
+/* ============================================================================
+   NVS CONFIGURATION
+   ============================================================================ */
+
+#define NVS_NAMESPACE       "zb_backup"
+#define NVS_KEY_PENDING     "pending"   /* Verified blob waiting to be applied */
+
+/* ============================================================================
+   BLOB LAYOUT
+   ============================================================================
+   [header, 24 bytes, plain] [payload + devices, AES-256-CTR] [HMAC-SHA256]
+   The MAC covers the header and the ciphertext.
+   ============================================================================ */
+
+typedef struct __attribute__((packed)) {
+    char magic[4];                      /* ZB_BACKUP_MAGIC */
+    uint8_t version;                    /* ZB_BACKUP_VERSION */
+    uint8_t device_count;
+    uint16_t reserved;
+    uint8_t iv[ZB_BACKUP_IV_LEN];       /* Random per export */
+} zb_backup_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t channel;
+    uint8_t reserved;
+    uint16_t pan_id;
+    uint8_t ext_pan_id[8];
+    uint8_t coordinator_ieee[8];
+    uint8_t nwk_key[16];
+    uint32_t nwk_frame_counter;         /* Outgoing, 0 = not known */
+    uint32_t aps_frame_counter;         /* Outgoing, 0 = not known */
+} zb_backup_network_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t short_addr;
+    uint8_t ieee_addr[8];
+    uint8_t endpoint;
+    uint8_t device_type;
+} zb_backup_device_t;
+
+_Static_assert(sizeof(zb_backup_header_t) == 24, "backup header size");
+_Static_assert(sizeof(zb_backup_network_t) == 44, "backup network size");
+_Static_assert(sizeof(zb_backup_device_t) == ZB_BACKUP_DEVICE_LEN, "backup device size");
+
+static bool s_restore_applied = false;
+static uint32_t s_restore_nwk_counter = 0;
+static uint32_t s_restore_aps_counter = 0;
+
+/* ============================================================================
+   FRAME COUNTERS
+   ============================================================================
+   The outgoing counters live in the ZBOSS NIB and AIB. esp-zigbee-lib does
+   not wrap them, so the ZBOSS accessors are resolved at link time, declared
+   weak: a stack build without them still links, the export then records 0
+   and a restore warns that devices have to be paired again.
+   ============================================================================ */
+
+extern uint32_t zb_nwk_get_outgoing_frame_counter(void) __attribute__((weak));
+extern void zb_nwk_set_outgoing_frame_counter(uint32_t counter) __attribute__((weak));
+extern uint32_t zb_aps_get_outgoing_frame_counter(void) __attribute__((weak));
+extern void zb_aps_set_outgoing_frame_counter(uint32_t counter) __attribute__((weak));
+
+static bool counters_supported(void)
+{
+    return zb_nwk_get_outgoing_frame_counter && zb_nwk_set_outgoing_frame_counter &&
+           zb_aps_get_outgoing_frame_counter && zb_aps_set_outgoing_frame_counter;
+}
+
+/* Never lower a counter, and leave room for what the old coordinator sent
+   after the export. Caller holds the Zigbee lock or runs in the Zigbee task. */
+static uint32_t counter_after(uint32_t saved, uint32_t current)
+{
+    uint32_t target = saved + ZB_BACKUP_COUNTER_MARGIN;
+    if (target < saved) {
+        target = UINT32_MAX;    /* Would wrap - devices would see a replay */
+    }
+    return target > current ? target : current;
+}
+
+/* ============================================================================
+   CRYPTO HELPERS
+   ============================================================================ */
+
+static bool secret_configured(void)
+{
+    const char *secret = ZIGBEE_BACKUP_SECRET;
+    if (strlen(secret) >= ZB_BACKUP_SECRET_MIN_LEN && strcmp(secret, ZB_BACKUP_SECRET_TEMPLATE) != 0) {
+        return true;
+    }
+    ESP_LOGE(TAG, "Set ZIGBEE_BACKUP_SECRET in credentials.h (%d+ characters) to use backups",
+             ZB_BACKUP_SECRET_MIN_LEN);
+    return false;
+}
+
+/* Separate encryption and MAC keys, both derived from the shared secret */
+static esp_err_t derive_key(const char *label, uint8_t out[32])
+{
+    const mbedtls_md_info_t *md = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    int ret = mbedtls_md_hmac(md, (const uint8_t *)ZIGBEE_BACKUP_SECRET, strlen(ZIGBEE_BACKUP_SECRET),
+                              (const uint8_t *)label, strlen(label), out);
+    return ret == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t compute_mac(const uint8_t *data, size_t len, uint8_t mac[ZB_BACKUP_MAC_LEN])
+{
+    uint8_t key[32];
+    esp_err_t err = derive_key("halo-zb-backup-mac", key);
+    if (err == ESP_OK) {
+        const mbedtls_md_info_t *md = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+        err = mbedtls_md_hmac(md, key, sizeof(key), data, len, mac) == 0 ? ESP_OK : ESP_FAIL;
+    }
+    memset(key, 0, sizeof(key));
+    return err;
+}
+
+/* CTR mode is symmetric - the same call encrypts and decrypts */
+static esp_err_t crypt_ctr(const uint8_t iv[ZB_BACKUP_IV_LEN], const uint8_t *in, uint8_t *out, size_t len)
+{
+    uint8_t key[32];
+    esp_err_t err = derive_key("halo-zb-backup-enc", key);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    uint8_t counter[16];
+    uint8_t stream_block[16];
+    size_t nc_off = 0;
+    memcpy(counter, iv, sizeof(counter));
+
+    int ret = mbedtls_aes_setkey_enc(&aes, key, 256);
+    if (ret == 0) {
+        ret = mbedtls_aes_crypt_ctr(&aes, len, &nc_off, counter, stream_block, in, out);
+    }
+
+    mbedtls_aes_free(&aes);
+    memset(key, 0, sizeof(key));
+    memset(stream_block, 0, sizeof(stream_block));
+    return ret == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static bool mac_equal(const uint8_t *a, const uint8_t *b, size_t len)
+{
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+/* ============================================================================
+   BLOB PARSING
+   ============================================================================ */
+
+/* Check framing and signature, then decrypt the body into plain_out.
+   Returns the number of devices in the blob via device_count. */
+static esp_err_t verify_and_decrypt(const uint8_t *blob, size_t len, uint8_t *plain_out,
+                                    uint8_t *device_count)
+{
+    if (!blob || len < sizeof(zb_backup_header_t) + sizeof(zb_backup_network_t) + ZB_BACKUP_MAC_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const zb_backup_header_t *hdr = (const zb_backup_header_t *)blob;
+    if (memcmp(hdr->magic, ZB_BACKUP_MAGIC, sizeof(hdr->magic)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (hdr->version != ZB_BACKUP_VERSION) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (hdr->device_count > ZIGBEE_MAX_DEVICES) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    size_t body_len = sizeof(zb_backup_network_t) + hdr->device_count * sizeof(zb_backup_device_t);
+    if (len != sizeof(zb_backup_header_t) + body_len + ZB_BACKUP_MAC_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t mac[ZB_BACKUP_MAC_LEN];
+    size_t signed_len = sizeof(zb_backup_header_t) + body_len;
+    if (compute_mac(blob, signed_len, mac) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (!mac_equal(mac, blob + signed_len, ZB_BACKUP_MAC_LEN)) {
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    *device_count = hdr->device_count;
+    return crypt_ctr(hdr->iv, blob + sizeof(zb_backup_header_t), plain_out, body_len);
+}
+
+/* ============================================================================
+   EXPORT
+   ============================================================================ */
+
+esp_err_t zigbee_backup_export(uint8_t *out, size_t out_size, size_t *out_len)
+{
+    if (!out || !out_len || out_size < ZB_BACKUP_MAX_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!zigbee_is_network_ready() || !secret_configured()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint8_t plain[ZB_BACKUP_MAX_LEN];
+    zb_backup_network_t *net = (zb_backup_network_t *)plain;
+    memset(net, 0, sizeof(*net));
+
+    /* Snapshot stack state - we are called from the MQTT task */
+    esp_zb_lock_acquire(portMAX_DELAY);
+    net->channel = esp_zb_get_current_channel();
+    net->pan_id = esp_zb_get_pan_id();
+    esp_zb_get_extended_pan_id(net->ext_pan_id);
+    esp_zb_get_long_address(net->coordinator_ieee);
+    esp_err_t key_err = esp_zb_secur_primary_network_key_get(net->nwk_key);
+    if (counters_supported()) {
+        net->nwk_frame_counter = zb_nwk_get_outgoing_frame_counter();
+        net->aps_frame_counter = zb_aps_get_outgoing_frame_counter();
+    }
+    esp_zb_lock_release();
+
+    if (key_err != ESP_OK) {
+        ESP_LOGE(TAG, "Could not read network key: %s", esp_err_to_name(key_err));
+        memset(plain, 0, sizeof(plain));
+        return key_err;
+    }
+
+    const zigbee_device_table_t *table = zigbee_devices_snapshot();
+    int count = table->count;
+    zb_backup_device_t *rec = (zb_backup_device_t *)(plain + sizeof(*net));
+    for (int i = 0; i < count; i++) {
+        const zigbee_device_t *dev = &table->devices[i];
+        rec[i].short_addr = dev->short_addr;
+        memcpy(rec[i].ieee_addr, dev->ieee_addr, sizeof(rec[i].ieee_addr));
+        rec[i].endpoint = dev->endpoint;
+        rec[i].device_type = (uint8_t)dev->device_type;
+    }
+    zigbee_devices_snapshot_release(table);
+
+    zb_backup_header_t *hdr = (zb_backup_header_t *)out;
+    memcpy(hdr->magic, ZB_BACKUP_MAGIC, sizeof(hdr->magic));
+    hdr->version = ZB_BACKUP_VERSION;
+    hdr->device_count = (uint8_t)count;
+    hdr->reserved = 0;
+    esp_fill_random(hdr->iv, sizeof(hdr->iv));
+
+    uint8_t channel = net->channel;
+    uint16_t pan_id = net->pan_id;
+    size_t body_len = sizeof(*net) + count * sizeof(zb_backup_device_t);
+    esp_err_t err = crypt_ctr(hdr->iv, plain, out + sizeof(*hdr), body_len);
+    memset(plain, 0, sizeof(plain));
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    size_t signed_len = sizeof(*hdr) + body_len;
+    err = compute_mac(out, signed_len, out + signed_len);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    *out_len = signed_len + ZB_BACKUP_MAC_LEN;
+    ESP_LOGI(TAG, "Exported backup: channel %d, PAN 0x%04x, %d devices, %u bytes",
+             channel, pan_id, count, (unsigned)*out_len);
+    if (!counters_supported()) {
+        ESP_LOGW(TAG, "Frame counters not readable from this stack - a restore needs re-pairing");
+    }
+    return ESP_OK;
+}
+
+esp_err_t zigbee_backup_export_base64(char *out, size_t out_size)
+{
+    uint8_t blob[ZB_BACKUP_MAX_LEN];
+    size_t blob_len = 0;
+    esp_err_t err = zigbee_backup_export(blob, sizeof(blob), &blob_len);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    size_t written = 0;
+    if (mbedtls_base64_encode((unsigned char *)out, out_size, &written, blob, blob_len) != 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+/* ============================================================================
+   IMPORT
+   ============================================================================ */
+
+esp_err_t zigbee_backup_import(const uint8_t *blob, size_t len)
+{
+    if (!secret_configured()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint8_t plain[ZB_BACKUP_MAX_LEN];
+    uint8_t count = 0;
+    esp_err_t err = verify_and_decrypt(blob, len, plain, &count);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Backup rejected: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    const zb_backup_network_t *net = (const zb_backup_network_t *)plain;
+    ESP_LOGI(TAG, "Backup verified: channel %d, PAN 0x%04x, %d devices",
+             net->channel, net->pan_id, count);
+
+    /* Stage the blob as received - it stays encrypted at rest */
+    nvs_handle_t nvs;
+    err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, NVS_KEY_PENDING, blob, len);
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to stage backup: %s", esp_err_to_name(err));
+        memset(plain, 0, sizeof(plain));
+        return err;
+    }
+
+    /* The device table is ours, not the stack's - restore it right away,
+       as one change so readers never see a half-restored table */
+    zigbee_device_t devices[ZIGBEE_MAX_DEVICES] = {0};
+    const zb_backup_device_t *rec = (const zb_backup_device_t *)(plain + sizeof(*net));
+    for (int i = 0; i < count; i++) {
+        devices[i].short_addr = rec[i].short_addr;
+        devices[i].endpoint = rec[i].endpoint;
+        devices[i].device_type = (zigbee_device_type_t)rec[i].device_type;
+        devices[i].is_online = false;
+        memcpy(devices[i].ieee_addr, rec[i].ieee_addr, sizeof(devices[i].ieee_addr));
+    }
+    zigbee_devices_replace_all(devices, count);
+
+    memset(plain, 0, sizeof(plain));
+    ESP_LOGI(TAG, "Restore staged - network is rebuilt on the next boot");
+    return ESP_OK;
+}
+
+esp_err_t zigbee_backup_import_base64(const char *b64)
+{
+    if (!b64) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t blob[ZB_BACKUP_MAX_LEN];
+    size_t blob_len = 0;
+    if (mbedtls_base64_decode(blob, sizeof(blob), &blob_len,
+                              (const unsigned char *)b64, strlen(b64)) != 0) {
+        ESP_LOGE(TAG, "Backup is not valid base64 (or too large)");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return zigbee_backup_import(blob, blob_len);
+}
+
+/* ============================================================================
+   BOOT-TIME RESTORE
+   ============================================================================ */
+
+bool zigbee_backup_apply_pending(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;   /* Namespace only exists once a restore was staged */
+    }
+
+    uint8_t blob[ZB_BACKUP_MAX_LEN];
+    size_t len = sizeof(blob);
+    esp_err_t err = nvs_get_blob(nvs, NVS_KEY_PENDING, blob, &len);
+    nvs_close(nvs);
+    if (err != ESP_OK) {
+        return false;
+    }
+
+    uint8_t plain[ZB_BACKUP_MAX_LEN];
+    uint8_t count = 0;
+    err = verify_and_decrypt(blob, len, plain, &count);
+    if (err != ESP_OK) {
+        /* Staged blobs were verified on import - only a changed secret gets here */
+        ESP_LOGE(TAG, "Staged backup no longer verifies (%s), discarding", esp_err_to_name(err));
+        zigbee_backup_restore_complete();
+        return false;
+    }
+
+    zb_backup_network_t *net = (zb_backup_network_t *)plain;
+
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "╔══════════════════════════════════════════════════════════╗");
+    ESP_LOGI(TAG, "║  ♻️  RESTORING ZIGBEE NETWORK FROM BACKUP                 ║");
+    ESP_LOGI(TAG, "╚══════════════════════════════════════════════════════════╝");
+    ESP_LOGI(TAG, "  Channel: %d, PAN ID: 0x%04x, devices: %d", net->channel, net->pan_id, count);
+    ESP_LOGI(TAG, "");
+
+    /* Forget the current network, then preset the old one for formation */
+    esp_zb_nvram_erase_at_start(true);
+    esp_zb_set_long_address(net->coordinator_ieee);
+    esp_zb_set_pan_id(net->pan_id);
+    esp_zb_set_extended_pan_id(net->ext_pan_id);
+    if (net->channel >= 11 && net->channel <= 26) {
+        esp_zb_set_primary_network_channel_set(1UL << net->channel);
+    }
+    esp_zb_secur_network_key_set(net->nwk_key);
+
+    /* The counters can only be moved once formation has reset them */
+    s_restore_nwk_counter = net->nwk_frame_counter;
+    s_restore_aps_counter = net->aps_frame_counter;
+
+    memset(plain, 0, sizeof(plain));
+    s_restore_applied = true;
+    return true;
+}
+
+/* ============================================================================
+   FRAME COUNTERS AFTER A RESTORE (Zigbee task)
+   ============================================================================
+   Formation starts the counters from zero, below what the devices last saw
+   from the old coordinator, so until they are moved up every secured frame
+   is dropped as a replay - a key update sent now would be dropped too.
+   ============================================================================ */
+
+static void restore_frame_counters(void)
+{
+    if (!counters_supported() || s_restore_nwk_counter == 0) {
+        ESP_LOGW(TAG, "Backup has no frame counters - devices ignore the hub until paired again");
+        return;
+    }
+
+    uint32_t nwk = counter_after(s_restore_nwk_counter, zb_nwk_get_outgoing_frame_counter());
+    uint32_t aps = counter_after(s_restore_aps_counter, zb_aps_get_outgoing_frame_counter());
+    zb_nwk_set_outgoing_frame_counter(nwk);
+    zb_aps_set_outgoing_frame_counter(aps);
+    ESP_LOGI(TAG, "Frame counters restored: NWK %lu, APS %lu",
+             (unsigned long)nwk, (unsigned long)aps);
+}
+
+void zigbee_backup_restore_complete(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    if (nvs_erase_key(nvs, NVS_KEY_PENDING) == ESP_OK) {
+        nvs_commit(nvs);
+        if (s_restore_applied) {
+            ESP_LOGI(TAG, "Network restored from backup - devices rejoin without pairing");
+            s_restore_applied = false;
+            restore_frame_counters();
+        }
+    }
+    nvs_close(nvs);
+}
@@ -0,0 +1,119 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee Backup - Export/import of the coordinator's network state
+ *
+ * A backup holds everything a replacement coordinator needs to take over the
+ * existing network without re-pairing: network key, PAN ID, extended PAN ID,
+ * channel, the coordinator's IEEE address (devices trust it by that address)
+ * and the paired-device table.
+ *
+ * The blob is compact (about 100 bytes + 12 per device) and encrypted with
+ * AES-256-CTR, then HMAC-SHA256 signed (encrypt-then-MAC). Both keys are
+ * derived from ZIGBEE_BACKUP_SECRET in credentials.h, a setting of its own:
+ * without it (or with the template's placeholder) backup and restore are
+ * refused. So it is safe to pass through MQTT feeds, and a tampered or
+ * foreign blob is rejected.
+ *
+ * Restoring stages the blob in NVS and reboots. On the next start the Zigbee
+ * storage is wiped, the saved parameters are applied before esp_zb_start(),
+ * and the coordinator forms the same network again.
+ *
+ * The backup also holds the coordinator's outgoing NWK and APS frame
+ * counters. Devices drop any secured frame whose counter is not above the
+ * last one they saw from the coordinator, so once the network is formed
+ * again the counters are set ZB_BACKUP_COUNTER_MARGIN above the saved ones.
+ * The margin covers what the old coordinator sent after the export.
+ */
+
+#ifndef ZIGBEE_BACKUP_H
+#define ZIGBEE_BACKUP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "zigbee_hub.h"
+
+/* ============================================================================
+   ZIGBEE BACKUP CONFIGURATION
+   ============================================================================ */
+
+#define ZB_BACKUP_MAGIC             "HZBK"
+#define ZB_BACKUP_VERSION           2       /* 2: frame counters */
+#define ZB_BACKUP_IV_LEN            16
+#define ZB_BACKUP_MAC_LEN           32
+#define ZB_BACKUP_DEVICE_LEN        12      /* Packed device record */
+#define ZB_BACKUP_SECRET_MIN_LEN    16      /* Shorter secrets are refused */
+#define ZB_BACKUP_COUNTER_MARGIN    (1UL << 16) /* Added to the saved frame counters */
+#define ZB_BACKUP_MAX_LEN           (24 + 44 + ZIGBEE_MAX_DEVICES * ZB_BACKUP_DEVICE_LEN + ZB_BACKUP_MAC_LEN)
+#define ZB_BACKUP_BASE64_MAX_LEN    (((ZB_BACKUP_MAX_LEN + 2) / 3) * 4 + 1)
+
+/* ============================================================================
+   EXPORT / IMPORT
+   ============================================================================ */
+
+/**
+ * @brief Export the current network state as a signed, encrypted blob
+ *
+ * @param out Buffer of at least ZB_BACKUP_MAX_LEN bytes
+ * @param out_size Size of out
+ * @param out_len Bytes written
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if no network is formed
+ *         or ZIGBEE_BACKUP_SECRET is not set
+ */
+esp_err_t zigbee_backup_export(uint8_t *out, size_t out_size, size_t *out_len);
+
+/**
+ * @brief Export as a NUL-terminated base64 string (for MQTT / logs)
+ *
+ * @param out Buffer of at least ZB_BACKUP_BASE64_MAX_LEN bytes
+ * @param out_size Size of out
+ * @return ESP_OK on success
+ */
+esp_err_t zigbee_backup_export_base64(char *out, size_t out_size);
+
+/**
+ * @brief Verify a backup and stage it for restore on the next boot
+ *
+ * The device table is written immediately. The network parameters are applied
+ * by zigbee_backup_apply_pending() during the next Zigbee start.
+ *
+ * @param blob Backup blob
+ * @param len Blob length
+ * @return ESP_OK if staged, ESP_ERR_INVALID_CRC if the signature does not
+ *         match, ESP_ERR_INVALID_VERSION / ESP_ERR_INVALID_SIZE for bad blobs,
+ *         ESP_ERR_INVALID_STATE if ZIGBEE_BACKUP_SECRET is not set
+ */
+esp_err_t zigbee_backup_import(const uint8_t *blob, size_t len);
+
+/**
+ * @brief Base64 variant of zigbee_backup_import()
+ */
+esp_err_t zigbee_backup_import_base64(const char *b64);
+
+/* ============================================================================
+   BOOT-TIME RESTORE (called from zigbee_hub.c, Zigbee task)
+   ============================================================================ */
+
+/**
+ * @brief Apply a staged restore
+ *
+ * Call after esp_zb_init() and before esp_zb_start(). Wipes Zigbee storage
+ * and presets PAN ID, extended PAN ID, channel, network key and the
+ * coordinator IEEE address, so the following formation rebuilds the old network.
+ *
+ * @return true if a restore was applied
+ */
+bool zigbee_backup_apply_pending(void);
+
+/**
+ * @brief Network formed - clear the staged restore
+ *
+ * After a restore this also moves the outgoing frame counters past the
+ * saved ones, so devices accept the coordinator's frames again.
+ */
+void zigbee_backup_restore_complete(void);
+
+#endif /* ZIGBEE_BACKUP_H */
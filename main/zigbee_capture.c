@@ -0,0 +1,469 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee Capture - 802.15.4 driver taps, capture ring, pcap export
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "esp_ieee802154.h"
+#include "esp_zigbee_core.h"
+#include "mbedtls/base64.h"
+#include "lwip/sockets.h"
+#include "halo_tasks.h"
+#include "zigbee_hub.h"
+#include "zigbee_capture.h"
+
+static const char *TAG = "zb_capture";
+
+#define PSDU_MAX_LEN        127     /* aMaxPHYPacketSize, FCS included */
+#define FCS_LEN             2
+
+/* ============================================================================
+   CAPTURE RING
+   ============================================================================ */
+
+typedef struct {
+    int64_t ts_us;                  /* esp_timer time */
+    uint8_t len;                    /* MAC frame length without FCS */
+    bool tx;
+    int8_t rssi;                    /* RX only */
+    uint8_t lqi;                    /* RX only */
+    uint8_t data[PSDU_MAX_LEN - FCS_LEN];
+} capture_slot_t;
+
+/* Producers: radio ISR. Consumer: dump (MQTT task) or the stream task. */
+static capture_slot_t s_ring[ZB_CAPTURE_SLOTS];
+static volatile uint32_t s_head = 0;        /* Slots written */
+static volatile uint32_t s_tail = 0;        /* Slots read */
+static volatile bool s_capturing = false;
+static int64_t s_capture_start_us = 0;
+static portMUX_TYPE s_ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static volatile uint32_t s_frames_rx = 0;
+static volatile uint32_t s_frames_tx = 0;
+static volatile uint32_t s_dropped = 0;     /* Ring full */
+static volatile uint32_t s_cost_cycles_total = 0;
+static volatile uint32_t s_cost_cycles_max = 0;
+
+/* UDP streaming. The stream task owns the socket it sends on: control
+   calls hand it a new one (or -1 to stop) and the task closes the old one
+   itself, between drains, so a socket is never closed under a sendto(). */
+static portMUX_TYPE s_stream_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_handoff_pending = false;
+static int s_handoff_sock = -1;
+static struct sockaddr_in s_handoff_dest;
+static volatile bool s_streaming = false;
+
+/* ============================================================================
+   DRIVER TAPS (radio ISR)
+   ============================================================================ */
+
+/* The driver's own entry points into esp_ieee802154.c (not in a public
+   header). If an IDF release renames them, __real_* no longer resolves and
+   the link fails, rather than building a capture that never sees a frame. */
+void __real_ieee802154_inner_receive_done(uint8_t *frame, esp_ieee802154_frame_info_t *frame_info);
+void __real_ieee802154_inner_transmit_done(const uint8_t *frame, const uint8_t *ack,
+                                           esp_ieee802154_frame_info_t *ack_frame_info);
+
+static IRAM_ATTR void capture_frame(const uint8_t *frame, bool tx, int8_t rssi, uint8_t lqi)
+{
+    uint32_t start = esp_cpu_get_cycle_count();
+    uint8_t psdu_len = frame[0];
+    if (psdu_len <= FCS_LEN || psdu_len > PSDU_MAX_LEN) {
+        return;
+    }
+
+    portENTER_CRITICAL_SAFE(&s_ring_lock);
+    if (s_head - s_tail >= ZB_CAPTURE_SLOTS) {
+        s_dropped++;
+    } else {
+        capture_slot_t *slot = &s_ring[s_head % ZB_CAPTURE_SLOTS];
+        slot->ts_us = esp_timer_get_time();
+        slot->len = psdu_len - FCS_LEN;
+        slot->tx = tx;
+        slot->rssi = rssi;
+        slot->lqi = lqi;
+        memcpy(slot->data, &frame[1], slot->len);
+        s_head++;
+        if (tx) {
+            s_frames_tx++;
+        } else {
+            s_frames_rx++;
+        }
+    }
+    uint32_t cost = esp_cpu_get_cycle_count() - start;
+    s_cost_cycles_total += cost;
+    if (cost > s_cost_cycles_max) {
+        s_cost_cycles_max = cost;
+    }
+    portEXIT_CRITICAL_SAFE(&s_ring_lock);
+}
+
+IRAM_ATTR void __wrap_ieee802154_inner_receive_done(uint8_t *frame, esp_ieee802154_frame_info_t *frame_info)
+{
+    if (s_capturing) {
+        capture_frame(frame, false, frame_info->rssi, frame_info->lqi);
+    }
+    __real_ieee802154_inner_receive_done(frame, frame_info);
+}
+
+IRAM_ATTR void __wrap_ieee802154_inner_transmit_done(const uint8_t *frame, const uint8_t *ack,
+                                                     esp_ieee802154_frame_info_t *ack_frame_info)
+{
+    if (s_capturing) {
+        capture_frame(frame, true, 0, 0);
+    }
+    __real_ieee802154_inner_transmit_done(frame, ack, ack_frame_info);
+}
+
+/* ============================================================================
+   PCAP
+   ============================================================================ */
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t network;
+} pcap_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t incl_len;
+    uint32_t orig_len;
+} pcap_record_t;
+
+static const pcap_header_t s_pcap_header = {
+    .magic = 0xa1b2c3d4,
+    .version_major = 2,
+    .version_minor = 4,
+    .snaplen = PSDU_MAX_LEN,
+    .network = ZB_CAPTURE_LINKTYPE,
+};
+
+/* esp_timer -> wall clock, if SNTP has set it (otherwise time since boot) */
+static int64_t wall_clock_offset_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    if (tv.tv_sec < 1600000000) {
+        return 0;
+    }
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - esp_timer_get_time();
+}
+
+static void pcap_record_for(const capture_slot_t *slot, int64_t offset_us, pcap_record_t *rec)
+{
+    int64_t ts = slot->ts_us + offset_us;
+    rec->ts_sec = (uint32_t)(ts / 1000000);
+    rec->ts_usec = (uint32_t)(ts % 1000000);
+    rec->incl_len = slot->len;
+    rec->orig_len = slot->len;
+}
+
+static bool ring_pop(capture_slot_t *out)
+{
+    bool ok = false;
+    portENTER_CRITICAL(&s_ring_lock);
+    if (s_tail != s_head) {
+        *out = s_ring[s_tail % ZB_CAPTURE_SLOTS];
+        s_tail++;
+        ok = true;
+    }
+    portEXIT_CRITICAL(&s_ring_lock);
+    return ok;
+}
+
+/* ============================================================================
+   CONTROL
+   ============================================================================ */
+
+void zigbee_capture_print_network_key(void)
+{
+    if (!zigbee_is_network_ready()) {
+        printf("Zigbee network not formed yet\n");
+        return;
+    }
+    uint8_t key[16];
+    esp_zb_lock_acquire(portMAX_DELAY);
+    esp_err_t err = esp_zb_secur_primary_network_key_get(key);
+    esp_zb_lock_release();
+    if (err == ESP_OK) {
+        char hex[16 * 3];
+        for (int i = 0; i < 16; i++) {
+            snprintf(&hex[i * 3], 4, "%02x%s", key[i], i < 15 ? ":" : "");
+        }
+        /* printf, not the log: this must not end up in a forwarded log */
+        printf("Network key (Wireshark Zigbee prefs): %s\n", hex);
+        memset(hex, 0, sizeof(hex));
+    } else {
+        printf("Network key not available: %s\n", esp_err_to_name(err));
+    }
+    memset(key, 0, sizeof(key));
+}
+
+esp_err_t zigbee_capture_start(void)
+{
+    portENTER_CRITICAL(&s_ring_lock);
+    s_head = s_tail = 0;
+    s_frames_rx = s_frames_tx = s_dropped = 0;
+    s_cost_cycles_total = s_cost_cycles_max = 0;
+    s_capturing = true;
+    portEXIT_CRITICAL(&s_ring_lock);
+    s_capture_start_us = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "╔══════════════════════════════════════════════════════════╗");
+    ESP_LOGI(TAG, "║  🦈 802.15.4 CAPTURE STARTED                              ║");
+    ESP_LOGI(TAG, "╚══════════════════════════════════════════════════════════╝");
+    ESP_LOGI(TAG, "  Ring: %d frames. 'zbcap:dump' or 'zbcap:udp:<ip>:<port>' to read it out",
+             ZB_CAPTURE_SLOTS);
+    ESP_LOGI(TAG, "  Network key for decoding: 'zbcap key' on the serial console");
+    ESP_LOGI(TAG, "");
+    return ESP_OK;
+}
+
+void zigbee_capture_stop(void)
+{
+    s_capturing = false;
+    ESP_LOGI(TAG, "Capture stopped: %lu frames in the ring",
+             (unsigned long)(s_head - s_tail));
+}
+
+/* ============================================================================
+   DUMP (base64 in the log, see tools/zbcap_extract.py)
+   ============================================================================ */
+
+static uint8_t s_dump_buf[ZB_CAPTURE_DUMP_CHUNK];
+static size_t s_dump_len = 0;
+
+static void dump_flush(void)
+{
+    if (s_dump_len == 0) {
+        return;
+    }
+    unsigned char b64[((ZB_CAPTURE_DUMP_CHUNK + 2) / 3) * 4 + 1];
+    size_t b64_len = 0;
+    mbedtls_base64_encode(b64, sizeof(b64), &b64_len, s_dump_buf, s_dump_len);
+    b64[b64_len] = '\0';
+    ESP_LOGI(TAG, "ZBCAP:%s", b64);
+    s_dump_len = 0;
+}
+
+static void dump_bytes(const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    while (len > 0) {
+        size_t n = ZB_CAPTURE_DUMP_CHUNK - s_dump_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(&s_dump_buf[s_dump_len], p, n);
+        s_dump_len += n;
+        p += n;
+        len -= n;
+        if (s_dump_len == ZB_CAPTURE_DUMP_CHUNK) {
+            dump_flush();
+        }
+    }
+}
+
+esp_err_t zigbee_capture_dump(void)
+{
+    if (s_streaming) {
+        ESP_LOGW(TAG, "Streaming over UDP - stop it first (zbcap:udp:off)");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_head == s_tail) {
+        ESP_LOGW(TAG, "Nothing captured");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int64_t offset_us = wall_clock_offset_us();
+    int frames = 0;
+    capture_slot_t slot;
+    pcap_record_t rec;
+
+    ESP_LOGI(TAG, "ZBCAP BEGIN");
+    s_dump_len = 0;
+    dump_bytes(&s_pcap_header, sizeof(s_pcap_header));
+    while (ring_pop(&slot)) {
+        pcap_record_for(&slot, offset_us, &rec);
+        dump_bytes(&rec, sizeof(rec));
+        dump_bytes(slot.data, slot.len);
+        frames++;
+    }
+    dump_flush();
+    ESP_LOGI(TAG, "ZBCAP END %d frames", frames);
+    return ESP_OK;
+}
+
+/* ============================================================================
+   UDP STREAMING
+   ============================================================================ */
+
+static void stream_task(void *pvParameters)
+{
+    uint8_t packet[sizeof(pcap_record_t) + PSDU_MAX_LEN];
+    capture_slot_t slot;
+    int sock = -1;
+    struct sockaddr_in dest;
+    bool header_sent = false;
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(ZB_CAPTURE_UDP_DRAIN_MS));
+
+        portENTER_CRITICAL(&s_stream_lock);
+        bool adopt = s_handoff_pending;
+        int next = s_handoff_sock;
+        if (adopt) {
+            dest = s_handoff_dest;
+            s_handoff_pending = false;
+            s_handoff_sock = -1;
+        }
+        portEXIT_CRITICAL(&s_stream_lock);
+
+        if (adopt) {
+            if (sock >= 0) {
+                close(sock);
+            }
+            sock = next;
+            header_sent = false;
+        }
+        if (sock < 0) {
+            continue;
+        }
+
+        if (!header_sent) {
+            sendto(sock, &s_pcap_header, sizeof(s_pcap_header), 0,
+                   (struct sockaddr *)&dest, sizeof(dest));
+            header_sent = true;
+        }
+
+        int64_t offset_us = wall_clock_offset_us();
+        while (ring_pop(&slot)) {
+            pcap_record_t *rec = (pcap_record_t *)packet;
+            pcap_record_for(&slot, offset_us, rec);
+            memcpy(&packet[sizeof(*rec)], slot.data, slot.len);
+            sendto(sock, packet, sizeof(*rec) + slot.len, 0,
+                   (struct sockaddr *)&dest, sizeof(dest));
+        }
+    }
+}
+
+/* Give the stream task its next socket (-1 to stop); it closes the old one */
+static void stream_hand_off(int sock, const struct sockaddr_in *dest)
+{
+    int unclaimed = -1;
+    portENTER_CRITICAL(&s_stream_lock);
+    if (s_handoff_pending) {
+        unclaimed = s_handoff_sock;
+    }
+    s_handoff_sock = sock;
+    if (dest != NULL) {
+        s_handoff_dest = *dest;
+    }
+    s_handoff_pending = true;
+    s_streaming = sock >= 0;
+    portEXIT_CRITICAL(&s_stream_lock);
+
+    /* Handed over earlier but never picked up, so the task never used it */
+    if (unclaimed >= 0) {
+        close(unclaimed);
+    }
+}
+
+esp_err_t zigbee_capture_stream_udp(const char *host, uint16_t port)
+{
+    static bool task_started = false;
+
+    struct sockaddr_in dest = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+    };
+    if (port == 0 || inet_pton(AF_INET, host, &dest.sin_addr) != 1) {
+        ESP_LOGW(TAG, "Bad UDP destination '%s:%u'", host, port);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "UDP socket failed: errno %d", errno);
+        return ESP_FAIL;
+    }
+
+    if (!task_started) {
+        if (halo_task_create_static(HALO_TASK_ZB_CAPTURE, stream_task, NULL) == NULL) {
+            ESP_LOGE(TAG, "Failed to start stream task");
+            close(sock);
+            return ESP_FAIL;
+        }
+        task_started = true;
+    }
+    /* Replaces any stream already running */
+    stream_hand_off(sock, &dest);
+
+    if (!s_capturing) {
+        zigbee_capture_start();
+    }
+    ESP_LOGI(TAG, "Streaming pcap to %s:%u (e.g. nc -ul %u > halo.pcap)", host, port, port);
+    return ESP_OK;
+}
+
+void zigbee_capture_stream_stop(void)
+{
+    if (s_streaming) {
+        stream_hand_off(-1, NULL);
+        ESP_LOGI(TAG, "UDP streaming stopped");
+    }
+}
+
+/* ============================================================================
+   STATUS
+   ============================================================================ */
+
+void zigbee_capture_print_status(void)
+{
+    uint32_t frames = s_frames_rx + s_frames_tx;
+    uint32_t mhz = esp_rom_get_cpu_ticks_per_us();
+
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "╔══════════════════════════════════════════════════════════╗");
+    ESP_LOGI(TAG, "║  🦈 802.15.4 CAPTURE                                      ║");
+    ESP_LOGI(TAG, "╚══════════════════════════════════════════════════════════╝");
+    ESP_LOGI(TAG, "  State: %s%s", s_capturing ? "capturing" : "stopped",
+             s_streaming ? ", streaming over UDP" : "");
+    ESP_LOGI(TAG, "  Frames: %lu rx, %lu tx, %lu dropped (ring full), %lu in ring",
+             (unsigned long)s_frames_rx, (unsigned long)s_frames_tx,
+             (unsigned long)s_dropped, (unsigned long)(s_head - s_tail));
+    if (frames > 0 && mhz > 0) {
+        /* Cost is paid in the radio ISR, before the stack sees the frame */
+        ESP_LOGI(TAG, "  Cost per frame: avg %luns, max %luns",
+                 (unsigned long)((uint64_t)s_cost_cycles_total * 1000 / frames / mhz),
+                 (unsigned long)((uint64_t)s_cost_cycles_max * 1000 / mhz));
+    }
+    /* A formed coordinator sends a link status every 15s, so silence means
+       the taps are not on the driver's path */
+    if (s_capturing && s_frames_tx == 0 && zigbee_is_network_ready() &&
+        esp_timer_get_time() - s_capture_start_us > ZB_CAPTURE_TAP_CHECK_MS * 1000LL) {
+        ESP_LOGW(TAG, "  No frame sent in %ds of capture: the driver taps are not reached",
+                 ZB_CAPTURE_TAP_CHECK_MS / 1000);
+    }
+    ESP_LOGI(TAG, "");
+}
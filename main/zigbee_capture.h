@@ -0,0 +1,99 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee Capture - 802.15.4 frame capture exported as pcap
+ *
+ * The 802.15.4 driver hands every received frame and every transmitted
+ * frame to callbacks that the Zigbee stack implements. The build wraps the
+ * driver functions that call them (-Wl,--wrap, see main/CMakeLists.txt),
+ * so while a capture runs each frame is copied, with a timestamp, RSSI and
+ * LQI, into a RAM ring before the stack sees it. zbcap:status warns if a
+ * capture sees no transmitted frame at all, which means the wrap missed. The copy is done in the radio ISR
+ * and costs a slot copy of at most 127 bytes; zbcap:status shows the
+ * measured per-frame cost.
+ *
+ * The ring is read out as a pcap with link type 230
+ * (LINKTYPE_IEEE802_15_4_NOFCS), which Wireshark decodes as Zigbee:
+ *   - zbcap:dump prints it as base64 in the log
+ *     (tools/zbcap_extract.py turns the log back into a .pcap)
+ *   - zbcap:udp:<ip>:<port> streams it live, one pcap record per datagram
+ *     (nc -ul <port> > halo.pcap)
+ *
+ * NWK payloads are encrypted. 'zbcap key' on the serial console prints the
+ * network key to add under Wireshark's Zigbee protocol preferences. It is a
+ * console command only: no MQTT command can read the key.
+ */
+
+#ifndef ZIGBEE_CAPTURE_H
+#define ZIGBEE_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/* ============================================================================
+   ZIGBEE CAPTURE CONFIGURATION
+   ============================================================================ */
+
+#define ZB_CAPTURE_SLOTS            96      /* Frames held in RAM (~14KB, static) */
+#define ZB_CAPTURE_LINKTYPE         230     /* LINKTYPE_IEEE802_15_4_NOFCS */
+#define ZB_CAPTURE_UDP_DRAIN_MS     100     /* Streaming task period */
+#define ZB_CAPTURE_DUMP_CHUNK       48      /* pcap bytes per base64 log line */
+#define ZB_CAPTURE_TAP_CHECK_MS     60000   /* No tx frame by then = taps not reached */
+
+/* ============================================================================
+   API
+   ============================================================================ */
+
+/**
+ * @brief Clear the ring and start capturing
+ *
+ * @return ESP_OK
+ */
+esp_err_t zigbee_capture_start(void);
+
+/**
+ * @brief Stop capturing (frames already in the ring are kept for dumping)
+ */
+void zigbee_capture_stop(void);
+
+/**
+ * @brief Log the ring as a base64 pcap and empty it
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE if nothing was captured or
+ *         streaming is active
+ */
+esp_err_t zigbee_capture_dump(void);
+
+/**
+ * @brief Stream the capture as pcap over UDP
+ *
+ * Sends the pcap global header, then one datagram per captured frame.
+ *
+ * @param host IPv4 address of the receiver
+ * @param port UDP port
+ * @return ESP_OK on success
+ */
+esp_err_t zigbee_capture_stream_udp(const char *host, uint16_t port);
+
+/**
+ * @brief Stop UDP streaming
+ *
+ * The stream task closes the socket after its current drain.
+ */
+void zigbee_capture_stream_stop(void);
+
+/**
+ * @brief Print the network key on the serial console (not through the log)
+ *
+ * Called by the console's "zbcap key" only, never from the MQTT handler.
+ */
+void zigbee_capture_print_network_key(void);
+
+/**
+ * @brief Log capture counters and per-frame overhead
+ */
+void zigbee_capture_print_status(void);
+
+#endif /* ZIGBEE_CAPTURE_H */
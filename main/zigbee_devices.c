@@ -6,6 +6,10 @@
  */
 
 #include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "nvs.h"
@@ -22,13 +26,113 @@ static const char *TAG = "zigbee_devices";
 #define NVS_KEY_PREFIX      "dev_"      /* Devices stored as dev_0, dev_1, etc. */
 
 /* ============================================================================
-   DEVICE STORAGE
+   DEVICE STORAGE - copy-on-write snapshots
+   ============================================================================
+   Readers never see a table being modified: a writer copies the current
+   table into a free pool buffer, edits the copy and publishes it with one
+   atomic pointer store. A buffer is reused only when it is not current and
+   no reader holds it. Writers pick the buffer retired longest ago, so raw
+   pointers from zigbee_devices_get_by_*() stay intact for at least
+   ZIGBEE_DEVICE_SNAPSHOTS - 1 further writes.
    ============================================================================ */
 
-static zigbee_device_t s_devices[ZIGBEE_MAX_DEVICES];
-static int s_device_count = 0;
+static zigbee_device_table_t s_pool[ZIGBEE_DEVICE_SNAPSHOTS];
+static _Atomic uint32_t s_readers[ZIGBEE_DEVICE_SNAPSHOTS];
+static zigbee_device_table_t *_Atomic s_current = &s_pool[0];
+
+/* Writers (Zigbee task, plus MQTT for clear/restore) take turns */
+static SemaphoreHandle_t s_write_mutex = NULL;
+static StaticSemaphore_t s_write_mutex_buf;
+static uint32_t s_reclaim_waits = 0;        /* Writer found every buffer in use */
+
 static nvs_handle_t s_nvs_handle = 0;
 
+/* ============================================================================
+   SNAPSHOTS
+   ============================================================================ */
+
+const zigbee_device_table_t *zigbee_devices_snapshot(void)
+{
+    for (;;) {
+        zigbee_device_table_t *table = atomic_load(&s_current);
+        int slot = table - s_pool;
+        atomic_fetch_add(&s_readers[slot], 1);
+        /* A writer may have retired this buffer between the load and the
+           increment - only keep it if it is still the published one */
+        if (atomic_load(&s_current) == table) {
+            return table;
+        }
+        atomic_fetch_sub(&s_readers[slot], 1);
+    }
+}
+
+void zigbee_devices_snapshot_release(const zigbee_device_table_t *snap)
+{
+    if (snap) {
+        atomic_fetch_sub(&s_readers[snap - s_pool], 1);
+    }
+}
+
+bool zigbee_devices_find(uint16_t short_addr, zigbee_device_t *out)
+{
+    const zigbee_device_table_t *snap = zigbee_devices_snapshot();
+    bool found = false;
+    for (int i = 0; i < snap->count; i++) {
+        if (snap->devices[i].short_addr == short_addr) {
+            *out = snap->devices[i];
+            found = true;
+            break;
+        }
+    }
+    zigbee_devices_snapshot_release(snap);
+    return found;
+}
+
+/* Take the write mutex and return a private copy of the current table */
+static zigbee_device_table_t *write_begin(void)
+{
+    xSemaphoreTake(s_write_mutex, portMAX_DELAY);
+
+    zigbee_device_table_t *cur = atomic_load(&s_current);
+    int cur_slot = cur - s_pool;
+    for (;;) {
+        /* Oldest retired buffer first: the one right after the current */
+        for (int n = 1; n < ZIGBEE_DEVICE_SNAPSHOTS; n++) {
+            int slot = (cur_slot + n) % ZIGBEE_DEVICE_SNAPSHOTS;
+            if (atomic_load(&s_readers[slot]) == 0) {
+                zigbee_device_table_t *next = &s_pool[slot];
+                memcpy(next, cur, sizeof(*next));
+                next->version = cur->version + 1;
+                return next;
+            }
+        }
+        /* Every spare buffer is held by a reader - they only hold it briefly */
+        s_reclaim_waits++;
+        vTaskDelay(1);
+    }
+}
+
+static void write_publish(zigbee_device_table_t *next)
+{
+    atomic_store(&s_current, next);
+    xSemaphoreGive(s_write_mutex);
+}
+
+/* Publish and persist while still holding the mutex, so NVS always ends up
+   with the newest table */
+static esp_err_t write_commit(zigbee_device_table_t *next)
+{
+    atomic_store(&s_current, next);
+    esp_err_t ret = zigbee_devices_save();
+    xSemaphoreGive(s_write_mutex);
+    return ret;
+}
+
+static void write_abort(void)
+{
+    xSemaphoreGive(s_write_mutex);
+}
+
 /* ============================================================================
    NVS HELPERS
    ============================================================================ */
@@ -66,6 +170,10 @@ esp_err_t zigbee_devices_init(void)
 {
     ESP_LOGI(TAG, "Initializing Zigbee device storage...");
     
+    if (s_write_mutex == NULL) {
+        s_write_mutex = xSemaphoreCreateMutexStatic(&s_write_mutex_buf);
+    }
+    
     /* Open NVS namespace */
     esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &s_nvs_handle);
     if (ret != ESP_OK) {
@@ -78,7 +186,6 @@ esp_err_t zigbee_devices_init(void)
     ret = nvs_get_u8(s_nvs_handle, NVS_KEY_COUNT, &count);
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         /* First run, no devices stored */
-        s_device_count = 0;
         ESP_LOGI(TAG, "No stored devices found");
         return ESP_OK;
     } else if (ret != ESP_OK) {
@@ -91,18 +198,20 @@ esp_err_t zigbee_devices_init(void)
         count = ZIGBEE_MAX_DEVICES;
     }
     
-    /* Load each device */
-    s_device_count = 0;
+    /* Load each device into a new snapshot */
+    zigbee_device_table_t *next = write_begin();
+    next->count = 0;
     for (int i = 0; i < count; i++) {
-        if (nvs_load_device(i, &s_devices[s_device_count]) == ESP_OK) {
+        zigbee_device_t *dev = &next->devices[next->count];
+        if (nvs_load_device(i, dev) == ESP_OK) {
             ESP_LOGI(TAG, "Loaded device %d: addr=0x%04x, type=%d",
-                     s_device_count, s_devices[s_device_count].short_addr,
-                     s_devices[s_device_count].device_type);
-            s_device_count++;
+                     next->count, dev->short_addr, dev->device_type);
+            next->count++;
         }
     }
+    write_publish(next);
     
-    ESP_LOGI(TAG, "Loaded %d devices from storage", s_device_count);
+    ESP_LOGI(TAG, "Loaded %d devices from storage", next->count);
     return ESP_OK;
 }
 
@@ -126,6 +235,9 @@ esp_err_t zigbee_devices_add(const zigbee_device_t *device)
     if (!device) {
         return ESP_ERR_INVALID_ARG;
     }
+    if (s_write_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
     
     /* Validate device address - 0xffff is broadcast, not valid */
     if (device->short_addr == 0xffff) {
@@ -133,82 +245,112 @@ esp_err_t zigbee_devices_add(const zigbee_device_t *device)
         return ESP_ERR_INVALID_ARG;
     }
     
+    zigbee_device_table_t *next = write_begin();
+    
     /* Check if device already exists */
-    for (int i = 0; i < s_device_count; i++) {
+    for (int i = 0; i < next->count; i++) {
+        zigbee_device_t *existing = &next->devices[i];
         bool match_by_ieee = !is_ieee_addr_zero(device->ieee_addr) && 
-                             !is_ieee_addr_zero(s_devices[i].ieee_addr) &&
-                             memcmp(s_devices[i].ieee_addr, device->ieee_addr, 8) == 0;
-        bool match_by_short = s_devices[i].short_addr == device->short_addr;
+                             !is_ieee_addr_zero(existing->ieee_addr) &&
+                             memcmp(existing->ieee_addr, device->ieee_addr, 8) == 0;
+        bool match_by_short = existing->short_addr == device->short_addr;
         
         if (match_by_ieee || match_by_short) {
             /* Update existing device, but preserve BLIND type if already set */
             ESP_LOGI(TAG, "Updating existing device 0x%04x", device->short_addr);
             
-            zigbee_device_type_t preserved_type = s_devices[i].device_type;
-            memcpy(&s_devices[i], device, sizeof(zigbee_device_t));
+            zigbee_device_type_t preserved_type = existing->device_type;
+            memcpy(existing, device, sizeof(zigbee_device_t));
             
             /* Don't let LIGHT overwrite BLIND - blinds have Window Covering which is more specific */
             if (preserved_type == ZIGBEE_DEVICE_TYPE_BLIND && 
                 device->device_type == ZIGBEE_DEVICE_TYPE_LIGHT) {
                 ESP_LOGI(TAG, "Preserving BLIND type (not overwriting with LIGHT)");
-                s_devices[i].device_type = ZIGBEE_DEVICE_TYPE_BLIND;
+                existing->device_type = ZIGBEE_DEVICE_TYPE_BLIND;
             }
             
-            return zigbee_devices_save();
+            return write_commit(next);
         }
     }
     
     /* Add new device */
-    if (s_device_count >= ZIGBEE_MAX_DEVICES) {
+    if (next->count >= ZIGBEE_MAX_DEVICES) {
+        write_abort();
         ESP_LOGW(TAG, "Device storage full, cannot add more devices");
         return ESP_ERR_NO_MEM;
     }
     
-    memcpy(&s_devices[s_device_count], device, sizeof(zigbee_device_t));
-    s_device_count++;
+    memcpy(&next->devices[next->count], device, sizeof(zigbee_device_t));
+    next->count++;
     
     ESP_LOGI(TAG, "Added new device 0x%04x (type=%d), total: %d",
-             device->short_addr, device->device_type, s_device_count);
+             device->short_addr, device->device_type, next->count);
+    
+    return write_commit(next);
+}
+
+esp_err_t zigbee_devices_replace_all(const zigbee_device_t *devices, int count)
+{
+    if ((!devices && count > 0) || count < 0 || count > ZIGBEE_MAX_DEVICES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_write_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
     
-    return zigbee_devices_save();
+    zigbee_device_table_t *next = write_begin();
+    if (count > 0) {
+        memcpy(next->devices, devices, count * sizeof(zigbee_device_t));
+    }
+    next->count = count;
+    
+    ESP_LOGI(TAG, "Replaced device table: %d device(s)", count);
+    return write_commit(next);
 }
 
 esp_err_t zigbee_devices_remove(uint16_t short_addr)
 {
-    for (int i = 0; i < s_device_count; i++) {
-        if (s_devices[i].short_addr == short_addr) {
-            /* Shift remaining devices down */
-            for (int j = i; j < s_device_count - 1; j++) {
-                memcpy(&s_devices[j], &s_devices[j + 1], sizeof(zigbee_device_t));
-            }
-            s_device_count--;
+    if (s_write_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    zigbee_device_table_t *next = write_begin();
+    for (int i = 0; i < next->count; i++) {
+        if (next->devices[i].short_addr == short_addr) {
+            /* Shift remaining devices down - in our private copy only */
+            memmove(&next->devices[i], &next->devices[i + 1],
+                    (next->count - i - 1) * sizeof(zigbee_device_t));
+            next->count--;
             
-            ESP_LOGI(TAG, "Removed device 0x%04x, remaining: %d", short_addr, s_device_count);
-            return zigbee_devices_save();
+            ESP_LOGI(TAG, "Removed device 0x%04x, remaining: %d", short_addr, next->count);
+            return write_commit(next);
         }
     }
+    write_abort();
     
     return ESP_ERR_NOT_FOUND;
 }
 
 int zigbee_devices_get_count(void)
 {
-    return s_device_count;
+    return atomic_load(&s_current)->count;
 }
 
 const zigbee_device_t* zigbee_devices_get_by_index(int index)
 {
-    if (index < 0 || index >= s_device_count) {
+    const zigbee_device_table_t *table = atomic_load(&s_current);
+    if (index < 0 || index >= table->count) {
         return NULL;
     }
-    return &s_devices[index];
+    return &table->devices[index];
 }
 
 const zigbee_device_t* zigbee_devices_get_by_addr(uint16_t short_addr)
 {
-    for (int i = 0; i < s_device_count; i++) {
-        if (s_devices[i].short_addr == short_addr) {
-            return &s_devices[i];
+    const zigbee_device_table_t *table = atomic_load(&s_current);
+    for (int i = 0; i < table->count; i++) {
+        if (table->devices[i].short_addr == short_addr) {
+            return &table->devices[i];
         }
     }
     return NULL;
@@ -225,17 +367,21 @@ esp_err_t zigbee_devices_save(void)
         return ESP_ERR_INVALID_STATE;
     }
     
+    const zigbee_device_table_t *snap = zigbee_devices_snapshot();
+    
     /* Save device count */
-    esp_err_t ret = nvs_set_u8(s_nvs_handle, NVS_KEY_COUNT, (uint8_t)s_device_count);
+    esp_err_t ret = nvs_set_u8(s_nvs_handle, NVS_KEY_COUNT, (uint8_t)snap->count);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to save device count: %s", esp_err_to_name(ret));
+        zigbee_devices_snapshot_release(snap);
         return ret;
     }
     
     /* Save each device */
-    for (int i = 0; i < s_device_count; i++) {
-        ret = nvs_save_device(i, &s_devices[i]);
+    for (int i = 0; i < snap->count; i++) {
+        ret = nvs_save_device(i, &snap->devices[i]);
         if (ret != ESP_OK) {
+            zigbee_devices_snapshot_release(snap);
             return ret;
         }
     }
@@ -245,20 +391,28 @@ esp_err_t zigbee_devices_save(void)
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to commit NVS: %s", esp_err_to_name(ret));
     } else {
-        ESP_LOGD(TAG, "Saved %d devices to NVS", s_device_count);
+        ESP_LOGD(TAG, "Saved %d devices to NVS (table v%lu)", snap->count,
+                 (unsigned long)snap->version);
     }
     
+    zigbee_devices_snapshot_release(snap);
     return ret;
 }
 
 esp_err_t zigbee_devices_clear_all(void)
 {
-    s_device_count = 0;
+    if (s_write_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
     
+    zigbee_device_table_t *next = write_begin();
+    next->count = 0;
+    atomic_store(&s_current, next);
     if (s_nvs_handle != 0) {
         nvs_erase_all(s_nvs_handle);
         nvs_commit(s_nvs_handle);
     }
+    xSemaphoreGive(s_write_mutex);
     
     ESP_LOGI(TAG, "Cleared all devices");
     return ESP_OK;
@@ -270,15 +424,19 @@ esp_err_t zigbee_devices_clear_all(void)
 
 void zigbee_devices_print_all(void)
 {
-    ESP_LOGI(TAG, "=== Paired Zigbee Devices (%d) ===", s_device_count);
+    const zigbee_device_table_t *snap = zigbee_devices_snapshot();
+    
+    ESP_LOGI(TAG, "=== Paired Zigbee Devices (%d, table v%lu, %lu reclaim waits) ===",
+             snap->count, (unsigned long)snap->version, (unsigned long)s_reclaim_waits);
     
-    if (s_device_count == 0) {
+    if (snap->count == 0) {
         ESP_LOGI(TAG, "  (no devices paired)");
+        zigbee_devices_snapshot_release(snap);
         return;
     }
     
-    for (int i = 0; i < s_device_count; i++) {
-        const zigbee_device_t *dev = &s_devices[i];
+    for (int i = 0; i < snap->count; i++) {
+        const zigbee_device_t *dev = &snap->devices[i];
         const char *type_str = "Unknown";
         
         switch (dev->device_type) {
@@ -298,5 +456,5 @@ void zigbee_devices_print_all(void)
     }
     
     ESP_LOGI(TAG, "================================");
+    zigbee_devices_snapshot_release(snap);
 }
-
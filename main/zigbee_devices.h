@@ -3,14 +3,28 @@
  * SPDX-License-Identifier: CC0-1.0
  *
  * Zigbee Devices - Storage and persistence for paired Zigbee devices
+ *
+ * The table is copy-on-write. Every change publishes a new immutable
+ * snapshot, so readers on any task get a consistent view without locks.
  */
 
 #ifndef ZIGBEE_DEVICES_H
 #define ZIGBEE_DEVICES_H
 
+#include <stdint.h>
+#include <stdbool.h>
 #include "esp_err.h"
 #include "zigbee_hub.h"
 
+#define ZIGBEE_DEVICE_SNAPSHOTS     4       /* Current table + buffers for readers/writers */
+
+/* One immutable version of the device table */
+typedef struct {
+    uint32_t version;                           /* Bumped on every change */
+    int count;
+    zigbee_device_t devices[ZIGBEE_MAX_DEVICES];
+} zigbee_device_table_t;
+
 /* ============================================================================
    DEVICE STORAGE API
    ============================================================================ */
@@ -36,6 +50,15 @@ esp_err_t zigbee_devices_init(void);
  */
 esp_err_t zigbee_devices_add(const zigbee_device_t *device);
 
+/**
+ * @brief Replace the whole table in one change (used by backup restore)
+ * 
+ * @param devices Devices to store
+ * @param count Number of devices (0 to ZIGBEE_MAX_DEVICES)
+ * @return ESP_OK on success
+ */
+esp_err_t zigbee_devices_replace_all(const zigbee_device_t *devices, int count);
+
 /**
  * @brief Remove a device by short address
  * 
@@ -54,6 +77,10 @@ int zigbee_devices_get_count(void);
 /**
  * @brief Get device by index
  * 
+ * The pointer is into the current snapshot and stays intact for at least
+ * ZIGBEE_DEVICE_SNAPSHOTS - 1 further changes. Fine for short use in the
+ * Zigbee task; elsewhere use zigbee_devices_snapshot() or _find().
+ * 
  * @param index Index (0 to count-1)
  * @return Pointer to device, or NULL if invalid index
  */
@@ -62,11 +89,43 @@ const zigbee_device_t* zigbee_devices_get_by_index(int index);
 /**
  * @brief Get device by short address
  * 
+ * Same pointer lifetime as zigbee_devices_get_by_index().
+ * 
  * @param short_addr Short address to search
  * @return Pointer to device, or NULL if not found
  */
 const zigbee_device_t* zigbee_devices_get_by_addr(uint16_t short_addr);
 
+/**
+ * @brief Copy a device out of the current snapshot (any task)
+ * 
+ * @param short_addr Short address to search
+ * @param out Device copy
+ * @return true if found
+ */
+bool zigbee_devices_find(uint16_t short_addr, zigbee_device_t *out);
+
+/* ============================================================================
+   SNAPSHOTS
+   ============================================================================ */
+
+/**
+ * @brief Pin the current table (any task, lock-free)
+ * 
+ * The snapshot never changes while pinned. Release it promptly: a writer
+ * waits if every spare buffer is pinned.
+ * 
+ * @return Current table, never NULL
+ */
+const zigbee_device_table_t* zigbee_devices_snapshot(void);
+
+/**
+ * @brief Unpin a table from zigbee_devices_snapshot()
+ * 
+ * @param snap Snapshot to release (NULL is ignored)
+ */
+void zigbee_devices_snapshot_release(const zigbee_device_table_t *snap);
+
 /**
  * @brief Save all devices to NVS
  * 
@@ -20,6 +20,15 @@
 
 #include "zigbee_hub.h"
 #include "zigbee_devices.h"
+#include "radio_policy.h"
+#include "halo_tasks.h"
+#include "zigbee_ota.h"
+#include "zigbee_backup.h"
+#include "zigbee_remote.h"
+#include "zigbee_lights.h"
+#include "zigbee_routing.h"
+#include "zigbee_tuya.h"
+#include "halo_metrics.h"
 
 static const char *TAG = "zigbee_hub";
 
@@ -35,9 +44,6 @@ static const char *TAG = "zigbee_hub";
 #define ESP_MANUFACTURER_NAME       "\x04""HALO"        /* Length-prefixed string */
 #define ESP_MODEL_IDENTIFIER        "\x0B""HALO-ZB-HUB" /* Length-prefixed string */
 
-/* Tuya cluster ID - used for MoES/Tuya devices */
-#define TUYA_CLUSTER_ID             0xEF00
-
 /* Zigbee coordinator config macro */
 #define ESP_ZB_ZC_CONFIG() \
     { \
@@ -54,16 +60,18 @@ static const char *TAG = "zigbee_hub";
 
 static bool s_network_ready = false;
 static TaskHandle_t s_zigbee_task_handle = NULL;
-static esp_timer_handle_t s_scan_timer = NULL;
-static uint16_t s_scan_interval_sec = 0;
 
-/* Debug timer for periodic position query */
-static esp_timer_handle_t s_debug_timer = NULL;
-#define ZIGBEE_DEBUG_INTERVAL_SEC  5  /* Query every 5 seconds */
+/* Periodic jobs run as self-rearming scheduler alarms in the Zigbee task,
+   not in the shared esp_timer task: they walk stack tables and log a lot */
+static uint16_t s_scan_interval_sec = 0;    /* 0 = device scan off */
+static bool s_debug_active = false;
+/* Just over the per-device query gap, so zigbee_tuya never skips a debug query */
+#define ZIGBEE_DEBUG_INTERVAL_SEC  (ZB_TUYA_QUERY_MIN_GAP_MS / 1000 + 1)
+static metrics_histogram_t s_job_time = METRICS_HISTOGRAM_INIT("zb_periodic_job", "us");
 
 /* Finder mode state */
 static zigbee_state_t s_zigbee_state = ZIGBEE_STATE_INITIALIZING;
-static esp_timer_handle_t s_finder_timer = NULL;
+static bool s_finder_active = false;
 static int s_finder_elapsed_sec = 0;
 static bool s_finder_complete = false;
 static bool s_device_paired_during_finder = false;
@@ -74,7 +82,7 @@ static bool s_device_paired_during_finder = false;
 
 static void esp_zb_task(void *pvParameters);
 static void bdb_start_top_level_commissioning_cb(uint8_t mode_mask);
-static void finder_mode_timer_callback(void *arg);
+static void finder_mode_alarm(uint8_t param);
 static void start_finder_mode(void);
 static void stop_finder_mode(bool paired);
 static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id, const void *message);
@@ -110,7 +118,8 @@ bool zigbee_is_finder_complete(void)
    FINDER MODE - Actively search for new devices
    ============================================================================ */
 
-static void finder_mode_timer_callback(void *arg)
+/* Zigbee task */
+static void finder_mode_scan(void)
 {
     s_finder_elapsed_sec += ZIGBEE_FINDER_SCAN_INTERVAL;
     
@@ -134,10 +143,9 @@ static void finder_mode_timer_callback(void *arg)
         return;
     }
     
-    /* Scan neighbors */
+    /* Scan neighbors (already in the Zigbee task - no lock needed) */
     ESP_LOGI(TAG, "  Scanning for nearby Zigbee devices...");
     
-    esp_zb_lock_acquire(portMAX_DELAY);
     esp_zb_nwk_neighbor_info_t neighbor_info;
     esp_zb_nwk_info_iterator_t iterator = 0;  /* Start from beginning */
     bool found_any = false;
@@ -151,7 +159,6 @@ static void finder_mode_timer_callback(void *arg)
                  neighbor_info.depth);
         ret = esp_zb_nwk_get_next_neighbor(&iterator, &neighbor_info);
     }
-    esp_zb_lock_release();
     
     if (!found_any) {
         ESP_LOGI(TAG, "    (no devices in range yet - put your blind in pairing mode!)");
@@ -170,6 +177,21 @@ static void finder_mode_timer_callback(void *arg)
     }
 }
 
+static void finder_mode_alarm(uint8_t param)
+{
+    if (!s_finder_active) {
+        return;
+    }
+    int64_t start_us = esp_timer_get_time();
+    finder_mode_scan();
+    metrics_hist_record(&s_job_time, (uint32_t)(esp_timer_get_time() - start_us));
+    
+    if (s_finder_active) {
+        esp_zb_scheduler_alarm(finder_mode_alarm, 0, ZIGBEE_FINDER_SCAN_INTERVAL * 1000);
+    }
+}
+
+/* Zigbee task (signal handler) */
 static void start_finder_mode(void)
 {
     ESP_LOGI(TAG, "");
@@ -186,45 +208,20 @@ static void start_finder_mode(void)
     s_device_paired_during_finder = false;
     s_finder_complete = false;
     
-    /* Create finder timer */
-    esp_timer_create_args_t timer_args = {
-        .callback = finder_mode_timer_callback,
-        .arg = NULL,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "zb_finder_timer",
-    };
-    
-    esp_err_t ret = esp_timer_create(&timer_args, &s_finder_timer);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to create finder timer: %s", esp_err_to_name(ret));
-        s_finder_complete = true;
-        return;
-    }
-    
     /* Open network for devices to join */
     esp_zb_bdb_open_network(ZIGBEE_FINDER_TIMEOUT_SEC + 10);
     
-    /* Start periodic timer (every ZIGBEE_FINDER_SCAN_INTERVAL seconds) */
-    ret = esp_timer_start_periodic(s_finder_timer, 
-                                   (uint64_t)ZIGBEE_FINDER_SCAN_INTERVAL * 1000000);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start finder timer: %s", esp_err_to_name(ret));
-        esp_timer_delete(s_finder_timer);
-        s_finder_timer = NULL;
-        s_finder_complete = true;
-        return;
-    }
-    
-    /* Do an immediate first scan */
-    finder_mode_timer_callback(NULL);
+    /* Do an immediate first scan, then every ZIGBEE_FINDER_SCAN_INTERVAL seconds */
+    s_finder_active = true;
+    finder_mode_alarm(0);
 }
 
+/* Zigbee task (finder alarm or device registration) */
 static void stop_finder_mode(bool paired)
 {
-    if (s_finder_timer) {
-        esp_timer_stop(s_finder_timer);
-        esp_timer_delete(s_finder_timer);
-        s_finder_timer = NULL;
+    if (s_finder_active) {
+        s_finder_active = false;
+        esp_zb_scheduler_alarm_cancel(finder_mode_alarm, 0);
     }
     
     s_device_paired_during_finder = paired;
@@ -265,6 +262,9 @@ esp_err_t zigbee_hub_init(void)
         return ret;
     }
     
+    /* Light rooms (Zigbee groups) */
+    zigbee_lights_init();
+    
     /* Configure Zigbee platform */
     esp_zb_platform_config_t config = {
         .radio_config = {
@@ -277,8 +277,12 @@ esp_err_t zigbee_hub_init(void)
     
     ESP_ERROR_CHECK(esp_zb_platform_config(&config));
     
-    /* Create Zigbee task */
-    xTaskCreate(esp_zb_task, "zigbee_main", 8192, NULL, 5, &s_zigbee_task_handle);
+    /* Create Zigbee task (priority/stack from the task table) */
+    s_zigbee_task_handle = halo_task_create_static(HALO_TASK_ZIGBEE, esp_zb_task, NULL);
+    if (s_zigbee_task_handle == NULL) {
+        ESP_LOGE(TAG, "Failed to create Zigbee task");
+        return ESP_FAIL;
+    }
     
     ESP_LOGI(TAG, "Zigbee Hub initialization started");
     return ESP_OK;
@@ -386,6 +390,13 @@ static void zb_simple_desc_cb(esp_zb_zdp_status_t zdo_status, esp_zb_af_simple_d
         }
     }
     
+    /* Remotes and wall switches send On/Off / Level / Scenes instead of taking them */
+    if ((detected_type == ZIGBEE_DEVICE_TYPE_UNKNOWN || detected_type == ZIGBEE_DEVICE_TYPE_LIGHT) &&
+        zigbee_remote_is_controller(simple_desc)) {
+        detected_type = ZIGBEE_DEVICE_TYPE_SWITCH;
+        ESP_LOGI(TAG, "  Detected as SWITCH/REMOTE (Device ID: 0x%04x)", simple_desc->app_device_id);
+    }
+    
     /* If no standard cluster found but has Tuya cluster, identify by device ID */
     if (detected_type == ZIGBEE_DEVICE_TYPE_UNKNOWN && has_tuya_cluster) {
         /* Device ID 0x0051 = Smart Plug, but Tuya uses this for many things including blinds */
@@ -411,6 +422,7 @@ static void zb_simple_desc_cb(esp_zb_zdp_status_t zdo_status, esp_zb_af_simple_d
         case ZIGBEE_DEVICE_TYPE_BLIND:      type_name = "BLIND"; break;
         case ZIGBEE_DEVICE_TYPE_TUYA_BLIND: type_name = "TUYA_BLIND"; break;
         case ZIGBEE_DEVICE_TYPE_LIGHT:      type_name = "LIGHT"; break;
+        case ZIGBEE_DEVICE_TYPE_SWITCH:     type_name = "SWITCH"; break;
         default:                            type_name = "UNKNOWN"; break;
     }
     
@@ -420,6 +432,8 @@ static void zb_simple_desc_cb(esp_zb_zdp_status_t zdo_status, esp_zb_af_simple_d
         ESP_LOGI(TAG, "║  🪟 WINDOW COVERING (BLIND) DEVICE REGISTERED!           ║");
     } else if (detected_type == ZIGBEE_DEVICE_TYPE_TUYA_BLIND) {
         ESP_LOGI(TAG, "║  🪟 TUYA/MOES BLIND DEVICE REGISTERED!                   ║");
+    } else if (detected_type == ZIGBEE_DEVICE_TYPE_SWITCH) {
+        ESP_LOGI(TAG, "║  🎛️  REMOTE / SWITCH REGISTERED!                          ║");
     } else {
         ESP_LOGI(TAG, "║  💡 ON/OFF DEVICE (LIGHT/SWITCH) REGISTERED!             ║");
     }
@@ -439,6 +453,14 @@ static void zb_simple_desc_cb(esp_zb_zdp_status_t zdo_status, esp_zb_af_simple_d
     zigbee_devices_add(&device);
     s_discovery_ctx.device_registered = true;
     
+    /* Have the remote send its button presses straight to us */
+    if (detected_type == ZIGBEE_DEVICE_TYPE_SWITCH) {
+        zigbee_remote_bind(device.short_addr, device.ieee_addr, endpoint);
+    }
+    
+    /* Learn the full Tuya state now rather than on the first movement */
+    zigbee_tuya_device_awake(device.short_addr);
+    
     ESP_LOGI(TAG, "  ✅ %s registered! Total devices: %d", type_name, zigbee_get_device_count());
     ESP_LOGI(TAG, "");
     
@@ -485,6 +507,9 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
                 /* Subsequent boot - network already formed */
                 s_network_ready = true;
                 ESP_LOGI(TAG, "Network already formed");
+                zigbee_ota_server_start();
+                zigbee_routing_start();
+                zigbee_lights_start();
                 
                 /* Check if we have previously paired devices */
                 int device_count = zigbee_devices_get_count();
@@ -504,15 +529,14 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
                     /* Print what devices we have */
                     zigbee_print_network_status();
                     
-                    /* Send a ping to each stored device to trigger reconnection */
+                    /* Ask each stored Tuya device for all of its DPs: this both
+                       checks connectivity and fills in the device state */
                     ESP_LOGI(TAG, "");
-                    ESP_LOGI(TAG, "Pinging stored devices to verify connectivity...");
+                    ESP_LOGI(TAG, "Querying stored Tuya devices...");
                     for (int i = 0; i < device_count; i++) {
                         const zigbee_device_t *dev = zigbee_devices_get_by_index(i);
                         if (dev && dev->device_type == ZIGBEE_DEVICE_TYPE_TUYA_BLIND) {
-                            ESP_LOGI(TAG, "  Sending ping to Tuya blind 0x%04x...", dev->short_addr);
-                            /* Send a Tuya query to wake up the device */
-                            zigbee_blind_query_position(dev->short_addr);
+                            zigbee_tuya_query_all(dev);
                         }
                     }
                 } else {
@@ -545,6 +569,10 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
             ESP_LOGI(TAG, "");
             
             s_network_ready = true;
+            zigbee_ota_server_start();
+            zigbee_routing_start();
+            zigbee_lights_start();
+            zigbee_backup_restore_complete();
             
             /* Start network steering to allow devices to join */
             esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
@@ -599,6 +627,8 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
                     
                     ESP_LOGI(TAG, "  ✅ Device is now ONLINE and ready for commands!");
                     ESP_LOGI(TAG, "");
+                    
+                    zigbee_tuya_device_awake(dev_annce_params->device_short_addr);
                     break;
                 }
             }
@@ -657,87 +687,6 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
     }
 }
 
-/* ============================================================================
-   TUYA DATA HANDLER - Parse incoming Tuya 0xEF00 reports
-   ============================================================================ */
-
-/* Current blind position (updated from device reports) */
-static uint8_t s_blind_position_percent = 0;
-static bool s_blind_position_known = false;
-
-/* Parse Tuya data frame and log position updates */
-static void tuya_parse_report(const uint8_t *data, uint16_t len, uint16_t src_addr)
-{
-    if (len < 7) {
-        ESP_LOGW(TAG, "Tuya report too short: %d bytes", len);
-        return;
-    }
-    
-    /* Tuya frame format:
-       [0-1] Sequence number (2 bytes)
-       [2]   Data Point ID
-       [3]   Data Type
-       [4-5] Data Length (2 bytes, big endian)
-       [6+]  Data
-    */
-    uint8_t dp_id = data[2];
-    uint8_t data_type = data[3];
-    uint16_t data_len = (data[4] << 8) | data[5];
-    
-    ESP_LOGI(TAG, "");
-    ESP_LOGI(TAG, "┌─── TUYA REPORT from 0x%04x ───", src_addr);
-    ESP_LOGI(TAG, "│ DP ID: %d, Type: %d, Len: %d", dp_id, data_type, data_len);
-    
-    if (len < 6 + data_len) {
-        ESP_LOGW(TAG, "│ Data truncated!");
-        return;
-    }
-    
-    switch (dp_id) {
-        case 1:  /* Control state */
-            if (data_len >= 1) {
-                const char *state = (data[6] == 0) ? "OPEN/OPENING" :
-                                    (data[6] == 1) ? "STOPPED" :
-                                    (data[6] == 2) ? "CLOSE/CLOSING" : "UNKNOWN";
-                ESP_LOGI(TAG, "│ Control State: %d (%s)", data[6], state);
-            }
-            break;
-            
-        case 2:  /* Position percentage */
-            if (data_len >= 4) {
-                uint32_t pos = (data[6] << 24) | (data[7] << 16) | (data[8] << 8) | data[9];
-                s_blind_position_percent = (uint8_t)pos;
-                s_blind_position_known = true;
-                ESP_LOGI(TAG, "│ Position: %d%% (0%%=closed, 100%%=open)", s_blind_position_percent);
-            } else if (data_len >= 1) {
-                s_blind_position_percent = data[6];
-                s_blind_position_known = true;
-                ESP_LOGI(TAG, "│ Position: %d%% (0%%=closed, 100%%=open)", s_blind_position_percent);
-            }
-            break;
-            
-        case 3:  /* Sometimes motor direction */
-            ESP_LOGI(TAG, "│ Motor Direction: %d", data[6]);
-            break;
-            
-        case 5:  /* Sometimes limit reached */
-            ESP_LOGI(TAG, "│ Limit Status: %d", data[6]);
-            break;
-            
-        case 7:  /* Work state */
-            ESP_LOGI(TAG, "│ Work State: %d", data[6]);
-            break;
-            
-        default:
-            ESP_LOGI(TAG, "│ Unknown DP %d, data:", dp_id);
-            ESP_LOG_BUFFER_HEX_LEVEL(TAG, &data[6], data_len, ESP_LOG_INFO);
-            break;
-    }
-    
-    ESP_LOGI(TAG, "└────────────────────────────────");
-    ESP_LOGI(TAG, "");
-}
-
 /* Core action handler - receives all ZCL messages */
 static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id, const void *message)
 {
@@ -760,16 +709,39 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
                 (esp_zb_zcl_custom_cluster_command_message_t *)message;
             
             if (cmd->info.cluster == TUYA_CLUSTER_ID) {
-                ESP_LOGI(TAG, "Tuya command received: cmd_id=%d, len=%d", 
+                ESP_LOGD(TAG, "Tuya command received: cmd_id=%d, len=%d", 
                          cmd->info.command.id, cmd->data.size);
                 if (cmd->data.value && cmd->data.size > 0) {
-                    tuya_parse_report(cmd->data.value, cmd->data.size, 
-                                      cmd->info.src_address.u.short_addr);
+                    zigbee_tuya_handle_frame(cmd->info.src_address.u.short_addr,
+                                             cmd->info.command.id,
+                                             cmd->data.value, cmd->data.size);
                 }
             }
             break;
         }
         
+        case ESP_ZB_CORE_CMD_DEFAULT_RESP_CB_ID: {
+            /* Window Covering commands are answered with a default response */
+            esp_zb_zcl_cmd_default_resp_message_t *resp =
+                (esp_zb_zcl_cmd_default_resp_message_t *)message;
+            ESP_LOGD(TAG, "Default response: cluster=0x%04x, cmd=0x%02x, status=0x%02x",
+                     resp->info.cluster, resp->resp_to_cmd, resp->status_code);
+            if (resp->status_code != ESP_ZB_ZCL_STATUS_SUCCESS) {
+                ESP_LOGW(TAG, "0x%04x refused cmd 0x%02x (cluster 0x%04x): status 0x%02x",
+                         resp->info.src_address.u.short_addr, resp->resp_to_cmd,
+                         resp->info.cluster, resp->status_code);
+            }
+            radio_policy_zigbee_txn_end(resp->info.src_address.u.short_addr,
+                                        resp->info.header.tsn, resp->status_code);
+            break;
+        }
+        
+        case ESP_ZB_CORE_CMD_PRIVILEGE_COMMAND_REQ_CB_ID: {
+            /* Remote / switch button presses bound to the hub endpoint */
+            zigbee_remote_handle_command((const esp_zb_zcl_privilege_command_message_t *)message);
+            break;
+        }
+        
         case ESP_ZB_CORE_SET_ATTR_VALUE_CB_ID: {
             esp_zb_zcl_set_attr_value_message_t *set_msg = 
                 (esp_zb_zcl_set_attr_value_message_t *)message;
@@ -790,15 +762,26 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
    ZIGBEE MAIN TASK
    ============================================================================ */
 
+/* Runs inside the ZBOSS main loop - if the stack's queue stalls, these stop */
+static void zb_heartbeat_alarm(uint8_t param)
+{
+    halo_task_heartbeat(HALO_TASK_ZIGBEE);
+    esp_zb_scheduler_alarm(zb_heartbeat_alarm, 0, HALO_ZIGBEE_HEARTBEAT_PERIOD_MS);
+}
+
 static void esp_zb_task(void *pvParameters)
 {
     /* Initialize Zigbee stack as coordinator */
     esp_zb_cfg_t zb_nwk_cfg = ESP_ZB_ZC_CONFIG();
+    zigbee_routing_configure();  /* Table sizes must be set before init */
     esp_zb_init(&zb_nwk_cfg);
     
     /* Set primary channel */
     esp_zb_set_primary_network_channel_set(ESP_ZB_PRIMARY_CHANNEL_MASK);
     
+    /* A staged restore overrides the channel and presets the old network */
+    zigbee_backup_apply_pending();
+    
     /* Create endpoint list */
     esp_zb_ep_list_t *ep_list = esp_zb_ep_list_create();
     
@@ -817,6 +800,15 @@ static void esp_zb_task(void *pvParameters)
     esp_zb_cluster_list_add_identify_cluster(cluster_list, esp_zb_identify_cluster_create(NULL),
                                               ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
     
+    /* OTA Upgrade server - serves device firmware from the zb_ota partition */
+    zigbee_ota_add_server_cluster(cluster_list);
+    
+    /* On/Off, Level and Scenes servers - paired remotes bind to these */
+    zigbee_remote_add_clusters(cluster_list);
+    
+    /* On/Off, Level, Color and Groups clients - for controlling bulbs */
+    zigbee_lights_add_clusters(cluster_list);
+    
     /* Note: We tried adding Tuya cluster (0xEF00) as CLIENT to receive position reports,
        but it broke command sending. Commands work without it registered.
        The "cannot find custom client cluster" errors are annoying but harmless -
@@ -835,6 +827,9 @@ static void esp_zb_task(void *pvParameters)
     /* Register device */
     esp_zb_device_register(ep_list);
     
+    /* Remote commands go to zigbee_remote.c instead of the stack's own handling */
+    zigbee_remote_register(ZIGBEE_HUB_ENDPOINT);
+    
     /* Register action handler to receive reports from devices */
     esp_zb_core_action_handler_register(zb_action_handler);
     
@@ -843,6 +838,9 @@ static void esp_zb_task(void *pvParameters)
     /* Start Zigbee stack */
     ESP_ERROR_CHECK(esp_zb_start(false));
     
+    /* Heartbeat for the task supervisor */
+    esp_zb_scheduler_alarm(zb_heartbeat_alarm, 0, HALO_ZIGBEE_HEARTBEAT_PERIOD_MS);
+    
     /* Run Zigbee main loop (does not return) */
     esp_zb_stack_main_loop();
     
@@ -899,41 +897,29 @@ static bool is_blind_device(const zigbee_device_t *dev)
                    dev->device_type == ZIGBEE_DEVICE_TYPE_TUYA_BLIND);
 }
 
-static const zigbee_device_t* get_blind_device(uint16_t device_addr)
+/* Copies the blind out of a table snapshot: callers run on the MQTT task
+   while the Zigbee task may be updating the table */
+static const zigbee_device_t* get_blind_device(uint16_t device_addr, zigbee_device_t *out)
 {
-    if (device_addr == 0) {
-        /* Use first blind */
-        return zigbee_get_first_blind();
-    }
-    
-    /* Find by address */
-    int count = zigbee_devices_get_count();
-    for (int i = 0; i < count; i++) {
-        const zigbee_device_t *dev = zigbee_devices_get_by_index(i);
-        if (dev && dev->short_addr == device_addr && is_blind_device(dev)) {
-            return dev;
+    const zigbee_device_table_t *table = zigbee_devices_snapshot();
+    const zigbee_device_t *found = NULL;
+    for (int i = 0; i < table->count && !found; i++) {
+        const zigbee_device_t *dev = &table->devices[i];
+        /* 0 = first blind, otherwise match by address */
+        if (is_blind_device(dev) && (device_addr == 0 || dev->short_addr == device_addr)) {
+            *out = *dev;
+            found = out;
         }
     }
-    return NULL;
+    zigbee_devices_snapshot_release(table);
+    return found;
 }
 
 /* ============================================================================
    TUYA PROTOCOL - 0xEF00 Cluster Commands
    ============================================================================ */
 
-/* TUYA_CLUSTER_ID defined at top of file */
-#define TUYA_CMD_SET_DATA       0x00    /* Set data point command */
-
-/* Tuya Data Point IDs for blinds (may vary by device) */
-#define TUYA_DP_CONTROL         0x01    /* Control: 0=open, 1=stop, 2=close */
-#define TUYA_DP_PERCENT         0x02    /* Position percentage 0-100 */
-
-/* Tuya Data Types */
-#define TUYA_TYPE_RAW           0x00
-#define TUYA_TYPE_BOOL          0x01
-#define TUYA_TYPE_VALUE         0x02    /* 4-byte integer */
-#define TUYA_TYPE_STRING        0x03
-#define TUYA_TYPE_ENUM          0x04    /* 1-byte enum */
+/* Cluster, command, DP and type IDs are in zigbee_tuya.h */
 
 /* Tuya control commands - standard Tuya protocol values */
 #define TUYA_BLIND_OPEN         0x00    /* Open command */
@@ -996,17 +982,18 @@ static esp_err_t tuya_send_command(const zigbee_device_t *device, uint8_t dp_id,
         },
     };
     
+    /* The blind answers with a DP frame carrying our sequence number (or a
+       default response) - that ends the transaction */
+    radio_policy_zigbee_txn_begin();
+    
+    /* The send call returns the ZCL transaction sequence number, not an
+       esp_err_t: nothing to check here */
     esp_zb_lock_acquire(portMAX_DELAY);
-    esp_err_t ret = esp_zb_zcl_custom_cluster_cmd_req(&cmd_req);
+    uint8_t tsn = esp_zb_zcl_custom_cluster_cmd_req(&cmd_req);
+    zigbee_tuya_command_sent(device->short_addr, s_tuya_seq, tsn);
     esp_zb_lock_release();
     
-    /* Note: esp_zb_zcl_custom_cluster_cmd_req often returns error even when 
-       the command is successfully sent. This is a known quirk - ignore it. */
-    if (ret != ESP_OK) {
-        ESP_LOGD(TAG, "Tuya command send returned: %s (command likely sent anyway)", esp_err_to_name(ret));
-    }
-    
-    return ESP_OK;  /* Always return OK since command usually works */
+    return ESP_OK;
 }
 
 /* Send Tuya blind control command (open/stop/close) */
@@ -1048,7 +1035,8 @@ static esp_err_t tuya_blind_position(const zigbee_device_t *blind, uint8_t perce
 
 esp_err_t zigbee_blind_open(uint16_t device_addr)
 {
-    const zigbee_device_t *blind = get_blind_device(device_addr);
+    zigbee_device_t blind_copy;
+    const zigbee_device_t *blind = get_blind_device(device_addr, &blind_copy);
     if (!blind) {
         ESP_LOGW(TAG, "No blind device found");
         return ESP_ERR_NOT_FOUND;
@@ -1073,16 +1061,20 @@ esp_err_t zigbee_blind_open(uint16_t device_addr)
         .cmd_id = ESP_ZB_ZCL_CMD_WINDOW_COVERING_UP_OPEN,
     };
     
+    radio_policy_zigbee_txn_begin();  /* Ended by the ZCL default response */
+    
     esp_zb_lock_acquire(portMAX_DELAY);
-    esp_err_t ret = esp_zb_zcl_window_covering_cluster_send_cmd_req(&cmd_req);
+    uint8_t tsn = esp_zb_zcl_window_covering_cluster_send_cmd_req(&cmd_req);
+    radio_policy_zigbee_txn_sent(blind->short_addr, tsn);
     esp_zb_lock_release();
     
-    return ret;
+    return ESP_OK;
 }
 
 esp_err_t zigbee_blind_close(uint16_t device_addr)
 {
-    const zigbee_device_t *blind = get_blind_device(device_addr);
+    zigbee_device_t blind_copy;
+    const zigbee_device_t *blind = get_blind_device(device_addr, &blind_copy);
     if (!blind) {
         ESP_LOGW(TAG, "No blind device found");
         return ESP_ERR_NOT_FOUND;
@@ -1107,16 +1099,20 @@ esp_err_t zigbee_blind_close(uint16_t device_addr)
         .cmd_id = ESP_ZB_ZCL_CMD_WINDOW_COVERING_DOWN_CLOSE,
     };
     
+    radio_policy_zigbee_txn_begin();  /* Ended by the ZCL default response */
+    
     esp_zb_lock_acquire(portMAX_DELAY);
-    esp_err_t ret = esp_zb_zcl_window_covering_cluster_send_cmd_req(&cmd_req);
+    uint8_t tsn = esp_zb_zcl_window_covering_cluster_send_cmd_req(&cmd_req);
+    radio_policy_zigbee_txn_sent(blind->short_addr, tsn);
     esp_zb_lock_release();
     
-    return ret;
+    return ESP_OK;
 }
 
 esp_err_t zigbee_blind_stop(uint16_t device_addr)
 {
-    const zigbee_device_t *blind = get_blind_device(device_addr);
+    zigbee_device_t blind_copy;
+    const zigbee_device_t *blind = get_blind_device(device_addr, &blind_copy);
     if (!blind) {
         ESP_LOGW(TAG, "No blind device found");
         return ESP_ERR_NOT_FOUND;
@@ -1141,16 +1137,20 @@ esp_err_t zigbee_blind_stop(uint16_t device_addr)
         .cmd_id = ESP_ZB_ZCL_CMD_WINDOW_COVERING_STOP,
     };
     
+    radio_policy_zigbee_txn_begin();  /* Ended by the ZCL default response */
+    
     esp_zb_lock_acquire(portMAX_DELAY);
-    esp_err_t ret = esp_zb_zcl_window_covering_cluster_send_cmd_req(&cmd_req);
+    uint8_t tsn = esp_zb_zcl_window_covering_cluster_send_cmd_req(&cmd_req);
+    radio_policy_zigbee_txn_sent(blind->short_addr, tsn);
     esp_zb_lock_release();
     
-    return ret;
+    return ESP_OK;
 }
 
 esp_err_t zigbee_blind_set_position(uint16_t device_addr, uint8_t percent)
 {
-    const zigbee_device_t *blind = get_blind_device(device_addr);
+    zigbee_device_t blind_copy;
+    const zigbee_device_t *blind = get_blind_device(device_addr, &blind_copy);
     if (!blind) {
         ESP_LOGW(TAG, "No blind device found");
         return ESP_ERR_NOT_FOUND;
@@ -1185,16 +1185,20 @@ esp_err_t zigbee_blind_set_position(uint16_t device_addr, uint8_t percent)
         .cmd_id = ESP_ZB_ZCL_CMD_WINDOW_COVERING_GO_TO_LIFT_PERCENTAGE,
     };
     
+    radio_policy_zigbee_txn_begin();  /* Ended by the ZCL default response */
+    
     esp_zb_lock_acquire(portMAX_DELAY);
-    esp_err_t ret = esp_zb_zcl_window_covering_cluster_send_cmd_req(&cmd_req);
+    uint8_t tsn = esp_zb_zcl_window_covering_cluster_send_cmd_req(&cmd_req);
+    radio_policy_zigbee_txn_sent(blind->short_addr, tsn);
     esp_zb_lock_release();
     
-    return ret;
+    return ESP_OK;
 }
 
 esp_err_t zigbee_blind_query_position(uint16_t device_addr)
 {
-    const zigbee_device_t *blind = get_blind_device(device_addr);
+    zigbee_device_t blind_copy;
+    const zigbee_device_t *blind = get_blind_device(device_addr, &blind_copy);
     if (!blind) {
         ESP_LOGW(TAG, "No blind device found");
         return ESP_ERR_NOT_FOUND;
@@ -1204,42 +1208,18 @@ esp_err_t zigbee_blind_query_position(uint16_t device_addr)
     ESP_LOGI(TAG, "┌─── QUERYING BLIND POSITION ───");
     ESP_LOGI(TAG, "│ Device: 0x%04x, Endpoint: %d", blind->short_addr, blind->endpoint);
     
-    if (s_blind_position_known) {
-        ESP_LOGI(TAG, "│ Last known position: %d%%", s_blind_position_percent);
+    zigbee_tuya_state_t state;
+    if (zigbee_tuya_get_state(blind->short_addr, &state) &&
+        (state.known & ZB_TUYA_KNOWN_POSITION)) {
+        ESP_LOGI(TAG, "│ Last known position: %d%% open", state.position);
     } else {
         ESP_LOGI(TAG, "│ Position: UNKNOWN (no report received yet)");
     }
     ESP_LOGI(TAG, "└────────────────────────────────");
     
-    /* For Tuya devices, send a query command */
+    /* Tuya devices answer a data query with every DP in one burst */
     if (blind->device_type == ZIGBEE_DEVICE_TYPE_TUYA_BLIND) {
-        /* Tuya uses command 0x00 to get data - send empty payload to request all DPs */
-        ESP_LOGI(TAG, "Sending Tuya query request...");
-        
-        /* Just request DP 2 (position) */
-        uint8_t query_frame[3] = {0x00, s_tuya_seq++, 0x02};  /* Seq, DP ID */
-        
-        esp_zb_zcl_custom_cluster_cmd_req_t cmd_req = {
-            .zcl_basic_cmd = {
-                .dst_addr_u.addr_short = blind->short_addr,
-                .dst_endpoint = blind->endpoint,
-                .src_endpoint = ZIGBEE_HUB_ENDPOINT,
-            },
-            .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
-            .profile_id = ESP_ZB_AF_HA_PROFILE_ID,
-            .cluster_id = TUYA_CLUSTER_ID,
-            .custom_cmd_id = 0x00,  /* Query/get data */
-            .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_SRV,
-            .data = {
-                .type = ESP_ZB_ZCL_ATTR_TYPE_SET,
-                .size = sizeof(query_frame),
-                .value = query_frame,
-            },
-        };
-        
-        esp_zb_lock_acquire(portMAX_DELAY);
-        esp_zb_zcl_custom_cluster_cmd_req(&cmd_req);
-        esp_zb_lock_release();
+        return zigbee_tuya_query_all(blind);
     }
     
     return ESP_OK;
@@ -1284,8 +1264,9 @@ void zigbee_print_network_status(void)
              ieee_address[7], ieee_address[6], ieee_address[5], ieee_address[4],
              ieee_address[3], ieee_address[2], ieee_address[1], ieee_address[0]);
     
-    /* List all paired devices */
-    int count = zigbee_devices_get_count();
+    /* List all paired devices from one consistent snapshot */
+    const zigbee_device_table_t *table = zigbee_devices_snapshot();
+    int count = table->count;
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, "  Paired Devices: %d", count);
     ESP_LOGI(TAG, "  ─────────────────────────────────────────────────────────");
@@ -1294,28 +1275,23 @@ void zigbee_print_network_status(void)
         ESP_LOGI(TAG, "  (no devices paired - send 'blinds:pair' to start pairing)");
     } else {
         for (int i = 0; i < count; i++) {
-            const zigbee_device_t *dev = zigbee_devices_get_by_index(i);
-            if (dev) {
-                ESP_LOGI(TAG, "  [%d] Addr: 0x%04x  Endpoint: %d  Type: %-7s  %s",
-                         i, dev->short_addr, dev->endpoint,
-                         device_type_to_string(dev->device_type),
-                         dev->is_online ? "ONLINE" : "OFFLINE");
-                ESP_LOGI(TAG, "      IEEE: %02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x",
-                         dev->ieee_addr[7], dev->ieee_addr[6], dev->ieee_addr[5], dev->ieee_addr[4],
-                         dev->ieee_addr[3], dev->ieee_addr[2], dev->ieee_addr[1], dev->ieee_addr[0]);
-            }
+            const zigbee_device_t *dev = &table->devices[i];
+            ESP_LOGI(TAG, "  [%d] Addr: 0x%04x  Endpoint: %d  Type: %-7s  %s",
+                     i, dev->short_addr, dev->endpoint,
+                     device_type_to_string(dev->device_type),
+                     dev->is_online ? "ONLINE" : "OFFLINE");
+            ESP_LOGI(TAG, "      IEEE: %02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x",
+                     dev->ieee_addr[7], dev->ieee_addr[6], dev->ieee_addr[5], dev->ieee_addr[4],
+                     dev->ieee_addr[3], dev->ieee_addr[2], dev->ieee_addr[1], dev->ieee_addr[0]);
         }
     }
+    zigbee_devices_snapshot_release(table);
     ESP_LOGI(TAG, "");
 }
 
-void zigbee_scan_neighbors(void)
+/* Caller holds the Zigbee lock or runs in the Zigbee task */
+static void log_neighbors(void)
 {
-    if (!s_network_ready) {
-        ESP_LOGW(TAG, "Cannot scan neighbors - network not ready");
-        return;
-    }
-    
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, "╔══════════════════════════════════════════════════════════╗");
     ESP_LOGI(TAG, "║              ZIGBEE NEIGHBOR SCAN                        ║");
@@ -1324,8 +1300,6 @@ void zigbee_scan_neighbors(void)
     /* The Zigbee stack maintains a neighbor table of devices in radio range */
     /* We can iterate through it to see what's nearby */
     
-    esp_zb_lock_acquire(portMAX_DELAY);
-    
     /* Get the neighbor table iterator */
     esp_zb_nwk_neighbor_info_t neighbor_info;
     bool found_any = false;
@@ -1347,36 +1321,54 @@ void zigbee_scan_neighbors(void)
         ret = esp_zb_nwk_get_next_neighbor(&iterator, &neighbor_info);
     }
     
-    esp_zb_lock_release();
-    
     if (!found_any) {
         ESP_LOGI(TAG, "  (no neighbors found in radio range)");
     }
     ESP_LOGI(TAG, "");
 }
 
-/* Timer callback for periodic scanning */
-static void scan_timer_callback(void *arg)
+void zigbee_scan_neighbors(void)
 {
     if (!s_network_ready) {
+        ESP_LOGW(TAG, "Cannot scan neighbors - network not ready");
         return;
     }
     
-    /* Print network status and device list */
-    zigbee_print_network_status();
+    esp_zb_lock_acquire(portMAX_DELAY);
+    log_neighbors();
+    esp_zb_lock_release();
+}
+
+/* Zigbee task: periodic scanning */
+static void scan_alarm(uint8_t param)
+{
+    if (s_scan_interval_sec == 0) {
+        return;
+    }
     
-    /* Scan neighbors in radio range */
-    zigbee_scan_neighbors();
+    if (s_network_ready) {
+        int64_t start_us = esp_timer_get_time();
+        
+        /* Print network status and device list */
+        zigbee_print_network_status();
+        
+        /* Scan neighbors in radio range */
+        log_neighbors();
+        
+        /* Keep network open for devices that want to join */
+        /* This allows new devices in pairing mode to be discovered */
+        ESP_LOGI(TAG, "  Keeping network open for new devices...");
+        esp_zb_bdb_open_network(s_scan_interval_sec + 5);  /* Keep open until next scan */
+        
+        metrics_hist_record(&s_job_time, (uint32_t)(esp_timer_get_time() - start_us));
+    }
     
-    /* Keep network open for devices that want to join */
-    /* This allows new devices in pairing mode to be discovered */
-    ESP_LOGI(TAG, "  Keeping network open for new devices...");
-    esp_zb_bdb_open_network(s_scan_interval_sec + 5);  /* Keep open until next scan */
+    esp_zb_scheduler_alarm(scan_alarm, 0, (uint32_t)s_scan_interval_sec * 1000);
 }
 
 void zigbee_start_device_scan(uint16_t interval_sec)
 {
-    /* Stop existing timer if running */
+    /* Stop existing scan if running */
     zigbee_stop_device_scan();
     
     if (interval_sec == 0) {
@@ -1384,54 +1376,40 @@ void zigbee_start_device_scan(uint16_t interval_sec)
         return;
     }
     
+    /* Do an immediate scan, then re-arm from the alarm itself */
+    esp_zb_lock_acquire(portMAX_DELAY);
     s_scan_interval_sec = interval_sec;
-    
-    /* Create timer */
-    esp_timer_create_args_t timer_args = {
-        .callback = scan_timer_callback,
-        .arg = NULL,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "zb_scan_timer",
-    };
-    
-    esp_err_t ret = esp_timer_create(&timer_args, &s_scan_timer);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to create scan timer: %s", esp_err_to_name(ret));
-        return;
-    }
-    
-    /* Start periodic timer */
-    ret = esp_timer_start_periodic(s_scan_timer, (uint64_t)interval_sec * 1000000);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start scan timer: %s", esp_err_to_name(ret));
-        esp_timer_delete(s_scan_timer);
-        s_scan_timer = NULL;
-        return;
-    }
+    esp_zb_scheduler_alarm(scan_alarm, 0, 0);
+    esp_zb_lock_release();
     
     ESP_LOGI(TAG, "Device scanning started (every %d seconds)", interval_sec);
-    
-    /* Do an immediate scan */
-    scan_timer_callback(NULL);
 }
 
 void zigbee_stop_device_scan(void)
 {
-    if (s_scan_timer) {
-        esp_timer_stop(s_scan_timer);
-        esp_timer_delete(s_scan_timer);
-        s_scan_timer = NULL;
+    esp_zb_lock_acquire(portMAX_DELAY);
+    bool was_active = s_scan_interval_sec != 0;
+    s_scan_interval_sec = 0;
+    esp_zb_scheduler_alarm_cancel(scan_alarm, 0);
+    esp_zb_lock_release();
+    
+    if (was_active) {
         ESP_LOGI(TAG, "Device scanning stopped");
     }
-    s_scan_interval_sec = 0;
 }
 
 /* ============================================================================
    DEBUG: Periodic Position Query (for debugging Tuya blinds)
    ============================================================================ */
 
-static void debug_query_timer_callback(void *arg)
+/* Zigbee task */
+static void debug_query_alarm(uint8_t param)
 {
+    if (!s_debug_active) {
+        return;
+    }
+    esp_zb_scheduler_alarm(debug_query_alarm, 0, ZIGBEE_DEBUG_INTERVAL_SEC * 1000);
+    
     if (!s_network_ready) {
         return;
     }
@@ -1443,63 +1421,43 @@ static void debug_query_timer_callback(void *arg)
     }
     
     /* Query position of first blind */
+    int64_t start_us = esp_timer_get_time();
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, "═══════════════════════════════════════════════════════");
     ESP_LOGI(TAG, "  [DEBUG] PERIODIC ZIGBEE STATUS CHECK");
     ESP_LOGI(TAG, "═══════════════════════════════════════════════════════");
     
     zigbee_blind_query_position(0);
+    metrics_hist_record(&s_job_time, (uint32_t)(esp_timer_get_time() - start_us));
 }
 
-/* Start debug mode - queries blind every 5 seconds */
+/* Start debug mode - queries blind every ZIGBEE_DEBUG_INTERVAL_SEC */
 void zigbee_start_debug_mode(void)
 {
-    /* Stop existing timer if running */
-    if (s_debug_timer) {
-        esp_timer_stop(s_debug_timer);
-        esp_timer_delete(s_debug_timer);
-        s_debug_timer = NULL;
-    }
-    
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, "╔══════════════════════════════════════════════════════════╗");
     ESP_LOGI(TAG, "║  🔧 ZIGBEE DEBUG MODE ENABLED                            ║");
-    ESP_LOGI(TAG, "║  Querying blind position every %d seconds                ║", ZIGBEE_DEBUG_INTERVAL_SEC);
+    ESP_LOGI(TAG, "║  Querying blind position every %2d seconds               ║", ZIGBEE_DEBUG_INTERVAL_SEC);
     ESP_LOGI(TAG, "╚══════════════════════════════════════════════════════════╝");
     ESP_LOGI(TAG, "");
     
-    esp_timer_create_args_t timer_args = {
-        .callback = debug_query_timer_callback,
-        .arg = NULL,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "zb_debug_timer",
-    };
-    
-    esp_err_t ret = esp_timer_create(&timer_args, &s_debug_timer);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to create debug timer: %s", esp_err_to_name(ret));
-        return;
-    }
-    
-    ret = esp_timer_start_periodic(s_debug_timer, (uint64_t)ZIGBEE_DEBUG_INTERVAL_SEC * 1000000);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start debug timer: %s", esp_err_to_name(ret));
-        esp_timer_delete(s_debug_timer);
-        s_debug_timer = NULL;
-        return;
-    }
-    
-    /* Do an immediate query */
-    debug_query_timer_callback(NULL);
+    /* Restart the cycle with an immediate query */
+    esp_zb_lock_acquire(portMAX_DELAY);
+    esp_zb_scheduler_alarm_cancel(debug_query_alarm, 0);
+    s_debug_active = true;
+    esp_zb_scheduler_alarm(debug_query_alarm, 0, 0);
+    esp_zb_lock_release();
 }
 
 void zigbee_stop_debug_mode(void)
 {
-    if (s_debug_timer) {
-        esp_timer_stop(s_debug_timer);
-        esp_timer_delete(s_debug_timer);
-        s_debug_timer = NULL;
+    esp_zb_lock_acquire(portMAX_DELAY);
+    bool was_active = s_debug_active;
+    s_debug_active = false;
+    esp_zb_scheduler_alarm_cancel(debug_query_alarm, 0);
+    esp_zb_lock_release();
+    
+    if (was_active) {
         ESP_LOGI(TAG, "Zigbee debug mode stopped");
     }
 }
-
@@ -16,7 +16,7 @@
    ZIGBEE HUB CONFIGURATION
    ============================================================================ */
 
-#define ZIGBEE_MAX_DEVICES          10      /* Maximum number of paired devices */
+#define ZIGBEE_MAX_DEVICES          32      /* Maximum number of paired devices */
 #define ZIGBEE_HUB_ENDPOINT         1       /* Hub's own endpoint */
 #define ZIGBEE_PRIMARY_CHANNEL      13      /* Zigbee channel (11-26, 13 is common) */
 #define ZIGBEE_PAIRING_TIMEOUT      180     /* Default pairing timeout in seconds */
@@ -129,6 +129,9 @@ int zigbee_get_device_count(void);
 /**
  * @brief Get device by index
  * 
+ * Points into the current device table snapshot - see
+ * zigbee_devices_get_by_index() for how long it stays valid.
+ * 
  * @param index Device index (0 to device_count-1)
  * @return Pointer to device info, or NULL if invalid index
  */
@@ -137,6 +140,8 @@ const zigbee_device_t* zigbee_get_device(int index);
 /**
  * @brief Get first paired blind device
  * 
+ * Same pointer lifetime as zigbee_get_device().
+ * 
  * @return Pointer to blind device, or NULL if no blind paired
  */
 const zigbee_device_t* zigbee_get_first_blind(void);
@@ -0,0 +1,622 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee Lights - Bulb control, rooms (groups) and ring follow
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "esp_zigbee_core.h"
+#include "ha/esp_zigbee_ha_standard.h"
+#include "zigbee_hub.h"
+#include "zigbee_devices.h"
+#include "radio_policy.h"
+#include "zigbee_lights.h"
+
+static const char *TAG = "zb_lights";
+
+#define NVS_NAMESPACE       "zb_lights"
+#define NVS_KEY_ROOMS       "rooms"
+
+/* ============================================================================
+   STATE
+   ============================================================================ */
+
+/* Written by the command handler, read by the Zigbee task (ring follow) */
+static zigbee_light_room_t s_rooms[ZB_LIGHT_MAX_ROOMS];
+static portMUX_TYPE s_rooms_lock = portMUX_INITIALIZER_UNLOCKED;   /* Also guards s_follow */
+
+/* Ring state: wanted by the render loop, last pushed to following rooms by the Zigbee task */
+typedef struct {
+    bool on;
+    uint8_t percent;
+    uint8_t r, g, b;
+} ring_state_t;
+
+static struct {
+    ring_state_t want;
+    bool want_set;
+    ring_state_t sent;
+    bool valid;                 /* sent is what the rooms show */
+    int64_t sent_us;
+    uint32_t updates;
+    uint32_t frames;
+} s_follow;
+
+static bool s_started = false;
+
+/* Rooms as stored before member lists were kept (NVS blob of 4 of these) */
+typedef struct {
+    char name[ZB_LIGHT_ROOM_NAME_LEN];
+    uint16_t group_id;
+    uint8_t light_count;
+    bool follow_ring;
+    bool used;
+} legacy_room_t;
+
+/* ============================================================================
+   PERSISTENCE
+   ============================================================================ */
+
+static esp_err_t save_rooms(void)
+{
+    zigbee_light_room_t rooms[ZB_LIGHT_MAX_ROOMS];
+    portENTER_CRITICAL(&s_rooms_lock);
+    memcpy(rooms, s_rooms, sizeof(rooms));
+    portEXIT_CRITICAL(&s_rooms_lock);
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(nvs, NVS_KEY_ROOMS, rooms, sizeof(rooms));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save rooms: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t zigbee_lights_init(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return ESP_OK;  /* No rooms yet */
+    }
+
+    size_t size = 0;
+    esp_err_t err = nvs_get_blob(nvs, NVS_KEY_ROOMS, NULL, &size);
+    if (err == ESP_OK && size == sizeof(s_rooms)) {
+        err = nvs_get_blob(nvs, NVS_KEY_ROOMS, s_rooms, &size);
+    } else if (err == ESP_OK && size == ZB_LIGHT_MAX_ROOMS * sizeof(legacy_room_t)) {
+        /* Older layout: keep the rooms, their members are not known */
+        legacy_room_t legacy[ZB_LIGHT_MAX_ROOMS];
+        err = nvs_get_blob(nvs, NVS_KEY_ROOMS, legacy, &size);
+        for (int i = 0; err == ESP_OK && i < ZB_LIGHT_MAX_ROOMS; i++) {
+            memcpy(s_rooms[i].name, legacy[i].name, sizeof(s_rooms[i].name));
+            s_rooms[i].group_id = legacy[i].group_id;
+            s_rooms[i].follow_ring = legacy[i].follow_ring;
+            s_rooms[i].used = legacy[i].used;
+        }
+        if (err == ESP_OK) {
+            ESP_LOGW(TAG, "Rooms saved by an older version - add their lights again to list them");
+        }
+    } else if (err == ESP_OK) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    nvs_close(nvs);
+    if (err != ESP_OK) {
+        memset(s_rooms, 0, sizeof(s_rooms));
+        return ESP_OK;
+    }
+
+    int count = 0;
+    for (int i = 0; i < ZB_LIGHT_MAX_ROOMS; i++) {
+        if (s_rooms[i].used) count++;
+    }
+    ESP_LOGI(TAG, "Loaded %d room(s)", count);
+    return ESP_OK;
+}
+
+/* ============================================================================
+   SETUP
+   ============================================================================ */
+
+void zigbee_lights_add_clusters(esp_zb_cluster_list_t *cluster_list)
+{
+    /* Client roles: we send these commands to bulbs */
+    esp_zb_cluster_list_add_on_off_cluster(cluster_list, esp_zb_on_off_cluster_create(NULL),
+                                           ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
+    esp_zb_cluster_list_add_level_cluster(cluster_list, esp_zb_level_cluster_create(NULL),
+                                          ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
+    esp_zb_cluster_list_add_color_control_cluster(cluster_list, esp_zb_color_control_cluster_create(NULL),
+                                                  ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
+    esp_zb_cluster_list_add_groups_cluster(cluster_list, esp_zb_groups_cluster_create(NULL),
+                                           ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
+}
+
+/* Call with s_rooms_lock held */
+static zigbee_light_room_t *find_room(const char *name)
+{
+    for (int i = 0; i < ZB_LIGHT_MAX_ROOMS; i++) {
+        if (s_rooms[i].used && strcmp(s_rooms[i].name, name) == 0) {
+            return &s_rooms[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t zigbee_light_resolve(const char *name, zigbee_light_target_t *out)
+{
+    if (!name || !out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (strncmp(name, "0x", 2) == 0) {
+        uint16_t addr = (uint16_t)strtol(name, NULL, 16);
+        zigbee_device_t dev;
+        if (!zigbee_devices_find(addr, &dev) || dev.device_type != ZIGBEE_DEVICE_TYPE_LIGHT) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        out->addr = dev.short_addr;
+        out->endpoint = dev.endpoint;
+        out->is_group = false;
+        return ESP_OK;
+    }
+
+    portENTER_CRITICAL(&s_rooms_lock);
+    const zigbee_light_room_t *room = find_room(name);
+    uint16_t group_id = room ? room->group_id : 0;
+    portEXIT_CRITICAL(&s_rooms_lock);
+    if (!room) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    out->addr = group_id;
+    out->endpoint = 0;
+    out->is_group = true;
+    return ESP_OK;
+}
+
+/* ============================================================================
+   CONTROL
+   ============================================================================ */
+
+static void fill_basic_cmd(const zigbee_light_target_t *target, esp_zb_zcl_basic_cmd_t *cmd,
+                           esp_zb_aps_address_mode_t *mode)
+{
+    cmd->dst_addr_u.addr_short = target->addr;
+    cmd->dst_endpoint = target->endpoint;
+    cmd->src_endpoint = ZIGBEE_HUB_ENDPOINT;
+    *mode = target->is_group ? ESP_ZB_APS_ADDR_MODE_16_GROUP_ENDP_NOT_PRESENT
+                             : ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT;
+
+    /* Groupcasts get no default response, so only unicasts are timed */
+    if (!target->is_group) {
+        radio_policy_zigbee_txn_begin();
+    }
+}
+
+/* Lets the default response carrying this TSN end the transaction */
+static void txn_sent(const zigbee_light_target_t *target, uint8_t tsn)
+{
+    if (!target->is_group) {
+        radio_policy_zigbee_txn_sent(target->addr, tsn);
+    }
+}
+
+/* The send_* helpers build and send one frame. Call them from the Zigbee
+   task or with the Zigbee lock held; the public calls take the lock. */
+
+static void send_on_off(const zigbee_light_target_t *target, bool on)
+{
+    esp_zb_zcl_on_off_cmd_t cmd_req = {
+        .on_off_cmd_id = on ? ESP_ZB_ZCL_CMD_ON_OFF_ON_ID : ESP_ZB_ZCL_CMD_ON_OFF_OFF_ID,
+    };
+    fill_basic_cmd(target, &cmd_req.zcl_basic_cmd, &cmd_req.address_mode);
+    txn_sent(target, esp_zb_zcl_on_off_cmd_req(&cmd_req));
+
+    ESP_LOGI(TAG, "%s 0x%04x: %s", target->is_group ? "Group" : "Light", target->addr, on ? "ON" : "OFF");
+}
+
+/* "With On/Off" turns the bulb on first - one frame for on + dim */
+static void send_level(const zigbee_light_target_t *target, uint8_t percent, uint16_t transition_ds)
+{
+    esp_zb_zcl_move_to_level_cmd_t cmd_req = {
+        .level = (uint8_t)((percent * 254 + 50) / 100),
+        .transition_time = transition_ds,
+    };
+    fill_basic_cmd(target, &cmd_req.zcl_basic_cmd, &cmd_req.address_mode);
+    txn_sent(target, esp_zb_zcl_level_move_to_level_with_onoff_cmd_req(&cmd_req));
+
+    ESP_LOGI(TAG, "%s 0x%04x: level %d%% over %d.%ds", target->is_group ? "Group" : "Light",
+             target->addr, percent, transition_ds / 10, transition_ds % 10);
+}
+
+esp_err_t zigbee_light_on_off(const zigbee_light_target_t *target, bool on)
+{
+    if (!zigbee_is_network_ready()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_zb_lock_acquire(portMAX_DELAY);
+    send_on_off(target, on);
+    esp_zb_lock_release();
+    return ESP_OK;
+}
+
+esp_err_t zigbee_light_set_level(const zigbee_light_target_t *target, uint8_t percent,
+                                 uint16_t transition_ds)
+{
+    if (percent == 0) {
+        return zigbee_light_on_off(target, false);
+    }
+    if (!zigbee_is_network_ready()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (percent > 100) percent = 100;
+
+    esp_zb_lock_acquire(portMAX_DELAY);
+    send_level(target, percent, transition_ds);
+    esp_zb_lock_release();
+    return ESP_OK;
+}
+
+/* sRGB -> CIE 1931 xy, scaled to the ZCL 0..65279 range */
+static void rgb_to_xy(uint8_t r8, uint8_t g8, uint8_t b8, uint16_t *x_out, uint16_t *y_out)
+{
+    float rgb[3] = { r8 / 255.0f, g8 / 255.0f, b8 / 255.0f };
+    for (int i = 0; i < 3; i++) {
+        rgb[i] = (rgb[i] > 0.04045f) ? powf((rgb[i] + 0.055f) / 1.055f, 2.4f) : rgb[i] / 12.92f;
+    }
+
+    float X = rgb[0] * 0.4124f + rgb[1] * 0.3576f + rgb[2] * 0.1805f;
+    float Y = rgb[0] * 0.2126f + rgb[1] * 0.7152f + rgb[2] * 0.0722f;
+    float Z = rgb[0] * 0.0193f + rgb[1] * 0.1192f + rgb[2] * 0.9505f;
+    float sum = X + Y + Z;
+
+    float x = 0.3127f, y = 0.3290f;     /* Black: fall back to the D65 white point */
+    if (sum > 0.0f) {
+        x = X / sum;
+        y = Y / sum;
+    }
+    *x_out = (uint16_t)(x * 65279.0f);
+    *y_out = (uint16_t)(y * 65279.0f);
+}
+
+static void send_color(const zigbee_light_target_t *target, uint8_t r, uint8_t g, uint8_t b,
+                       uint16_t transition_ds)
+{
+    esp_zb_zcl_color_move_to_color_cmd_t cmd_req = {
+        .transition_time = transition_ds,
+    };
+    rgb_to_xy(r, g, b, &cmd_req.color_x, &cmd_req.color_y);
+    fill_basic_cmd(target, &cmd_req.zcl_basic_cmd, &cmd_req.address_mode);
+    txn_sent(target, esp_zb_zcl_color_move_to_color_cmd_req(&cmd_req));
+
+    ESP_LOGI(TAG, "%s 0x%04x: color #%02X%02X%02X (xy %u,%u)", target->is_group ? "Group" : "Light",
+             target->addr, r, g, b, cmd_req.color_x, cmd_req.color_y);
+}
+
+esp_err_t zigbee_light_set_color(const zigbee_light_target_t *target, uint8_t r, uint8_t g,
+                                 uint8_t b, uint16_t transition_ds)
+{
+    if (!zigbee_is_network_ready()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_zb_lock_acquire(portMAX_DELAY);
+    send_color(target, r, g, b, transition_ds);
+    esp_zb_lock_release();
+    return ESP_OK;
+}
+
+/* ============================================================================
+   ROOMS
+   ============================================================================ */
+
+static bool room_name_valid(const char *room_name)
+{
+    return room_name && room_name[0] != '\0' && strlen(room_name) < ZB_LIGHT_ROOM_NAME_LEN &&
+           strncmp(room_name, "0x", 2) != 0;
+}
+
+static int room_member_index(const zigbee_light_room_t *room, uint16_t light_addr)
+{
+    for (int i = 0; i < room->light_count; i++) {
+        if (room->lights[i] == light_addr) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Add Group / Remove Group to one light, with the Zigbee lock */
+static void send_group_membership(const zigbee_device_t *dev, uint16_t group_id, bool add)
+{
+    esp_zb_zcl_groups_add_group_cmd_t cmd_req = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = dev->short_addr,
+            .dst_endpoint = dev->endpoint,
+            .src_endpoint = ZIGBEE_HUB_ENDPOINT,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .group_id = group_id,
+    };
+
+    esp_zb_lock_acquire(portMAX_DELAY);
+    if (add) {
+        esp_zb_zcl_groups_add_group_cmd_req(&cmd_req);
+    } else {
+        esp_zb_zcl_groups_remove_group_cmd_req(&cmd_req);
+    }
+    esp_zb_lock_release();
+}
+
+esp_err_t zigbee_light_room_add(const char *room_name, uint16_t light_addr)
+{
+    if (!room_name_valid(room_name)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    zigbee_device_t light;
+    const zigbee_device_t *dev = zigbee_devices_find(light_addr, &light) ? &light : NULL;
+    if (!dev || dev->device_type != ZIGBEE_DEVICE_TYPE_LIGHT) {
+        ESP_LOGW(TAG, "0x%04x is not a paired light", light_addr);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (!zigbee_is_network_ready()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    /* Lookup, slot claim and membership change as one step */
+    bool created = false;
+    bool already = false;
+    uint16_t group_id = 0;
+    portENTER_CRITICAL(&s_rooms_lock);
+    zigbee_light_room_t *room = find_room(room_name);
+    for (int i = 0; i < ZB_LIGHT_MAX_ROOMS && !room; i++) {
+        if (!s_rooms[i].used) {
+            room = &s_rooms[i];
+            memset(room, 0, sizeof(*room));
+            strlcpy(room->name, room_name, sizeof(room->name));
+            room->group_id = ZB_LIGHT_GROUP_BASE + i;
+            room->used = true;
+            created = true;
+        }
+    }
+    if (room) {
+        group_id = room->group_id;
+        already = room_member_index(room, light_addr) >= 0;
+        if (!already && room->light_count < ZB_LIGHT_ROOM_MAX_LIGHTS) {
+            room->lights[room->light_count++] = light_addr;
+        } else if (!already) {
+            room = NULL;
+        }
+    }
+    portEXIT_CRITICAL(&s_rooms_lock);
+
+    if (!room) {
+        ESP_LOGW(TAG, "No room for light 0x%04x (max %d rooms of %d lights)", light_addr,
+                 ZB_LIGHT_MAX_ROOMS, ZB_LIGHT_ROOM_MAX_LIGHTS);
+        return ESP_ERR_NO_MEM;
+    }
+    if (created) {
+        ESP_LOGI(TAG, "Created room '%s' (group 0x%04x)", room_name, group_id);
+    }
+
+    /* Sent again for a light already in the room, in case it missed the first one */
+    send_group_membership(dev, group_id, true);
+    if (already) {
+        ESP_LOGI(TAG, "Light 0x%04x is already in room '%s'", light_addr, room_name);
+        return ESP_OK;
+    }
+    save_rooms();
+    ESP_LOGI(TAG, "Added light 0x%04x to room '%s'", light_addr, room_name);
+    return ESP_OK;
+}
+
+esp_err_t zigbee_light_room_remove(const char *room_name, uint16_t light_addr)
+{
+    if (!room_name_valid(room_name)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint16_t group_id = 0;
+    int member = -1;
+    portENTER_CRITICAL(&s_rooms_lock);
+    zigbee_light_room_t *room = find_room(room_name);
+    if (room) {
+        group_id = room->group_id;
+        member = room_member_index(room, light_addr);
+        if (member >= 0) {
+            room->lights[member] = room->lights[--room->light_count];
+        }
+    }
+    portEXIT_CRITICAL(&s_rooms_lock);
+
+    if (member < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    save_rooms();
+
+    /* A light that has left the network can't be told - just forget it */
+    zigbee_device_t light;
+    if (zigbee_is_network_ready() && zigbee_devices_find(light_addr, &light)) {
+        send_group_membership(&light, group_id, false);
+    }
+    ESP_LOGI(TAG, "Removed light 0x%04x from room '%s'", light_addr, room_name);
+    return ESP_OK;
+}
+
+esp_err_t zigbee_light_room_follow(const char *room_name, bool follow)
+{
+    portENTER_CRITICAL(&s_rooms_lock);
+    zigbee_light_room_t *room = find_room(room_name);
+    if (room) {
+        room->follow_ring = follow;
+        s_follow.valid = false;     /* Push the current ring state on the next tick */
+    }
+    portEXIT_CRITICAL(&s_rooms_lock);
+    if (!room) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    save_rooms();
+    ESP_LOGI(TAG, "Room '%s' %s the ring", room_name, follow ? "follows" : "no longer follows");
+    return ESP_OK;
+}
+
+/* ============================================================================
+   RING FOLLOW
+   ============================================================================
+   The render loop only records the ring state it wants. A scheduler alarm
+   on the Zigbee task compares it with what the rooms last got and sends the
+   groupcasts, so the render task never waits for the Zigbee lock.
+   ============================================================================ */
+
+void zigbee_lights_follow_ring(bool on, uint8_t percent, uint8_t r, uint8_t g, uint8_t b)
+{
+    portENTER_CRITICAL(&s_rooms_lock);
+    s_follow.want = (ring_state_t){ .on = on, .percent = percent, .r = r, .g = g, .b = b };
+    s_follow.want_set = true;
+    portEXIT_CRITICAL(&s_rooms_lock);
+}
+
+static void follow_tick(uint8_t param)
+{
+    esp_zb_scheduler_alarm(follow_tick, 0, ZB_LIGHT_FOLLOW_TICK_MS);
+
+    int64_t now = esp_timer_get_time();
+    uint16_t groups[ZB_LIGHT_MAX_ROOMS];
+    int group_count = 0;
+    bool state_changed = false;
+    bool color_changed = false;
+    ring_state_t want;
+
+    portENTER_CRITICAL(&s_rooms_lock);
+    want = s_follow.want;
+    const ring_state_t *sent = &s_follow.sent;
+    if (s_follow.want_set) {
+        state_changed = !s_follow.valid || want.on != sent->on || want.percent != sent->percent;
+        color_changed = !s_follow.valid || want.r != sent->r || want.g != sent->g || want.b != sent->b;
+    }
+    /* Rate-limit; a pending change is picked up by a later tick */
+    if ((state_changed || color_changed) &&
+        (!s_follow.valid || now - s_follow.sent_us >= ZB_LIGHT_FOLLOW_MIN_INTERVAL_MS * 1000LL)) {
+        for (int i = 0; i < ZB_LIGHT_MAX_ROOMS; i++) {
+            if (s_rooms[i].used && s_rooms[i].follow_ring) {
+                groups[group_count++] = s_rooms[i].group_id;
+            }
+        }
+        s_follow.valid = true;
+        s_follow.sent.on = want.on;
+        s_follow.sent.percent = want.percent;
+        if (want.on) {
+            /* Colors are only sent while on - an off ring keeps the old one pending */
+            s_follow.sent.r = want.r;
+            s_follow.sent.g = want.g;
+            s_follow.sent.b = want.b;
+        }
+        s_follow.sent_us = now;
+        if (group_count > 0) {
+            s_follow.updates++;
+        }
+    } else {
+        state_changed = color_changed = false;
+    }
+    portEXIT_CRITICAL(&s_rooms_lock);
+
+    /* Already in the Zigbee task - no lock needed */
+    uint32_t frames = 0;
+    for (int i = 0; i < group_count; i++) {
+        zigbee_light_target_t target = { .addr = groups[i], .is_group = true };
+        if (state_changed) {
+            if (want.on && want.percent > 0) {
+                send_level(&target, want.percent > 100 ? 100 : want.percent,
+                           ZB_LIGHT_FOLLOW_TRANSITION_DS);
+            } else {
+                send_on_off(&target, false);
+            }
+            frames++;
+        }
+        if (want.on && color_changed) {
+            send_color(&target, want.r, want.g, want.b, ZB_LIGHT_FOLLOW_TRANSITION_DS);
+            frames++;
+        }
+    }
+    if (frames > 0) {
+        portENTER_CRITICAL(&s_rooms_lock);
+        s_follow.frames += frames;
+        portEXIT_CRITICAL(&s_rooms_lock);
+    }
+}
+
+void zigbee_lights_start(void)
+{
+    if (s_started) {
+        return;
+    }
+    s_started = true;
+    esp_zb_scheduler_alarm(follow_tick, 0, ZB_LIGHT_FOLLOW_TICK_MS);
+}
+
+/* ============================================================================
+   STATUS
+   ============================================================================ */
+
+void zigbee_lights_print_status(void)
+{
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "╔══════════════════════════════════════════════════════════╗");
+    ESP_LOGI(TAG, "║  💡 ZIGBEE LIGHTS                                         ║");
+    ESP_LOGI(TAG, "╚══════════════════════════════════════════════════════════╝");
+
+    int lights = 0;
+    const zigbee_device_table_t *table = zigbee_devices_snapshot();
+    for (int i = 0; i < table->count; i++) {
+        const zigbee_device_t *dev = &table->devices[i];
+        if (dev->device_type == ZIGBEE_DEVICE_TYPE_LIGHT) {
+            ESP_LOGI(TAG, "  Light 0x%04x (endpoint %d)%s", dev->short_addr, dev->endpoint,
+                     dev->is_online ? "" : " - offline");
+            lights++;
+        }
+    }
+    zigbee_devices_snapshot_release(table);
+    if (lights == 0) {
+        ESP_LOGI(TAG, "  No lights paired");
+    }
+
+    zigbee_light_room_t rooms[ZB_LIGHT_MAX_ROOMS];
+    portENTER_CRITICAL(&s_rooms_lock);
+    memcpy(rooms, s_rooms, sizeof(rooms));
+    portEXIT_CRITICAL(&s_rooms_lock);
+
+    for (int i = 0; i < ZB_LIGHT_MAX_ROOMS; i++) {
+        if (!rooms[i].used) {
+            continue;
+        }
+        char members[ZB_LIGHT_ROOM_MAX_LIGHTS * 7 + 1] = "";
+        size_t len = 0;
+        for (int j = 0; j < rooms[i].light_count && len < sizeof(members); j++) {
+            len += snprintf(members + len, sizeof(members) - len, " 0x%04x", rooms[i].lights[j]);
+        }
+        ESP_LOGI(TAG, "  Room '%s': group 0x%04x, %d light(s)%s%s", rooms[i].name,
+                 rooms[i].group_id, rooms[i].light_count, members,
+                 rooms[i].follow_ring ? ", follows ring" : "");
+    }
+    ESP_LOGI(TAG, "  Ring follow: %lu updates, %lu groupcasts",
+             (unsigned long)s_follow.updates, (unsigned long)s_follow.frames);
+    ESP_LOGI(TAG, "");
+}
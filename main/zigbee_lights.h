@@ -0,0 +1,171 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee Lights - On/Off, Level and Color control for Zigbee bulbs
+ *
+ * Fades are done by the bulbs themselves: every command carries a ZCL
+ * transition time, so a 1s dim is one frame, not a stream of steps.
+ *
+ * Rooms are Zigbee groups. Adding a light to a room sends it an Add Group
+ * command; after that, the whole room is addressed with one groupcast.
+ *
+ * Rooms can follow the ring. The render loop hands the ring's on/brightness/
+ * color to zigbee_lights_follow_ring() every frame, which only records it. A
+ * tick on the Zigbee task picks up changes: each following room gets a single
+ * Move to Level (with On/Off) groupcast, plus a Move to Color if the color
+ * changed.
+ */
+
+#ifndef ZIGBEE_LIGHTS_H
+#define ZIGBEE_LIGHTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_zigbee_core.h"
+
+/* ============================================================================
+   ZIGBEE LIGHTS CONFIGURATION
+   ============================================================================ */
+
+#define ZB_LIGHT_MAX_ROOMS              4
+#define ZB_LIGHT_ROOM_MAX_LIGHTS        16
+#define ZB_LIGHT_ROOM_NAME_LEN          12
+#define ZB_LIGHT_GROUP_BASE             0x1000  /* Room n uses group 0x1000 + n */
+#define ZB_LIGHT_TRANSITION_DS          10      /* Explicit commands: 1.0s fade (tenths of a second) */
+#define ZB_LIGHT_FOLLOW_TRANSITION_DS   4       /* Ring follow: 0.4s fade */
+#define ZB_LIGHT_FOLLOW_MIN_INTERVAL_MS 300     /* Coalesce encoder spins into fewer groupcasts */
+#define ZB_LIGHT_FOLLOW_TICK_MS         100     /* Zigbee task checks the ring state this often */
+
+/* ============================================================================
+   TARGETS
+   ============================================================================ */
+
+typedef struct {
+    uint16_t addr;          /* Light short address, or group ID */
+    uint8_t endpoint;       /* Unused for groups */
+    bool is_group;
+} zigbee_light_target_t;
+
+typedef struct {
+    char name[ZB_LIGHT_ROOM_NAME_LEN];
+    uint16_t group_id;
+    uint16_t lights[ZB_LIGHT_ROOM_MAX_LIGHTS];  /* Short addresses we added */
+    uint8_t light_count;
+    bool follow_ring;
+    bool used;
+} zigbee_light_room_t;
+
+/* ============================================================================
+   SETUP
+   ============================================================================ */
+
+/**
+ * @brief Load rooms from NVS
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t zigbee_lights_init(void);
+
+/**
+ * @brief Add the client clusters used to control lights to the hub endpoint
+ *
+ * Call while building the endpoint, before esp_zb_device_register().
+ *
+ * @param cluster_list Hub endpoint cluster list
+ */
+void zigbee_lights_add_clusters(esp_zb_cluster_list_t *cluster_list);
+
+/**
+ * @brief Resolve "0x1234" (a paired light) or a room name to a target
+ *
+ * @param name Address or room name
+ * @param out Target
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND
+ */
+esp_err_t zigbee_light_resolve(const char *name, zigbee_light_target_t *out);
+
+/* ============================================================================
+   CONTROL
+   ============================================================================ */
+
+/**
+ * @brief Switch a light or room on or off
+ */
+esp_err_t zigbee_light_on_off(const zigbee_light_target_t *target, bool on);
+
+/**
+ * @brief Fade to a brightness (turns on if off, 0% turns off)
+ *
+ * @param target Light or room
+ * @param percent 0-100
+ * @param transition_ds Fade time in tenths of a second, done by the bulb
+ */
+esp_err_t zigbee_light_set_level(const zigbee_light_target_t *target, uint8_t percent,
+                                 uint16_t transition_ds);
+
+/**
+ * @brief Fade to an RGB color (sent as CIE xy)
+ *
+ * @param target Light or room
+ * @param r Red 0-255
+ * @param g Green 0-255
+ * @param b Blue 0-255
+ * @param transition_ds Fade time in tenths of a second, done by the bulb
+ */
+esp_err_t zigbee_light_set_color(const zigbee_light_target_t *target, uint8_t r, uint8_t g,
+                                 uint8_t b, uint16_t transition_ds);
+
+/* ============================================================================
+   ROOMS
+   ============================================================================ */
+
+/**
+ * @brief Add a paired light to a room, creating the room if needed
+ *
+ * @param room Room name
+ * @param light_addr Light short address
+ * @return ESP_OK if the Add Group command was sent
+ */
+esp_err_t zigbee_light_room_add(const char *room, uint16_t light_addr);
+
+/**
+ * @brief Take a light out of a room (sends Remove Group if it is still paired)
+ *
+ * @param room Room name
+ * @param light_addr Light short address
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND if the light is not in the room
+ */
+esp_err_t zigbee_light_room_remove(const char *room, uint16_t light_addr);
+
+/**
+ * @brief Make a room follow the ring's on/brightness/color
+ */
+esp_err_t zigbee_light_room_follow(const char *room, bool follow);
+
+/**
+ * @brief Start the ring follow tick (Zigbee task, once the network is up)
+ */
+void zigbee_lights_start(void);
+
+/**
+ * @brief Feed the ring state (call once per frame from the render loop)
+ *
+ * Only records the state; never blocks. The Zigbee task sends at most one
+ * update per ZB_LIGHT_FOLLOW_MIN_INTERVAL_MS.
+ *
+ * @param on Ring is on
+ * @param percent Ring brightness 0-100
+ * @param r Ring color red
+ * @param g Ring color green
+ * @param b Ring color blue
+ */
+void zigbee_lights_follow_ring(bool on, uint8_t percent, uint8_t r, uint8_t g, uint8_t b);
+
+/**
+ * @brief Log paired lights, rooms and follow state
+ */
+void zigbee_lights_print_status(void);
+
+#endif /* ZIGBEE_LIGHTS_H */
@@ -0,0 +1,723 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee OTA - OTA Upgrade server for paired end devices
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "esp_zigbee_core.h"
+#include "zcl/esp_zigbee_zcl_ota.h"
+#include "zigbee_hub.h"
+#include "zigbee_devices.h"
+#include "halo_metrics.h"
+#include "halo_tasks.h"
+#include "zigbee_ota.h"
+
+static const char *TAG = "zb_ota";
+
+#define ZB_OTA_CLUSTER_ID           0x0019
+#define ZB_OTA_CMD_IMAGE_NOTIFY     0x00
+#define ZB_OTA_NOTIFY_JITTER_ONLY   0x00    /* Image Notify payload type */
+#define ZB_OTA_FETCH_HTTP_TIMEOUT   15000
+
+/* ============================================================================
+   STATE
+   ============================================================================ */
+
+typedef struct {
+    uint32_t offset;                /* Into the partition */
+    zigbee_ota_file_header_t hdr;
+} zigbee_ota_image_t;
+
+static const esp_partition_t *s_partition = NULL;
+static const uint8_t *s_map = NULL;                 /* Whole partition, read-only */
+static esp_partition_mmap_handle_t s_map_handle;
+static bool s_server_started = false;
+
+static zigbee_ota_image_t s_images[ZB_OTA_MAX_IMAGES];
+static int s_image_count = 0;
+static uint32_t s_used_bytes = 0;                   /* First free (aligned) offset */
+
+/* Touched from the Zigbee task (block callbacks, tick) and the MQTT task */
+static zigbee_ota_session_t s_sessions[ZB_OTA_MAX_SESSIONS];
+static int s_session_count = 0;
+static int64_t s_rate_window_us = 0;                /* Block rate cap, one-second windows */
+static uint32_t s_rate_blocks = 0;
+static uint32_t s_blocks_deferred = 0;              /* Block requests answered "wait" */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static metrics_histogram_t s_block_gap = METRICS_HISTOGRAM_INIT("zb_ota_block_gap", "ms");
+
+static char s_fetch_url[ZB_OTA_URL_MAX_LEN];
+static uint8_t s_fetch_buf[1024];
+static volatile bool s_fetch_running = false;
+
+/* ============================================================================
+   IMAGE PARTITION
+   ============================================================================ */
+
+static uint32_t align_up(uint32_t value)
+{
+    return (value + ZB_OTA_FILE_ALIGN - 1) & ~(uint32_t)(ZB_OTA_FILE_ALIGN - 1);
+}
+
+/* Walk the back-to-back OTA files in the mapped partition */
+static void scan_images(void)
+{
+    s_image_count = 0;
+    uint32_t offset = 0;
+
+    while (s_image_count < ZB_OTA_MAX_IMAGES &&
+           offset + sizeof(zigbee_ota_file_header_t) <= s_partition->size) {
+        zigbee_ota_file_header_t hdr;
+        memcpy(&hdr, s_map + offset, sizeof(hdr));
+        if (hdr.file_identifier != ZB_OTA_FILE_IDENTIFIER ||
+            hdr.total_image_size < sizeof(hdr) ||
+            hdr.total_image_size > s_partition->size - offset) {
+            break;
+        }
+        s_images[s_image_count].offset = offset;
+        s_images[s_image_count].hdr = hdr;
+        s_image_count++;
+        offset = align_up(offset + hdr.total_image_size);
+    }
+    s_used_bytes = offset;
+}
+
+static esp_err_t map_partition(void)
+{
+    if (s_partition == NULL) {
+        s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                               ZB_OTA_PARTITION_LABEL);
+        if (s_partition == NULL) {
+            ESP_LOGW(TAG, "No '%s' partition - OTA server disabled", ZB_OTA_PARTITION_LABEL);
+            return ESP_ERR_NOT_FOUND;
+        }
+    }
+    if (s_map != NULL) {
+        return ESP_OK;
+    }
+    const void *ptr = NULL;
+    esp_err_t err = esp_partition_mmap(s_partition, 0, s_partition->size,
+                                       ESP_PARTITION_MMAP_DATA, &ptr, &s_map_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "mmap of '%s' failed: %s", ZB_OTA_PARTITION_LABEL, esp_err_to_name(err));
+        return err;
+    }
+    s_map = ptr;
+    scan_images();
+    return ESP_OK;
+}
+
+static void unmap_partition(void)
+{
+    if (s_map != NULL) {
+        esp_partition_munmap(s_map_handle);
+        s_map = NULL;
+    }
+}
+
+/* ============================================================================
+   SESSIONS (call with s_lock held)
+   ============================================================================ */
+
+static zigbee_ota_session_t *session_find(uint16_t short_addr)
+{
+    for (int i = 0; i < s_session_count; i++) {
+        if (s_sessions[i].short_addr == short_addr) {
+            return &s_sessions[i];
+        }
+    }
+    return NULL;
+}
+
+/* New (or reset) session, recycling a finished one when the table is full */
+static zigbee_ota_session_t *session_alloc(uint16_t short_addr, int64_t now)
+{
+    zigbee_ota_session_t *s = session_find(short_addr);
+    if (s == NULL && s_session_count < ZB_OTA_MAX_SESSIONS) {
+        s = &s_sessions[s_session_count++];
+    }
+    for (int i = 0; s == NULL && i < s_session_count; i++) {
+        if (s_sessions[i].state == ZB_OTA_SESSION_DONE ||
+            s_sessions[i].state == ZB_OTA_SESSION_STALLED) {
+            s = &s_sessions[i];
+        }
+    }
+    if (s != NULL) {
+        memset(s, 0, sizeof(*s));
+        s->short_addr = short_addr;
+        s->image = -1;
+        s->state_since_us = now;
+    }
+    return s;
+}
+
+static int sessions_in_flight(void)
+{
+    int n = 0;
+    for (int i = 0; i < s_session_count; i++) {
+        if (s_sessions[i].state == ZB_OTA_SESSION_NOTIFIED ||
+            s_sessions[i].state == ZB_OTA_SESSION_TRANSFERRING) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static const char *session_state_to_string(zigbee_ota_session_state_t state)
+{
+    switch (state) {
+        case ZB_OTA_SESSION_QUEUED:       return "queued";
+        case ZB_OTA_SESSION_NOTIFIED:     return "notified";
+        case ZB_OTA_SESSION_TRANSFERRING: return "transferring";
+        case ZB_OTA_SESSION_DONE:         return "done";
+        case ZB_OTA_SESSION_STALLED:      return "stalled";
+        default:                          return "?";
+    }
+}
+
+/* ============================================================================
+   BLOCK SERVING (Zigbee task)
+   ============================================================================
+   The stack calls back for every Image Block Request. The returned pointer
+   goes straight into the mapped partition. One callback per image slot, since
+   the stack does not say which inserted file a request is for.
+
+   A request is refused (anything but ESP_OK) when the block rate cap is
+   reached, or when a device that was not admitted asks while every transfer
+   slot is taken. The stack answers it with WAIT_FOR_DATA and the device asks
+   again later. A device refused for want of a slot is queued, and gets its
+   Image Notify from the tick like any other.
+   ============================================================================ */
+
+/* Count a block against the cap, false if this second's budget is spent */
+static bool rate_admit(int64_t now)
+{
+    if (now - s_rate_window_us >= 1000000) {
+        s_rate_window_us = now;
+        s_rate_blocks = 0;
+    }
+    if (s_rate_blocks >= ZB_OTA_MAX_BLOCKS_PER_SEC) {
+        return false;
+    }
+    s_rate_blocks++;
+    return true;
+}
+
+static esp_err_t serve_block(int image, esp_zb_ota_zcl_information_t message,
+                             uint32_t index, uint8_t size, uint8_t **data)
+{
+    if (s_map == NULL || image >= s_image_count) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    const zigbee_ota_image_t *img = &s_images[image];
+    if (index >= img->hdr.total_image_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t end = index + size;
+    if (end > img->hdr.total_image_size) {
+        end = img->hdr.total_image_size;
+    }
+
+    int64_t now = esp_timer_get_time();
+    uint16_t addr = message.src_addr.u.short_addr;
+    int64_t gap_us = -1;
+    int64_t started_us = now;
+    bool finished = false;
+    bool queued = false;
+
+    taskENTER_CRITICAL(&s_lock);
+    if (!rate_admit(now)) {
+        s_blocks_deferred++;
+        taskEXIT_CRITICAL(&s_lock);
+        return ESP_ERR_NOT_FINISHED;
+    }
+    zigbee_ota_session_t *s = session_find(addr);
+    bool holds_slot = s != NULL && (s->state == ZB_OTA_SESSION_NOTIFIED ||
+                                    s->state == ZB_OTA_SESSION_TRANSFERRING);
+    if (s != NULL && s->state == ZB_OTA_SESSION_DONE && index != 0) {
+        s = NULL;   /* Retry of the final block - already counted */
+    } else if (!holds_slot && sessions_in_flight() >= ZB_OTA_MAX_CONCURRENT) {
+        /* Queried on its own schedule while the slots are taken - wait in line */
+        if (s == NULL || s->state != ZB_OTA_SESSION_QUEUED) {
+            s = session_alloc(addr, now);
+            queued = s != NULL;
+        }
+        s_blocks_deferred++;
+        taskEXIT_CRITICAL(&s_lock);
+        if (queued) {
+            ESP_LOGI(TAG, "0x%04x: asked for blocks unannounced - queued", addr);
+        }
+        return ESP_ERR_NOT_FINISHED;
+    } else if (!holds_slot) {
+        /* Device queried on its own schedule (or started over) with a slot free */
+        s = session_alloc(addr, now);
+    }
+    if (s != NULL) {
+        if (s->state != ZB_OTA_SESSION_TRANSFERRING) {
+            s->state = ZB_OTA_SESSION_TRANSFERRING;
+            s->state_since_us = now;
+            s->started_us = now;
+        } else {
+            gap_us = now - s->last_block_us;
+        }
+        s->image = (int8_t)image;
+        s->blocks++;
+        s->last_block_us = now;
+        if (end > s->bytes_served) {
+            s->bytes_served = end;
+        }
+        started_us = s->started_us;
+        if (end >= img->hdr.total_image_size) {
+            s->state = ZB_OTA_SESSION_DONE;
+            s->state_since_us = now;
+            finished = true;
+        }
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    *data = (uint8_t *)(s_map + img->offset + index);
+    if (gap_us >= 0) {
+        metrics_hist_record(&s_block_gap, (uint32_t)(gap_us / 1000));
+    }
+    if (finished) {
+        ESP_LOGI(TAG, "0x%04x: last block served (%lu bytes in %lus)", addr,
+                 (unsigned long)img->hdr.total_image_size,
+                 (unsigned long)((now - started_us) / 1000000));
+    }
+    return ESP_OK;
+}
+
+#define ZB_OTA_SERVE_FN(n)                                                          \
+    static esp_err_t serve_block_##n(esp_zb_ota_zcl_information_t message,          \
+                                     uint32_t index, uint8_t size, uint8_t **data)  \
+    {                                                                               \
+        return serve_block(n, message, index, size, data);                          \
+    }
+ZB_OTA_SERVE_FN(0)
+ZB_OTA_SERVE_FN(1)
+ZB_OTA_SERVE_FN(2)
+ZB_OTA_SERVE_FN(3)
+
+static esp_zb_ota_next_data_callback_t const s_serve_fns[ZB_OTA_MAX_IMAGES] = {
+    serve_block_0, serve_block_1, serve_block_2, serve_block_3,
+};
+
+/* Offer every image in the partition to the stack's OTA server */
+static void register_images(void)
+{
+    for (int i = 0; i < s_image_count; i++) {
+        const zigbee_ota_file_header_t *hdr = &s_images[i].hdr;
+        esp_zb_ota_upgrade_server_notify_req_t req = {
+            .endpoint = ZIGBEE_HUB_ENDPOINT,
+            .index = (uint8_t)i,
+            .notify_on = false,         /* Devices are notified one at a time */
+            .ota_upgrade_time = 0,      /* Apply as soon as the transfer completes */
+            .ota_file_header = {
+                .file_identifier = hdr->file_identifier,
+                .header_version = hdr->header_version,
+                .header_length = hdr->header_length,
+                .field_control = hdr->field_control,
+                .manufacturer_code = hdr->manufacturer_code,
+                .image_type = hdr->image_type,
+                .file_version = hdr->file_version,
+                .stack_version = hdr->stack_version,
+                .image_size = hdr->total_image_size,
+            },
+            .next_data = {
+                .data_cb = s_serve_fns[i],
+            },
+        };
+        memcpy(req.ota_file_header.header_string, hdr->header_string,
+               sizeof(req.ota_file_header.header_string));
+        esp_err_t err = esp_zb_ota_upgrade_server_notify_req(&req);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Image %d not accepted by the stack: %s", i, esp_err_to_name(err));
+        }
+    }
+}
+
+/* ============================================================================
+   ADMISSION (Zigbee task, scheduler alarm)
+   ============================================================================ */
+
+static esp_err_t send_image_notify(uint16_t short_addr)
+{
+    zigbee_device_t dev;
+    bool known = zigbee_devices_find(short_addr, &dev);
+    uint8_t payload[2] = { ZB_OTA_NOTIFY_JITTER_ONLY, ZB_OTA_QUERY_JITTER };
+
+    esp_zb_zcl_custom_cluster_cmd_req_t cmd_req = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = short_addr,
+            .dst_endpoint = known ? dev.endpoint : 1,
+            .src_endpoint = ZIGBEE_HUB_ENDPOINT,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+        .cluster_id = ZB_OTA_CLUSTER_ID,
+        .custom_cmd_id = ZB_OTA_CMD_IMAGE_NOTIFY,
+        .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI,
+        .data = {
+            .type = ESP_ZB_ZCL_ATTR_TYPE_SET,
+            .size = sizeof(payload),
+            .value = payload,
+        },
+    };
+    /* Already in the Zigbee task - no lock needed */
+    return esp_zb_zcl_custom_cluster_cmd_req(&cmd_req);
+}
+
+static void ota_tick(uint8_t param)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t timeout_us = (int64_t)ZB_OTA_SESSION_TIMEOUT_MS * 1000;
+    uint16_t notify_addr[ZB_OTA_MAX_CONCURRENT];
+    int notify_count = 0;
+
+    taskENTER_CRITICAL(&s_lock);
+    /* Release slots held by devices that went quiet */
+    for (int i = 0; i < s_session_count; i++) {
+        zigbee_ota_session_t *s = &s_sessions[i];
+        int64_t since = s->state == ZB_OTA_SESSION_TRANSFERRING ? s->last_block_us
+                                                                : s->state_since_us;
+        if ((s->state == ZB_OTA_SESSION_NOTIFIED || s->state == ZB_OTA_SESSION_TRANSFERRING) &&
+            now - since > timeout_us) {
+            s->state = ZB_OTA_SESSION_STALLED;
+            s->state_since_us = now;
+        }
+    }
+    /* Admit queued devices into free slots, oldest first */
+    int free_slots = ZB_OTA_MAX_CONCURRENT - sessions_in_flight();
+    while (free_slots > 0) {
+        zigbee_ota_session_t *next = NULL;
+        for (int i = 0; i < s_session_count; i++) {
+            zigbee_ota_session_t *s = &s_sessions[i];
+            if (s->state == ZB_OTA_SESSION_QUEUED &&
+                (next == NULL || s->state_since_us < next->state_since_us)) {
+                next = s;
+            }
+        }
+        if (next == NULL) {
+            break;
+        }
+        next->state = ZB_OTA_SESSION_NOTIFIED;
+        next->state_since_us = now;
+        notify_addr[notify_count++] = next->short_addr;
+        free_slots--;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    for (int i = 0; i < notify_count; i++) {
+        esp_err_t err = send_image_notify(notify_addr[i]);
+        ESP_LOGI(TAG, "Image Notify -> 0x%04x%s", notify_addr[i],
+                 err == ESP_OK ? "" : " (send reported an error)");
+    }
+
+    esp_zb_scheduler_alarm(ota_tick, 0, ZB_OTA_TICK_MS);
+}
+
+/* ============================================================================
+   SERVER LIFECYCLE
+   ============================================================================ */
+
+void zigbee_ota_add_server_cluster(esp_zb_cluster_list_t *cluster_list)
+{
+    esp_zb_ota_cluster_cfg_t ota_cfg = { 0 };
+    esp_zb_attribute_list_t *ota_cluster = esp_zb_ota_cluster_create(&ota_cfg);
+
+    esp_zb_zcl_ota_upgrade_server_variable_t server_vars = {
+        .query_jitter = ZB_OTA_QUERY_JITTER,
+        .current_time = 0,
+        .file_count = ZB_OTA_MAX_IMAGES,
+    };
+    esp_zb_ota_cluster_add_attr(ota_cluster, ESP_ZB_ZCL_ATTR_OTA_UPGRADE_SERVER_DATA_ID,
+                                (void *)&server_vars);
+    esp_zb_cluster_list_add_ota_cluster(cluster_list, ota_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+}
+
+void zigbee_ota_server_start(void)
+{
+    if (s_server_started) {
+        return;
+    }
+    if (map_partition() != ESP_OK) {
+        return;
+    }
+    s_server_started = true;
+    register_images();
+    esp_zb_scheduler_alarm(ota_tick, 0, ZB_OTA_TICK_MS);
+
+    ESP_LOGI(TAG, "OTA server: %d image(s) in '%s' (%lu of %lu KB used)", s_image_count,
+             ZB_OTA_PARTITION_LABEL, (unsigned long)(s_used_bytes / 1024),
+             (unsigned long)(s_partition->size / 1024));
+}
+
+/* ============================================================================
+   PUBLIC API
+   ============================================================================ */
+
+static esp_err_t queue_device(uint16_t short_addr, int64_t now)
+{
+    taskENTER_CRITICAL(&s_lock);
+    zigbee_ota_session_t *s = session_find(short_addr);
+    bool busy = s != NULL && (s->state == ZB_OTA_SESSION_NOTIFIED ||
+                              s->state == ZB_OTA_SESSION_TRANSFERRING ||
+                              s->state == ZB_OTA_SESSION_QUEUED);
+    if (!busy) {
+        s = session_alloc(short_addr, now);
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (busy) {
+        return ESP_OK;
+    }
+    return s != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t zigbee_ota_upgrade(uint16_t short_addr)
+{
+    if (!s_server_started || s_image_count == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t now = esp_timer_get_time();
+
+    if (short_addr != 0) {
+        zigbee_device_t dev;
+        if (!zigbee_devices_find(short_addr, &dev)) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        return queue_device(short_addr, now);
+    }
+
+    /* Pinned: a join or leave meanwhile can't reuse the table under us */
+    esp_err_t ret = ESP_OK;
+    const zigbee_device_table_t *table = zigbee_devices_snapshot();
+    for (int i = 0; i < table->count; i++) {
+        if (queue_device(table->devices[i].short_addr, now) != ESP_OK) {
+            ret = ESP_ERR_NO_MEM;
+        }
+    }
+    zigbee_devices_snapshot_release(table);
+    return ret;
+}
+
+static int transfers_in_flight(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    int n = sessions_in_flight();
+    taskEXIT_CRITICAL(&s_lock);
+    return n;
+}
+
+/* Called with the Zigbee lock held so no block callback runs meanwhile */
+static void remap_and_register(void)
+{
+    unmap_partition();
+    if (map_partition() == ESP_OK && s_server_started) {
+        register_images();
+    }
+}
+
+esp_err_t zigbee_ota_erase(void)
+{
+    if (s_partition == NULL || transfers_in_flight() > 0 || s_fetch_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_zb_lock_acquire(portMAX_DELAY);
+    unmap_partition();
+    esp_err_t err = esp_partition_erase_range(s_partition, 0, s_partition->size);
+    remap_and_register();
+    esp_zb_lock_release();
+
+    ESP_LOGI(TAG, "Image partition erased");
+    return err;
+}
+
+static esp_err_t fetch_to_partition(uint32_t base, uint32_t *written)
+{
+    esp_http_client_config_t http_cfg = {
+        .url = s_fetch_url,
+        .timeout_ms = ZB_OTA_FETCH_HTTP_TIMEOUT,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&http_cfg);
+    if (client == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = esp_http_client_open(client, 0);
+    if (ret != ESP_OK) {
+        esp_http_client_cleanup(client);
+        return ret;
+    }
+    esp_http_client_fetch_headers(client);
+    if (esp_http_client_get_status_code(client) != 200) {
+        ESP_LOGE(TAG, "HTTP status %d", esp_http_client_get_status_code(client));
+        ret = ESP_FAIL;
+        goto cleanup;
+    }
+
+    uint32_t erased = base;
+    while (1) {
+        int n = esp_http_client_read(client, (char *)s_fetch_buf, sizeof(s_fetch_buf));
+        if (n < 0) {
+            ret = ESP_FAIL;
+            goto cleanup;
+        }
+        if (n == 0) {
+            ret = esp_http_client_is_complete_data_received(client) ? ESP_OK : ESP_FAIL;
+            break;
+        }
+        uint32_t off = base + *written;
+        if (off + n > s_partition->size) {
+            ESP_LOGE(TAG, "Image does not fit in '%s'", ZB_OTA_PARTITION_LABEL);
+            ret = ESP_ERR_INVALID_SIZE;
+            goto cleanup;
+        }
+        /* Erase sector by sector just ahead of the write */
+        while (erased < off + n) {
+            ret = esp_partition_erase_range(s_partition, erased, ZB_OTA_FILE_ALIGN);
+            if (ret != ESP_OK) {
+                goto cleanup;
+            }
+            erased += ZB_OTA_FILE_ALIGN;
+        }
+        ret = esp_partition_write(s_partition, off, s_fetch_buf, n);
+        if (ret != ESP_OK) {
+            goto cleanup;
+        }
+        *written += n;
+    }
+
+cleanup:
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    return ret;
+}
+
+static void fetch_job(void *arg)
+{
+    uint32_t base = s_used_bytes;
+    uint32_t written = 0;
+    esp_err_t ret = fetch_to_partition(base, &written);
+
+    /* Only a complete file with a valid header may become visible */
+    if (ret == ESP_OK) {
+        zigbee_ota_file_header_t hdr;
+        ret = esp_partition_read(s_partition, base, &hdr, sizeof(hdr));
+        if (ret == ESP_OK && (hdr.file_identifier != ZB_OTA_FILE_IDENTIFIER ||
+                              hdr.total_image_size != written)) {
+            ESP_LOGE(TAG, "Not a Zigbee OTA file, or size mismatch (%lu bytes)",
+                     (unsigned long)written);
+            ret = ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+    if (ret != ESP_OK && written > 0) {
+        esp_partition_erase_range(s_partition, base, ZB_OTA_FILE_ALIGN);
+    }
+
+    esp_zb_lock_acquire(portMAX_DELAY);
+    remap_and_register();
+    esp_zb_lock_release();
+
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Stored image %d (%lu bytes) - %d image(s) available",
+                 s_image_count - 1, (unsigned long)written, s_image_count);
+    } else {
+        ESP_LOGE(TAG, "Fetch failed: %s", esp_err_to_name(ret));
+    }
+    s_fetch_running = false;
+}
+
+esp_err_t zigbee_ota_fetch(const char *url)
+{
+    if (url == NULL || url[0] == '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (strlen(url) >= sizeof(s_fetch_url)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (s_partition == NULL || s_fetch_running || transfers_in_flight() > 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_image_count >= ZB_OTA_MAX_IMAGES) {
+        ESP_LOGW(TAG, "Image table full - erase first");
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_fetch_running = true;
+    strlcpy(s_fetch_url, url, sizeof(s_fetch_url));
+    /* Same job task as the firmware OTA */
+    esp_err_t err = halo_job_submit(fetch_job, NULL);
+    if (err != ESP_OK) {
+        s_fetch_running = false;
+        return err;
+    }
+    ESP_LOGI(TAG, "Fetching Zigbee OTA image from %s", url);
+    return ESP_OK;
+}
+
+/* ============================================================================
+   STATUS
+   ============================================================================ */
+
+void zigbee_ota_print_status(void)
+{
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "╔══════════════════════════════════════════════════════════╗");
+    ESP_LOGI(TAG, "║  📦 ZIGBEE OTA SERVER                                    ║");
+    ESP_LOGI(TAG, "╚══════════════════════════════════════════════════════════╝");
+    if (s_partition == NULL) {
+        ESP_LOGI(TAG, "  No '%s' partition", ZB_OTA_PARTITION_LABEL);
+        return;
+    }
+    ESP_LOGI(TAG, "  Partition: %lu of %lu KB used, %d/%d concurrent transfer(s)",
+             (unsigned long)(s_used_bytes / 1024), (unsigned long)(s_partition->size / 1024),
+             transfers_in_flight(), ZB_OTA_MAX_CONCURRENT);
+    ESP_LOGI(TAG, "  Block cap: %d/s, %lu request(s) told to wait", ZB_OTA_MAX_BLOCKS_PER_SEC,
+             (unsigned long)s_blocks_deferred);
+    for (int i = 0; i < s_image_count; i++) {
+        const zigbee_ota_file_header_t *hdr = &s_images[i].hdr;
+        ESP_LOGI(TAG, "  [%d] manuf 0x%04x type 0x%04x version 0x%08lx  %lu bytes @0x%05lx",
+                 i, hdr->manufacturer_code, hdr->image_type, (unsigned long)hdr->file_version,
+                 (unsigned long)hdr->total_image_size, (unsigned long)s_images[i].offset);
+    }
+
+    /* One slot per paired device: too big for the caller's stack */
+    static zigbee_ota_session_t sessions[ZB_OTA_MAX_SESSIONS];
+    taskENTER_CRITICAL(&s_lock);
+    int count = s_session_count;
+    memcpy(sessions, s_sessions, sizeof(sessions));
+    taskEXIT_CRITICAL(&s_lock);
+
+    int64_t now = esp_timer_get_time();
+    if (count == 0) {
+        ESP_LOGI(TAG, "  No upgrades yet");
+    }
+    for (int i = 0; i < count; i++) {
+        const zigbee_ota_session_t *s = &sessions[i];
+        uint32_t total = s->image >= 0 && s->image < s_image_count
+                         ? s_images[s->image].hdr.total_image_size : 0;
+        int64_t end_us = s->state == ZB_OTA_SESSION_TRANSFERRING ? now : s->last_block_us;
+        uint32_t secs = s->started_us > 0 ? (uint32_t)((end_us - s->started_us) / 1000000) : 0;
+        ESP_LOGI(TAG, "  0x%04x %-12s %3lu%%  %lu/%lu B  %lu blocks  %lus  %lu B/s",
+                 s->short_addr, session_state_to_string(s->state),
+                 (unsigned long)(total ? (uint64_t)s->bytes_served * 100 / total : 0),
+                 (unsigned long)s->bytes_served, (unsigned long)total,
+                 (unsigned long)s->blocks, (unsigned long)secs,
+                 (unsigned long)(secs ? s->bytes_served / secs : 0));
+    }
+    metrics_hist_print(&s_block_gap);
+    ESP_LOGI(TAG, "");
+}
@@ -0,0 +1,149 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee OTA - OTA Upgrade server for paired end devices
+ *
+ * The coordinator serves standard Zigbee OTA files (0x0BEEF11E header) to
+ * devices on the network. The files sit back-to-back (4KB aligned) in the
+ * "zb_ota" data partition, which is memory-mapped once. Each Image Block
+ * Response points straight into mapped flash: no image is ever copied to RAM.
+ *
+ * Upgrades are started per device and admitted a few at a time, so block
+ * traffic never crowds out normal Zigbee commands. That holds for devices
+ * that query on their own schedule too: they wait for a slot like the rest,
+ * and blocks are capped per second across all devices. Progress is tracked
+ * per device.
+ *
+ * Images can be written with parttool.py or fetched over HTTP(S).
+ */
+
+#ifndef ZIGBEE_OTA_H
+#define ZIGBEE_OTA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_zigbee_core.h"
+#include "zigbee_hub.h"
+
+/* ============================================================================
+   ZIGBEE OTA CONFIGURATION
+   ============================================================================ */
+
+#define ZB_OTA_PARTITION_LABEL      "zb_ota"    /* Data partition holding the images */
+#define ZB_OTA_FILE_IDENTIFIER      0x0BEEF11E  /* Zigbee OTA file magic */
+#define ZB_OTA_FILE_ALIGN           4096        /* Files start on a flash sector */
+#define ZB_OTA_MAX_IMAGES           4           /* Images served at once */
+#define ZB_OTA_MAX_SESSIONS         ZIGBEE_MAX_DEVICES  /* Devices tracked (active + finished) */
+#define ZB_OTA_MAX_CONCURRENT       1           /* Devices transferring at the same time */
+#define ZB_OTA_MAX_BLOCKS_PER_SEC   16          /* Block responses per second, all devices */
+#define ZB_OTA_SESSION_TIMEOUT_MS   60000       /* No block for this long = stalled */
+#define ZB_OTA_TICK_MS              1000        /* Admission/timeout check period */
+#define ZB_OTA_QUERY_JITTER         100         /* Image Notify jitter (100 = always query) */
+#define ZB_OTA_URL_MAX_LEN          160         /* Longest accepted fetch URL */
+
+/* ============================================================================
+   OTA FILE HEADER (Zigbee spec, little-endian)
+   ============================================================================ */
+
+typedef struct __attribute__((packed)) {
+    uint32_t file_identifier;       /* ZB_OTA_FILE_IDENTIFIER */
+    uint16_t header_version;
+    uint16_t header_length;
+    uint16_t field_control;
+    uint16_t manufacturer_code;
+    uint16_t image_type;
+    uint32_t file_version;
+    uint16_t stack_version;
+    char header_string[32];
+    uint32_t total_image_size;      /* Whole file including this header */
+} zigbee_ota_file_header_t;
+
+/* ============================================================================
+   SESSION STATE
+   ============================================================================ */
+
+typedef enum {
+    ZB_OTA_SESSION_QUEUED = 0,      /* Waiting for a transfer slot */
+    ZB_OTA_SESSION_NOTIFIED,        /* Image Notify sent, waiting for the first block request */
+    ZB_OTA_SESSION_TRANSFERRING,    /* Blocks flowing */
+    ZB_OTA_SESSION_DONE,            /* Last block served */
+    ZB_OTA_SESSION_STALLED,         /* Timed out - slot released */
+} zigbee_ota_session_state_t;
+
+typedef struct {
+    uint16_t short_addr;
+    zigbee_ota_session_state_t state;
+    int8_t image;                   /* Index of the image served, -1 until known */
+    uint32_t bytes_served;          /* Highest offset served so far */
+    uint32_t blocks;                /* Block responses (including retries) */
+    int64_t started_us;             /* First block request */
+    int64_t last_block_us;
+    int64_t state_since_us;
+} zigbee_ota_session_t;
+
+/* ============================================================================
+   SERVER LIFECYCLE (called from zigbee_hub.c, Zigbee task)
+   ============================================================================ */
+
+/**
+ * @brief Add the OTA Upgrade server cluster to the hub endpoint
+ *
+ * Call while building the endpoint, before esp_zb_device_register().
+ *
+ * @param cluster_list Hub endpoint cluster list
+ */
+void zigbee_ota_add_server_cluster(esp_zb_cluster_list_t *cluster_list);
+
+/**
+ * @brief Map the image partition and offer its images to the stack
+ *
+ * Call once the network is up. Safe to call more than once.
+ */
+void zigbee_ota_server_start(void);
+
+/* ============================================================================
+   UPGRADES
+   ============================================================================ */
+
+/**
+ * @brief Queue an upgrade for a device
+ *
+ * The device is sent an Image Notify when a transfer slot is free. It then
+ * queries for an image, and the stack offers one matching its manufacturer
+ * code and image type.
+ *
+ * @param short_addr Device short address, 0 for every paired device
+ * @return ESP_OK if queued, ESP_ERR_NOT_FOUND for an unknown device,
+ *         ESP_ERR_INVALID_STATE if no images are loaded
+ */
+esp_err_t zigbee_ota_upgrade(uint16_t short_addr);
+
+/**
+ * @brief Download an OTA file and append it to the image partition
+ *
+ * Runs on the background job task (halo_tasks.h). Refused while transfers are active.
+ *
+ * @param url HTTP(S) URL of a .ota / .zigbee file
+ * @return ESP_OK if the download was queued
+ */
+esp_err_t zigbee_ota_fetch(const char *url);
+
+/**
+ * @brief Erase all images from the partition
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE while transfers are active
+ */
+esp_err_t zigbee_ota_erase(void);
+
+/* ============================================================================
+   STATUS
+   ============================================================================ */
+
+/**
+ * @brief Log the stored images and per-device upgrade progress
+ */
+void zigbee_ota_print_status(void);
+
+#endif /* ZIGBEE_OTA_H */
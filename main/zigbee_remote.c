@@ -0,0 +1,388 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee Remote - Remote/switch binding, command decoding and mapping
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_zigbee_core.h"
+#include "halo_metrics.h"
+#include "zigbee_hub.h"
+#include "zigbee_remote.h"
+
+static const char *TAG = "zb_remote";
+
+#define ZCL_CLUSTER_ON_OFF          0x0006
+#define ZCL_CLUSTER_LEVEL           0x0008
+#define ZCL_CLUSTER_SCENES          0x0005
+
+#define ZCL_ON_OFF_OFF              0x00
+#define ZCL_ON_OFF_ON               0x01
+#define ZCL_ON_OFF_TOGGLE           0x02
+#define ZCL_ON_OFF_OFF_WITH_EFFECT  0x40
+#define ZCL_ON_OFF_ON_TIMED         0x42
+#define ZCL_ON_OFF_TUYA_PRESS       0xFD    /* Tuya scene switches: 0=single, 1=double, 2=hold */
+
+#define ZCL_LEVEL_MOVE_TO_LEVEL     0x00    /* +0x04 = "with On/Off" variant */
+#define ZCL_LEVEL_MOVE              0x01
+#define ZCL_LEVEL_STEP              0x02
+#define ZCL_LEVEL_STOP              0x03
+
+#define ZCL_SCENES_RECALL           0x05
+
+/* ============================================================================
+   MAPPING TABLE
+   ============================================================================
+   First match wins. endpoint and arg accept ZB_REMOTE_ANY. A "%u" in the
+   command is replaced by the event's arg (level percent, scene ID).
+   Tuya 4-gang scene switches report the button as the endpoint (1-4).
+   ============================================================================ */
+
+typedef struct {
+    zigbee_remote_event_t event;
+    uint8_t endpoint;
+    uint8_t arg;
+    const char *command;
+} zigbee_remote_mapping_t;
+
+static const zigbee_remote_mapping_t s_mappings[] = {
+    /* Standard On/Off + Level remotes (Hue, IKEA, Aqara, ...) drive the ring */
+    { ZB_REMOTE_EVENT_ON,           ZB_REMOTE_ANY, ZB_REMOTE_ANY, "on"              },
+    { ZB_REMOTE_EVENT_OFF,          ZB_REMOTE_ANY, ZB_REMOTE_ANY, "off"             },
+    { ZB_REMOTE_EVENT_TOGGLE,       ZB_REMOTE_ANY, ZB_REMOTE_ANY, "toggle"          },
+    { ZB_REMOTE_EVENT_LEVEL_UP,     ZB_REMOTE_ANY, ZB_REMOTE_ANY, "brightness:up"   },
+    { ZB_REMOTE_EVENT_LEVEL_DOWN,   ZB_REMOTE_ANY, ZB_REMOTE_ANY, "brightness:down" },
+    { ZB_REMOTE_EVENT_LEVEL_SET,    ZB_REMOTE_ANY, ZB_REMOTE_ANY, "brightness:%u"   },
+
+    /* Scene buttons pick a mood */
+    { ZB_REMOTE_EVENT_SCENE,        ZB_REMOTE_ANY, 1,             "effect:candle"   },
+    { ZB_REMOTE_EVENT_SCENE,        ZB_REMOTE_ANY, 2,             "effect:chill"    },
+    { ZB_REMOTE_EVENT_SCENE,        ZB_REMOTE_ANY, 3,             "rainbow"         },
+    { ZB_REMOTE_EVENT_SCENE,        ZB_REMOTE_ANY, ZB_REMOTE_ANY, "cycle"           },
+
+    /* Tuya 4-gang: ring on button 1, blinds on 2-4 */
+    { ZB_REMOTE_EVENT_PRESS_SINGLE, 1,             ZB_REMOTE_ANY, "toggle"          },
+    { ZB_REMOTE_EVENT_PRESS_DOUBLE, 1,             ZB_REMOTE_ANY, "effect:candle"   },
+    { ZB_REMOTE_EVENT_PRESS_HOLD,   1,             ZB_REMOTE_ANY, "off"             },
+    { ZB_REMOTE_EVENT_PRESS_SINGLE, 2,             ZB_REMOTE_ANY, "blinds:open"     },
+    { ZB_REMOTE_EVENT_PRESS_SINGLE, 3,             ZB_REMOTE_ANY, "blinds:close"    },
+    { ZB_REMOTE_EVENT_PRESS_SINGLE, 4,             ZB_REMOTE_ANY, "blinds:stop"     },
+};
+
+#define MAPPING_COUNT (sizeof(s_mappings) / sizeof(s_mappings[0]))
+
+/* ============================================================================
+   STATE
+   ============================================================================ */
+
+static QueueHandle_t s_queue = NULL;
+static StaticQueue_t s_queue_struct;
+static uint8_t s_queue_storage[ZB_REMOTE_QUEUE_LEN * sizeof(zigbee_remote_input_t)];
+
+static uint32_t s_event_counts[ZB_REMOTE_EVENT_COUNT];
+static uint32_t s_dropped = 0;
+static uint32_t s_unmapped = 0;
+
+static metrics_histogram_t s_press_to_light = METRICS_HISTOGRAM_INIT("remote_to_light", "us");
+
+static const char *event_names[ZB_REMOTE_EVENT_COUNT] = {
+    "on", "off", "toggle", "level_up", "level_down", "level_stop",
+    "level_set", "scene", "single", "double", "hold",
+};
+
+/* ============================================================================
+   SETUP
+   ============================================================================ */
+
+void zigbee_remote_add_clusters(esp_zb_cluster_list_t *cluster_list)
+{
+    /* Server roles: remotes bind to these and send us their commands */
+    esp_zb_cluster_list_add_on_off_cluster(cluster_list, esp_zb_on_off_cluster_create(NULL),
+                                           ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+    esp_zb_cluster_list_add_level_cluster(cluster_list, esp_zb_level_cluster_create(NULL),
+                                          ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+    /* Scenes server requires Groups */
+    esp_zb_cluster_list_add_groups_cluster(cluster_list, esp_zb_groups_cluster_create(NULL),
+                                           ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+    esp_zb_cluster_list_add_scenes_cluster(cluster_list, esp_zb_scenes_cluster_create(NULL),
+                                           ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+}
+
+esp_err_t zigbee_remote_register(uint8_t endpoint)
+{
+    static const struct { uint16_t cluster; uint8_t command; } privileged[] = {
+        { ZCL_CLUSTER_ON_OFF, ZCL_ON_OFF_OFF },
+        { ZCL_CLUSTER_ON_OFF, ZCL_ON_OFF_ON },
+        { ZCL_CLUSTER_ON_OFF, ZCL_ON_OFF_TOGGLE },
+        { ZCL_CLUSTER_ON_OFF, ZCL_ON_OFF_OFF_WITH_EFFECT },
+        { ZCL_CLUSTER_ON_OFF, ZCL_ON_OFF_ON_TIMED },
+        { ZCL_CLUSTER_ON_OFF, ZCL_ON_OFF_TUYA_PRESS },
+        { ZCL_CLUSTER_LEVEL,  ZCL_LEVEL_MOVE_TO_LEVEL },
+        { ZCL_CLUSTER_LEVEL,  ZCL_LEVEL_MOVE },
+        { ZCL_CLUSTER_LEVEL,  ZCL_LEVEL_STEP },
+        { ZCL_CLUSTER_LEVEL,  ZCL_LEVEL_STOP },
+        { ZCL_CLUSTER_LEVEL,  ZCL_LEVEL_MOVE_TO_LEVEL + 4 },
+        { ZCL_CLUSTER_LEVEL,  ZCL_LEVEL_MOVE + 4 },
+        { ZCL_CLUSTER_LEVEL,  ZCL_LEVEL_STEP + 4 },
+        { ZCL_CLUSTER_LEVEL,  ZCL_LEVEL_STOP + 4 },
+        { ZCL_CLUSTER_SCENES, ZCL_SCENES_RECALL },
+    };
+
+    if (!s_queue) {
+        s_queue = xQueueCreateStatic(ZB_REMOTE_QUEUE_LEN, sizeof(zigbee_remote_input_t),
+                                     s_queue_storage, &s_queue_struct);
+    }
+
+    for (int i = 0; i < sizeof(privileged) / sizeof(privileged[0]); i++) {
+        esp_err_t err = esp_zb_zcl_add_privilege_command(endpoint, privileged[i].cluster,
+                                                         privileged[i].command);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to route cluster 0x%04x cmd 0x%02x: %s",
+                     privileged[i].cluster, privileged[i].command, esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    ESP_LOGI(TAG, "Remote input ready on endpoint %d (%d mappings)", endpoint, (int)MAPPING_COUNT);
+    return ESP_OK;
+}
+
+/* ============================================================================
+   DISCOVERY AND BINDING
+   ============================================================================ */
+
+/* HA / ZLL controller device IDs */
+static bool is_controller_device_id(uint16_t device_id)
+{
+    switch (device_id) {
+        case 0x0000:    /* On/Off Switch */
+        case 0x0001:    /* Level Control Switch */
+        case 0x0006:    /* Remote Control */
+        case 0x0103:    /* On/Off Light Switch */
+        case 0x0104:    /* Dimmer Switch */
+        case 0x0105:    /* Color Dimmer Switch */
+        case 0x0810:    /* ZLL Color Controller */
+        case 0x0820:    /* ZLL Non-Color Controller */
+        case 0x0830:    /* ZLL Color Scene Controller */
+        case 0x0840:    /* ZLL Non-Color Scene Controller */
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool zigbee_remote_is_controller(const esp_zb_af_simple_desc_1_1_t *desc)
+{
+    if (is_controller_device_id(desc->app_device_id)) {
+        return true;
+    }
+
+    /* Otherwise: sends On/Off, Level or Scenes but doesn't take On/Off itself */
+    bool has_on_off_server = false;
+    for (int i = 0; i < desc->app_input_cluster_count; i++) {
+        if (desc->app_cluster_list[i] == ZCL_CLUSTER_ON_OFF) {
+            has_on_off_server = true;
+        }
+    }
+
+    const uint16_t *outputs = desc->app_cluster_list + desc->app_input_cluster_count;
+    for (int i = 0; i < desc->app_output_cluster_count; i++) {
+        if (outputs[i] == ZCL_CLUSTER_ON_OFF || outputs[i] == ZCL_CLUSTER_LEVEL ||
+            outputs[i] == ZCL_CLUSTER_SCENES) {
+            return !has_on_off_server;
+        }
+    }
+    return false;
+}
+
+static void bind_cb(esp_zb_zdp_status_t zdo_status, void *user_ctx)
+{
+    uint16_t cluster = (uint16_t)(uintptr_t)user_ctx;
+    if (zdo_status == ESP_ZB_ZDP_STATUS_SUCCESS) {
+        ESP_LOGI(TAG, "  Bound cluster 0x%04x to the hub", cluster);
+    } else {
+        /* Not every remote has all three clusters */
+        ESP_LOGD(TAG, "  Bind cluster 0x%04x: status %d", cluster, zdo_status);
+    }
+}
+
+void zigbee_remote_bind(uint16_t short_addr, const uint8_t ieee_addr[8], uint8_t endpoint)
+{
+    static const uint16_t clusters[] = { ZCL_CLUSTER_ON_OFF, ZCL_CLUSTER_LEVEL, ZCL_CLUSTER_SCENES };
+
+    ESP_LOGI(TAG, "Binding remote 0x%04x (endpoint %d) to the hub", short_addr, endpoint);
+
+    for (int i = 0; i < sizeof(clusters) / sizeof(clusters[0]); i++) {
+        esp_zb_zdo_bind_req_param_t bind_req = {
+            .src_endp = endpoint,
+            .cluster_id = clusters[i],
+            .dst_addr_mode = ESP_ZB_ZDO_BIND_DST_ADDR_MODE_64_BIT_EXTENDED,
+            .dst_endp = ZIGBEE_HUB_ENDPOINT,
+            .req_dst_addr = short_addr,
+        };
+        memcpy(bind_req.src_address, ieee_addr, sizeof(esp_zb_ieee_addr_t));
+        esp_zb_get_long_address(bind_req.dst_address_u.addr_long);
+        esp_zb_zdo_device_bind_req(&bind_req, bind_cb, (void *)(uintptr_t)clusters[i]);
+    }
+}
+
+/* ============================================================================
+   COMMAND DECODING (Zigbee task)
+   ============================================================================ */
+
+static bool decode_command(uint16_t cluster, uint8_t cmd, const uint8_t *data, uint16_t size,
+                           zigbee_remote_input_t *in)
+{
+    switch (cluster) {
+        case ZCL_CLUSTER_ON_OFF:
+            switch (cmd) {
+                case ZCL_ON_OFF_OFF:
+                case ZCL_ON_OFF_OFF_WITH_EFFECT: in->event = ZB_REMOTE_EVENT_OFF;    return true;
+                case ZCL_ON_OFF_ON:
+                case ZCL_ON_OFF_ON_TIMED:        in->event = ZB_REMOTE_EVENT_ON;     return true;
+                case ZCL_ON_OFF_TOGGLE:          in->event = ZB_REMOTE_EVENT_TOGGLE; return true;
+                case ZCL_ON_OFF_TUYA_PRESS:
+                    if (size < 1 || data[0] > 2) {
+                        return false;
+                    }
+                    in->event = ZB_REMOTE_EVENT_PRESS_SINGLE + data[0];
+                    return true;
+                default:
+                    return false;
+            }
+
+        case ZCL_CLUSTER_LEVEL:
+            /* "with On/Off" variants carry the same payload */
+            switch (cmd & ~0x04) {
+                case ZCL_LEVEL_MOVE_TO_LEVEL:
+                    if (size < 1) {
+                        return false;
+                    }
+                    in->event = ZB_REMOTE_EVENT_LEVEL_SET;
+                    in->arg = (uint8_t)((data[0] * 100 + 127) / 254);
+                    return true;
+                case ZCL_LEVEL_MOVE:
+                case ZCL_LEVEL_STEP:
+                    if (size < 1) {
+                        return false;
+                    }
+                    in->event = (data[0] == 0) ? ZB_REMOTE_EVENT_LEVEL_UP : ZB_REMOTE_EVENT_LEVEL_DOWN;
+                    return true;
+                case ZCL_LEVEL_STOP:
+                    in->event = ZB_REMOTE_EVENT_LEVEL_STOP;
+                    return true;
+                default:
+                    return false;
+            }
+
+        case ZCL_CLUSTER_SCENES:
+            if (cmd != ZCL_SCENES_RECALL || size < 3) {
+                return false;
+            }
+            in->event = ZB_REMOTE_EVENT_SCENE;
+            in->arg = data[2];          /* Group ID (2 bytes), then scene ID */
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+bool zigbee_remote_handle_command(const esp_zb_zcl_privilege_command_message_t *msg)
+{
+    zigbee_remote_input_t in = {
+        .short_addr = msg->info.src_address.u.short_addr,
+        .endpoint = msg->info.src_endpoint,
+        .rx_us = esp_timer_get_time(),
+    };
+
+    if (!decode_command(msg->info.cluster, msg->info.command.id,
+                        (const uint8_t *)msg->data, msg->size, &in)) {
+        return false;
+    }
+
+    s_event_counts[in.event]++;
+    ESP_LOGD(TAG, "Remote 0x%04x ep %d: %s (%d)", in.short_addr, in.endpoint,
+             event_names[in.event], in.arg);
+
+    /* Never block the Zigbee task - a full queue means the remote task is stuck */
+    if (!s_queue || xQueueSend(s_queue, &in, 0) != pdTRUE) {
+        s_dropped++;
+    }
+    return true;
+}
+
+/* ============================================================================
+   INPUT (remote input task)
+   ============================================================================ */
+
+bool zigbee_remote_poll(zigbee_remote_input_t *out, uint32_t wait_ms)
+{
+    if (!s_queue) {
+        /* Created when the hub endpoint is built, on the Zigbee task */
+        vTaskDelay(pdMS_TO_TICKS(wait_ms));
+        return false;
+    }
+    return xQueueReceive(s_queue, out, pdMS_TO_TICKS(wait_ms)) == pdTRUE;
+}
+
+bool zigbee_remote_map(const zigbee_remote_input_t *in, char *buf, size_t buf_len)
+{
+    for (int i = 0; i < MAPPING_COUNT; i++) {
+        const zigbee_remote_mapping_t *m = &s_mappings[i];
+        if (m->event != in->event) continue;
+        if (m->endpoint != ZB_REMOTE_ANY && m->endpoint != in->endpoint) continue;
+        if (m->arg != ZB_REMOTE_ANY && m->arg != in->arg) continue;
+
+        snprintf(buf, buf_len, m->command, (unsigned)in->arg);
+        return true;
+    }
+
+    s_unmapped++;
+    return false;
+}
+
+void zigbee_remote_record_latency(int64_t rx_us)
+{
+    metrics_hist_record(&s_press_to_light, (uint32_t)(esp_timer_get_time() - rx_us));
+}
+
+/* ============================================================================
+   STATUS
+   ============================================================================ */
+
+void zigbee_remote_print_status(void)
+{
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "╔══════════════════════════════════════════════════════════╗");
+    ESP_LOGI(TAG, "║  🎛️  ZIGBEE REMOTE INPUT                                  ║");
+    ESP_LOGI(TAG, "╚══════════════════════════════════════════════════════════╝");
+
+    ESP_LOGI(TAG, "  Mappings:");
+    for (int i = 0; i < MAPPING_COUNT; i++) {
+        const zigbee_remote_mapping_t *m = &s_mappings[i];
+        char ep[4] = "*", arg[4] = "*";
+        if (m->endpoint != ZB_REMOTE_ANY) snprintf(ep, sizeof(ep), "%u", m->endpoint);
+        if (m->arg != ZB_REMOTE_ANY) snprintf(arg, sizeof(arg), "%u", m->arg);
+        ESP_LOGI(TAG, "    %-10s ep=%-3s arg=%-3s -> %s", event_names[m->event], ep, arg, m->command);
+    }
+
+    ESP_LOGI(TAG, "  Events received:");
+    for (int i = 0; i < ZB_REMOTE_EVENT_COUNT; i++) {
+        if (s_event_counts[i] > 0) {
+            ESP_LOGI(TAG, "    %-10s %lu", event_names[i], (unsigned long)s_event_counts[i]);
+        }
+    }
+    ESP_LOGI(TAG, "  Unmapped: %lu, dropped (queue full): %lu",
+             (unsigned long)s_unmapped, (unsigned long)s_dropped);
+
+    metrics_hist_print(&s_press_to_light);
+    ESP_LOGI(TAG, "");
+}
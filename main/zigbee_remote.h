@@ -0,0 +1,147 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee Remote - Zigbee switches and remotes as Halo input devices
+ *
+ * Remotes and wall switches are controllers: they have On/Off, Level Control
+ * or Scenes as *output* clusters and send commands rather than receive them.
+ * When one pairs, the hub binds those clusters to its own endpoint, so the
+ * remote's button presses are sent straight to the hub.
+ *
+ * The Zigbee task turns each received command into an input event and queues
+ * it. A task of its own in halo.c takes events off the queue and runs them
+ * through a mapping table into normal Halo commands ("toggle", "brightness:up",
+ * "blinds:open", ...). Everything stays on-device. No MQTT round trip.
+ *
+ * Press-to-light latency is measured from the frame's arrival at the hub to
+ * the first rendered frame after the command was applied.
+ */
+
+#ifndef ZIGBEE_REMOTE_H
+#define ZIGBEE_REMOTE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_zigbee_core.h"
+
+/* ============================================================================
+   ZIGBEE REMOTE CONFIGURATION
+   ============================================================================ */
+
+#define ZB_REMOTE_QUEUE_LEN         8       /* Presses buffered while a command runs */
+#define ZB_REMOTE_ANY               0xFF    /* Mapping wildcard for endpoint / arg */
+
+/* ============================================================================
+   INPUT EVENTS
+   ============================================================================ */
+
+typedef enum {
+    ZB_REMOTE_EVENT_ON = 0,         /* On/Off: On */
+    ZB_REMOTE_EVENT_OFF,            /* On/Off: Off */
+    ZB_REMOTE_EVENT_TOGGLE,         /* On/Off: Toggle */
+    ZB_REMOTE_EVENT_LEVEL_UP,       /* Level: Step / Move up */
+    ZB_REMOTE_EVENT_LEVEL_DOWN,     /* Level: Step / Move down */
+    ZB_REMOTE_EVENT_LEVEL_STOP,     /* Level: Stop (button released) */
+    ZB_REMOTE_EVENT_LEVEL_SET,      /* Level: Move to Level, arg = percent */
+    ZB_REMOTE_EVENT_SCENE,          /* Scenes: Recall, arg = scene ID */
+    ZB_REMOTE_EVENT_PRESS_SINGLE,   /* Tuya scene switch (On/Off cmd 0xFD) */
+    ZB_REMOTE_EVENT_PRESS_DOUBLE,
+    ZB_REMOTE_EVENT_PRESS_HOLD,
+    ZB_REMOTE_EVENT_COUNT,
+} zigbee_remote_event_t;
+
+typedef struct {
+    uint16_t short_addr;            /* Remote that sent it */
+    uint8_t endpoint;               /* Button group on multi-gang switches */
+    zigbee_remote_event_t event;
+    uint8_t arg;                    /* Level percent or scene ID */
+    int64_t rx_us;                  /* esp_timer time the command arrived */
+} zigbee_remote_input_t;
+
+/* ============================================================================
+   SETUP (called from zigbee_hub.c, Zigbee task)
+   ============================================================================ */
+
+/**
+ * @brief Add the On/Off, Level and Scenes server clusters remotes bind to
+ *
+ * Call while building the hub endpoint, before esp_zb_device_register().
+ *
+ * @param cluster_list Hub endpoint cluster list
+ */
+void zigbee_remote_add_clusters(esp_zb_cluster_list_t *cluster_list);
+
+/**
+ * @brief Route remote commands on the hub endpoint to this module
+ *
+ * Call after esp_zb_device_register(). Registers the commands as privilege
+ * commands, so the stack hands them over instead of acting on them.
+ *
+ * @param endpoint Hub endpoint
+ * @return ESP_OK on success
+ */
+esp_err_t zigbee_remote_register(uint8_t endpoint);
+
+/**
+ * @brief Check whether a simple descriptor describes a controller (remote/switch)
+ *
+ * @param desc Simple descriptor from device discovery
+ * @return true if the device sends On/Off, Level or Scenes commands
+ */
+bool zigbee_remote_is_controller(const esp_zb_af_simple_desc_1_1_t *desc);
+
+/**
+ * @brief Bind a remote's controller clusters to the hub endpoint
+ *
+ * @param short_addr Remote short address
+ * @param ieee_addr Remote IEEE address
+ * @param endpoint Remote endpoint
+ */
+void zigbee_remote_bind(uint16_t short_addr, const uint8_t ieee_addr[8], uint8_t endpoint);
+
+/**
+ * @brief Handle a privilege command from the core action handler
+ *
+ * @param msg Message from ESP_ZB_CORE_CMD_PRIVILEGE_COMMAND_REQ_CB_ID
+ * @return true if it was a remote command
+ */
+bool zigbee_remote_handle_command(const esp_zb_zcl_privilege_command_message_t *msg);
+
+/* ============================================================================
+   INPUT (called from the remote input task)
+   ============================================================================ */
+
+/**
+ * @brief Take the next queued input event, waiting for one
+ *
+ * @param out Event
+ * @param wait_ms Longest wait (also slept through if the queue does not exist yet)
+ * @return true if an event was returned
+ */
+bool zigbee_remote_poll(zigbee_remote_input_t *out, uint32_t wait_ms);
+
+/**
+ * @brief Look up the Halo command an input event maps to
+ *
+ * @param in Input event
+ * @param buf Buffer for the command
+ * @param buf_len Size of buf
+ * @return true if a mapping matched (command in buf)
+ */
+bool zigbee_remote_map(const zigbee_remote_input_t *in, char *buf, size_t buf_len);
+
+/**
+ * @brief Record press-to-light latency once a frame shows the result
+ *
+ * @param rx_us Arrival time of the oldest input applied in that frame
+ */
+void zigbee_remote_record_latency(int64_t rx_us);
+
+/**
+ * @brief Log the mapping table, event counters and latency histogram
+ */
+void zigbee_remote_print_status(void);
+
+#endif /* ZIGBEE_REMOTE_H */
@@ -0,0 +1,259 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee Routing - Concentrator mode, routing table sampler and RTT probes
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_zigbee_core.h"
+#include "zboss_api.h"          /* Concentrator mode has no esp_zb_* wrapper */
+#include "halo_metrics.h"
+#include "zigbee_hub.h"
+#include "zigbee_devices.h"
+#include "zigbee_routing.h"
+
+static const char *TAG = "zb_routing";
+
+#define TRACKED_DISCOVERIES     16      /* Destinations remembered between samples */
+
+/* ============================================================================
+   STATE
+   ============================================================================ */
+
+static bool s_started = false;
+static int64_t s_started_us = 0;
+
+/* Last routing table sample (written by the Zigbee task, read by status) */
+static struct {
+    uint16_t routes;                /* Entries in the table */
+    uint16_t active;
+    uint16_t discovering;
+    uint16_t failed;
+    uint16_t many_to_one;
+    uint16_t record_required;
+    uint32_t samples;
+} s_sample;
+
+/* Destinations caught in discovery by a sample, counted once per run of
+   samples that see them. This is not a route request count: a discovery
+   that starts and ends between two samples is missed, and one entry can
+   stay in discovery across several requests. The stack has no hook to
+   count the requests themselves. */
+static uint16_t s_discovering_dst[TRACKED_DISCOVERIES];
+static int s_discovering_count = 0;
+static uint32_t s_discovering_sighted = 0;
+static uint32_t s_discovering_then_failed = 0;
+
+/* Probe bookkeeping, indexed like the device table */
+static int64_t s_probe_sent_us[ZIGBEE_MAX_DEVICES];
+static bool s_probe_direct[ZIGBEE_MAX_DEVICES];
+static uint32_t s_probe_sent = 0;
+static uint32_t s_probe_lost = 0;
+
+static metrics_histogram_t s_rtt_direct = METRICS_HISTOGRAM_INIT("zb_rtt_direct", "ms");
+static metrics_histogram_t s_rtt_routed = METRICS_HISTOGRAM_INIT("zb_rtt_routed", "ms");
+
+/* ============================================================================
+   LIFECYCLE
+   ============================================================================ */
+
+void zigbee_routing_configure(void)
+{
+    /* Neighbor, routing and address tables scale with this */
+    esp_zb_overall_network_size_set(ZB_ROUTE_NETWORK_SIZE);
+}
+
+static bool dst_was_discovering(uint16_t dst)
+{
+    for (int i = 0; i < s_discovering_count; i++) {
+        if (s_discovering_dst[i] == dst) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Zigbee task: walk the routing table, no lock needed here */
+static void route_sample_alarm(uint8_t param)
+{
+    uint16_t discovering_now[TRACKED_DISCOVERIES];
+    int discovering_now_count = 0;
+    uint16_t routes = 0, active = 0, discovering = 0, failed = 0, m2o = 0, rr = 0;
+
+    esp_zb_nwk_route_info_t route;
+    esp_zb_nwk_info_iterator_t iterator = 0;
+    while (esp_zb_nwk_get_next_route(&iterator, &route) == ESP_OK) {
+        routes++;
+        if (route.flags.many_to_one) m2o++;
+        if (route.flags.route_record_required) rr++;
+
+        switch (route.flags.status) {
+            case ESP_ZB_NWK_ROUTE_STATE_ACTIVE:
+                active++;
+                break;
+            case ESP_ZB_NWK_ROUTE_STATE_DISCOVERY_UNDERWAY:
+                discovering++;
+                if (!dst_was_discovering(route.dest_addr)) {
+                    s_discovering_sighted++;
+                }
+                if (discovering_now_count < TRACKED_DISCOVERIES) {
+                    discovering_now[discovering_now_count++] = route.dest_addr;
+                }
+                break;
+            case ESP_ZB_NWK_ROUTE_STATE_DISCOVERY_FAILED:
+                failed++;
+                if (dst_was_discovering(route.dest_addr)) {
+                    s_discovering_then_failed++;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    memcpy(s_discovering_dst, discovering_now, discovering_now_count * sizeof(uint16_t));
+    s_discovering_count = discovering_now_count;
+
+    s_sample.routes = routes;
+    s_sample.active = active;
+    s_sample.discovering = discovering;
+    s_sample.failed = failed;
+    s_sample.many_to_one = m2o;
+    s_sample.record_required = rr;
+    s_sample.samples++;
+
+    esp_zb_scheduler_alarm(route_sample_alarm, 0, ZB_ROUTE_SAMPLE_MS);
+}
+
+void zigbee_routing_start(void)
+{
+    if (s_started) {
+        return;
+    }
+    s_started = true;
+    s_started_us = esp_timer_get_time();
+
+    /* The stack floods a many-to-one route request every interval, keeps
+       the route records devices send back and source-routes to them */
+    zb_start_concentrator_mode(ZB_ROUTE_CONCENTRATOR_RADIUS, ZB_ROUTE_MTORR_INTERVAL_S);
+    ESP_LOGI(TAG, "Concentrator mode on (many-to-one route request every %ds)",
+             ZB_ROUTE_MTORR_INTERVAL_S);
+
+    esp_zb_scheduler_alarm(route_sample_alarm, 0, ZB_ROUTE_SAMPLE_MS);
+}
+
+/* ============================================================================
+   RTT PROBE
+   ============================================================================ */
+
+static void probe_cb(esp_zb_zdp_status_t zdo_status, esp_zb_zdo_ieee_addr_rsp_t *resp, void *user_ctx)
+{
+    int index = (int)(uintptr_t)user_ctx;
+    if (index < 0 || index >= ZIGBEE_MAX_DEVICES || s_probe_sent_us[index] == 0) {
+        return;
+    }
+
+    int64_t sent_us = s_probe_sent_us[index];
+    s_probe_sent_us[index] = 0;
+
+    if (zdo_status != ESP_ZB_ZDP_STATUS_SUCCESS) {
+        s_probe_lost++;
+        return;
+    }
+
+    uint32_t rtt_ms = (uint32_t)((esp_timer_get_time() - sent_us) / 1000);
+    metrics_hist_record(s_probe_direct[index] ? &s_rtt_direct : &s_rtt_routed, rtt_ms);
+}
+
+static bool is_neighbor(uint16_t short_addr)
+{
+    esp_zb_nwk_neighbor_info_t neighbor;
+    esp_zb_nwk_info_iterator_t iterator = 0;
+    while (esp_zb_nwk_get_next_neighbor(&iterator, &neighbor) == ESP_OK) {
+        if (neighbor.short_addr == short_addr) {
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t zigbee_routing_probe(void)
+{
+    if (!zigbee_is_network_ready()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int sent = 0;
+    int64_t now = esp_timer_get_time();
+
+    const zigbee_device_table_t *table = zigbee_devices_snapshot();
+    esp_zb_lock_acquire(portMAX_DELAY);
+    for (int i = 0; i < table->count; i++) {
+        const zigbee_device_t *dev = &table->devices[i];
+        if (s_probe_sent_us[i] != 0) {
+            if (now - s_probe_sent_us[i] < ZB_ROUTE_PROBE_TIMEOUT_MS * 1000LL) {
+                continue;   /* Previous probe still outstanding */
+            }
+            s_probe_lost++;     /* Never answered, not even with a timeout */
+        }
+
+        esp_zb_zdo_ieee_addr_req_param_t req = {
+            .dst_nwk_addr = dev->short_addr,
+            .addr_of_interest = dev->short_addr,
+            .request_type = 0,      /* Single device response */
+            .start_index = 0,
+        };
+        s_probe_direct[i] = is_neighbor(dev->short_addr);
+        s_probe_sent_us[i] = esp_timer_get_time();
+        esp_zb_zdo_ieee_addr_req(&req, probe_cb, (void *)(uintptr_t)i);
+        sent++;
+    }
+    esp_zb_lock_release();
+    zigbee_devices_snapshot_release(table);
+
+    s_probe_sent += sent;
+    ESP_LOGI(TAG, "Probing %d device(s)", sent);
+    return ESP_OK;
+}
+
+/* ============================================================================
+   STATUS
+   ============================================================================ */
+
+void zigbee_routing_print_status(void)
+{
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "╔══════════════════════════════════════════════════════════╗");
+    ESP_LOGI(TAG, "║  🕸️  ZIGBEE ROUTING                                       ║");
+    ESP_LOGI(TAG, "╚══════════════════════════════════════════════════════════╝");
+
+    if (!s_started) {
+        ESP_LOGI(TAG, "  Concentrator not started (network not formed)");
+        return;
+    }
+
+    uint32_t uptime_s = (uint32_t)((esp_timer_get_time() - s_started_us) / 1000000);
+    ESP_LOGI(TAG, "  Concentrator: on for %lus, ~%lu many-to-one requests sent",
+             (unsigned long)uptime_s, (unsigned long)(uptime_s / ZB_ROUTE_MTORR_INTERVAL_S + 1));
+    ESP_LOGI(TAG, "  Routing table: %d entries (%d active, %d many-to-one, %d need route record)",
+             s_sample.routes, s_sample.active, s_sample.many_to_one, s_sample.record_required);
+    ESP_LOGI(TAG, "  Routes in discovery: %d now; sampled every %ds: %lu destinations caught, %lu then failed (%lu samples)",
+             s_sample.discovering, ZB_ROUTE_SAMPLE_MS / 1000, (unsigned long)s_discovering_sighted,
+             (unsigned long)s_discovering_then_failed, (unsigned long)s_sample.samples);
+    ESP_LOGI(TAG, "  Probes: %lu sent, %lu lost", (unsigned long)s_probe_sent, (unsigned long)s_probe_lost);
+
+    /* Routed minus direct RTT ~ what the extra hops cost */
+    if (s_rtt_direct.count > 0 && s_rtt_routed.count > 0) {
+        uint32_t direct = metrics_hist_percentile(&s_rtt_direct, 50);
+        uint32_t routed = metrics_hist_percentile(&s_rtt_routed, 50);
+        ESP_LOGI(TAG, "  p50 RTT: direct %lums, routed %lums (+%ldms for the extra hops)",
+                 (unsigned long)direct, (unsigned long)routed, (long)routed - (long)direct);
+    }
+    metrics_hist_print(&s_rtt_direct);
+    metrics_hist_print(&s_rtt_routed);
+    ESP_LOGI(TAG, "");
+}
@@ -0,0 +1,76 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee Routing - Concentrator (many-to-one) routing and route metrics
+ *
+ * By default every new destination costs a route discovery: a route request
+ * flooded through every router in the mesh. With more than a handful of
+ * devices this traffic grows with (devices x routers).
+ *
+ * As a concentrator the hub instead floods one many-to-one route request per
+ * interval. Every router learns a route *to* the hub, and devices send a
+ * route record with their first frame, so the stack can source-route frames
+ * *from* the hub without discovering anything.
+ *
+ * A sampler on the Zigbee task watches the routing table: routes in use,
+ * routes in discovery or failed, and many-to-one entries. It only sees the
+ * table at each sample, so it does not count route requests. A probe sends
+ * a ZDO request to every paired device and records round-trip time for
+ * direct neighbors and for multi-hop devices separately.
+ */
+
+#ifndef ZIGBEE_ROUTING_H
+#define ZIGBEE_ROUTING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/* ============================================================================
+   ZIGBEE ROUTING CONFIGURATION
+   ============================================================================ */
+
+#define ZB_ROUTE_NETWORK_SIZE           128     /* Stack table sizing (neighbors, routes, addresses) */
+#define ZB_ROUTE_CONCENTRATOR_RADIUS    0       /* 0 = stack default (2 x max depth) */
+#define ZB_ROUTE_MTORR_INTERVAL_S       300     /* Many-to-one route request period (see tools/zigbee_route_sim.py) */
+#define ZB_ROUTE_SAMPLE_MS              10000   /* Routing table sampling period */
+#define ZB_ROUTE_PROBE_TIMEOUT_MS       3000    /* Per-device probe answer timeout */
+
+/* ============================================================================
+   LIFECYCLE (called from zigbee_hub.c, Zigbee task)
+   ============================================================================ */
+
+/**
+ * @brief Size the stack's network tables
+ *
+ * Call before esp_zb_init().
+ */
+void zigbee_routing_configure(void);
+
+/**
+ * @brief Start concentrator mode and the routing table sampler
+ *
+ * Call once the network is up. Safe to call more than once.
+ */
+void zigbee_routing_start(void);
+
+/* ============================================================================
+   METRICS
+   ============================================================================ */
+
+/**
+ * @brief Send a ZDO IEEE address request to every paired device and time it
+ *
+ * Answers are recorded in the zb_rtt_direct / zb_rtt_routed histograms.
+ *
+ * @return ESP_OK if probes were sent, ESP_ERR_INVALID_STATE if no network
+ */
+esp_err_t zigbee_routing_probe(void);
+
+/**
+ * @brief Log routing table counters and RTT histograms
+ */
+void zigbee_routing_print_status(void);
+
+#endif /* ZIGBEE_ROUTING_H */
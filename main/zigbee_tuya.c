@@ -0,0 +1,409 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee Tuya - Data query, multi-DP parser and Tuya device state
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_zigbee_core.h"
+#include "halo_metrics.h"
+#include "radio_policy.h"
+#include "zigbee_hub.h"
+#include "zigbee_devices.h"
+#include "zigbee_tuya.h"
+
+static const char *TAG = "zb_tuya";
+
+/* ============================================================================
+   STATE
+   ============================================================================ */
+
+/* Written by the Zigbee task, copied out under the lock by other tasks */
+static zigbee_tuya_state_t s_state[ZIGBEE_MAX_DEVICES];
+static bool s_used[ZIGBEE_MAX_DEVICES];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Command waiting for its DP frame back, to end the radio_policy
+   transaction (Zigbee task or Zigbee lock held). Queries run in the
+   background and open none, so they never take the transaction an MQTT
+   reply is waiting on. */
+static struct {
+    bool pending;
+    uint16_t addr;
+    uint16_t seq;
+    uint8_t tsn;
+} s_txn;
+
+/* Query sent -> first DP frame back */
+static metrics_histogram_t s_query_latency = METRICS_HISTOGRAM_INIT("tuya_query_state", "ms");
+
+static zigbee_tuya_state_t *find_state(uint16_t short_addr)
+{
+    for (int i = 0; i < ZIGBEE_MAX_DEVICES; i++) {
+        if (s_used[i] && s_state[i].short_addr == short_addr) {
+            return &s_state[i];
+        }
+    }
+    return NULL;
+}
+
+/* Zigbee task only */
+static zigbee_tuya_state_t *get_or_add_state(uint16_t short_addr)
+{
+    zigbee_tuya_state_t *st = find_state(short_addr);
+    if (st) {
+        return st;
+    }
+
+    /* Free slot, or one left behind by a device that changed address */
+    for (int i = 0; i < ZIGBEE_MAX_DEVICES; i++) {
+        if (!s_used[i] || zigbee_devices_get_by_addr(s_state[i].short_addr) == NULL) {
+            taskENTER_CRITICAL(&s_lock);
+            memset(&s_state[i], 0, sizeof(s_state[i]));
+            s_state[i].short_addr = short_addr;
+            s_used[i] = true;
+            taskEXIT_CRITICAL(&s_lock);
+            return &s_state[i];
+        }
+    }
+    return NULL;
+}
+
+static bool query_expired(const zigbee_tuya_state_t *st, int64_t now)
+{
+    return st->query_sent_us != 0 &&
+           now - st->query_sent_us >= (int64_t)ZB_TUYA_QUERY_MIN_GAP_MS * 1000;
+}
+
+/* A query unanswered for the whole gap is lost: count it and clear it, so
+   the device can be queried again and its next report can count as a wake-up.
+   Zigbee task only. */
+static void expire_query(zigbee_tuya_state_t *st, int64_t now)
+{
+    if (!query_expired(st, now)) {
+        return;
+    }
+    taskENTER_CRITICAL(&s_lock);
+    st->query_sent_us = 0;
+    st->queries_lost++;
+    taskEXIT_CRITICAL(&s_lock);
+    ESP_LOGW(TAG, "Query to 0x%04x went unanswered for %ds - counted as lost", st->short_addr,
+             ZB_TUYA_QUERY_MIN_GAP_MS / 1000);
+}
+
+/* ============================================================================
+   DATA QUERY
+   ============================================================================ */
+
+/* Caller holds the Zigbee lock or runs in the Zigbee task */
+static esp_err_t send_query(const zigbee_device_t *device)
+{
+    zigbee_tuya_state_t *st = get_or_add_state(device->short_addr);
+    int64_t now = esp_timer_get_time();
+
+    if (st) {
+        expire_query(st, now);
+    }
+    if (st && st->query_sent_us != 0) {
+        ESP_LOGD(TAG, "Query to 0x%04x skipped (one already in flight)", device->short_addr);
+        return ESP_OK;
+    }
+
+    /* Data query carries no payload: the device answers with every DP */
+    esp_zb_zcl_custom_cluster_cmd_req_t cmd_req = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = device->short_addr,
+            .dst_endpoint = device->endpoint,
+            .src_endpoint = ZIGBEE_HUB_ENDPOINT,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+        .cluster_id = TUYA_CLUSTER_ID,
+        .custom_cmd_id = TUYA_CMD_DATA_QUERY,
+        .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_SRV,
+        .data = {
+            .type = ESP_ZB_ZCL_ATTR_TYPE_SET,
+            .size = 0,
+            .value = NULL,
+        },
+    };
+
+    if (st) {
+        taskENTER_CRITICAL(&s_lock);
+        st->query_sent_us = now;
+        st->queries++;
+        taskEXIT_CRITICAL(&s_lock);
+    }
+
+    ESP_LOGI(TAG, "Querying all data points of 0x%04x", device->short_addr);
+    esp_zb_zcl_custom_cluster_cmd_req(&cmd_req);
+    return ESP_OK;
+}
+
+void zigbee_tuya_command_sent(uint16_t short_addr, uint16_t seq, uint8_t tsn)
+{
+    s_txn.pending = true;
+    s_txn.addr = short_addr;
+    s_txn.seq = seq;
+    s_txn.tsn = tsn;
+    radio_policy_zigbee_txn_sent(short_addr, tsn);
+}
+
+esp_err_t zigbee_tuya_query_all(const zigbee_device_t *device)
+{
+    if (!device || device->device_type != ZIGBEE_DEVICE_TYPE_TUYA_BLIND) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_zb_lock_acquire(portMAX_DELAY);
+    esp_err_t ret = send_query(device);
+    esp_zb_lock_release();
+    return ret;
+}
+
+/* Zigbee task, scheduled from zigbee_tuya_device_awake() */
+static void query_alarm(uint8_t device_index)
+{
+    const zigbee_device_t *dev = zigbee_devices_get_by_index(device_index);
+    if (dev && dev->device_type == ZIGBEE_DEVICE_TYPE_TUYA_BLIND) {
+        send_query(dev);
+    }
+}
+
+void zigbee_tuya_device_awake(uint16_t short_addr)
+{
+    int count = zigbee_devices_get_count();
+    for (int i = 0; i < count; i++) {
+        const zigbee_device_t *dev = zigbee_devices_get_by_index(i);
+        if (dev && dev->short_addr == short_addr) {
+            if (dev->device_type == ZIGBEE_DEVICE_TYPE_TUYA_BLIND) {
+                esp_zb_scheduler_alarm(query_alarm, (uint8_t)i, ZB_TUYA_QUERY_DELAY_MS);
+            }
+            return;
+        }
+    }
+}
+
+/* ============================================================================
+   MULTI-DP PARSER (Zigbee task)
+   ============================================================================ */
+
+/* BOOL/ENUM are 1 byte, VALUE is 4 bytes, all big endian */
+static uint32_t dp_uint(const uint8_t *value, uint16_t len)
+{
+    uint32_t v = 0;
+    for (uint16_t i = 0; i < len && i < 4; i++) {
+        v = (v << 8) | value[i];
+    }
+    return v;
+}
+
+/* Tuya reports 0% = open, the hub uses 0% = closed */
+static uint8_t tuya_to_hub_percent(uint32_t tuya)
+{
+    return (uint8_t)(100 - (tuya > 100 ? 100 : tuya));
+}
+
+static void apply_dp(zigbee_tuya_state_t *st, uint8_t dp_id, uint8_t type,
+                     const uint8_t *value, uint16_t len)
+{
+    uint32_t v = dp_uint(value, len);
+
+    switch (dp_id) {
+        case TUYA_DP_CONTROL:
+            st->control = (uint8_t)v;
+            st->known |= ZB_TUYA_KNOWN_CONTROL;
+            ESP_LOGI(TAG, "│ Control: %lu (%s)", (unsigned long)v,
+                     v == 0 ? "OPEN" : v == 1 ? "STOP" : v == 2 ? "CLOSE" : "?");
+            break;
+
+        case TUYA_DP_PERCENT:
+            st->position = tuya_to_hub_percent(v);
+            st->known |= ZB_TUYA_KNOWN_POSITION;
+            ESP_LOGI(TAG, "│ Position: %d%% open", st->position);
+            break;
+
+        case TUYA_DP_PERCENT_CONTROL:
+            st->target = tuya_to_hub_percent(v);
+            st->known |= ZB_TUYA_KNOWN_TARGET;
+            ESP_LOGI(TAG, "│ Target: %d%% open", st->target);
+            break;
+
+        case TUYA_DP_DIRECTION:
+            st->direction = (uint8_t)v;
+            st->known |= ZB_TUYA_KNOWN_DIRECTION;
+            ESP_LOGI(TAG, "│ Motor Direction: %s", v ? "reversed" : "forward");
+            break;
+
+        case TUYA_DP_WORK_STATE:
+            st->work_state = (uint8_t)v;
+            st->known |= ZB_TUYA_KNOWN_WORK_STATE;
+            ESP_LOGI(TAG, "│ Work State: %s", v ? "closing" : "opening");
+            break;
+
+        case TUYA_DP_LIMITS:
+            st->limits = (uint8_t)v;
+            st->known |= ZB_TUYA_KNOWN_LIMITS;
+            ESP_LOGI(TAG, "│ Limits: %lu", (unsigned long)v);
+            break;
+
+        default:
+            ESP_LOGI(TAG, "│ Unknown DP %d (type %d), data:", dp_id, type);
+            ESP_LOG_BUFFER_HEX_LEVEL(TAG, value, len, ESP_LOG_INFO);
+            break;
+    }
+}
+
+void zigbee_tuya_handle_frame(uint16_t src_addr, uint8_t cmd_id, const uint8_t *data, uint16_t len)
+{
+    if (cmd_id != TUYA_CMD_DATA_RESPONSE && cmd_id != TUYA_CMD_DATA_REPORT) {
+        ESP_LOGD(TAG, "Tuya cmd 0x%02x from 0x%04x ignored", cmd_id, src_addr);
+        return;
+    }
+    if (len < 6) {
+        ESP_LOGW(TAG, "Tuya frame too short: %d bytes", len);
+        return;
+    }
+
+    /* Only the frame echoing our command's sequence number ends its
+       transaction. Query answers and reports the device sends on its own
+       are not acks. */
+    uint16_t seq = (data[0] << 8) | data[1];
+    if (s_txn.pending && s_txn.addr == src_addr && s_txn.seq == seq) {
+        s_txn.pending = false;
+        radio_policy_zigbee_txn_end(src_addr, s_txn.tsn, 0);
+    }
+
+    zigbee_tuya_state_t *st = get_or_add_state(src_addr);
+    if (!st) {
+        ESP_LOGW(TAG, "No state slot for 0x%04x", src_addr);
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    expire_query(st, now);
+    bool woke = st->query_sent_us == 0 &&
+                (st->last_rx_us == 0 ||
+                 now - st->last_rx_us > (int64_t)ZB_TUYA_WAKE_GAP_S * 1000000);
+
+    /* Parse into a copy, publish it in one step */
+    zigbee_tuya_state_t next = *st;
+    int dp_count = 0;
+
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "┌─── TUYA %s from 0x%04x ───",
+             cmd_id == TUYA_CMD_DATA_RESPONSE ? "RESPONSE" : "REPORT", src_addr);
+
+    uint16_t off = 2;   /* Skip the sequence number */
+    while (off + 4 <= len) {
+        uint8_t dp_id = data[off];
+        uint8_t type = data[off + 1];
+        uint16_t dp_len = (data[off + 2] << 8) | data[off + 3];
+        if (off + 4 + dp_len > len) {
+            ESP_LOGW(TAG, "│ DP %d truncated (%d of %d bytes)", dp_id, len - off - 4, dp_len);
+            break;
+        }
+        apply_dp(&next, dp_id, type, &data[off + 4], dp_len);
+        off += 4 + dp_len;
+        dp_count++;
+    }
+
+    if (next.query_sent_us != 0) {
+        metrics_hist_record(&s_query_latency, (uint32_t)((now - next.query_sent_us) / 1000));
+        next.query_sent_us = 0;
+    }
+    next.last_dp_count = (uint8_t)dp_count;
+    next.frames++;
+    next.last_rx_us = now;
+
+    taskENTER_CRITICAL(&s_lock);
+    *st = next;
+    taskEXIT_CRITICAL(&s_lock);
+
+    ESP_LOGI(TAG, "└─── %d DP(s) ───", dp_count);
+
+    /* Unprompted report after a long silence (or the first since boot):
+       fetch everything else too */
+    if (woke && cmd_id == TUYA_CMD_DATA_REPORT) {
+        zigbee_tuya_device_awake(src_addr);
+    }
+}
+
+/* ============================================================================
+   STATUS
+   ============================================================================ */
+
+bool zigbee_tuya_get_state(uint16_t short_addr, zigbee_tuya_state_t *out)
+{
+    bool found = false;
+    taskENTER_CRITICAL(&s_lock);
+    zigbee_tuya_state_t *st = find_state(short_addr);
+    if (st) {
+        *out = *st;
+        found = true;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return found;
+}
+
+void zigbee_tuya_print_status(void)
+{
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "╔══════════════════════════════════════════════════════════╗");
+    ESP_LOGI(TAG, "║  🪟 TUYA DEVICE STATE                                     ║");
+    ESP_LOGI(TAG, "╚══════════════════════════════════════════════════════════╝");
+
+    int64_t now = esp_timer_get_time();
+    int shown = 0;
+    for (int i = 0; i < ZIGBEE_MAX_DEVICES; i++) {
+        zigbee_tuya_state_t st;
+        taskENTER_CRITICAL(&s_lock);
+        bool used = s_used[i];
+        st = s_state[i];
+        taskEXIT_CRITICAL(&s_lock);
+        if (!used) {
+            continue;
+        }
+        shown++;
+
+        if (st.last_rx_us) {
+            ESP_LOGI(TAG, "  0x%04x: %lu frame(s), %lu query(s) (%lu lost), last %lus ago with %d DP(s)",
+                     st.short_addr, (unsigned long)st.frames, (unsigned long)st.queries,
+                     (unsigned long)st.queries_lost,
+                     (unsigned long)((now - st.last_rx_us) / 1000000), st.last_dp_count);
+        } else {
+            ESP_LOGI(TAG, "  0x%04x: %lu query(s) (%lu lost), no DP frame yet",
+                     st.short_addr, (unsigned long)st.queries, (unsigned long)st.queries_lost);
+        }
+        if (st.known & ZB_TUYA_KNOWN_POSITION) {
+            ESP_LOGI(TAG, "    Position: %d%% open", st.position);
+        }
+        if (st.known & ZB_TUYA_KNOWN_TARGET) {
+            ESP_LOGI(TAG, "    Target: %d%% open", st.target);
+        }
+        if (st.known & ZB_TUYA_KNOWN_WORK_STATE) {
+            ESP_LOGI(TAG, "    Work state: %s", st.work_state ? "closing" : "opening");
+        }
+        if (st.known & ZB_TUYA_KNOWN_DIRECTION) {
+            ESP_LOGI(TAG, "    Motor direction: %s", st.direction ? "reversed" : "forward");
+        }
+        if (st.known & ZB_TUYA_KNOWN_LIMITS) {
+            ESP_LOGI(TAG, "    Limits: %d", st.limits);
+        }
+        if (query_expired(&st, now)) {
+            ESP_LOGI(TAG, "    Last query unanswered (lost)");
+        } else if (st.query_sent_us) {
+            ESP_LOGI(TAG, "    Query outstanding for %lums",
+                     (unsigned long)((now - st.query_sent_us) / 1000));
+        }
+    }
+    if (shown == 0) {
+        ESP_LOGI(TAG, "  No Tuya device has reported yet");
+    }
+    metrics_hist_print(&s_query_latency);
+    ESP_LOGI(TAG, "");
+}
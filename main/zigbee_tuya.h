@@ -0,0 +1,155 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee Tuya - 0xEF00 data point protocol and Tuya device state
+ *
+ * Tuya devices only report a data point (DP) when it changes, so after a
+ * rejoin the hub knows nothing until the blind moves. The Tuya "data query"
+ * command (0x03) asks the device MCU to report every DP it has. The answer
+ * arrives as one or more frames, each holding several DP records:
+ *
+ *   [0-1] Sequence number (big endian)
+ *   then repeated:
+ *   [0]   DP ID
+ *   [1]   Data type (TUYA_TYPE_*)
+ *   [2-3] Data length (big endian)
+ *   [4+]  Data
+ *
+ * Every record of every frame goes into a per-device state entry in one
+ * pass. The query is sent when a Tuya device announces, is registered, or
+ * talks again after a long silence (battery blinds waking up).
+ */
+
+#ifndef ZIGBEE_TUYA_H
+#define ZIGBEE_TUYA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "zigbee_hub.h"
+
+/* ============================================================================
+   TUYA PROTOCOL
+   ============================================================================ */
+
+#define TUYA_CLUSTER_ID             0xEF00
+
+#define TUYA_CMD_SET_DATA           0x00    /* Hub -> device: set DP */
+#define TUYA_CMD_DATA_RESPONSE      0x01    /* Device -> hub: answer to set/query */
+#define TUYA_CMD_DATA_REPORT        0x02    /* Device -> hub: spontaneous report */
+#define TUYA_CMD_DATA_QUERY         0x03    /* Hub -> device: report all DPs */
+
+/* Tuya Data Point IDs for blinds (may vary by device) */
+#define TUYA_DP_CONTROL             0x01    /* Control: 0=open, 1=stop, 2=close */
+#define TUYA_DP_PERCENT             0x02    /* Position percentage 0-100 */
+#define TUYA_DP_PERCENT_CONTROL     0x03    /* Target position 0-100 */
+#define TUYA_DP_DIRECTION           0x05    /* Motor direction: 0=forward, 1=reversed */
+#define TUYA_DP_WORK_STATE          0x07    /* 0=opening, 1=closing */
+#define TUYA_DP_LIMITS              0x10    /* Limit (border) setting */
+
+/* Tuya Data Types */
+#define TUYA_TYPE_RAW               0x00
+#define TUYA_TYPE_BOOL              0x01
+#define TUYA_TYPE_VALUE             0x02    /* 4-byte integer */
+#define TUYA_TYPE_STRING            0x03
+#define TUYA_TYPE_ENUM              0x04    /* 1-byte enum */
+
+/* ============================================================================
+   ZIGBEE TUYA CONFIGURATION
+   ============================================================================ */
+
+#define ZB_TUYA_QUERY_DELAY_MS      500     /* After announce: let the device finish rejoining */
+#define ZB_TUYA_QUERY_MIN_GAP_MS    10000   /* At most one query per device per 10s; unanswered by then = lost */
+#define ZB_TUYA_WAKE_GAP_S          600     /* Silence after which a frame counts as a wake-up */
+
+/* ============================================================================
+   DEVICE STATE
+   ============================================================================ */
+
+/* zigbee_tuya_state_t.known bits */
+#define ZB_TUYA_KNOWN_POSITION      (1 << 0)
+#define ZB_TUYA_KNOWN_TARGET        (1 << 1)
+#define ZB_TUYA_KNOWN_CONTROL       (1 << 2)
+#define ZB_TUYA_KNOWN_DIRECTION     (1 << 3)
+#define ZB_TUYA_KNOWN_WORK_STATE    (1 << 4)
+#define ZB_TUYA_KNOWN_LIMITS        (1 << 5)
+
+typedef struct {
+    uint16_t short_addr;
+    uint8_t known;              /* ZB_TUYA_KNOWN_* */
+    uint8_t position;           /* 0=closed, 100=open (hub convention, not Tuya's) */
+    uint8_t target;             /* 0=closed, 100=open */
+    uint8_t control;            /* Last control DP: 0=open, 1=stop, 2=close */
+    uint8_t direction;          /* 0=forward, 1=reversed */
+    uint8_t work_state;         /* 0=opening, 1=closing */
+    uint8_t limits;             /* Raw limit setting */
+    uint8_t last_dp_count;      /* DP records in the last frame */
+    uint32_t frames;            /* DP frames received */
+    uint32_t queries;           /* Data queries sent */
+    uint32_t queries_lost;      /* No DP frame within ZB_TUYA_QUERY_MIN_GAP_MS */
+    int64_t last_rx_us;         /* 0 = never heard */
+    int64_t query_sent_us;      /* 0 = no query outstanding */
+} zigbee_tuya_state_t;
+
+/* ============================================================================
+   API
+   ============================================================================ */
+
+/**
+ * @brief Handle a Tuya cluster command from a device (Zigbee task)
+ *
+ * Parses every DP record in the frame into the device's state entry.
+ *
+ * @param src_addr Sender short address
+ * @param cmd_id Tuya command ID (TUYA_CMD_*)
+ * @param data ZCL payload
+ * @param len Payload length
+ */
+void zigbee_tuya_handle_frame(uint16_t src_addr, uint8_t cmd_id, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief A data command went out to a Tuya device (Zigbee lock held)
+ *
+ * The device's next DP frame carrying the same Tuya sequence number ends
+ * the radio_policy transaction for it.
+ *
+ * @param short_addr Destination short address
+ * @param seq Tuya sequence number in the frame
+ * @param tsn ZCL transaction sequence number returned by the send call
+ */
+void zigbee_tuya_command_sent(uint16_t short_addr, uint16_t seq, uint8_t tsn);
+
+/**
+ * @brief Schedule a data query for a Tuya device that just (re)joined
+ *
+ * Does nothing for non-Tuya devices or if a query was sent recently.
+ * Must be called from the Zigbee task.
+ *
+ * @param short_addr Device short address
+ */
+void zigbee_tuya_device_awake(uint16_t short_addr);
+
+/**
+ * @brief Ask a Tuya device to report all of its data points now
+ *
+ * @param device Tuya device
+ * @return ESP_OK if the query was queued
+ */
+esp_err_t zigbee_tuya_query_all(const zigbee_device_t *device);
+
+/**
+ * @brief Copy a Tuya device's state
+ *
+ * @param short_addr Device short address
+ * @param out State copy
+ * @return true if the device has a state entry
+ */
+bool zigbee_tuya_get_state(uint16_t short_addr, zigbee_tuya_state_t *out);
+
+/**
+ * @brief Log the state of every Tuya device
+ */
+void zigbee_tuya_print_status(void);
+
+#endif /* ZIGBEE_TUYA_H */
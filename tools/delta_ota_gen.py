@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""
+Delta OTA patch generator for Halo.
+
+Creates a compressed binary patch that turns the firmware currently running on
+the device (base) into a new build. The device applies it with
+`ota:delta:<url>` (see main/delta_ota.c).
+
+Usage:
+    pip install detools
+    python tools/delta_ota_gen.py base.bin build/hamurabi_led_controller.bin halo.patch
+
+Keep a copy of every .bin you flash - the patch only applies to that exact image.
+"""
+
+import argparse
+import hashlib
+import io
+import struct
+import sys
+
+try:
+    import detools
+except ImportError:
+    sys.exit("detools is required: pip install detools")
+
+MAGIC = b"HDLT"
+HEADER_VERSION = 1
+HEADER_SIZE = 64
+COMPRESSION_HEATSHRINK = 1
+
+# esp_image_header_t (24) + esp_image_segment_header_t (8) -> esp_app_desc_t
+APP_DESC_OFFSET = 0x20
+APP_DESC_MAGIC = 0xABCD5432
+# magic, secure_version, reserv1[2], version[32], project_name[32], time[16], date[16], idf_ver[32]
+APP_ELF_SHA256_OFFSET = APP_DESC_OFFSET + 4 + 4 + 8 + 32 + 32 + 16 + 16 + 32
+
+
+def app_elf_sha256(image):
+    magic, = struct.unpack_from("<I", image, APP_DESC_OFFSET)
+    if magic != APP_DESC_MAGIC:
+        sys.exit("base image has no esp_app_desc_t - is it an app .bin?")
+    return image[APP_ELF_SHA256_OFFSET:APP_ELF_SHA256_OFFSET + 32]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("base", help="app .bin currently running on the device")
+    parser.add_argument("new", help="new app .bin")
+    parser.add_argument("patch", help="output patch file")
+    args = parser.parse_args()
+
+    with open(args.base, "rb") as f:
+        base = f.read()
+    with open(args.new, "rb") as f:
+        new = f.read()
+
+    # Sequential heatshrink patches are what esp_delta_ota can apply in a stream
+    body = io.BytesIO()
+    detools.create_patch(io.BytesIO(base), io.BytesIO(new), body,
+                         compression="heatshrink", patch_type="sequential")
+    body = body.getvalue()
+
+    header = struct.pack("<4sBBHII32s", MAGIC, HEADER_VERSION, COMPRESSION_HEATSHRINK, 0,
+                         len(new), len(body), app_elf_sha256(base))
+    header = header.ljust(HEADER_SIZE, b"\0")
+
+    with open(args.patch, "wb") as f:
+        f.write(header)
+        f.write(body)
+
+    total = len(header) + len(body)
+    print(f"base image : {len(base):>9} bytes  sha256 {hashlib.sha256(base).hexdigest()[:16]}")
+    print(f"new image  : {len(new):>9} bytes  (full-image OTA download)")
+    print(f"patch      : {total:>9} bytes  ({100.0 * total / len(new):.1f}% of full image)")
+
+
+if __name__ == "__main__":
+    main()
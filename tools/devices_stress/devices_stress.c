@@ -0,0 +1,237 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Halo Project
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host-side concurrency stress test for the copy-on-write device table
+ * (main/zigbee_devices.c), built against pthread stubs of FreeRTOS and NVS.
+ *
+ * Two writers and several readers run at once:
+ *   - one writer replaces the whole table with a new "generation": every
+ *     device carries the generation number, and the device count follows
+ *     from it
+ *   - one writer adds and removes a probe device, so add/remove copy a
+ *     table another writer just published
+ *   - readers pin a snapshot, check that it is one whole generation (no mix
+ *     of two tables), keep it pinned for a while and check it did not change
+ *     underneath them (a buffer was not reused while pinned). They also look
+ *     devices up with zigbee_devices_find().
+ *
+ * Build and run from the repository root:
+ *   cc -O2 -pthread -Itools/devices_stress/stub -Imain \
+ *      tools/devices_stress/devices_stress.c main/zigbee_devices.c -o devices_stress
+ *   ./devices_stress [seconds] [readers]
+ *
+ * Add -fsanitize=thread to have ThreadSanitizer check the atomics as well.
+ * Exits non-zero on the first inconsistency.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "zigbee_devices.h"
+
+#define STRESS_MAX_READERS      16
+#define STRESS_PROBE_ADDR       0xFFF0
+#define STRESS_PROBE_IEEE       0xEE
+#define STRESS_BASE_ADDR        0x0100
+#define STRESS_NORMAL_MAX       (ZIGBEE_MAX_DEVICES - 1)    /* Room for the probe */
+
+static atomic_bool s_stop;
+static atomic_bool s_failed;
+static atomic_ulong s_pins;
+static atomic_ulong s_finds;
+static atomic_ulong s_replaces;
+static atomic_ulong s_probes;
+
+static void fail(const char *what, uint32_t version)
+{
+    if (!atomic_exchange(&s_failed, true)) {
+        fprintf(stderr, "FAIL: %s (table v%lu)\n", what, (unsigned long)version);
+    }
+    atomic_store(&s_stop, true);
+}
+
+static int normal_count(uint16_t gen)
+{
+    return 1 + gen % STRESS_NORMAL_MAX;
+}
+
+static void make_device(zigbee_device_t *dev, int index, uint16_t gen)
+{
+    memset(dev, 0, sizeof(*dev));
+    dev->short_addr = STRESS_BASE_ADDR + index;
+    for (int b = 0; b < 7; b++) {
+        dev->ieee_addr[b] = (uint8_t)(index + 1);
+    }
+    dev->ieee_addr[7] = (uint8_t)(gen & 0xff);
+    dev->endpoint = (uint8_t)(gen >> 8);
+    dev->device_type = ZIGBEE_DEVICE_TYPE_LIGHT;
+}
+
+/* One whole generation, plus at most one probe at the end */
+static const char *check_table(const zigbee_device_table_t *t)
+{
+    if (t->count < 0 || t->count > ZIGBEE_MAX_DEVICES) {
+        return "count out of range";
+    }
+    int normal = 0;
+    int probes = 0;
+    uint16_t gen = 0;
+    for (int i = 0; i < t->count; i++) {
+        const zigbee_device_t *dev = &t->devices[i];
+        if (dev->short_addr == STRESS_PROBE_ADDR) {
+            for (int b = 0; b < 8; b++) {
+                if (dev->ieee_addr[b] != STRESS_PROBE_IEEE) {
+                    return "torn probe device";
+                }
+            }
+            probes++;
+            continue;
+        }
+        uint16_t dev_gen = (uint16_t)(dev->ieee_addr[7] | (dev->endpoint << 8));
+        if (normal == 0) {
+            gen = dev_gen;
+        } else if (dev_gen != gen) {
+            return "devices from two generations in one snapshot";
+        }
+        zigbee_device_t expect;
+        make_device(&expect, normal, gen);
+        if (memcmp(dev, &expect, sizeof(expect)) != 0) {
+            return "device does not match its generation";
+        }
+        normal++;
+    }
+    if (probes > 1) {
+        return "probe added twice";
+    }
+    if (normal > 0 && normal != normal_count(gen)) {
+        return "device count does not match the generation";
+    }
+    return NULL;
+}
+
+static void *replace_writer(void *arg)
+{
+    (void)arg;
+    static zigbee_device_t devices[ZIGBEE_MAX_DEVICES];
+    uint16_t gen = 0;
+    while (!atomic_load(&s_stop)) {
+        gen++;
+        int count = normal_count(gen);
+        for (int i = 0; i < count; i++) {
+            make_device(&devices[i], i, gen);
+        }
+        if (zigbee_devices_replace_all(devices, count) != ESP_OK) {
+            fail("replace_all failed", 0);
+        }
+        atomic_fetch_add(&s_replaces, 1);
+    }
+    return NULL;
+}
+
+static void *probe_writer(void *arg)
+{
+    (void)arg;
+    zigbee_device_t probe;
+    memset(&probe, 0, sizeof(probe));
+    probe.short_addr = STRESS_PROBE_ADDR;
+    memset(probe.ieee_addr, STRESS_PROBE_IEEE, sizeof(probe.ieee_addr));
+    probe.device_type = ZIGBEE_DEVICE_TYPE_SWITCH;
+
+    while (!atomic_load(&s_stop)) {
+        if (zigbee_devices_add(&probe) != ESP_OK) {
+            fail("add failed", 0);
+        }
+        /* NOT_FOUND is fine: a replace may have dropped it already */
+        esp_err_t err = zigbee_devices_remove(STRESS_PROBE_ADDR);
+        if (err != ESP_OK && err != ESP_ERR_NOT_FOUND) {
+            fail("remove failed", 0);
+        }
+        atomic_fetch_add(&s_probes, 1);
+    }
+    return NULL;
+}
+
+static void *reader(void *arg)
+{
+    unsigned seed = (unsigned)(uintptr_t)arg;
+    static _Thread_local zigbee_device_table_t copy;
+    while (!atomic_load(&s_stop)) {
+        const zigbee_device_table_t *snap = zigbee_devices_snapshot();
+        memcpy(&copy, snap, sizeof(copy));
+        const char *err = check_table(&copy);
+        if (err) {
+            fail(err, copy.version);
+        }
+
+        /* Hold the pin across a few writes, then make sure nothing moved */
+        int spins = rand_r(&seed) % 2000;
+        for (volatile int i = 0; i < spins; i++) {
+        }
+        if (memcmp(&copy, snap, sizeof(copy)) != 0) {
+            fail("pinned snapshot changed while held", copy.version);
+        }
+        zigbee_devices_snapshot_release(snap);
+        atomic_fetch_add(&s_pins, 1);
+
+        zigbee_device_t dev;
+        int index = rand_r(&seed) % STRESS_NORMAL_MAX;
+        if (zigbee_devices_find(STRESS_BASE_ADDR + index, &dev)) {
+            zigbee_device_t expect;
+            make_device(&expect, index, (uint16_t)(dev.ieee_addr[7] | (dev.endpoint << 8)));
+            if (memcmp(&dev, &expect, sizeof(dev)) != 0) {
+                fail("zigbee_devices_find returned a torn device", 0);
+            }
+        }
+        atomic_fetch_add(&s_finds, 1);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 5;
+    int readers = argc > 2 ? atoi(argv[2]) : 4;
+    if (seconds < 1) {
+        seconds = 1;
+    }
+    if (readers < 1 || readers > STRESS_MAX_READERS) {
+        readers = 4;
+    }
+
+    if (zigbee_devices_init() != ESP_OK) {
+        fprintf(stderr, "zigbee_devices_init failed\n");
+        return 2;
+    }
+
+    pthread_t threads[STRESS_MAX_READERS + 2];
+    int n = 0;
+    pthread_create(&threads[n++], NULL, replace_writer, NULL);
+    pthread_create(&threads[n++], NULL, probe_writer, NULL);
+    for (int i = 0; i < readers; i++) {
+        pthread_create(&threads[n++], NULL, reader, (void *)(uintptr_t)(i + 1));
+    }
+
+    struct timespec end, now;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    end.tv_sec += seconds;
+    do {
+        struct timespec tick = { 0, 50 * 1000 * 1000 };
+        nanosleep(&tick, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while (!atomic_load(&s_stop) &&
+             (now.tv_sec < end.tv_sec || (now.tv_sec == end.tv_sec && now.tv_nsec < end.tv_nsec)));
+    atomic_store(&s_stop, true);
+    for (int i = 0; i < n; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    printf("%ds, %d readers: %lu replaces, %lu probe add/removes, %lu pins, %lu finds - %s\n",
+           seconds, readers, atomic_load(&s_replaces), atomic_load(&s_probes),
+           atomic_load(&s_pins), atomic_load(&s_finds),
+           atomic_load(&s_failed) ? "FAILED" : "ok");
+    return atomic_load(&s_failed) ? 1 : 0;
+}
@@ -0,0 +1,13 @@
+/* Host stub for tools/devices_stress - logging is type-checked, then compiled out */
+#ifndef ESP_LOG_H
+#define ESP_LOG_H
+
+#include <stdio.h>
+
+#define ESP_LOG_OFF(tag, fmt, ...) do { if (0) { printf("%s " fmt, tag, ##__VA_ARGS__); } } while (0)
+#define ESP_LOGE(tag, ...) ESP_LOG_OFF(tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) ESP_LOG_OFF(tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) ESP_LOG_OFF(tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) ESP_LOG_OFF(tag, __VA_ARGS__)
+
+#endif
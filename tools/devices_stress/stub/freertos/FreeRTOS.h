@@ -0,0 +1,10 @@
+/* Host stub for tools/devices_stress - FreeRTOS mapped onto pthreads */
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+#define portMAX_DELAY               0xffffffffu
+
+#endif
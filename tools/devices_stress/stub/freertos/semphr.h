@@ -0,0 +1,26 @@
+/* Host stub for tools/devices_stress - a mutex is a pthread mutex */
+#ifndef SEMPHR_H
+#define SEMPHR_H
+
+#include <pthread.h>
+#include "FreeRTOS.h"
+
+typedef pthread_mutex_t StaticSemaphore_t;
+typedef pthread_mutex_t *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buf)
+{
+    pthread_mutex_init(buf, NULL);
+    return buf;
+}
+static inline int xSemaphoreTake(SemaphoreHandle_t m, TickType_t wait)
+{
+    (void)wait;
+    return pthread_mutex_lock(m) == 0;
+}
+static inline int xSemaphoreGive(SemaphoreHandle_t m)
+{
+    return pthread_mutex_unlock(m) == 0;
+}
+
+#endif
@@ -0,0 +1,14 @@
+/* Host stub for tools/devices_stress - a tick is a yield */
+#ifndef TASK_H
+#define TASK_H
+
+#include <sched.h>
+#include "FreeRTOS.h"
+
+static inline void vTaskDelay(TickType_t ticks)
+{
+    (void)ticks;
+    sched_yield();
+}
+
+#endif
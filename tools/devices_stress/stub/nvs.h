@@ -0,0 +1,49 @@
+/* Host stub for tools/devices_stress - NVS accepts every write, holds nothing */
+#ifndef NVS_H
+#define NVS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+
+static inline esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    (void)ns; (void)mode;
+    *out = 1;
+    return ESP_OK;
+}
+static inline esp_err_t nvs_get_u8(nvs_handle_t h, const char *key, uint8_t *out)
+{
+    (void)h; (void)key; (void)out;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+static inline esp_err_t nvs_set_u8(nvs_handle_t h, const char *key, uint8_t value)
+{
+    (void)h; (void)key; (void)value;
+    return ESP_OK;
+}
+static inline esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len)
+{
+    (void)h; (void)key; (void)out; (void)len;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+static inline esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t len)
+{
+    (void)h; (void)key; (void)value; (void)len;
+    return ESP_OK;
+}
+static inline esp_err_t nvs_erase_all(nvs_handle_t h)
+{
+    (void)h;
+    return ESP_OK;
+}
+static inline esp_err_t nvs_commit(nvs_handle_t h)
+{
+    (void)h;
+    return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,2 @@
+/* Host stub for tools/devices_stress */
+#include "nvs.h"
@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+"""
+Print a Halo command journal as a timeline, or replay it on a device.
+
+journal:dump (main/halo_journal.c) prints the journal as base64 log lines
+between 'JOURNAL BEGIN' and 'JOURNAL END'. Each entry holds when a command
+ran, where it came from (mqtt, console, remote, matter, encoder), its text
+and the ring state right after it. This script decodes the last complete
+dump in the log and prints it oldest first.
+
+With --port it plays the journal back through the serial console of a
+Halo, at the recorded pace (or --speed times faster). The ring is driven
+by "state:" commands carrying the recorded state, so it ends up exactly as
+it was whatever the original command was; entries that drove a Zigbee
+blind or light, and "seed:" and "mod:" entries, are sent as the original
+command. "sync:" entries are only shown: they set up the recording unit's
+sync role, which a replay must not copy onto the unit it plays on. A run
+of presence levels (mod:input:presence:<n>) is journaled as its latest
+value. Gaps across a reboot are replaced by --boot-gap seconds.
+
+Usage:
+    idf.py monitor | tee halo.log          # then send journal:dump
+    python tools/journal_replay.py halo.log
+    python tools/journal_replay.py halo.log --port /dev/ttyACM0 --speed 10
+    python tools/journal_replay.py halo.log --dry-run   # print what would be sent
+
+Effects that draw random numbers (stars, tetris, shower, and cycle when it
+shows them) restart from the "seed:" journaled when they were selected, so
+the replay draws the same pattern. It stays in step as closely as the
+replay's timing follows the recording.
+"""
+
+import argparse
+import base64
+import datetime
+import re
+import struct
+import sys
+import time
+
+ANSI = re.compile(r"\x1b\[[0-9;]*m")
+DATA = re.compile(r"JOURNAL:([A-Za-z0-9+/=]+)")
+
+MAGIC = 0x4E524A48
+HEADER = struct.Struct("<IBBHHHII")           # journal_dump_header_t
+ENTRY = struct.Struct("<IHBBBBBBBBHH46s")     # halo_journal_entry_t
+
+SOURCES = ["mqtt", "console", "remote", "matter", "encoder"]
+MODES = ["cycle", "fusion", "wave", "tetris", "stars", "meteor", "shower",
+         "rainbow", "breathing", "solid", "off"]       # animation_mode_t order
+
+F_DEVICE = 0x01
+F_TRUNCATED = 0x02
+F_VERBATIM = 0x08           # seed:, mod: - not ring state
+F_LOCAL = 0x10              # sync: - the recording unit's own setup, never replayed
+F_LEVEL = 0x20              # mod:input:<in>:<n> - only the latest of a run is kept
+
+
+def last_dump(lines):
+    """Base64 chunks of the last BEGIN..END block, or None."""
+    chunks = None
+    found = None
+    for line in lines:
+        line = ANSI.sub("", line)
+        if "JOURNAL BEGIN" in line:
+            chunks = []
+        elif "JOURNAL END" in line and chunks is not None:
+            found = chunks
+            chunks = None
+        elif chunks is not None:
+            m = DATA.search(line)
+            if m:
+                chunks.append(m.group(1))
+    return found
+
+
+def parse(blob):
+    """(header dict, list of entry dicts) from the decoded dump."""
+    if len(blob) < HEADER.size:
+        sys.exit("Dump is shorter than its header")
+    magic, version, entry_size, count, boot, _, uptime_ms, wall_s = HEADER.unpack_from(blob)
+    if magic != MAGIC:
+        sys.exit("Dump does not start with the journal magic")
+    if version != 1 or entry_size != ENTRY.size:
+        sys.exit(f"Unsupported journal version {version} (entry size {entry_size})")
+    entries = []
+    offset = HEADER.size
+    for _ in range(count):
+        if offset + ENTRY.size > len(blob):
+            print("warning: dump is truncated (lost log lines?)", file=sys.stderr)
+            break
+        (t_ms, e_boot, source, flags, anim, r, g, b, w, text_len,
+         brightness_pm, speed_pm, text) = ENTRY.unpack_from(blob, offset)
+        offset += ENTRY.size
+        entries.append({
+            "t_ms": t_ms, "boot": e_boot, "source": source, "flags": flags,
+            "text": text[:min(text_len, len(text))].decode(errors="replace"),
+            "state": (anim, r, g, b, w, brightness_pm, speed_pm),
+        })
+    return {"boot": boot, "uptime_ms": uptime_ms, "wall_s": wall_s}, entries
+
+
+def state_command(state):
+    anim, r, g, b, w, brightness_pm, speed_pm = state
+    mode = MODES[anim] if anim < len(MODES) else "solid"
+    brightness_pm = min(max(brightness_pm, 1), 1000)
+    speed_pm = min(max(speed_pm, 1), 1000)
+    return f"state:{mode}:{r:02X}{g:02X}{b:02X}{w:02X}:{brightness_pm}:{speed_pm}"
+
+
+def print_timeline(header, entries):
+    for e in entries:
+        when = f"boot {e['boot']} {e['t_ms'] / 1000:10.3f}s"
+        if header["wall_s"] and e["boot"] == header["boot"]:
+            # Only the dump's own boot can be placed on the wall clock
+            wall = header["wall_s"] - (header["uptime_ms"] - e["t_ms"]) / 1000
+            when += " " + datetime.datetime.fromtimestamp(wall).strftime("%Y-%m-%d %H:%M:%S")
+        source = SOURCES[e["source"]] if e["source"] < len(SOURCES) else "?"
+        text = e["text"] + ("..." if e["flags"] & F_TRUNCATED else "")
+        if e["flags"] & F_LOCAL:
+            text += " (not replayed)"
+        print(f"{when}  {source:<7} {text:<30} -> {state_command(e['state'])[6:]}")
+    print(f"{len(entries)} entries, boots {entries[0]['boot']}-{header['boot']}")
+
+
+def replay_steps(entries, speed, boot_gap):
+    """(delay in seconds, command) pairs that reproduce the journal."""
+    steps = []
+    sent_state = None
+    wait = 0.0
+    prev = entries[0]
+    for e in entries:
+        if e["boot"] != prev["boot"]:
+            wait += boot_gap
+        else:
+            wait += max(e["t_ms"] - prev["t_ms"], 0) / 1000 / speed
+        prev = e
+        # State first: selecting an effect on the device draws a new seed,
+        # which the journaled "seed:" entry that follows then replaces
+        if e["state"] != sent_state:
+            steps.append((wait, state_command(e["state"])))
+            sent_state = e["state"]
+            wait = 0.0
+        if e["flags"] & (F_DEVICE | F_VERBATIM) and not e["flags"] & F_TRUNCATED:
+            steps.append((wait, e["text"]))
+            wait = 0.0
+    return steps
+
+
+def replay(steps, port):
+    try:
+        import serial
+    except ImportError:
+        sys.exit("Replay needs pyserial (pip install pyserial, or run from an ESP-IDF shell)")
+    with serial.Serial(port, 115200, timeout=0) as ser:
+        for delay, command in steps:
+            time.sleep(delay)
+            print(command)
+            ser.write(command.encode() + b"\n")
+            ser.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    parser.add_argument("log", help="serial log file ('-' for stdin)")
+    parser.add_argument("--port", help="serial port of the Halo to replay on")
+    parser.add_argument("--speed", type=float, default=1.0,
+                        help="replay this many times faster than recorded")
+    parser.add_argument("--boot-gap", type=float, default=1.0,
+                        help="seconds to wait where the device rebooted")
+    parser.add_argument("--dry-run", action="store_true",
+                        help="print the replay commands and delays instead of sending them")
+    args = parser.parse_args()
+
+    source = sys.stdin if args.log == "-" else open(args.log, errors="replace")
+    with source:
+        chunks = last_dump(source)
+    if not chunks:
+        sys.exit("No complete JOURNAL BEGIN..END block in the log")
+    if args.speed <= 0:
+        sys.exit("--speed must be positive")
+
+    header, entries = parse(b"".join(base64.b64decode(c) for c in chunks))
+    if not entries:
+        sys.exit("Journal is empty")
+
+    if not args.port and not args.dry_run:
+        print_timeline(header, entries)
+        return
+
+    steps = replay_steps(entries, args.speed, args.boot_gap)
+    if args.dry_run:
+        for delay, command in steps:
+            print(f"+{delay:8.3f}s  {command}")
+        return
+    replay(steps, args.port)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""
+Report every static memory region of the Halo component after a build.
+
+Halo's tasks, queues and working buffers are static, so their RAM cost is
+fixed at link time. This script reads the linker map (and optionally the
+ELF, for names) and lists each region that main/ puts in RAM, largest
+first, with totals per source file:
+
+    halo_tasks.c    s_zigbee_stack       bss    8192
+    halo_profiler.c s_stacks             bss   18432
+    ...
+    main/ static RAM: 96312 bytes (bss 94100, data 1020, IRAM code 1192)
+
+The top-level CMakeLists.txt runs it after every link. By hand:
+
+    python tools/memplan_report.py build/hamurabi_led_controller.map \\
+        --elf build/hamurabi_led_controller.elf --nm riscv32-esp-elf-nm
+
+With --budget, the exit status is 1 if main/'s static RAM exceeds it. A map
+with no main/ sections (a layout this script does not recognize) only
+gives a warning, so the build still succeeds.
+Regions in flash (.text, .rodata) are not listed.
+"""
+
+import argparse
+import re
+import subprocess
+import sys
+from collections import defaultdict
+
+# Input section line: name, address, size, archive(object). Long section
+# names push the rest onto the next line.
+SECTION = re.compile(r"^ (\.[\w.$]+)\s*$")
+PLACED = re.compile(r"^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)$")
+SECTION_PLACED = re.compile(r"^ (\.[\w.$]+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)$")
+MAIN_OBJECT = re.compile(r"libmain\.a\((.+?)\.obj\)$")
+
+KINDS = (
+    (".bss", "bss"), (".sbss", "bss"),
+    (".data", "data"), (".sdata", "data"), (".dram1", "data"),
+    (".iram1", "iram"), (".iram0", "iram"),
+)
+
+
+def kind_of(section):
+    for prefix, kind in KINDS:
+        if section == prefix or section.startswith(prefix + "."):
+            return kind
+    return None
+
+
+def name_of(section):
+    """Variable name from -fdata-sections naming, e.g. .bss.s_ring -> s_ring."""
+    for prefix, _ in KINDS:
+        if section.startswith(prefix + "."):
+            rest = section[len(prefix) + 1:]
+            if rest and not rest.isdigit():
+                return rest
+    return section
+
+
+def parse_map(lines):
+    """(file, section, address, size) for every main/ input section in RAM."""
+    regions = []
+    pending = None
+    for line in lines:
+        line = line.rstrip("\n")
+        m = SECTION_PLACED.match(line)
+        if m:
+            section, addr, size, obj = m.groups()
+        elif pending is not None and PLACED.match(line):
+            section = pending
+            addr, size, obj = PLACED.match(line).groups()
+        else:
+            m = SECTION.match(line)
+            pending = m.group(1) if m else None
+            continue
+        pending = None
+        src = MAIN_OBJECT.search(obj)
+        kind = kind_of(section)
+        size = int(size, 16)
+        if src and kind and size > 0:
+            regions.append((src.group(1), section, int(addr, 16), size, kind))
+    return regions
+
+
+def symbol_names(nm, elf):
+    """Address -> symbol name (locals too) from nm, or {} if nm isn't usable."""
+    try:
+        out = subprocess.run([nm, "-S", elf], capture_output=True, text=True,
+                             check=True).stdout
+    except (OSError, subprocess.CalledProcessError):
+        return {}
+    names = {}
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) == 4 and parts[2].lower() in "bdt":
+            names.setdefault(int(parts[0], 16), parts[3])
+    return names
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    parser.add_argument("map", help="linker map (build/<project>.map)")
+    parser.add_argument("--elf", help="firmware ELF, to name DRAM_ATTR/IRAM_ATTR regions")
+    parser.add_argument("--nm", default="riscv32-esp-elf-nm", help="nm of the ESP-IDF toolchain")
+    parser.add_argument("--min", type=int, default=256,
+                        help="list regions of at least this many bytes (totals include all)")
+    parser.add_argument("--budget", type=int,
+                        help="fail if main/ static RAM (bss + data + IRAM) exceeds this")
+    args = parser.parse_args()
+
+    with open(args.map, errors="replace") as f:
+        regions = parse_map(f)
+    if not regions:
+        # Runs after every link: a map layout it can't read must not fail the build
+        print(f"warning: no main/ sections found in {args.map} - map format not recognized, "
+              "no static memory report", file=sys.stderr)
+        return
+
+    names = symbol_names(args.nm, args.elf) if args.elf else {}
+
+    totals = defaultdict(int)
+    per_file = defaultdict(int)
+    listed = []
+    for src, section, addr, size, kind in regions:
+        totals[kind] += size
+        per_file[src] += size
+        if size >= args.min:
+            listed.append((size, src, names.get(addr, name_of(section)), kind))
+
+    print("Halo static memory (main/), largest first:")
+    for size, src, name, kind in sorted(listed, reverse=True):
+        print(f"  {src:<18} {name:<32} {kind:<4} {size:7d}")
+    print()
+    print("Per file:")
+    for src, size in sorted(per_file.items(), key=lambda kv: -kv[1]):
+        print(f"  {src:<18} {size:7d}")
+    total = sum(totals.values())
+    print()
+    print(f"main/ static RAM: {total} bytes (bss {totals['bss']}, data {totals['data']}, "
+          f"IRAM code {totals['iram']})")
+
+    if args.budget is not None and total > args.budget:
+        print(f"Over budget by {total - args.budget} bytes (budget {args.budget})", file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
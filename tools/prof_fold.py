@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""
+Symbolize a 'prof:dump' from the Halo serial log into folded stacks.
+
+prof:dump (main/halo_profiler.c) prints one line per distinct stack between
+'PROF BEGIN' and 'PROF END', with raw addresses, root first:
+
+    PROF:zigbee_main;0x42012345;0x4201abcd 57
+
+This script takes the last complete dump in the log and resolves every
+address against the firmware ELF with addr2line (one batched call). Stacks
+that resolve to the same functions are merged. The output is the folded
+format that flamegraph.pl and speedscope read:
+
+    zigbee_main;esp_zb_main_loop_iteration;zb_zdo_handler 57
+
+Usage:
+    idf.py monitor | tee halo.log          # prof:start ... prof:dump
+    python tools/prof_fold.py halo.log > halo.folded
+    flamegraph.pl halo.folded > halo.svg
+
+The ELF must be the exact build that ran. Return addresses (every frame but
+the leaf) are looked up one byte earlier, so they resolve to the call
+instruction instead of the line after it.
+"""
+
+import argparse
+import re
+import subprocess
+import sys
+from collections import Counter
+
+ANSI = re.compile(r"\x1b\[[0-9;]*m")
+LINE = re.compile(r"PROF:(.+) (\d+)\s*$")
+
+
+def last_dump(lines):
+    """(stack frames, count) pairs of the last BEGIN..END block, or None."""
+    current = None
+    found = None
+    for line in lines:
+        line = ANSI.sub("", line)
+        if "PROF BEGIN" in line:
+            current = []
+        elif "PROF END" in line and current is not None:
+            found = current
+            current = None
+        elif current is not None:
+            m = LINE.search(line)
+            if m:
+                current.append((m.group(1).split(";"), int(m.group(2))))
+    return found
+
+
+def symbolize(addr2line, elf, addresses):
+    """Map address -> function name with one addr2line run."""
+    addresses = sorted(addresses)
+    if not addresses:
+        return {}
+    proc = subprocess.run(
+        [addr2line, "-f", "-C", "-e", elf],
+        input="".join(f"0x{a:08x}\n" for a in addresses),
+        capture_output=True, text=True, check=True)
+    out = proc.stdout.splitlines()
+    # Two lines per address: function, then file:line
+    names = {}
+    for i, addr in enumerate(addresses):
+        name = out[2 * i] if 2 * i < len(out) else "??"
+        names[addr] = name if name != "??" else f"0x{addr:08x}"
+    return names
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    parser.add_argument("log", help="serial log file ('-' for stdin)")
+    parser.add_argument("--elf", default="build/hamurabi_led_controller.elf",
+                        help="firmware ELF of the build that was profiled")
+    parser.add_argument("--addr2line", default="riscv32-esp-elf-addr2line",
+                        help="addr2line of the ESP-IDF toolchain")
+    parser.add_argument("--raw", action="store_true",
+                        help="keep addresses, only merge and print")
+    args = parser.parse_args()
+
+    source = sys.stdin if args.log == "-" else open(args.log, errors="replace")
+    with source:
+        stacks = last_dump(source)
+    if not stacks:
+        sys.exit("No complete PROF BEGIN..END block in the log")
+
+    # frames[0] is the task name, frames[-1] the interrupted PC (leaf)
+    def lookup_addr(frames, i):
+        addr = int(frames[i], 16)
+        return addr if i == len(frames) - 1 else addr - 1
+
+    names = {}
+    if not args.raw:
+        wanted = {lookup_addr(f, i) for f, _ in stacks for i in range(1, len(f))}
+        try:
+            names = symbolize(args.addr2line, args.elf, wanted)
+        except (OSError, subprocess.CalledProcessError) as e:
+            sys.exit(f"addr2line failed ({e}); pass --addr2line/--elf or use --raw")
+
+    folded = Counter()
+    for frames, count in stacks:
+        out = [frames[0]]
+        for i in range(1, len(frames)):
+            out.append(names.get(lookup_addr(frames, i), frames[i]))
+        folded[";".join(out)] += count
+
+    for stack, count in folded.most_common():
+        print(f"{stack} {count}")
+    total = sum(folded.values())
+    print(f"{total} samples, {len(folded)} stacks", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
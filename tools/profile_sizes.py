@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""
+Build every Halo profile and compare flash and RAM use side by side.
+
+A profile is an sdkconfig overlay at the top of the repo
+(sdkconfig.profile.<name>) that turns subsystems and effects on or off
+under "Halo Features". Each one is built into its own build-<name>
+directory, on top of sdkconfig.defaults:
+
+    idf.py -B build-<name> -D SDKCONFIG=build-<name>/sdkconfig \\
+           -D SDKCONFIG_DEFAULTS="sdkconfig.defaults;sdkconfig.profile.<name>" build
+
+Then the report lists, per profile, the app image size, the share of the
+ota_0 slot it fills, static DRAM (data + bss) and IRAM, all in bytes.
+"image" is the app binary written to an OTA slot, so the ota_0 column
+shows how much smaller partitions.csv could make the app slots for that
+profile (leave room for growth and the delta OTA patch headroom).
+
+Run from an ESP-IDF shell (idf.py and the toolchain on PATH):
+
+    python tools/profile_sizes.py                 # build and report all profiles
+    python tools/profile_sizes.py ring-only full  # just these
+    python tools/profile_sizes.py --no-build      # report existing build dirs
+"""
+
+import argparse
+import csv
+import glob
+import os
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+PROJECT = "hamurabi_led_controller"
+PROFILE_PREFIX = "sdkconfig.profile."
+
+# riscv32-esp-elf-size -A section name prefixes
+DRAM_SECTIONS = (".dram0.data", ".dram0.bss", ".noinit")
+IRAM_SECTIONS = (".iram0.text", ".iram0.data", ".iram0.bss")
+
+
+def available_profiles():
+    paths = sorted(glob.glob(os.path.join(ROOT, PROFILE_PREFIX + "*")))
+    return [os.path.basename(p)[len(PROFILE_PREFIX):] for p in paths]
+
+
+def build(profile):
+    build_dir = os.path.join(ROOT, "build-" + profile)
+    defaults = "sdkconfig.defaults;" + PROFILE_PREFIX + profile
+    cmd = ["idf.py", "-B", build_dir,
+           "-D", "SDKCONFIG=" + os.path.join(build_dir, "sdkconfig"),
+           "-D", "SDKCONFIG_DEFAULTS=" + defaults, "build"]
+    print(f"=== {profile}: {' '.join(cmd)}", flush=True)
+    subprocess.run(cmd, cwd=ROOT, check=True)
+
+
+def app_partition_size(path):
+    """Size of ota_0 in partitions.csv, or None."""
+    with open(path) as f:
+        rows = [r for r in csv.reader(f) if r and not r[0].lstrip().startswith("#")]
+    for row in rows:
+        fields = [c.strip() for c in row]
+        if len(fields) >= 5 and fields[0] == "ota_0":
+            size = fields[4].upper()
+            if size.endswith("K"):
+                return int(size[:-1], 0) * 1024
+            if size.endswith("M"):
+                return int(size[:-1], 0) * 1024 * 1024
+            return int(fields[4], 0)
+    return None
+
+
+def section_sizes(size_tool, elf):
+    out = subprocess.run([size_tool, "-A", elf], capture_output=True, text=True,
+                         check=True).stdout
+    sizes = {}
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) == 3 and parts[0].startswith(".") and parts[1].isdigit():
+            sizes[parts[0]] = int(parts[1])
+    return sizes
+
+
+def measure(profile, size_tool):
+    build_dir = os.path.join(ROOT, "build-" + profile)
+    binary = os.path.join(build_dir, PROJECT + ".bin")
+    elf = os.path.join(build_dir, PROJECT + ".elf")
+    if not (os.path.exists(binary) and os.path.exists(elf)):
+        return None
+    sections = section_sizes(size_tool, elf)
+    dram = sum(v for k, v in sections.items() if k.startswith(DRAM_SECTIONS))
+    iram = sum(v for k, v in sections.items() if k.startswith(IRAM_SECTIONS))
+    return os.path.getsize(binary), dram, iram
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    parser.add_argument("profiles", nargs="*",
+                        help="profiles to build (default: every sdkconfig.profile.*)")
+    parser.add_argument("--no-build", action="store_true",
+                        help="only report build-<profile> directories that already exist")
+    parser.add_argument("--size", default="riscv32-esp-elf-size", help="size of the ESP-IDF toolchain")
+    args = parser.parse_args()
+
+    known = available_profiles()
+    profiles = args.profiles or known
+    unknown = [p for p in profiles if p not in known]
+    if unknown:
+        sys.exit(f"Unknown profile(s): {', '.join(unknown)} (have: {', '.join(known)})")
+
+    if not args.no_build:
+        for profile in profiles:
+            build(profile)
+
+    slot = app_partition_size(os.path.join(ROOT, "partitions.csv"))
+
+    print()
+    print(f"{'profile':<12} {'image':>9} {'ota_0 used':>11} {'DRAM data+bss':>15} {'IRAM':>7}")
+    for profile in profiles:
+        sizes = measure(profile, args.size)
+        if sizes is None:
+            print(f"{profile:<12} (not built)")
+            continue
+        image, dram, iram = sizes
+        used = f"{100.0 * image / slot:.1f}%" if slot else "-"
+        print(f"{profile:<12} {image:>9} {used:>11} {dram:>15} {iram:>7}")
+    if slot:
+        print(f"\nota_0 slot: {slot} bytes (partitions.csv)")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,281 @@
+#!/usr/bin/env python3
+"""
+Simulate Halo animation sync on a jittery LAN and report the phase error.
+
+main/halo_sync.c keeps several Halos on one animation clock: a leader
+multicasts beacons and answers NTP-style time requests, and each follower
+fits offset and skew through the best exchange of each burst, then slews
+its clock towards the estimate. This script runs the same estimator for a
+leader and N followers with random crystal errors, over a network with
+random one-way delays, asymmetry, loss and the occasional WiFi power-save
+stall, and measures how far each follower's clock is from the leader's at
+every render frame.
+
+An effect's phase is a function of the shared clock, so a clock error of
+one frame period (16.7ms at 60 FPS) is one frame of visible phase error.
+
+Usage:
+    python tools/sync_sim.py
+    python tools/sync_sim.py --nodes 6 --jitter-ms 8 --stall 0.05 --minutes 30
+    python tools/sync_sim.py --skew 100 --loss 0.2 --seed 7
+
+The constants below mirror halo_sync.h; change both together.
+"""
+
+import argparse
+import random
+import statistics
+
+BEACON_MS = 1000
+POLL_MS = 2000
+BURST = 4
+BURST_GAP_MS = 25
+MAX_DELAY_US = 30000
+SAMPLES = 32
+GATE_SLACK_US = 1000
+MIN_FIT = 4
+STEP_US = 50000
+MAX_SLEW_PPM = 5000
+MAX_SKEW_PPM = 500
+
+FRAME_US = 16667            # 60 FPS render loop
+
+
+class Crystal:
+    """A unit's esp_timer: local = offset + true * (1 + skew)."""
+
+    def __init__(self, rng, skew_ppm, boot_spread_s):
+        self.skew = rng.uniform(-skew_ppm, skew_ppm) * 1e-6
+        self.offset = rng.uniform(0, boot_spread_s) * 1e6
+
+    def local(self, true_us):
+        return self.offset + true_us * (1 + self.skew)
+
+    def true(self, local_us):
+        return (local_us - self.offset) / (1 + self.skew)
+
+
+class Network:
+    """One-way delays: base + exponential jitter, plus rare power-save stalls."""
+
+    def __init__(self, rng, args):
+        self.rng = rng
+        self.args = args
+
+    def delay_us(self, uplink):
+        a = self.args
+        d = a.base_ms * 1000 + self.rng.expovariate(1 / (a.jitter_ms * 1000)) if a.jitter_ms > 0 \
+            else a.base_ms * 1000
+        if uplink:
+            d += a.asym_ms * 1000       # Follower -> leader slower than back
+        if self.rng.random() < a.stall:
+            d += self.rng.uniform(20, 300) * 1000
+        return d
+
+    def lost(self):
+        return self.rng.random() < self.args.loss
+
+    def stamp_jitter_us(self):
+        """Task wake-up latency between the packet and esp_timer_get_time()."""
+        return self.rng.expovariate(1 / self.args.sched_us) if self.args.sched_us > 0 else 0
+
+
+class Follower:
+    """halo_sync.c follower: burst min-filter, least-squares fit, slew/step."""
+
+    def __init__(self, crystal):
+        self.crystal = crystal
+        self.valid = False
+        self.base_local = 0.0
+        self.base_shared = 0.0
+        self.rate = 0.0             # Fractional, skew plus slew
+        self.skew = 0.0
+        self.samples = []
+        self.recent_delays = []     # Best round trip of the last bursts, kept or not
+        self.steps = 0
+        self.discarded = 0
+
+    def shared(self, local_us):
+        if not self.valid:
+            return local_us
+        d = local_us - self.base_local
+        return self.base_shared + d + d * self.rate
+
+    def step(self, local_us, offset_us, skew):
+        self.base_local = local_us
+        self.base_shared = local_us + offset_us
+        self.rate = skew
+        self.valid = True
+        self.steps += 1
+
+    def set_rate(self, local_us, rate):
+        self.base_shared = self.shared(local_us)
+        self.base_local = local_us
+        self.rate = rate
+
+    def fit(self, newest):
+        if len(self.samples) < MIN_FIT:
+            return newest[1], self.skew
+        xs = [(s[0] - newest[0]) / 1e6 for s in self.samples]
+        ys = [s[1] - newest[1] for s in self.samples]
+        xm, ym = statistics.fmean(xs), statistics.fmean(ys)
+        sxx = sum((x - xm) ** 2 for x in xs)
+        sxy = sum((x - xm) * (y - ym) for x, y in zip(xs, ys))
+        slope = sxy / sxx if sxx > 0 else 0.0
+        if abs(slope) > MAX_SKEW_PPM:
+            slope = self.skew * 1e6
+        return newest[1] + ym - slope * xm, slope * 1e-6
+
+    def finish_burst(self, best, now_local):
+        if best is not None and best[2] <= MAX_DELAY_US:
+            self.recent_delays = (self.recent_delays + [best[2]])[-SAMPLES:]
+        if best is None or best[2] > MAX_DELAY_US or \
+                best[2] > 2 * min(self.recent_delays) + GATE_SLACK_US:
+            # Nothing usable (a slow round trip was queued somewhere, so its
+            # offset is off): the last correction is done, run on the skew
+            self.discarded += 1
+            self.set_rate(now_local, self.skew)
+            return
+        local_us, offset_us, _ = best
+        if len(self.samples) >= MIN_FIT:
+            predicted = self.shared(local_us) - local_us
+            if abs(offset_us - predicted) > STEP_US:
+                self.samples = []
+        self.samples = (self.samples + [best])[-SAMPLES:]
+
+        offset, skew = self.fit(best)
+        self.skew = skew
+        target = now_local + offset + skew * (now_local - local_us)
+        error = target - self.shared(now_local)
+        if abs(error) > STEP_US:
+            self.step(now_local, target - now_local, skew)
+            return
+        slew = error / (POLL_MS * 1000)
+        slew = max(-MAX_SLEW_PPM * 1e-6, min(MAX_SLEW_PPM * 1e-6, slew))
+        self.set_rate(now_local, skew + slew)
+
+
+def simulate(args):
+    rng = random.Random(args.seed)
+    net = Network(rng, args)
+    leader = Crystal(rng, args.skew, args.boot_spread)
+    followers = [Follower(Crystal(rng, args.skew, args.boot_spread)) for _ in range(args.nodes - 1)]
+    duration_us = args.minutes * 60e6
+    warmup_us = args.warmup * 1e6
+
+    errors = [[] for _ in followers]
+    free_run = [[] for _ in followers]
+    next_frame = 0.0
+    next_poll = [rng.uniform(0, BEACON_MS) * 1000 for _ in followers]   # First beacon heard
+
+    def measure_until(t_end):
+        nonlocal next_frame
+        while next_frame < t_end:
+            if next_frame >= warmup_us:
+                lead = leader.local(next_frame)
+                for i, f in enumerate(followers):
+                    local = f.crystal.local(next_frame)
+                    errors[i].append(f.shared(local) - lead)
+                    free_run[i].append((local - f.crystal.offset) - (lead - leader.offset))
+            next_frame += FRAME_US
+
+    while True:
+        i = min(range(len(followers)), key=lambda k: next_poll[k])
+        t = next_poll[i]
+        if t >= duration_us:
+            break
+        measure_until(t)
+        f = followers[i]
+
+        if not f.valid:
+            # First beacon: coarse step to the leader's send time
+            beacon_tx = t - net.delay_us(False)
+            rx_local = f.crystal.local(t) + net.stamp_jitter_us()
+            f.step(rx_local, leader.local(beacon_tx) - rx_local, 0.0)
+
+        best = None
+        for k in range(BURST):
+            send = t + k * BURST_GAP_MS * 1000
+            if net.lost():
+                continue
+            t1 = f.crystal.local(send) + net.stamp_jitter_us()
+            arrive = send + net.delay_us(True)
+            t2 = leader.local(arrive) + net.stamp_jitter_us()
+            t3 = t2 + 150 + net.stamp_jitter_us()           # Leader turnaround
+            if net.lost():
+                continue
+            back = leader.true(t3) + net.delay_us(False)
+            if back > t + BURST * BURST_GAP_MS * 1000:
+                continue                                    # Too late for this burst
+            t4 = f.crystal.local(back) + net.stamp_jitter_us()
+            delay = (t4 - t1) - (t3 - t2)
+            sample = ((t1 + t4) / 2, ((t2 - t1) + (t3 - t4)) / 2, delay)
+            if best is None or delay < best[2]:
+                best = sample
+        end = t + BURST * BURST_GAP_MS * 1000
+        measure_until(end)
+        f.finish_burst(best, f.crystal.local(end))
+        next_poll[i] = t + POLL_MS * 1000
+    measure_until(duration_us)
+    return followers, leader, errors, free_run
+
+
+def percentile(values, p):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(p / 100 * len(ordered)))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    parser.add_argument("--nodes", type=int, default=4, help="units, leader included")
+    parser.add_argument("--minutes", type=float, default=10, help="simulated time")
+    parser.add_argument("--warmup", type=float, default=30, help="seconds left out of the statistics")
+    parser.add_argument("--skew", type=float, default=40, help="crystal error, +/- ppm")
+    parser.add_argument("--boot-spread", type=float, default=3600,
+                        help="units booted up to this many seconds apart")
+    parser.add_argument("--base-ms", type=float, default=1.5, help="one-way delay floor")
+    parser.add_argument("--jitter-ms", type=float, default=3.0, help="mean of the random extra delay")
+    parser.add_argument("--asym-ms", type=float, default=0.5, help="extra uplink delay (not observable)")
+    parser.add_argument("--stall", type=float, default=0.02,
+                        help="probability of a 20-300ms power-save stall per packet")
+    parser.add_argument("--loss", type=float, default=0.05, help="packet loss probability")
+    parser.add_argument("--sched-us", type=float, default=200, help="mean timestamping latency")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    if args.nodes < 2:
+        parser.error("--nodes needs a leader and at least one follower")
+    if args.minutes * 60 <= args.warmup:
+        parser.error("--minutes must be longer than --warmup")
+
+    followers, leader, errors, free_run = simulate(args)
+
+    print(f"{args.nodes} units, {args.minutes:g} min, jitter {args.jitter_ms:g}ms mean, "
+          f"stalls {args.stall:.0%}, loss {args.loss:.0%}, asymmetry {args.asym_ms:g}ms")
+    print(f"leader skew {leader.skew * 1e6:+.1f} ppm; errors after {args.warmup:g}s, "
+          f"1 frame = {FRAME_US / 1000:.1f}ms")
+    print()
+    print("unit  skew ppm (fit)     p50 ms   p95 ms   p99 ms   max ms  in frame  steps  dropped bursts  "
+          "unsynced drift")
+    worst = []
+    for i, f in enumerate(followers):
+        abs_err = [abs(e) for e in errors[i]]
+        true_rel = ((1 + leader.skew) / (1 + f.crystal.skew) - 1) * 1e6     # What the fit sees
+        in_frame = sum(e < FRAME_US / 2 for e in abs_err) / len(abs_err)
+        drift = abs(free_run[i][-1] - free_run[i][0]) / 1000
+        print(f"{i + 1:4}  {true_rel:+7.1f} ({f.skew * 1e6:+7.1f})"
+              f"  {percentile(abs_err, 50) / 1000:8.2f} {percentile(abs_err, 95) / 1000:8.2f}"
+              f" {percentile(abs_err, 99) / 1000:8.2f} {max(abs_err) / 1000:8.2f}"
+              f"  {in_frame:7.1%}  {f.steps:5}  {f.discarded:14}  {drift:8.0f}ms")
+        worst.append(max(abs_err))
+
+    frames = max(worst) / FRAME_US
+    phase_deg = max(worst) / 1e6 * 360      # Of a 1 Hz effect, for scale
+    print()
+    print(f"worst residual: {max(worst) / 1000:.2f}ms = {frames:.2f} frames "
+          f"({phase_deg:.1f} deg of a 1s cycle)")
+    print("PASS: every unit within half a frame" if max(worst) < FRAME_US / 2 else
+          "FAIL: a unit was more than half a frame off")
+
+
+if __name__ == "__main__":
+    main()
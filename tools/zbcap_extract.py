@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""
+Turn a 'zbcap:dump' from the Halo serial log into a .pcap file.
+
+zbcap:dump (main/zigbee_capture.c) prints the capture ring as base64 log
+lines between 'ZBCAP BEGIN' and 'ZBCAP END'. This script finds the last
+complete dump in the log, decodes it and writes the pcap, which Wireshark
+opens as IEEE 802.15.4 / Zigbee (link type 230).
+
+Usage:
+    idf.py monitor | tee halo.log          # then send zbcap:dump
+    python tools/zbcap_extract.py halo.log -o halo.pcap
+
+For live capture use zbcap:udp:<ip>:<port> instead:
+    nc -ul 17754 > halo.pcap
+"""
+
+import argparse
+import base64
+import re
+import struct
+import sys
+
+ANSI = re.compile(r"\x1b\[[0-9;]*m")
+DATA = re.compile(r"ZBCAP:([A-Za-z0-9+/=]+)")
+
+
+def last_dump(lines):
+    """Base64 chunks of the last BEGIN..END block, or None."""
+    chunks = None
+    found = None
+    for line in lines:
+        line = ANSI.sub("", line)
+        if "ZBCAP BEGIN" in line:
+            chunks = []
+        elif "ZBCAP END" in line and chunks is not None:
+            found = chunks
+            chunks = None
+        elif chunks is not None:
+            m = DATA.search(line)
+            if m:
+                chunks.append(m.group(1))
+    return found
+
+
+def count_records(pcap):
+    """Walk the records to make sure nothing was lost from the log."""
+    offset = 24
+    frames = 0
+    while offset + 16 <= len(pcap):
+        _, _, incl_len, _ = struct.unpack_from("<IIII", pcap, offset)
+        offset += 16 + incl_len
+        frames += 1
+    return frames, offset == len(pcap)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    parser.add_argument("log", help="serial log file ('-' for stdin)")
+    parser.add_argument("-o", "--output", default="halo.pcap", help="pcap file to write")
+    args = parser.parse_args()
+
+    source = sys.stdin if args.log == "-" else open(args.log, errors="replace")
+    with source:
+        chunks = last_dump(source)
+    if not chunks:
+        sys.exit("No complete ZBCAP BEGIN..END block in the log")
+
+    pcap = b"".join(base64.b64decode(c) for c in chunks)
+    if len(pcap) < 24 or struct.unpack_from("<I", pcap)[0] != 0xA1B2C3D4:
+        sys.exit("Dump does not start with a pcap header")
+
+    frames, complete = count_records(pcap)
+    if not complete:
+        print("warning: dump is truncated (lost log lines?)", file=sys.stderr)
+
+    with open(args.output, "wb") as f:
+        f.write(pcap)
+    print(f"{frames} frames -> {args.output}")
+
+
+if __name__ == "__main__":
+    main()
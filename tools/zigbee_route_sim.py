@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""
+Zigbee routing cost simulation for Halo.
+
+Compares the radio traffic the coordinator causes with default (AODV-style)
+route discovery and with concentrator (many-to-one) routing, as used by
+main/zigbee_routing.c. Nodes are scattered over a floor plan and linked when
+in radio range. Routers rebroadcast every flood exactly once.
+
+  default:       every destination whose route expired is discovered
+                 with its own route request flood + a route reply back
+  concentrator:  one many-to-one request flood per interval, then one
+                 route record per device on its first frame after it,
+                 and source-routed frames from the hub
+
+Usage:
+    python tools/zigbee_route_sim.py                   # 10..100 node sweep
+    python tools/zigbee_route_sim.py --nodes 60 --hours 24 --seed 7
+
+Only counts frames and hops; MAC retries, link loss and timing are ignored.
+"""
+
+import argparse
+import math
+import random
+from collections import deque
+
+
+def build_mesh(nodes, area_m, range_m, router_share, rng):
+    """Random geometric graph. Node 0 is the coordinator, placed in the middle."""
+    pos = [(area_m / 2, area_m / 2)]
+    pos += [(rng.uniform(0, area_m), rng.uniform(0, area_m)) for _ in range(nodes)]
+    routers = {0} | {i for i in range(1, nodes + 1) if rng.random() < router_share}
+    links = {i: set() for i in range(len(pos))}
+    for a in range(len(pos)):
+        for b in range(a + 1, len(pos)):
+            if math.dist(pos[a], pos[b]) <= range_m and (a in routers or b in routers):
+                links[a].add(b)
+                links[b].add(a)
+    return routers, links
+
+
+def hops_from_hub(routers, links):
+    """BFS over router-forwarded paths: end devices only terminate a path."""
+    hops = {0: 0}
+    queue = deque([0])
+    while queue:
+        node = queue.popleft()
+        if node not in routers:
+            continue
+        for nxt in links[node]:
+            if nxt not in hops:
+                hops[nxt] = hops[node] + 1
+                queue.append(nxt)
+    return hops
+
+
+def reachable_routers(routers, hops):
+    return sum(1 for r in routers if r in hops)
+
+
+def simulate(args, nodes, rng):
+    routers, links = build_mesh(nodes, args.area, args.range, args.router_share, rng)
+    hops = hops_from_hub(routers, links)
+    devices = [n for n in hops if n != 0]
+    if not devices:
+        return None
+
+    flood = reachable_routers(routers, hops)          # one rebroadcast per router
+    minutes = args.hours * 60
+    cmds_per_dev = int(args.cmds_per_hour * args.hours)
+
+    # Default routing: discovery whenever a route has expired since the last
+    # frame to that destination (commands spread evenly over the period).
+    # Commands closer together than the expiry keep the route alive, so
+    # only the first one discovers it.
+    gap_min = minutes / max(cmds_per_dev, 1)
+    discoveries_per_dev = cmds_per_dev if gap_min >= args.route_expiry_min else 1
+    default_disc = sum(discoveries_per_dev * (flood + hops[d]) for d in devices)
+
+    # Concentrator: periodic many-to-one flood plus one route record per
+    # device per interval in which it talks (record travels hops[d] frames)
+    intervals = math.ceil(minutes / args.mtorr_interval_min)
+    active_intervals = min(intervals, cmds_per_dev)
+    conc_disc = intervals * flood + sum(active_intervals * hops[d] for d in devices)
+
+    data = sum(cmds_per_dev * hops[d] for d in devices)
+    avg_hops = sum(hops[d] for d in devices) / len(devices)
+    return {
+        "nodes": nodes,
+        "reached": len(devices),
+        "routers": flood,
+        "avg_hops": avg_hops,
+        "max_hops": max(hops[d] for d in devices),
+        "data": data,
+        "default": default_disc,
+        "conc": conc_disc,
+        "latency_ms": avg_hops * args.hop_ms,
+    }
+
+
+def print_row(r):
+    ratio = r["default"] / r["conc"] if r["conc"] else float("inf")
+    print(f"{r['nodes']:>6} {r['reached']:>8} {r['routers']:>8} {r['avg_hops']:>8.1f} {r['max_hops']:>5}"
+          f" {r['data']:>9} {r['default']:>12} {r['conc']:>12} {ratio:>7.2f}x {r['latency_ms']:>8.0f}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--nodes", type=int, nargs="*", default=[10, 30, 60, 100],
+                        help="node counts to simulate (default: 10 30 60 100)")
+    parser.add_argument("--area", type=float, default=40.0, help="floor plan side, metres")
+    parser.add_argument("--range", type=float, default=12.0, help="indoor radio range, metres")
+    parser.add_argument("--router-share", type=float, default=0.6, help="fraction of mains-powered routers")
+    parser.add_argument("--hours", type=float, default=24.0)
+    parser.add_argument("--cmds-per-hour", type=float, default=4.0, help="unicasts per device per hour")
+    parser.add_argument("--route-expiry-min", type=float, default=5.0, help="idle route lifetime (default routing)")
+    parser.add_argument("--mtorr-interval-min", type=float, default=5.0,
+                        help="many-to-one request period (ZB_ROUTE_MTORR_INTERVAL_S / 60)")
+    parser.add_argument("--hop-ms", type=float, default=8.0, help="per-hop forward latency estimate")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    print(f"{args.hours:.0f}h, {args.cmds_per_hour:g} cmds/device/h, route expiry {args.route_expiry_min:g} min, "
+          f"MTORR every {args.mtorr_interval_min:g} min")
+    print(f"{'nodes':>6} {'reached':>8} {'routers':>8} {'avg hop':>8} {'max':>5} {'data':>9}"
+          f" {'disc(def)':>12} {'disc(conc)':>12} {'saving':>8} {'lat ms':>8}")
+    for n in args.nodes:
+        result = simulate(args, n, rng)
+        if result is None:
+            print(f"{n:>6}  mesh not connected to the hub - increase --range")
+            continue
+        print_row(result)
+
+
+if __name__ == "__main__":
+    main()